@@ -0,0 +1,131 @@
+/* samaya-alloc-counter.c
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include "samaya-alloc-counter.h"
+
+/*  The real allocators of glibc, the interposed functions below must never call into GLib since
+    GLib itself allocates through them.
+*/
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void *ptr);
+
+static guint64 allocationCount = 0;
+static guint64 allocatedBytes = 0;
+static guint64 freeCount = 0;
+
+static inline void count_allocation(size_t size)
+{
+    __atomic_add_fetch(&allocationCount, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&allocatedBytes, size, __ATOMIC_RELAXED);
+}
+
+static inline void count_free(void *ptr)
+{
+    if (ptr != NULL) {
+        __atomic_add_fetch(&freeCount, 1, __ATOMIC_RELAXED);
+    }
+}
+
+
+/* ============================================================================
+ * Interposed Allocators
+ * ============================================================================ */
+
+void *malloc(size_t size)
+{
+    count_allocation(size);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    count_allocation(count * size);
+    return __libc_calloc(count, size);
+}
+
+// Moving a block to a new size counts as freeing it and allocating another, shrinking it to
+// nothing only as the free.
+void *realloc(void *ptr, size_t size)
+{
+    count_free(ptr);
+    if (size != 0 || ptr == NULL) {
+        count_allocation(size);
+    }
+
+    return __libc_realloc(ptr, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    count_allocation(size);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+    count_allocation(size);
+
+    void *ptr = __libc_memalign(alignment, size);
+    if (ptr == NULL && size != 0) {
+        return ENOMEM;
+    }
+
+    *memptr = ptr;
+    return 0;
+}
+
+void free(void *ptr)
+{
+    count_free(ptr);
+    __libc_free(ptr);
+}
+
+
+/* ============================================================================
+ * Public API
+ * ============================================================================ */
+
+AllocCounterSample alloc_counter_sample(void)
+{
+    return (AllocCounterSample) {
+        .allocations = __atomic_load_n(&allocationCount, __ATOMIC_RELAXED),
+        .bytes = __atomic_load_n(&allocatedBytes, __ATOMIC_RELAXED),
+        .frees = __atomic_load_n(&freeCount, __ATOMIC_RELAXED),
+    };
+}
+
+AllocCounterSample alloc_counter_delta(AllocCounterSample start, AllocCounterSample end)
+{
+    return (AllocCounterSample) {
+        .allocations = end.allocations - start.allocations,
+        .bytes = end.bytes - start.bytes,
+        .frees = end.frees - start.frees,
+    };
+}
+
+gint64 alloc_counter_live_blocks(AllocCounterSample sample)
+{
+    return (gint64) (sample.allocations - sample.frees);
+}
@@ -0,0 +1,47 @@
+/* samaya-alloc-counter.h
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <glib.h>
+
+/*  Allocation accounting for benchmarks and long running tests.
+
+    Linking samaya-alloc-counter.c into an executable interposes malloc, calloc, realloc and the
+    aligned allocators of the C library, so every allocation made by the process (including the
+    ones made inside GLib, GTK and cairo) is counted before being forwarded to glibc. Frees are
+    counted as well, the difference is the number of blocks still allocated.
+*/
+
+typedef struct
+{
+    guint64 allocations;
+    guint64 bytes;
+    guint64 frees;
+} AllocCounterSample;
+
+// Reads the number of allocations, allocated bytes and frees since the process started.
+AllocCounterSample alloc_counter_sample(void);
+
+// Blocks allocated but not freed yet, as of the sample.
+gint64 alloc_counter_live_blocks(AllocCounterSample sample);
+
+// Returns the difference between two samples, end must have been taken after start.
+AllocCounterSample alloc_counter_delta(AllocCounterSample start, AllocCounterSample end);
@@ -0,0 +1,465 @@
+/* samaya-bench.c
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include "samaya-calendar.h"
+#include "samaya-schedule.h"
+#include "samaya-session-private.h"
+#include "samaya-session.h"
+#include "samaya-timer-private.h"
+#include "samaya-timer.h"
+
+/*  Micro benchmarks for the timer, session and formatting hot paths.
+
+    Everything runs against a fake clock so that the measured code never waits on real time, the
+    results are printed as JSON and compared against a baseline key file. Benchmarks slower than
+    the baseline by more than REPORT_TOLERANCE are only reported, the baseline was measured on one
+    machine. The process exits with a non zero status for them only when --tolerance is given.
+*/
+
+#define MIN_RUN_TIME_US (50 * 1000)
+#define MAX_ITERATIONS (1 << 24)
+#define REPETITIONS 5
+
+// Slowdown against the baseline that is reported as a regression when no tolerance was given.
+#define REPORT_TOLERANCE 1.5
+
+// Long enough that a timer never completes while being benchmarked.
+#define BENCH_DURATION_MINUTES 1000000.0f
+
+// A busy schedule, evaluating it should not depend on the number of rules.
+#define BENCH_SCHEDULE_RULES 300
+
+// A crowded calendar, a few meetings every hour of the expansion window.
+#define BENCH_CALENDAR_EVENTS 5000
+
+typedef struct
+{
+    const char *name;
+    void (*run)(guint64 iterations);
+} BenchCase;
+
+typedef struct
+{
+    const char *name;
+    guint64 iterations;
+    gdouble ns_per_op;
+    gdouble baseline_ns_per_op;
+    gboolean regressed;
+} BenchResult;
+
+
+/* ============================================================================
+ * Static Variables
+ * ============================================================================ */
+
+static gint64 fakeClockUs = 0;
+
+static TimerPtr benchTimer = NULL;
+static SessionManagerPtr benchSession = NULL;
+
+static volatile gfloat benchSink;
+
+static gchar *benchCalendarPath = NULL;
+
+static gchar *baselinePath = NULL;
+static gchar *outputPath = NULL;
+static gboolean updateBaseline = FALSE;
+static gdouble tolerance = 0.0;
+
+static const GOptionEntry benchOptions[] = {
+    {"baseline", 'b', 0, G_OPTION_ARG_FILENAME, &baselinePath,
+     "Baseline key file to compare the results against", "FILE"},
+    {"output", 'o', 0, G_OPTION_ARG_FILENAME, &outputPath, "Also write the JSON results to FILE",
+     "FILE"},
+    {"update-baseline", 0, 0, G_OPTION_ARG_NONE, &updateBaseline,
+     "Overwrite the baseline with the measured results", NULL},
+    {"tolerance", 't', 0, G_OPTION_ARG_DOUBLE, &tolerance,
+     "Fail when slower than the baseline by more than this factor, otherwise only report",
+     "FACTOR"},
+    G_OPTION_ENTRY_NULL,
+};
+
+
+/* ============================================================================
+ * Fake Clock
+ * ============================================================================ */
+
+static gint64 fake_clock(void)
+{
+    return fakeClockUs;
+}
+
+static void fake_clock_advance(gint64 delta_us)
+{
+    fakeClockUs += delta_us;
+}
+
+
+/* ============================================================================
+ * Benchmark Cases
+ * ============================================================================ */
+
+static void bench_process_transition(guint64 iterations)
+{
+    tm_process_transition(benchTimer, EvReset);
+
+    for (guint64 i = 0; i < iterations; i++) {
+        fake_clock_advance(G_USEC_PER_SEC);
+        tm_process_transition(benchTimer, (i & 1) ? EvStop : EvStart);
+    }
+
+    tm_process_transition(benchTimer, EvReset);
+}
+
+static void bench_get_progress(guint64 iterations)
+{
+    tm_process_transition(benchTimer, EvReset);
+    tm_process_transition(benchTimer, EvStart);
+
+    for (guint64 i = 0; i < iterations; i++) {
+        fake_clock_advance(16 * 1000);
+        benchSink = tm_get_progress(benchTimer);
+    }
+
+    tm_process_transition(benchTimer, EvReset);
+}
+
+static void bench_run_tick(guint64 iterations)
+{
+    tm_process_transition(benchTimer, EvReset);
+    tm_process_transition(benchTimer, EvStart);
+
+    for (guint64 i = 0; i < iterations; i++) {
+        fake_clock_advance(G_USEC_PER_SEC);
+        tm_run_tick(benchTimer);
+    }
+
+    tm_process_transition(benchTimer, EvReset);
+}
+
+static void bench_format_time(guint64 iterations)
+{
+    for (guint64 i = 0; i < iterations; i++) {
+        sm_format_time(benchSession, (gint64) ((i * 997) % (180 * 60 * 1000)));
+    }
+}
+
+static void bench_set_routine(guint64 iterations)
+{
+    for (guint64 i = 0; i < iterations; i++) {
+        sm_set_routine((RoutineType) (i % 3), benchSession);
+    }
+}
+
+static void bench_session_complete(guint64 iterations)
+{
+    for (guint64 i = 0; i < iterations; i++) {
+        on_session_complete(NULL);
+    }
+}
+
+// Uncontended, which is the common case for a reader on another thread.
+static void bench_snapshot(guint64 iterations)
+{
+    SmSnapshot snapshot;
+
+    for (guint64 i = 0; i < iterations; i++) {
+        sm_snapshot(&snapshot);
+        benchSink = snapshot.work_duration;
+    }
+}
+
+static void set_up_schedule(void)
+{
+    ScRule rules[BENCH_SCHEDULE_RULES];
+
+    for (guint i = 0; i < BENCH_SCHEDULE_RULES; i++) {
+        g_autofree gchar *text = g_strdup_printf("%s %02u:%02u", (i % 3) ? "weekdays" : "weekends",
+                                                 (i * 7) % 24, (i * 13) % 60);
+        sc_parse_rule(text, &rules[i], NULL);
+    }
+
+    sc_set_rules(rules, BENCH_SCHEDULE_RULES);
+}
+
+static void bench_next_start(guint64 iterations)
+{
+    gint64 real_us = g_get_real_time();
+
+    // Steps by a prime number of seconds, so the starting minute moves around the week.
+    for (guint64 i = 0; i < iterations; i++) {
+        gint64 offset_us = (gint64) (i % 100000) * 7919 * G_USEC_PER_SEC;
+        benchSink = (gfloat) sc_next_start_after(real_us + offset_us);
+    }
+}
+
+static void set_up_calendar(void)
+{
+    g_autoptr(GString) contents = g_string_new("BEGIN:VCALENDAR\r\nVERSION:2.0\r\n");
+    gint64 now_s = g_get_real_time() / G_USEC_PER_SEC;
+    gint64 step_s = (gint64) CL_WINDOW_DAYS * 24 * 60 * 60 / BENCH_CALENDAR_EVENTS;
+
+    for (guint i = 0; i < BENCH_CALENDAR_EVENTS; i++) {
+        g_autoptr(GDateTime) start = g_date_time_new_from_unix_utc(now_s + i * step_s);
+        g_autofree gchar *dtstart = g_date_time_format(start, "%Y%m%dT%H%M%SZ");
+
+        g_string_append_printf(contents,
+                               "BEGIN:VEVENT\r\nUID:bench-%u\r\nDTSTART:%s\r\n"
+                               "DURATION:PT%uM\r\nEND:VEVENT\r\n",
+                               i, dtstart, 5 + i % 40);
+    }
+    g_string_append(contents, "END:VCALENDAR\r\n");
+
+    gint fd = g_file_open_tmp("samaya-bench-XXXXXX.ics", &benchCalendarPath, NULL);
+    if (fd < 0) {
+        return;
+    }
+    g_close(fd, NULL);
+
+    g_file_set_contents(benchCalendarPath, contents->str, contents->len, NULL);
+
+    const char *const paths[] = {benchCalendarPath, NULL};
+    cl_enable(paths);
+}
+
+static void tear_down_calendar(void)
+{
+    cl_disable();
+
+    if (benchCalendarPath != NULL) {
+        g_unlink(benchCalendarPath);
+        g_clear_pointer(&benchCalendarPath, g_free);
+    }
+}
+
+static void bench_find_busy(guint64 iterations)
+{
+    gint64 real_us = g_get_real_time();
+    ClInterval busy;
+
+    // Steps by a prime number of seconds through the first four weeks.
+    for (guint64 i = 0; i < iterations; i++) {
+        gint64 start_us = real_us + (gint64) (i % 300) * 7919 * G_USEC_PER_SEC;
+        benchSink = (gfloat) cl_find_busy(start_us, start_us + 25 * 60 * G_USEC_PER_SEC, &busy);
+    }
+}
+
+static const BenchCase benchCases[] = {
+    {"tm_process_transition", bench_process_transition},
+    {"tm_get_progress", bench_get_progress},
+    {"tm_run_tick", bench_run_tick},
+    {"sm_format_time", bench_format_time},
+    {"sm_set_routine", bench_set_routine},
+    {"on_session_complete", bench_session_complete},
+    {"sm_snapshot", bench_snapshot},
+    {"sc_next_start_after", bench_next_start},
+    {"cl_find_busy", bench_find_busy},
+};
+
+
+/* ============================================================================
+ * Measurement and Reporting
+ * ============================================================================ */
+
+static gdouble measure_ns_per_op(const BenchCase *bench, guint64 *iterations_out)
+{
+    guint64 iterations = 1024;
+
+    // Grow the iteration count until a single run is long enough for the clock resolution to
+    // stop mattering.
+    for (;;) {
+        gint64 start_us = g_get_monotonic_time();
+        bench->run(iterations);
+        gint64 elapsed_us = g_get_monotonic_time() - start_us;
+
+        if (elapsed_us >= MIN_RUN_TIME_US || iterations >= MAX_ITERATIONS) {
+            break;
+        }
+        iterations *= 4;
+    }
+
+    gdouble best_ns_per_op = G_MAXDOUBLE;
+
+    for (guint rep = 0; rep < REPETITIONS; rep++) {
+        gint64 start_us = g_get_monotonic_time();
+        bench->run(iterations);
+        gint64 elapsed_us = g_get_monotonic_time() - start_us;
+
+        best_ns_per_op = MIN(best_ns_per_op, (gdouble) elapsed_us * 1000.0 / (gdouble) iterations);
+    }
+
+    *iterations_out = iterations;
+    return best_ns_per_op;
+}
+
+static gdouble get_tolerance(void)
+{
+    return tolerance > 0.0 ? tolerance : REPORT_TOLERANCE;
+}
+
+static void compare_with_baseline(GKeyFile *baseline, BenchResult *result)
+{
+    g_autoptr(GError) error = NULL;
+
+    result->baseline_ns_per_op = 0.0;
+    result->regressed = FALSE;
+
+    if (baseline == NULL) {
+        return;
+    }
+
+    gdouble expected = g_key_file_get_double(baseline, "ns-per-op", result->name, &error);
+    if (error != NULL) {
+        g_printerr("No baseline for %s, skipping comparison.\n", result->name);
+        return;
+    }
+
+    result->baseline_ns_per_op = expected;
+    result->regressed = (expected > 0.0 && result->ns_per_op > expected * get_tolerance());
+}
+
+static gchar *format_results_json(const BenchResult *results, guint n_results)
+{
+    GString *json = g_string_new("{\n");
+    gchar number[G_ASCII_DTOSTR_BUF_SIZE];
+
+    g_string_append(json, "  \"unit\": \"ns/op\",\n");
+    g_string_append_printf(json, "  \"tolerance\": %s,\n",
+                           g_ascii_formatd(number, sizeof(number), "%.2f", get_tolerance()));
+    g_string_append(json, "  \"benchmarks\": [\n");
+
+    for (guint i = 0; i < n_results; i++) {
+        const BenchResult *result = &results[i];
+
+        g_string_append_printf(json, "    {\"name\": \"%s\", ", result->name);
+        g_string_append_printf(json, "\"iterations\": %" G_GUINT64_FORMAT ", ", result->iterations);
+        g_string_append_printf(json, "\"ns_per_op\": %s, ",
+                               g_ascii_formatd(number, sizeof(number), "%.2f", result->ns_per_op));
+        g_string_append_printf(
+            json, "\"baseline_ns_per_op\": %s, ",
+            g_ascii_formatd(number, sizeof(number), "%.2f", result->baseline_ns_per_op));
+        g_string_append_printf(json, "\"regressed\": %s}%s\n",
+                               result->regressed ? "true" : "false",
+                               (i + 1 < n_results) ? "," : "");
+    }
+
+    g_string_append(json, "  ]\n}\n");
+
+    return g_string_free(json, FALSE);
+}
+
+static gboolean write_baseline(const char *path, const BenchResult *results, guint n_results,
+                               GError **error)
+{
+    g_autoptr(GKeyFile) key_file = g_key_file_new();
+
+    for (guint i = 0; i < n_results; i++) {
+        g_key_file_set_double(key_file, "ns-per-op", results[i].name, results[i].ns_per_op);
+    }
+
+    g_key_file_set_comment(key_file, NULL, NULL,
+                           " Reference ns/op of the core benchmarks, regenerate with\n"
+                           " samaya-bench --baseline <this file> --update-baseline",
+                           NULL);
+
+    return g_key_file_save_to_file(key_file, path, error);
+}
+
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(int argc, char *argv[])
+{
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GOptionContext) context = g_option_context_new("- benchmark the Samaya core");
+    g_autoptr(GKeyFile) baseline = NULL;
+
+    g_option_context_add_main_entries(context, benchOptions, NULL);
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        g_printerr("%s\n", error->message);
+        return 1;
+    }
+
+    if (baselinePath != NULL && !updateBaseline) {
+        baseline = g_key_file_new();
+        if (!g_key_file_load_from_file(baseline, baselinePath, G_KEY_FILE_NONE, &error)) {
+            g_printerr("Failed to load baseline %s: %s\n", baselinePath, error->message);
+            return 1;
+        }
+    }
+
+    benchTimer = tm_new(BENCH_DURATION_MINUTES, NULL, NULL, NULL);
+    tm_set_clock(benchTimer, fake_clock);
+
+    benchSession = sm_init(4, BENCH_DURATION_MINUTES, BENCH_DURATION_MINUTES,
+                           BENCH_DURATION_MINUTES, FALSE, FALSE, NULL, NULL);
+    tm_set_clock(benchSession->timer_instance, fake_clock);
+    set_up_schedule();
+    set_up_calendar();
+
+    BenchResult results[G_N_ELEMENTS(benchCases)];
+    gboolean any_regressed = FALSE;
+
+    for (guint i = 0; i < G_N_ELEMENTS(benchCases); i++) {
+        BenchResult *result = &results[i];
+
+        result->name = benchCases[i].name;
+        result->ns_per_op = measure_ns_per_op(&benchCases[i], &result->iterations);
+        compare_with_baseline(baseline, result);
+
+        any_regressed |= result->regressed;
+    }
+
+    g_autofree gchar *json = format_results_json(results, G_N_ELEMENTS(results));
+    fputs(json, stdout);
+
+    if (outputPath != NULL && !g_file_set_contents(outputPath, json, -1, &error)) {
+        g_printerr("Failed to write %s: %s\n", outputPath, error->message);
+        return 1;
+    }
+
+    if (updateBaseline) {
+        if (baselinePath == NULL) {
+            g_printerr("--update-baseline needs --baseline to know where to write.\n");
+            return 1;
+        }
+        if (!write_baseline(baselinePath, results, G_N_ELEMENTS(results), &error)) {
+            g_printerr("Failed to write baseline %s: %s\n", baselinePath, error->message);
+            return 1;
+        }
+    }
+
+    tear_down_calendar();
+    sm_deinit(benchSession);
+    tm_free(benchTimer);
+
+    if (any_regressed && tolerance <= 0.0) {
+        g_printerr("Some benchmarks are slower than the baseline, pass --tolerance to fail on "
+                   "them.\n");
+        return 0;
+    }
+
+    return any_regressed ? 1 : 0;
+}
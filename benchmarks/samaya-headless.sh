@@ -0,0 +1,34 @@
+#!/bin/sh
+# SPDX-License-Identifier: AGPL-3.0-or-later
+#
+# Runs a command with a display of its own, so benchmarks and tests that realize windows behave
+# the same on a desktop, over ssh and in CI: under a virtual X server started by xvfb-run, or, when
+# Xvfb is not installed, under a GTK broadway server spawned for it. With neither the command is
+# run as is, and reports itself as skipped if it cannot open a display.
+
+if command -v xvfb-run >/dev/null 2>&1; then
+    # Keeps GDK from picking the Wayland compositor of the session the command was started from.
+    export GDK_BACKEND=x11
+    exec xvfb-run --auto-servernum --server-args='-screen 0 1920x1080x24' "$@"
+fi
+
+broadwayd=$(command -v gtk4-broadwayd)
+if [ -n "$broadwayd" ]; then
+    display=$(( $$ % 1000 + 100 ))
+    socket="${XDG_RUNTIME_DIR:-${XDG_CACHE_HOME:-$HOME/.cache}}/broadway$display.socket"
+
+    "$broadwayd" ":$display" >/dev/null 2>&1 &
+    broadwayd_pid=$!
+    trap 'kill "$broadwayd_pid" 2>/dev/null' EXIT INT TERM
+
+    tries=0
+    while [ ! -S "$socket" ] && [ "$tries" -lt 50 ]; do
+        sleep 0.1
+        tries=$(( tries + 1 ))
+    done
+
+    GDK_BACKEND=broadway BROADWAY_DISPLAY=":$display" "$@"
+    exit $?
+fi
+
+exec "$@"
@@ -0,0 +1,147 @@
+/* samaya-history-bench.c
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include <fcntl.h>
+#include <gio/gio.h>
+#include <gio/gunixoutputstream.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <sys/resource.h>
+#include <time.h>
+#include "samaya-alloc-counter.h"
+#include "samaya-history.h"
+#include "samaya-synthetic-history.h"
+
+/*  Export throughput benchmark for the session history.
+
+    A synthetic history of --rows records (ten million by default, a few lifetimes of pomodoros)
+    is written to a temporary file and exported to /dev/null in every format. For each format the
+    records per second are reported along with how many allocations the export made and how much
+    the peak resident set grew, which should both stay flat however many rows there are.
+*/
+
+static gint64 rows = 10 * 1000 * 1000;
+
+static const GOptionEntry benchOptions[] = {
+    {"rows", 'r', 0, G_OPTION_ARG_INT64, &rows, "Number of records in the synthetic history", "N"},
+    G_OPTION_ENTRY_NULL,
+};
+
+
+/* ============================================================================
+ * Measurement Helpers
+ * ============================================================================ */
+
+static gint64 get_cpu_time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (gint64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static glong get_peak_rss_kib(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static gboolean bench_export(const char *history_path, HsExportFormat format, const char *name)
+{
+    g_autoptr(GError) error = NULL;
+
+    int null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    if (null_fd < 0) {
+        g_printerr("Failed to open /dev/null\n");
+        return FALSE;
+    }
+    g_autoptr(GOutputStream) output = g_unix_output_stream_new(null_fd, TRUE);
+
+    glong rss_start_kib = get_peak_rss_kib();
+    AllocCounterSample allocs_start = alloc_counter_sample();
+    gint64 cpu_start_ns = get_cpu_time_ns();
+    gint64 wall_start_us = g_get_monotonic_time();
+
+    gboolean exported = hs_export(history_path, output, format, NULL, &error);
+
+    gint64 wall_time_us = g_get_monotonic_time() - wall_start_us;
+    gint64 cpu_time_ns = get_cpu_time_ns() - cpu_start_ns;
+    AllocCounterSample allocs = alloc_counter_delta(allocs_start, alloc_counter_sample());
+    glong rss_growth_kib = get_peak_rss_kib() - rss_start_kib;
+
+    if (!exported) {
+        g_printerr("Exporting %s failed: %s\n", name, error->message);
+        return FALSE;
+    }
+
+    gchar records_per_second[G_ASCII_DTOSTR_BUF_SIZE];
+    gchar cpu_ns_per_record[G_ASCII_DTOSTR_BUF_SIZE];
+
+    // One JSON object per line, so results can be streamed into other tools.
+    printf("{\"format\": \"%s\", \"records\": %" G_GINT64_FORMAT ", \"records_per_second\": %s, "
+           "\"cpu_ns_per_record\": %s, \"allocations\": %" G_GUINT64_FORMAT
+           ", \"bytes_allocated\": %" G_GUINT64_FORMAT ", \"peak_rss_growth_kib\": %ld}\n",
+           name, rows,
+           g_ascii_formatd(records_per_second, sizeof(records_per_second), "%.0f",
+                           rows * (gdouble) G_USEC_PER_SEC / MAX(wall_time_us, 1)),
+           g_ascii_formatd(cpu_ns_per_record, sizeof(cpu_ns_per_record), "%.1f",
+                           (gdouble) cpu_time_ns / MAX(rows, 1)),
+           allocs.allocations, allocs.bytes, rss_growth_kib);
+    fflush(stdout);
+
+    return TRUE;
+}
+
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(int argc, char *argv[])
+{
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GOptionContext) context = g_option_context_new("- benchmark history export");
+
+    g_option_context_add_main_entries(context, benchOptions, NULL);
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        g_printerr("%s\n", error->message);
+        return 1;
+    }
+
+    g_autofree gchar *directory = g_dir_make_tmp("samaya-history-bench-XXXXXX", &error);
+    if (directory == NULL) {
+        g_printerr("%s\n", error->message);
+        return 1;
+    }
+    g_autofree gchar *history_path = g_build_filename(directory, "history.bin", NULL);
+
+    gboolean succeeded = synthetic_history_write(history_path, rows, &error);
+    if (!succeeded) {
+        g_printerr("%s\n", error->message);
+    }
+
+    succeeded = succeeded && bench_export(history_path, HsFormatCsv, "csv");
+    succeeded = succeeded && bench_export(history_path, HsFormatJson, "json");
+
+    g_unlink(history_path);
+    g_rmdir(directory);
+
+    return succeeded ? 0 : 1;
+}
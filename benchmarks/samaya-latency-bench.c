@@ -0,0 +1,395 @@
+/* samaya-latency-bench.c
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include <adwaita.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "samaya-application.h"
+#include "samaya-session.h"
+#include "samaya-timer.h"
+
+/*  Input to repaint latency of starting, stopping, resuming, skipping and resetting the timer.
+
+    Each input is timestamped when it is fed into the main window, and measured until the frame
+    showing its result, the one the start button got its new label in, was presented according to
+    the timings of the frame clock. Where the backend does not report presentation times, the end
+    of painting that frame is used instead. Inputs are fed at a random point of the frame, like a
+    user would, either by activating the window action or by activating the button itself, which
+    is what pressing Space or Enter on the focused button does.
+
+    The results are printed as one JSON object per input and action, and the benchmark fails when
+    any 99th percentile is over --max-p99-ms. It needs a GDK display, meson runs it through
+    samaya-headless.sh, which gives it one of its own with Xvfb or a GTK broadway server. When no
+    display can be opened the benchmark is reported as skipped.
+*/
+
+#define DEFAULT_CYCLES 100
+#define DEFAULT_MAX_P99_MS 50.0
+
+// Longest wait for the result of an input to be painted, and for its frame to be presented.
+#define PAINT_WAIT_US (2 * G_USEC_PER_SEC)
+#define SETTLE_FRAMES 2
+
+// Inputs land anywhere within a frame of 60 Hz.
+#define INPUT_JITTER_US 16667
+
+typedef enum
+{
+    LaStart,
+    LaStop,
+    LaResume,
+    LaSkip,
+    LaReset,
+} LatencyAction;
+
+#define LA_N_ACTIONS (LaReset + 1)
+
+typedef enum
+{
+    LiAction,
+    LiButton,
+} LatencyInput;
+
+#define LI_N_INPUTS (LiButton + 1)
+
+typedef struct
+{
+    gint64 *latencies_us;
+    guint n_latencies;
+    guint n_presented;
+} LatencySamples;
+
+static const char *const actionNames[LA_N_ACTIONS] = {
+    [LaStart] = "start",
+    [LaStop] = "stop",
+    [LaResume] = "resume",
+    [LaSkip] = "skip",
+    [LaReset] = "reset",
+};
+
+static const char *const windowActions[LA_N_ACTIONS] = {
+    [LaStart] = "win.start-timer",
+    [LaStop] = "win.start-timer",
+    [LaResume] = "win.start-timer",
+    [LaSkip] = "win.skip-session",
+    [LaReset] = "win.reset-timer",
+};
+
+static const char *const inputNames[LI_N_INPUTS] = {
+    [LiAction] = "action",
+    [LiButton] = "button",
+};
+
+// Every action from the state it is offered in, ending idle again for the next cycle.
+static const LatencyAction cycleActions[] = {
+    LaStart, LaStop, LaResume, LaSkip, LaStart, LaStop, LaReset,
+};
+
+static gint cycles = DEFAULT_CYCLES;
+static gdouble maxP99Ms = DEFAULT_MAX_P99_MS;
+
+static const GOptionEntry latencyOptions[] = {
+    {"cycles", 'c', 0, G_OPTION_ARG_INT, &cycles, "Feed every input N times per action", "N"},
+    {"max-p99-ms", 0, 0, G_OPTION_ARG_DOUBLE, &maxP99Ms,
+     "Fail when a 99th percentile is over this many milliseconds", "MS"},
+    G_OPTION_ENTRY_NULL,
+};
+
+static LatencySamples samples[LI_N_INPUTS][LA_N_ACTIONS];
+
+static int exitStatus = 0;
+
+// The frame being waited for, set by on_after_paint() once the start button shows the result.
+static GtkWidget *startButton = NULL;
+static const char *labelBefore = NULL;
+static gint64 paintedUs = 0;
+static gint64 paintedFrame = -1;
+static guint paintedFrames = 0;
+
+
+/* ============================================================================
+ * Measurement Helpers
+ * ============================================================================ */
+
+// The first button in the widget tree bound to the action, or NULL when none is shown.
+static GtkWidget *find_button(GtkWidget *widget, const char *action_name)
+{
+    if (GTK_IS_BUTTON(widget) && gtk_widget_get_visible(widget) &&
+        g_strcmp0(gtk_actionable_get_action_name(GTK_ACTIONABLE(widget)), action_name) == 0) {
+        return widget;
+    }
+
+    for (GtkWidget *child = gtk_widget_get_first_child(widget); child != NULL;
+         child = gtk_widget_get_next_sibling(child)) {
+        GtkWidget *button = find_button(child, action_name);
+        if (button != NULL) {
+            return button;
+        }
+    }
+
+    return NULL;
+}
+
+static void on_after_paint(GdkFrameClock *frame_clock, gpointer user_data)
+{
+    paintedFrames++;
+
+    if (labelBefore == NULL || paintedFrame >= 0) {
+        return;
+    }
+
+    if (g_strcmp0(gtk_button_get_label(GTK_BUTTON(startButton)), labelBefore) != 0) {
+        paintedUs = g_get_monotonic_time();
+        paintedFrame = gdk_frame_clock_get_frame_counter(frame_clock);
+    }
+}
+
+static void iterate_until(gint64 deadline_us)
+{
+    while (g_get_monotonic_time() < deadline_us) {
+        g_main_context_iteration(NULL, FALSE);
+    }
+}
+
+/*  Runs the main loop until the window painted another n frames, or gives up after PAINT_WAIT_US.
+    An idle window paints nothing, so the start button is redrawn for every frame waited for.
+*/
+static void wait_for_frames(guint n_frames)
+{
+    guint target_frames = paintedFrames + n_frames;
+    gint64 deadline_us = g_get_monotonic_time() + PAINT_WAIT_US;
+
+    while (paintedFrames < target_frames && g_get_monotonic_time() < deadline_us) {
+        guint frames = paintedFrames;
+
+        gtk_widget_queue_draw(startButton);
+        while (paintedFrames == frames && g_get_monotonic_time() < deadline_us) {
+            g_main_context_iteration(NULL, FALSE);
+        }
+    }
+}
+
+static gboolean feed_input(GtkWindow *window, LatencyInput input, LatencyAction action)
+{
+    const char *action_name = windowActions[action];
+
+    switch (input) {
+        case LiAction:
+            return gtk_widget_activate_action(GTK_WIDGET(window), action_name, NULL);
+        case LiButton: {
+            GtkWidget *button = find_button(GTK_WIDGET(window), action_name);
+            return button != NULL && gtk_widget_activate(button);
+        }
+        default:
+            return FALSE;
+    }
+}
+
+/*  Feeds one input and waits for the frame showing its result, then for the frame clock to know
+    when that frame was presented.
+*/
+static void measure_input(GtkWindow *window, GdkFrameClock *frame_clock, LatencyInput input,
+                          LatencyAction action)
+{
+    iterate_until(g_get_monotonic_time() + g_random_int_range(0, INPUT_JITTER_US));
+
+    g_autofree gchar *label = g_strdup(gtk_button_get_label(GTK_BUTTON(startButton)));
+    paintedFrame = -1;
+    labelBefore = label;
+
+    gint64 input_us = g_get_monotonic_time();
+    if (!feed_input(window, input, action)) {
+        g_printerr("Failed to feed %s through the %s\n", actionNames[action], inputNames[input]);
+        exitStatus = 1;
+        labelBefore = NULL;
+        return;
+    }
+
+    gint64 deadline_us = input_us + PAINT_WAIT_US;
+    while (paintedFrame < 0 && g_get_monotonic_time() < deadline_us) {
+        g_main_context_iteration(NULL, FALSE);
+    }
+    labelBefore = NULL;
+
+    if (paintedFrame < 0) {
+        g_printerr("The result of %s through the %s was never painted\n", actionNames[action],
+                   inputNames[input]);
+        exitStatus = 1;
+        return;
+    }
+
+    // Presentation times arrive with later frames, if the backend reports them at all.
+    wait_for_frames(SETTLE_FRAMES);
+
+    LatencySamples *action_samples = &samples[input][action];
+    gint64 shown_us = paintedUs;
+
+    GdkFrameTimings *timings = gdk_frame_clock_get_timings(frame_clock, paintedFrame);
+    if (timings != NULL && gdk_frame_timings_get_complete(timings) &&
+        gdk_frame_timings_get_presentation_time(timings) > 0) {
+        shown_us = gdk_frame_timings_get_presentation_time(timings);
+        action_samples->n_presented++;
+    }
+
+    action_samples->latencies_us[action_samples->n_latencies++] = MAX(shown_us - input_us, 0);
+}
+
+static gint compare_latencies(gconstpointer a, gconstpointer b)
+{
+    gint64 left = *(const gint64 *) a;
+    gint64 right = *(const gint64 *) b;
+
+    return (left > right) - (left < right);
+}
+
+// Nearest rank percentile of sorted latencies, in milliseconds.
+static gdouble get_percentile_ms(const LatencySamples *action_samples, gdouble percentile)
+{
+    guint rank = (guint) (percentile / 100.0 * (action_samples->n_latencies - 1) + 0.5);
+
+    return action_samples->latencies_us[rank] / 1000.0;
+}
+
+static void print_result(LatencyInput input, LatencyAction action)
+{
+    LatencySamples *action_samples = &samples[input][action];
+
+    if (action_samples->n_latencies == 0) {
+        return;
+    }
+
+    qsort(action_samples->latencies_us, action_samples->n_latencies, sizeof(gint64),
+          compare_latencies);
+
+    gdouble p50_ms = get_percentile_ms(action_samples, 50.0);
+    gdouble p99_ms = get_percentile_ms(action_samples, 99.0);
+    gdouble max_ms = get_percentile_ms(action_samples, 100.0);
+
+    gchar p50[G_ASCII_DTOSTR_BUF_SIZE];
+    gchar p99[G_ASCII_DTOSTR_BUF_SIZE];
+    gchar max[G_ASCII_DTOSTR_BUF_SIZE];
+
+    // One JSON object per line, so results can be streamed into other tools.
+    printf("{\"input\": \"%s\", \"action\": \"%s\", \"samples\": %u, \"presented\": %u, "
+           "\"p50_ms\": %s, \"p99_ms\": %s, \"max_ms\": %s}\n",
+           inputNames[input], actionNames[action], action_samples->n_latencies,
+           action_samples->n_presented, g_ascii_formatd(p50, sizeof(p50), "%.3f", p50_ms),
+           g_ascii_formatd(p99, sizeof(p99), "%.3f", p99_ms),
+           g_ascii_formatd(max, sizeof(max), "%.3f", max_ms));
+    fflush(stdout);
+
+    if (p99_ms > maxP99Ms) {
+        g_printerr("%s through the %s took %.3f ms at the 99th percentile, more than %.3f ms\n",
+                   actionNames[action], inputNames[input], p99_ms, maxP99Ms);
+        exitStatus = 1;
+    }
+}
+
+
+/* ============================================================================
+ * Application Hooks
+ * ============================================================================ */
+
+static void on_activate(GApplication *app, gpointer user_data)
+{
+    GtkWindow *window = gtk_application_get_active_window(GTK_APPLICATION(app));
+
+    startButton = window != NULL ? find_button(GTK_WIDGET(window), "win.start-timer") : NULL;
+    if (startButton == NULL) {
+        g_printerr("Main window was not created, aborting latency benchmark.\n");
+        exitStatus = 1;
+        g_application_quit(app);
+        return;
+    }
+
+    // Every cycle has to end idle, and skipping must not start the next routine.
+    SessionManagerPtr session_manager = sm_get_default();
+    sm_set_auto_start_breaks(session_manager, FALSE);
+    sm_set_auto_start_work(session_manager, FALSE);
+
+    GdkFrameClock *frame_clock = gtk_widget_get_frame_clock(GTK_WIDGET(window));
+    gulong handler_id =
+        g_signal_connect(frame_clock, "after-paint", G_CALLBACK(on_after_paint), NULL);
+
+    wait_for_frames(SETTLE_FRAMES);
+
+    for (guint i = 0; i < LI_N_INPUTS; i++) {
+        for (gint cycle = 0; cycle < cycles; cycle++) {
+            for (guint a = 0; a < G_N_ELEMENTS(cycleActions); a++) {
+                measure_input(window, frame_clock, (LatencyInput) i, cycleActions[a]);
+            }
+        }
+    }
+
+    g_signal_handler_disconnect(frame_clock, handler_id);
+
+    for (guint i = 0; i < LI_N_INPUTS; i++) {
+        for (guint a = 0; a < LA_N_ACTIONS; a++) {
+            print_result((LatencyInput) i, (LatencyAction) a);
+        }
+    }
+
+    g_application_quit(app);
+}
+
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(int argc, char *argv[])
+{
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GOptionContext) context = g_option_context_new("- measure input latency");
+
+    g_option_context_add_main_entries(context, latencyOptions, NULL);
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        g_printerr("%s\n", error->message);
+        return 1;
+    }
+
+    if (!gtk_init_check()) {
+        g_printerr("No display available, skipping latency benchmark.\n");
+        return 77;
+    }
+
+    // Start and stop come twice in a cycle.
+    for (guint i = 0; i < LI_N_INPUTS; i++) {
+        for (guint a = 0; a < LA_N_ACTIONS; a++) {
+            samples[i][a].latencies_us = g_new0(gint64, 2 * MAX(cycles, 1));
+        }
+    }
+
+    g_autoptr(SamayaApplication) app = samaya_application_new(
+        "io.github.redddfoxxyy.samaya.LatencyBench", G_APPLICATION_NON_UNIQUE);
+
+    // Runs after the default handler, which creates and presents the main window.
+    g_signal_connect_after(app, "activate", G_CALLBACK(on_activate), NULL);
+
+    int status = g_application_run(G_APPLICATION(app), argc, argv);
+
+    for (guint i = 0; i < LI_N_INPUTS; i++) {
+        for (guint a = 0; a < LA_N_ACTIONS; a++) {
+            g_free(samples[i][a].latencies_us);
+        }
+    }
+
+    return status != 0 ? status : exitStatus;
+}
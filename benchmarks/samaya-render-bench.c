@@ -0,0 +1,408 @@
+/* samaya-render-bench.c
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include <adwaita.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <time.h>
+#include "samaya-alloc-counter.h"
+#include "samaya-application.h"
+#include "samaya-heatmap.h"
+#include "samaya-history-dialog.h"
+#include "samaya-progress-ring.h"
+#include "samaya-session.h"
+#include "samaya-synthetic-history.h"
+
+/*  Offscreen render benchmark for the progress ring and the main window.
+
+    The progress ring is drawn with the same code as on_progress_draw into a cairo image surface,
+    and the whole SamayaWindow template is snapshotted and rasterised through an offscreen cairo
+    GskRenderer, so no GPU is needed. The history dialog is then opened on a synthetic history of a
+    million sessions and scrolled to a different part of it on every frame, which is laid out and
+    painted by the window itself, and the work calendar is loaded from the same history. It still
+    needs a GDK display to realize the window, meson runs it through samaya-headless.sh, which gives
+    it one of its own with Xvfb or a GTK broadway server. When no display can be opened the
+    benchmark is reported as skipped.
+*/
+
+#define RING_FRAMES 240
+#define WINDOW_FRAMES 30
+#define SIZE_WAIT_US (2 * G_USEC_PER_SEC)
+#define HISTORY_RECORDS (1000 * 1000)
+#define HISTORY_FRAMES 120
+
+typedef struct
+{
+    int width;
+    int height;
+} BenchSize;
+
+typedef struct
+{
+    const char *css_class;
+    RoutineType routine;
+} BenchRoutine;
+
+// From the smallest ring the window allows up to a 4K fullscreen window.
+static const BenchSize ringSizes[] = {{280, 280}, {540, 540}, {1080, 1080}, {2160, 2160}};
+static const BenchSize windowSizes[] = {{360, 480}, {1280, 720}, {1920, 1080}, {3840, 2160}};
+static const int scaleFactors[] = {1, 2, 3};
+
+static const BenchRoutine routines[] = {
+    {"routine-working", Working},
+    {"routine-short-break", ShortBreak},
+    {"routine-long-break", LongBreak},
+};
+
+static int exitStatus = 0;
+
+static guint paintedFrames = 0;
+
+
+/* ============================================================================
+ * Measurement Helpers
+ * ============================================================================ */
+
+static gint64 get_cpu_time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (gint64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void print_result(const char *target, const char *routine, int width, int height,
+                         int scale, guint frames, gint64 cpu_time_ns, AllocCounterSample allocs)
+{
+    gchar number[G_ASCII_DTOSTR_BUF_SIZE];
+    gdouble cpu_us_per_frame = (gdouble) cpu_time_ns / 1000.0 / frames;
+
+    // One JSON object per line, so results can be streamed into other tools.
+    printf("{\"target\": \"%s\", \"routine\": \"%s\", \"width\": %d, \"height\": %d, "
+           "\"scale\": %d, \"frames\": %u, \"cpu_us_per_frame\": %s, "
+           "\"allocations_per_frame\": %" G_GUINT64_FORMAT
+           ", \"bytes_per_frame\": %" G_GUINT64_FORMAT "}\n",
+           target, routine, width, height, scale, frames,
+           g_ascii_formatd(number, sizeof(number), "%.2f", cpu_us_per_frame),
+           allocs.allocations / frames, allocs.bytes / frames);
+    fflush(stdout);
+}
+
+static void queue_draw_recursive(GtkWidget *widget)
+{
+    gtk_widget_queue_draw(widget);
+
+    for (GtkWidget *child = gtk_widget_get_first_child(widget); child != NULL;
+         child = gtk_widget_get_next_sibling(child)) {
+        queue_draw_recursive(child);
+    }
+}
+
+static void wait_for_size(GtkWidget *widget, int width, int height)
+{
+    gint64 deadline_us = g_get_monotonic_time() + SIZE_WAIT_US;
+
+    while (g_get_monotonic_time() < deadline_us) {
+        if (gtk_widget_get_width(widget) == width && gtk_widget_get_height(widget) == height) {
+            return;
+        }
+        g_main_context_iteration(NULL, FALSE);
+    }
+}
+
+static void on_after_paint(GdkFrameClock *frame_clock, gpointer user_data)
+{
+    paintedFrames++;
+}
+
+// Runs the main loop until the window painted another frame, or gives up after SIZE_WAIT_US.
+static void wait_for_paint(void)
+{
+    guint start_frames = paintedFrames;
+    gint64 deadline_us = g_get_monotonic_time() + SIZE_WAIT_US;
+
+    while (paintedFrames == start_frames && g_get_monotonic_time() < deadline_us) {
+        g_main_context_iteration(NULL, FALSE);
+    }
+}
+
+
+/* ============================================================================
+ * Benchmark Cases
+ * ============================================================================ */
+
+static void bench_progress_ring(const BenchRoutine *routine)
+{
+    GtkWidget *area = g_object_ref_sink(gtk_drawing_area_new());
+    gtk_widget_add_css_class(area, routine->css_class);
+
+    GdkRGBA color;
+    gtk_widget_get_color(area, &color);
+
+    for (guint s = 0; s < G_N_ELEMENTS(ringSizes); s++) {
+        for (guint f = 0; f < G_N_ELEMENTS(scaleFactors); f++) {
+            int width = ringSizes[s].width;
+            int height = ringSizes[s].height;
+            int scale = scaleFactors[f];
+
+            cairo_surface_t *surface =
+                cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width * scale, height * scale);
+            cairo_surface_set_device_scale(surface, scale, scale);
+
+            AllocCounterSample allocs_start = alloc_counter_sample();
+            gint64 cpu_start_ns = get_cpu_time_ns();
+
+            for (guint frame = 0; frame < RING_FRAMES; frame++) {
+                cairo_t *cr = cairo_create(surface);
+
+                cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
+                cairo_paint(cr);
+                cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+
+                pr_draw_ring(cr, width, height, 1.0f - (gfloat) frame / RING_FRAMES, &color);
+
+                cairo_destroy(cr);
+                cairo_surface_flush(surface);
+            }
+
+            gint64 cpu_time_ns = get_cpu_time_ns() - cpu_start_ns;
+            AllocCounterSample allocs =
+                alloc_counter_delta(allocs_start, alloc_counter_sample());
+
+            print_result("progress-ring", routine->css_class, width, height, scale, RING_FRAMES,
+                         cpu_time_ns, allocs);
+
+            cairo_surface_destroy(surface);
+        }
+    }
+
+    g_object_unref(area);
+}
+
+static void bench_window(GtkWindow *window, GskRenderer *renderer, const BenchRoutine *routine)
+{
+    GtkWidget *widget = GTK_WIDGET(window);
+    GdkPaintable *paintable = gtk_widget_paintable_new(widget);
+
+    sm_set_routine(routine->routine, sm_get_default());
+
+    for (guint s = 0; s < G_N_ELEMENTS(windowSizes); s++) {
+        gtk_window_set_default_size(window, windowSizes[s].width, windowSizes[s].height);
+        wait_for_size(widget, windowSizes[s].width, windowSizes[s].height);
+
+        // The compositor has the final say over the size, report what was actually rendered.
+        int width = gtk_widget_get_width(widget);
+        int height = gtk_widget_get_height(widget);
+
+        for (guint f = 0; f < G_N_ELEMENTS(scaleFactors); f++) {
+            int scale = scaleFactors[f];
+            graphene_rect_t viewport;
+            graphene_rect_init(&viewport, 0, 0, width * scale, height * scale);
+
+            AllocCounterSample allocs_start = alloc_counter_sample();
+            gint64 cpu_start_ns = get_cpu_time_ns();
+
+            for (guint frame = 0; frame < WINDOW_FRAMES; frame++) {
+                queue_draw_recursive(widget);
+
+                GtkSnapshot *snapshot = gtk_snapshot_new();
+                gtk_snapshot_scale(snapshot, scale, scale);
+                gdk_paintable_snapshot(paintable, GDK_SNAPSHOT(snapshot), width, height);
+
+                GskRenderNode *node = gtk_snapshot_free_to_node(snapshot);
+                if (node == NULL) {
+                    continue;
+                }
+
+                GdkTexture *texture = gsk_renderer_render_texture(renderer, node, &viewport);
+
+                g_object_unref(texture);
+                gsk_render_node_unref(node);
+            }
+
+            gint64 cpu_time_ns = get_cpu_time_ns() - cpu_start_ns;
+            AllocCounterSample allocs =
+                alloc_counter_delta(allocs_start, alloc_counter_sample());
+
+            print_result("window", routine->css_class, width, height, scale, WINDOW_FRAMES,
+                         cpu_time_ns, allocs);
+        }
+    }
+
+    g_object_unref(paintable);
+}
+
+/*  Every frame jumps to a part of the history no row has been bound to yet, the worst case for
+    the list view as all of its rows are rebound and their section headers looked up again.
+*/
+static void bench_history_scroll(GtkWindow *window, SamayaHistoryModel *model, gint routine,
+                                 const char *name)
+{
+    GtkWidget *widget = GTK_WIDGET(window);
+    GdkFrameClock *frame_clock = gtk_widget_get_frame_clock(widget);
+
+    samaya_history_model_set_routine_filter(model, routine);
+    while (samaya_history_model_is_filtering(model)) {
+        g_main_context_iteration(NULL, TRUE);
+    }
+    guint n_items = g_list_model_get_n_items(G_LIST_MODEL(model));
+
+    gulong handler_id = g_signal_connect(frame_clock, "after-paint", G_CALLBACK(on_after_paint),
+                                         NULL);
+
+    SamayaHistoryDialog *dialog = samaya_history_dialog_new(model);
+    adw_dialog_present(ADW_DIALOG(dialog), widget);
+    wait_for_paint();
+
+    AllocCounterSample allocs_start = alloc_counter_sample();
+    gint64 cpu_start_ns = get_cpu_time_ns();
+
+    for (guint frame = 0; frame < HISTORY_FRAMES; frame++) {
+        guint position = (guint) ((guint64) n_items * frame / HISTORY_FRAMES);
+
+        samaya_history_dialog_scroll_to(dialog, position);
+        wait_for_paint();
+    }
+
+    gint64 cpu_time_ns = get_cpu_time_ns() - cpu_start_ns;
+    AllocCounterSample allocs = alloc_counter_delta(allocs_start, alloc_counter_sample());
+
+    g_signal_handler_disconnect(frame_clock, handler_id);
+
+    print_result("history-scroll", name, gtk_widget_get_width(widget),
+                 gtk_widget_get_height(widget), gtk_widget_get_scale_factor(widget),
+                 HISTORY_FRAMES, cpu_time_ns, allocs);
+
+    adw_dialog_force_close(ADW_DIALOG(dialog));
+}
+
+// Loading the work calendar has to fit in a frame, however many years of history there are.
+static void bench_heatmap_load(const char *history_path)
+{
+    SamayaHeatmap *heatmap = g_object_ref_sink(samaya_heatmap_new());
+
+    AllocCounterSample allocs_start = alloc_counter_sample();
+    gint64 cpu_start_ns = get_cpu_time_ns();
+
+    samaya_heatmap_load_history(heatmap, history_path);
+
+    gint64 cpu_time_ns = get_cpu_time_ns() - cpu_start_ns;
+    AllocCounterSample allocs = alloc_counter_delta(allocs_start, alloc_counter_sample());
+
+    print_result("heatmap-load", "routine-working", 0, 0, 1, 1, cpu_time_ns, allocs);
+
+    g_object_unref(heatmap);
+}
+
+static void bench_history(GtkWindow *window)
+{
+    g_autoptr(GError) error = NULL;
+
+    g_autofree gchar *directory = g_dir_make_tmp("samaya-render-bench-XXXXXX", &error);
+    if (directory == NULL) {
+        g_printerr("%s\n", error->message);
+        exitStatus = 1;
+        return;
+    }
+    g_autofree gchar *history_path = g_build_filename(directory, "history.bin", NULL);
+
+    g_autoptr(SamayaHistoryModel) model = NULL;
+    if (synthetic_history_write(history_path, HISTORY_RECORDS, &error)) {
+        model = samaya_history_model_new(history_path, &error);
+    }
+
+    if (model == NULL) {
+        g_printerr("Failed to create the synthetic history: %s\n", error->message);
+        exitStatus = 1;
+    } else {
+        gtk_window_set_default_size(window, windowSizes[1].width, windowSizes[1].height);
+        wait_for_size(GTK_WIDGET(window), windowSizes[1].width, windowSizes[1].height);
+
+        bench_heatmap_load(history_path);
+        bench_history_scroll(window, model, -1, "all");
+        bench_history_scroll(window, model, Working, "routine-working");
+    }
+
+    // The model keeps its mapping of the file until it is dropped on return.
+    g_unlink(history_path);
+    g_rmdir(directory);
+}
+
+
+/* ============================================================================
+ * Application Hooks
+ * ============================================================================ */
+
+static void on_activate(GApplication *app, gpointer user_data)
+{
+    g_autoptr(GError) error = NULL;
+    GtkWindow *window = gtk_application_get_active_window(GTK_APPLICATION(app));
+
+    if (window == NULL) {
+        g_printerr("Main window was not created, aborting render benchmark.\n");
+        exitStatus = 1;
+        g_application_quit(app);
+        return;
+    }
+
+    for (guint r = 0; r < G_N_ELEMENTS(routines); r++) {
+        bench_progress_ring(&routines[r]);
+    }
+
+    GskRenderer *renderer = gsk_cairo_renderer_new();
+    if (!gsk_renderer_realize_for_display(renderer, gtk_widget_get_display(GTK_WIDGET(window)),
+                                          &error)) {
+        g_printerr("Failed to realize the offscreen renderer: %s\n", error->message);
+        exitStatus = 1;
+    } else {
+        for (guint r = 0; r < G_N_ELEMENTS(routines); r++) {
+            bench_window(window, renderer, &routines[r]);
+        }
+        gsk_renderer_unrealize(renderer);
+    }
+
+    g_object_unref(renderer);
+
+    bench_history(window);
+
+    g_application_quit(app);
+}
+
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(int argc, char *argv[])
+{
+    if (!gtk_init_check()) {
+        g_printerr("No display available, skipping render benchmark.\n");
+        return 77;
+    }
+
+    g_autoptr(SamayaApplication) app = samaya_application_new(
+        "io.github.redddfoxxyy.samaya.RenderBench", G_APPLICATION_NON_UNIQUE);
+
+    // Runs after the default handler, which creates and presents the main window.
+    g_signal_connect_after(app, "activate", G_CALLBACK(on_activate), NULL);
+
+    int status = g_application_run(G_APPLICATION(app), argc, argv);
+
+    return status != 0 ? status : exitStatus;
+}
@@ -0,0 +1,82 @@
+/* samaya-synthetic-history.c
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "samaya-synthetic-history.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include "samaya-session.h"
+
+#define GENERATE_CHUNK_RECORDS 65536
+
+static const RoutineType routineCycle[] = {
+    Working, ShortBreak, Working, ShortBreak, Working, ShortBreak, Working, LongBreak,
+};
+
+void synthetic_history_fill_record(HsRecord *record, gint64 index)
+{
+    RoutineType routine = routineCycle[index % G_N_ELEMENTS(routineCycle)];
+    guint32 planned_ms = (routine == Working) ? 25 * 60 * 1000 : 5 * 60 * 1000;
+    gboolean skipped = (index % 10) == 9;
+
+    // Sessions follow each other with a minute in between, starting at the start of 2020.
+    gint64 start_real_us = 1577836800LL * G_USEC_PER_SEC + index * 31 * G_TIME_SPAN_MINUTE;
+
+    *record = (HsRecord) {
+        .start_real_us = start_real_us,
+        .duration_ms = skipped ? planned_ms / 3 : planned_ms,
+        .planned_ms = planned_ms,
+        .routine = routine,
+        .outcome = skipped ? HsSkipped : HsCompleted,
+    };
+    record->end_real_us = start_real_us + (gint64) record->duration_ms * 1000;
+}
+
+gboolean synthetic_history_write(const char *path, gint64 n_records, GError **error)
+{
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno), "Failed to create %s",
+                    path);
+        return FALSE;
+    }
+
+    HsFileHeader header = {.version = HS_FILE_VERSION, .record_size = sizeof(HsRecord)};
+    memcpy(header.magic, HS_FILE_MAGIC, sizeof(header.magic));
+    gboolean written = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    g_autofree HsRecord *chunk = g_new(HsRecord, GENERATE_CHUNK_RECORDS);
+
+    for (gint64 index = 0; written && index < n_records; index += GENERATE_CHUNK_RECORDS) {
+        gint64 n_chunk = MIN(n_records - index, GENERATE_CHUNK_RECORDS);
+
+        for (gint64 i = 0; i < n_chunk; i++) {
+            synthetic_history_fill_record(&chunk[i], index + i);
+        }
+        written = fwrite(chunk, sizeof(HsRecord), (gsize) n_chunk, file) == (gsize) n_chunk;
+    }
+
+    if (fclose(file) != 0 || !written) {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED, "Failed to write %s", path);
+        return FALSE;
+    }
+
+    return TRUE;
+}
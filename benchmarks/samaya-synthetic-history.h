@@ -0,0 +1,35 @@
+/* samaya-synthetic-history.h
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "samaya-history.h"
+
+/*  Synthetic session histories for the benchmarks.
+
+    Records follow a day of four pomodoros and their breaks, one session every 31 minutes from the
+    start of 2020, with every tenth session skipped. The same index always gives the same record.
+*/
+
+// Fills in the record at the given index of the synthetic history.
+void synthetic_history_fill_record(HsRecord *record, gint64 index);
+
+// Writes a history file of n_records synthetic records to path, replacing any existing file.
+gboolean synthetic_history_write(const char *path, gint64 n_records, GError **error);
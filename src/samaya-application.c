@@ -18,10 +18,26 @@
  * SPDX-License-Identifier: AGPL-3.0-or-later
  */
 
+#include <gio/gunixoutputstream.h>
+#include <glib-unix.h>
 #include <glib/gi18n.h>
+#include <gsound.h>
+#include <signal.h>
+#include <unistd.h>
 #include "samaya-application.h"
+#include "samaya-calendar.h"
+#include "samaya-checkpoint.h"
+#include "samaya-history-dialog.h"
+#include "samaya-history.h"
+#include "samaya-hooks.h"
+#include "samaya-idle.h"
+#include "samaya-indicator.h"
+#include "samaya-low-power.h"
 #include "samaya-preferences-dialog.h"
 #include "samaya-session.h"
+#include "samaya-sleep.h"
+#include "samaya-tags.h"
+#include "samaya-trace.h"
 #include "samaya-window.h"
 
 struct _SamayaApplication
@@ -29,10 +45,538 @@ struct _SamayaApplication
     AdwApplication parent_instance;
 
     SessionManagerPtr samayaSessionManager;
+
+    // Rings the bell when a routine runs out, NULL when there is no sound server to talk to.
+    GSoundContext *sound_context;
+
+    gboolean trace_requested;
+
+    // Held while the panel indicator is shown, closing the window only hides it then.
+    gboolean held_for_indicator;
+
+    guint session_registration_id;
+
+    // Cancels connecting to the system bus for the sleep hooks and the low power mode.
+    GCancellable *system_bus_cancellable;
+
+    // Followed for changes to the user hooks, the schedule and the calendars.
+    GSettings *settings;
 };
 
 G_DEFINE_FINAL_TYPE(SamayaApplication, samaya_application, ADW_TYPE_APPLICATION)
 
+// Files kept across runs, such as the checkpoint and traces, live in $XDG_STATE_HOME/samaya.
+static gchar *get_state_path(const char *file_name)
+{
+    return g_build_filename(g_get_user_state_dir(), "samaya", file_name, NULL);
+}
+
+
+gchar *samaya_application_get_history_path(void)
+{
+    return g_build_filename(g_get_user_data_dir(), "samaya", "history.bin", NULL);
+}
+
+static gchar *get_tags_path(void)
+{
+    return g_build_filename(g_get_user_data_dir(), "samaya", "tags.txt", NULL);
+}
+
+
+/* ============================================================================
+ * Session History
+ * ============================================================================ */
+
+static void on_history_exported(GObject *source_object, GAsyncResult *result, gpointer user_data)
+{
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GFile) destination = user_data;
+    g_autofree gchar *destination_path = g_file_get_path(destination);
+
+    if (!hs_export_finish(result, &error)) {
+        g_warning("Failed to export the session history: %s", error->message);
+        return;
+    }
+
+    g_message("Session history exported to %s", destination_path);
+}
+
+static void on_export_destination_chosen(GObject *source_object, GAsyncResult *result,
+                                         gpointer user_data)
+{
+    g_autoptr(GError) error = NULL;
+    GFile *destination =
+        gtk_file_dialog_save_finish(GTK_FILE_DIALOG(source_object), result, &error);
+
+    if (destination == NULL) {
+        if (!g_error_matches(error, GTK_DIALOG_ERROR, GTK_DIALOG_ERROR_DISMISSED)) {
+            g_warning("Failed to choose where to export the history: %s", error->message);
+        }
+        return;
+    }
+
+    g_autofree gchar *history_path = samaya_application_get_history_path();
+    g_autofree gchar *destination_name = g_file_get_basename(destination);
+
+    hs_export_async(history_path, destination, hs_export_format_for_path(destination_name), NULL,
+                    on_history_exported, destination);
+}
+
+// Exports the history to stdout or a file for `--export-history`, without starting the UI.
+static gint samaya_application_export_history(const char *destination_path,
+                                              const char *format_name)
+{
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GOutputStream) output = NULL;
+    g_autofree gchar *history_path = samaya_application_get_history_path();
+    HsExportFormat format = hs_export_format_for_path(destination_path);
+
+    if (format_name != NULL && !hs_export_format_from_string(format_name, &format)) {
+        g_printerr(_("Unknown export format “%s”, expected csv or json.\n"), format_name);
+        return 1;
+    }
+
+    if (g_strcmp0(destination_path, "-") == 0) {
+        output = g_unix_output_stream_new(STDOUT_FILENO, FALSE);
+    } else {
+        g_autoptr(GFile) destination = g_file_new_for_commandline_arg(destination_path);
+        output = G_OUTPUT_STREAM(g_file_replace(destination, NULL, FALSE,
+                                                G_FILE_CREATE_REPLACE_DESTINATION, NULL, &error));
+    }
+
+    if (output == NULL || !hs_export_and_close(history_path, output, format, NULL, &error)) {
+        g_printerr(_("Failed to export the session history: %s\n"), error->message);
+        return 1;
+    }
+
+    return 0;
+}
+
+
+/* ============================================================================
+ * Session Checkpoint
+ * ============================================================================ */
+
+// Resumes the session from the last checkpoint, before any window shows the timer.
+static void samaya_application_restore_checkpoint(SamayaApplication *self)
+{
+    g_autoptr(GError) error = NULL;
+    g_autofree gchar *checkpoint_path = get_state_path("checkpoint.bin");
+    CpCheckpoint checkpoint;
+
+    // Enabled first, so a session that ran out while Samaya was gone is checkpointed as done.
+    cp_enable(checkpoint_path);
+
+    if (cp_read(checkpoint_path, &checkpoint, &error)) {
+        sm_restore_checkpoint(self->samayaSessionManager, &checkpoint);
+    } else if (!g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+        g_warning("Failed to restore the session: %s", error->message);
+    }
+}
+
+
+/* ============================================================================
+ * Idle Detection
+ * ============================================================================ */
+
+static void samaya_application_enable_idle_monitor(SamayaApplication *self)
+{
+    GDBusConnection *connection = g_application_get_dbus_connection(G_APPLICATION(self));
+    g_autoptr(GSettings) settings = g_settings_new("io.github.redddfoxxyy.samaya");
+
+    if (connection == NULL || !g_settings_get_boolean(settings, "pause-when-idle")) {
+        return;
+    }
+
+    im_enable(connection, (guint64) (g_settings_get_double(settings, "idle-timeout") * 60 * 1000),
+              g_settings_get_boolean(settings, "subtract-idle-time"));
+}
+
+
+/* ============================================================================
+ * Completion Sound and Notification
+ * ============================================================================ */
+
+static void play_completion_sound(gpointer backend_data)
+{
+    SamayaApplication *self = SAMAYA_APPLICATION(backend_data);
+
+    if (self->sound_context == NULL) {
+        return;
+    }
+
+    g_autofree char *sound_path = g_build_filename("/app", "share", "sounds", "bell.oga", NULL);
+
+    gsound_context_play_full(self->sound_context, NULL, NULL, NULL, GSOUND_ATTR_MEDIA_FILENAME,
+                             sound_path, NULL);
+}
+
+static void show_completion(RoutineType ended_routine, gpointer backend_data)
+{
+    const char *title = _("Samaya");
+    const char *body = NULL;
+
+    switch (ended_routine) {
+        case Working:
+            body = _("Focus session complete! Time for a break.");
+            break;
+        case ShortBreak:
+        case LongBreak:
+            body = _("Break over! Time to get back to work.");
+            break;
+        default:
+            body = _("Timer finished.");
+            break;
+    }
+
+    GNotification *note = g_notification_new(title);
+    g_notification_set_body(note, body);
+    g_notification_set_priority(note, G_NOTIFICATION_PRIORITY_HIGH);
+
+    g_notification_set_default_action(note, "app.activate");
+
+    g_application_send_notification(G_APPLICATION(backend_data), "timer-complete", note);
+    g_object_unref(note);
+}
+
+static const SmBackend desktopBackend = {
+    .play_completion_sound = play_completion_sound,
+    .show_completion = show_completion,
+};
+
+
+/* ============================================================================
+ * User Hooks
+ * ============================================================================ */
+
+static const char *const hookKeys[HK_N_EVENTS] = {
+    [HkSessionStart] = "hook-session-start",
+    [HkSessionEnd] = "hook-session-end",
+    [HkSessionSkip] = "hook-session-skip",
+};
+
+static void set_hook_command(GSettings *settings, HkEvent event)
+{
+    g_autoptr(GError) error = NULL;
+    g_autofree gchar *command_line = g_settings_get_string(settings, hookKeys[event]);
+
+    if (!hk_set_command(event, command_line, &error)) {
+        g_warning("Ignoring the %s hook: %s", hk_event_to_string(event), error->message);
+        hk_set_command(event, NULL, NULL);
+    }
+}
+
+static void on_hook_settings_changed(GSettings *settings, const char *key, gpointer user_data)
+{
+    if (g_strcmp0(key, "hook-timeout") == 0) {
+        hk_set_timeout(g_settings_get_uint(settings, key) * 1000);
+        return;
+    }
+
+    for (guint event = 0; event < HK_N_EVENTS; event++) {
+        if (g_strcmp0(key, hookKeys[event]) == 0) {
+            set_hook_command(settings, event);
+        }
+    }
+}
+
+// Enabled after the restore, a session that ran out while Samaya was gone does not run hooks.
+static void samaya_application_enable_hooks(SamayaApplication *self)
+{
+    hk_enable(g_settings_get_uint(self->settings, "hook-timeout") * 1000);
+    for (guint event = 0; event < HK_N_EVENTS; event++) {
+        set_hook_command(self->settings, event);
+    }
+
+    g_signal_connect(self->settings, "changed", G_CALLBACK(on_hook_settings_changed), NULL);
+}
+
+
+/* ============================================================================
+ * Schedule
+ * ============================================================================ */
+
+static void load_schedule(SamayaApplication *self)
+{
+    g_auto(GStrv) texts = g_settings_get_strv(self->settings, "schedule");
+    g_autoptr(GArray) rules = g_array_new(FALSE, FALSE, sizeof(ScRule));
+
+    for (guint i = 0; texts[i] != NULL; i++) {
+        g_autoptr(GError) error = NULL;
+        ScRule rule;
+
+        if (sc_parse_rule(texts[i], &rule, &error)) {
+            g_array_append_val(rules, rule);
+        } else {
+            g_warning("Ignoring the schedule rule “%s”: %s", texts[i], error->message);
+        }
+    }
+
+    sm_set_schedule(self->samayaSessionManager, (const ScRule *) rules->data, rules->len);
+}
+
+static void on_schedule_changed(GSettings *settings, const char *key, gpointer user_data)
+{
+    load_schedule(SAMAYA_APPLICATION(user_data));
+}
+
+// Like the hooks, only once a session that was under way has been restored.
+static void samaya_application_enable_schedule(SamayaApplication *self)
+{
+    load_schedule(self);
+
+    g_signal_connect(self->settings, "changed::schedule", G_CALLBACK(on_schedule_changed), self);
+}
+
+
+/* ============================================================================
+ * Calendars
+ * ============================================================================ */
+
+static void load_calendars(SamayaApplication *self)
+{
+    g_auto(GStrv) files = g_settings_get_strv(self->settings, "calendar-files");
+    g_autoptr(GPtrArray) paths = g_ptr_array_new_with_free_func(g_free);
+
+    for (guint i = 0; files[i] != NULL; i++) {
+        if (g_str_has_prefix(files[i], "~/")) {
+            g_ptr_array_add(paths, g_build_filename(g_get_home_dir(), files[i] + 2, NULL));
+        } else if (files[i][0] != '\0') {
+            g_ptr_array_add(paths, g_strdup(files[i]));
+        }
+    }
+
+    if (paths->len == 0) {
+        sm_set_planner(self->samayaSessionManager, NULL, NULL);
+        cl_disable();
+        return;
+    }
+
+    g_ptr_array_add(paths, NULL);
+    cl_enable((const char *const *) paths->pdata);
+    sm_set_planner(self->samayaSessionManager, cl_plan_work_session, NULL);
+}
+
+static void on_calendar_files_changed(GSettings *settings, const char *key, gpointer user_data)
+{
+    load_calendars(SAMAYA_APPLICATION(user_data));
+}
+
+static void samaya_application_enable_calendars(SamayaApplication *self)
+{
+    load_calendars(self);
+
+    g_signal_connect(self->settings, "changed::calendar-files",
+                     G_CALLBACK(on_calendar_files_changed), self);
+}
+
+
+/* ============================================================================
+ * Suspend and Low Power Mode
+ * ============================================================================ */
+
+static void on_low_power_changed(gboolean low_power, gpointer user_data)
+{
+    SamayaApplication *self = SAMAYA_APPLICATION(user_data);
+
+    g_info("%s low power mode", low_power ? "Entering" : "Leaving");
+
+    if (self->samayaSessionManager != NULL) {
+        sm_set_low_power(self->samayaSessionManager, low_power);
+    }
+
+    for (GList *l = gtk_application_get_windows(GTK_APPLICATION(self)); l != NULL; l = l->next) {
+        if (SAMAYA_IS_WINDOW(l->data)) {
+            samaya_window_set_low_power(SAMAYA_WINDOW(l->data), low_power);
+        }
+    }
+}
+
+static void on_system_bus_ready(GObject *source_object, GAsyncResult *result, gpointer user_data)
+{
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GDBusConnection) connection = g_bus_get_finish(result, &error);
+
+    if (connection == NULL) {
+        if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+            g_info("No system bus, a suspend is only noticed on the next tick and there is no "
+                   "low power mode: %s",
+                   error->message);
+        }
+        return;
+    }
+
+    sl_enable(connection);
+    lp_enable(connection, on_low_power_changed, user_data);
+}
+
+static void samaya_application_connect_system_bus(SamayaApplication *self)
+{
+    self->system_bus_cancellable = g_cancellable_new();
+    g_bus_get(G_BUS_TYPE_SYSTEM, self->system_bus_cancellable, on_system_bus_ready, self);
+}
+
+
+/* ============================================================================
+ * Session D-Bus API
+ * ============================================================================ */
+
+// Times are wall clock times in microseconds since the epoch.
+static const char sessionIntrospectionXml[] =
+    "<node>"
+    "  <interface name='io.github.redddfoxxyy.samaya.Session'>"
+    "    <method name='GetProjection'>"
+    "      <arg name='session_end' type='x' direction='out'/>"
+    "      <arg name='long_break_start' type='x' direction='out'/>"
+    "      <arg name='long_break_end' type='x' direction='out'/>"
+    "      <arg name='work_sessions_left' type='u' direction='out'/>"
+    "      <arg name='waits_for_user' type='b' direction='out'/>"
+    "    </method>"
+    "    <method name='CountSessionsBefore'>"
+    "      <arg name='target' type='x' direction='in'/>"
+    "      <arg name='sessions' type='u' direction='out'/>"
+    "    </method>"
+    "  </interface>"
+    "</node>";
+
+static void on_session_method_call(GDBusConnection *connection, const gchar *sender,
+                                   const gchar *object_path, const gchar *interface_name,
+                                   const gchar *method_name, GVariant *parameters,
+                                   GDBusMethodInvocation *invocation, gpointer user_data)
+{
+    SamayaApplication *self = SAMAYA_APPLICATION(user_data);
+
+    if (g_strcmp0(method_name, "GetProjection") == 0) {
+        SmProjectedTimes times;
+        sm_get_projection(self->samayaSessionManager, &times);
+
+        g_dbus_method_invocation_return_value(
+            invocation, g_variant_new("(xxxub)", times.session_end_real_us,
+                                      times.long_break_start_real_us, times.long_break_end_real_us,
+                                      times.work_sessions_left, times.waits_for_user));
+    } else if (g_strcmp0(method_name, "CountSessionsBefore") == 0) {
+        gint64 target_real_us = 0;
+        g_variant_get(parameters, "(x)", &target_real_us);
+
+        g_dbus_method_invocation_return_value(
+            invocation, g_variant_new("(u)", sm_count_sessions_before(self->samayaSessionManager,
+                                                                      target_real_us)));
+    } else {
+        g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR,
+                                              G_DBUS_ERROR_UNKNOWN_METHOD, "Unknown method %s",
+                                              method_name);
+    }
+}
+
+static const GDBusInterfaceVTable sessionVTable = {.method_call = on_session_method_call};
+
+
+/* ============================================================================
+ * Panel Indicator
+ * ============================================================================ */
+
+static void on_indicator_activate(gpointer user_data)
+{
+    g_application_activate(G_APPLICATION(user_data));
+}
+
+// Starts or stops the timer like the start button, whether or not a window is open.
+static void on_indicator_secondary_activate(gpointer user_data)
+{
+    SessionManagerPtr session_manager = SAMAYA_APPLICATION(user_data)->samayaSessionManager;
+    TimerPtr timer = session_manager->timer_instance;
+
+    if (tm_get_state(timer) == StRunning) {
+        tm_trigger_event(timer, EvStop);
+    } else {
+        sm_start(session_manager);
+    }
+}
+
+static void on_indicator_registration_changed(gpointer user_data)
+{
+    SamayaApplication *self = SAMAYA_APPLICATION(user_data);
+    gboolean registered = si_is_registered();
+
+    if (registered == self->held_for_indicator) {
+        return;
+    }
+    self->held_for_indicator = registered;
+
+    if (registered) {
+        g_application_hold(G_APPLICATION(self));
+    } else {
+        g_application_release(G_APPLICATION(self));
+    }
+
+    for (GList *l = gtk_application_get_windows(GTK_APPLICATION(self)); l != NULL; l = l->next) {
+        GtkWindow *window = GTK_WINDOW(l->data);
+
+        gtk_window_set_hide_on_close(window, registered);
+
+        // The panel went away, nothing would bring a hidden window back anymore.
+        if (!registered && !gtk_widget_get_visible(GTK_WIDGET(window))) {
+            gtk_window_present(window);
+        }
+    }
+}
+
+static void samaya_application_enable_indicator(SamayaApplication *self)
+{
+    GDBusConnection *connection = g_application_get_dbus_connection(G_APPLICATION(self));
+
+    if (connection == NULL) {
+        return;
+    }
+
+    si_enable(connection, on_indicator_activate, on_indicator_secondary_activate,
+              on_indicator_registration_changed, self);
+}
+
+
+/* ============================================================================
+ * Event Tracing
+ * ============================================================================ */
+
+static void samaya_application_flush_trace(SamayaApplication *self)
+{
+    g_autoptr(GError) error = NULL;
+    g_autofree gchar *trace_path = get_state_path("trace.bin");
+
+    if (!tr_flush(trace_path, &error)) {
+        g_warning("Failed to write event trace: %s", error->message);
+        return;
+    }
+
+    g_message("Event trace written to %s", trace_path);
+}
+
+static gboolean on_flush_trace_signal(gpointer user_data)
+{
+    samaya_application_flush_trace(SAMAYA_APPLICATION(user_data));
+    return G_SOURCE_CONTINUE;
+}
+
+static void samaya_application_enable_trace(SamayaApplication *self)
+{
+    g_autofree gchar *trace_dir = g_build_filename(g_get_user_state_dir(), "samaya", NULL);
+    g_autofree gchar *crash_path = get_state_path("trace-crash.bin");
+
+    if (g_mkdir_with_parents(trace_dir, 0700) != 0) {
+        g_warning("Failed to create %s, crash traces will not be written.", trace_dir);
+        g_clear_pointer(&crash_path, g_free);
+    }
+
+    // Stamped with the clock of the timer, so a replay sees the same jumps over a suspend.
+    tr_enable(TR_DEFAULT_CAPACITY, self->samayaSessionManager->timer_instance->tm_clock,
+              crash_path);
+    sm_trace_snapshot(self->samayaSessionManager);
+
+    // Lets a trace be taken with `kill -USR1` even when the UI is stuck.
+    g_unix_signal_add(SIGUSR1, on_flush_trace_signal, self);
+}
+
+
 /* ============================================================================
  * Samaya Application Methods
  * ============================================================================ */
@@ -48,6 +592,25 @@ static void samaya_application_preferences_action(GSimpleAction *action, GVarian
     adw_dialog_present(ADW_DIALOG(dialog), GTK_WIDGET(window));
 }
 
+static void samaya_application_history_action(GSimpleAction *action, GVariant *parameter,
+                                              gpointer user_data)
+{
+    SamayaApplication *self = SAMAYA_APPLICATION(user_data);
+    GtkWindow *window = gtk_application_get_active_window(GTK_APPLICATION(self));
+    g_autofree gchar *history_path = samaya_application_get_history_path();
+    g_autoptr(GError) error = NULL;
+
+    g_autoptr(SamayaHistoryModel) model = samaya_history_model_new(history_path, &error);
+    if (model == NULL) {
+        g_warning("Failed to open the session history: %s", error->message);
+        return;
+    }
+
+    SamayaHistoryDialog *dialog = samaya_history_dialog_new(model);
+
+    adw_dialog_present(ADW_DIALOG(dialog), GTK_WIDGET(window));
+}
+
 static void samaya_application_about_action(GSimpleAction *action, GVariant *parameter,
                                             gpointer user_data)
 {
@@ -80,6 +643,22 @@ static void samaya_application_about_action(GSimpleAction *action, GVariant *par
     // clang-format on
 }
 
+static GtkWindow *samaya_application_new_window(SamayaApplication *self)
+{
+    GtkWindow *window = g_object_new(SAMAYA_TYPE_WINDOW, "application", self, NULL);
+
+    gtk_window_set_hide_on_close(window, si_is_registered());
+
+    return window;
+}
+
+// Every window follows the same session, one can be kept on each monitor.
+static void samaya_application_new_window_action(GSimpleAction *action, GVariant *parameter,
+                                                 gpointer user_data)
+{
+    gtk_window_present(samaya_application_new_window(SAMAYA_APPLICATION(user_data)));
+}
+
 static void samaya_application_quit_action(GSimpleAction *action, GVariant *parameter,
                                            gpointer user_data)
 {
@@ -90,8 +669,30 @@ static void samaya_application_quit_action(GSimpleAction *action, GVariant *para
     g_application_quit(G_APPLICATION(self));
 }
 
+static void samaya_application_flush_trace_action(GSimpleAction *action, GVariant *parameter,
+                                                  gpointer user_data)
+{
+    samaya_application_flush_trace(SAMAYA_APPLICATION(user_data));
+}
+
+static void samaya_application_export_history_action(GSimpleAction *action, GVariant *parameter,
+                                                     gpointer user_data)
+{
+    SamayaApplication *self = SAMAYA_APPLICATION(user_data);
+    GtkWindow *window = gtk_application_get_active_window(GTK_APPLICATION(self));
+    g_autoptr(GtkFileDialog) dialog = gtk_file_dialog_new();
+
+    gtk_file_dialog_set_title(dialog, _("Export History"));
+    gtk_file_dialog_set_initial_name(dialog, "samaya-history.csv");
+    gtk_file_dialog_save(dialog, window, NULL, on_export_destination_chosen, self);
+}
+
 static const GActionEntry appActions[] = {
     {"quit", samaya_application_quit_action},
+    {"new-window", samaya_application_new_window_action},
+    {"history", samaya_application_history_action},
+    {"export-history", samaya_application_export_history_action},
+    {"flush-trace", samaya_application_flush_trace_action},
     {"about", samaya_application_about_action},
     {"preferences", samaya_application_preferences_action},
 };
@@ -116,6 +717,30 @@ static void samaya_application_startup(GApplication *app)
                                                GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
 
     g_object_unref(provider);
+
+    g_autofree gchar *history_path = samaya_application_get_history_path();
+    g_autofree gchar *tags_path = get_tags_path();
+    hs_enable(history_path);
+    tg_enable(tags_path, history_path);
+
+    // The tag outlives the session it was set on, until the user changes it.
+    SAMAYA_APPLICATION(app)->settings = g_settings_new("io.github.redddfoxxyy.samaya");
+    g_autofree gchar *current_tag =
+        g_settings_get_string(SAMAYA_APPLICATION(app)->settings, "current-tag");
+    sm_set_tag(SAMAYA_APPLICATION(app)->samayaSessionManager, tg_intern(current_tag));
+
+    samaya_application_restore_checkpoint(SAMAYA_APPLICATION(app));
+    samaya_application_enable_hooks(SAMAYA_APPLICATION(app));
+    samaya_application_enable_schedule(SAMAYA_APPLICATION(app));
+    samaya_application_enable_calendars(SAMAYA_APPLICATION(app));
+    samaya_application_enable_idle_monitor(SAMAYA_APPLICATION(app));
+    samaya_application_connect_system_bus(SAMAYA_APPLICATION(app));
+    samaya_application_enable_indicator(SAMAYA_APPLICATION(app));
+
+    // Started after the restore, so the trace snapshot includes the resumed session.
+    if (SAMAYA_APPLICATION(app)->trace_requested) {
+        samaya_application_enable_trace(SAMAYA_APPLICATION(app));
+    }
 }
 
 static void samaya_application_activate(GApplication *app)
@@ -127,20 +752,93 @@ static void samaya_application_activate(GApplication *app)
     window = gtk_application_get_active_window(GTK_APPLICATION(app));
 
     if (window == NULL) {
-        window = g_object_new(SAMAYA_TYPE_WINDOW, "application", app, NULL);
+        window = samaya_application_new_window(SAMAYA_APPLICATION(app));
     }
 
     gtk_window_present(window);
 }
 
+static gint samaya_application_handle_local_options(GApplication *app, GVariantDict *options)
+{
+    SamayaApplication *self = SAMAYA_APPLICATION(app);
+
+    const char *export_path = NULL;
+    const char *export_format = NULL;
+
+    if (g_variant_dict_lookup(options, "export-history", "^&ay", &export_path)) {
+        g_variant_dict_lookup(options, "export-format", "&s", &export_format);
+        return samaya_application_export_history(export_path, export_format);
+    }
+
+    self->trace_requested = g_variant_dict_contains(options, "trace");
+
+    return -1;
+}
+
+static gboolean samaya_application_dbus_register(GApplication *app, GDBusConnection *connection,
+                                                 const gchar *object_path, GError **error)
+{
+    SamayaApplication *self = SAMAYA_APPLICATION(app);
+
+    if (!G_APPLICATION_CLASS(samaya_application_parent_class)
+             ->dbus_register(app, connection, object_path, error)) {
+        return FALSE;
+    }
+
+    g_autoptr(GDBusNodeInfo) node_info =
+        g_dbus_node_info_new_for_xml(sessionIntrospectionXml, error);
+    if (node_info == NULL) {
+        return FALSE;
+    }
+
+    self->session_registration_id =
+        g_dbus_connection_register_object(connection, object_path, node_info->interfaces[0],
+                                          &sessionVTable, self, NULL, error);
+
+    return self->session_registration_id != 0;
+}
+
+static void samaya_application_dbus_unregister(GApplication *app, GDBusConnection *connection,
+                                               const gchar *object_path)
+{
+    SamayaApplication *self = SAMAYA_APPLICATION(app);
+
+    if (self->session_registration_id != 0) {
+        g_dbus_connection_unregister_object(connection, self->session_registration_id);
+        self->session_registration_id = 0;
+    }
+
+    G_APPLICATION_CLASS(samaya_application_parent_class)
+        ->dbus_unregister(app, connection, object_path);
+}
+
 static void samaya_application_dispose(GObject *object)
 {
     SamayaApplication *self = SAMAYA_APPLICATION(object);
 
+    im_disable();
+    si_disable();
+
+    g_cancellable_cancel(self->system_bus_cancellable);
+    g_clear_object(&self->system_bus_cancellable);
+    sl_disable();
+    lp_disable();
+
+    hk_disable();
+
+    // Turns the schedule off as well.
     if (self->samayaSessionManager) {
         sm_deinit(self->samayaSessionManager);
         self->samayaSessionManager = NULL;
     }
+    cl_disable();
+    g_clear_object(&self->settings);
+    g_clear_object(&self->sound_context);
+
+    cp_disable();
+    hs_disable();
+    tg_disable();
+    tr_disable();
 
     G_OBJECT_CLASS(samaya_application_parent_class)->dispose(object);
 }
@@ -152,6 +850,9 @@ static void samaya_application_class_init(SamayaApplicationClass *klass)
 
     app_class->startup = samaya_application_startup;
     app_class->activate = samaya_application_activate;
+    app_class->handle_local_options = samaya_application_handle_local_options;
+    app_class->dbus_register = samaya_application_dbus_register;
+    app_class->dbus_unregister = samaya_application_dbus_unregister;
     object_class->dispose = samaya_application_dispose;
 }
 
@@ -160,8 +861,30 @@ static void samaya_application_init(SamayaApplication *self)
     g_action_map_add_action_entries(G_ACTION_MAP(self), appActions, G_N_ELEMENTS(appActions), self);
     gtk_application_set_accels_for_action(GTK_APPLICATION(self), "app.quit",
                                           (const char *[]) {"<control>q", NULL});
+    gtk_application_set_accels_for_action(GTK_APPLICATION(self), "app.new-window",
+                                          (const char *[]) {"<control>n", NULL});
     gtk_application_set_accels_for_action(GTK_APPLICATION(self), "app.preferences",
                                           (const char *[]) {"<control>comma", NULL});
+    gtk_application_set_accels_for_action(GTK_APPLICATION(self), "app.history",
+                                          (const char *[]) {"<control>h", NULL});
+    gtk_application_set_accels_for_action(GTK_APPLICATION(self), "win.toggle-debug-overlay",
+                                          (const char *[]) {"<control><shift>d", NULL});
+
+    g_application_add_main_option(G_APPLICATION(self), "trace", 0, G_OPTION_FLAG_NONE,
+                                  G_OPTION_ARG_NONE,
+                                  _("Record timer events, write them out with the flush-trace "
+                                    "action or SIGUSR1"),
+                                  NULL);
+    g_application_add_main_option(G_APPLICATION(self), "export-history", 0, G_OPTION_FLAG_NONE,
+                                  G_OPTION_ARG_FILENAME,
+                                  _("Export the session history to FILE, or to stdout for -, and "
+                                    "exit"),
+                                  _("FILE"));
+    g_application_add_main_option(G_APPLICATION(self), "export-format", 0, G_OPTION_FLAG_NONE,
+                                  G_OPTION_ARG_STRING,
+                                  _("Format of the exported history, csv or json, picked from the "
+                                    "file name by default"),
+                                  _("FORMAT"));
 
     // TODO: Convert the given block of code till line 163 into a function.
     GSettings *settings = g_settings_new("io.github.redddfoxxyy.samaya");
@@ -178,6 +901,15 @@ static void samaya_application_init(SamayaApplication *self)
 
     self->samayaSessionManager = sm_init(sessions, work_duration, short_break_duration,
                                          long_break_duration, auto_breaks, auto_work, NULL, self);
+    sm_set_count_suspended_time(self->samayaSessionManager,
+                                g_settings_get_boolean(settings, "count-suspended-time"));
+
+    g_autoptr(GError) error = NULL;
+    self->sound_context = gsound_context_new(NULL, &error);
+    if (self->sound_context == NULL) {
+        g_warning("Failed to set up the completion sound: %s", error->message);
+    }
+    sm_set_backend(self->samayaSessionManager, &desktopBackend, self);
 
     g_object_unref(settings);
 }
@@ -30,4 +30,7 @@ G_DECLARE_FINAL_TYPE(SamayaApplication, samaya_application, SAMAYA, APPLICATION,
 
 SamayaApplication *samaya_application_new(const char *application_id, GApplicationFlags flags);
 
+// Path of the session history, $XDG_DATA_HOME/samaya/history.bin.
+gchar *samaya_application_get_history_path(void);
+
 G_END_DECLS
@@ -0,0 +1,986 @@
+/* samaya-calendar.c
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include <gio/gio.h>
+#include <stdio.h>
+#include <string.h>
+#include "samaya-calendar.h"
+
+#define DAY_US (G_GINT64_CONSTANT(86400) * G_USEC_PER_SEC)
+#define HOUR_US (G_GINT64_CONSTANT(3600) * G_USEC_PER_SEC)
+
+// Recurrences are expanded no further than this, against rules gone wrong.
+#define MAX_OCCURRENCES 100000
+
+typedef enum
+{
+    ClOnce,
+    ClDaily,
+    ClWeekly,
+    ClMonthly,
+    ClYearly,
+} ClFrequency;
+
+typedef struct
+{
+    gchar *uid;
+
+    // In the zone of the event, which the recurrence steps through.
+    GDateTime *start;
+    gint64 duration_us;
+
+    // Cancelled or free, kept only to leave out the instance it replaces.
+    gboolean free;
+
+    ClFrequency frequency;
+    guint interval;
+
+    // 0 when the recurrence does not end that way.
+    guint count;
+    gint64 until_us;
+
+    // BYDAY of weekly rules with bit 0 for Monday, 0 for the day of the start.
+    guint8 weekdays;
+
+    // Start times of instances left out, NULL for none.
+    GArray *exdates;
+
+    // Start of the instance of a recurring event this one replaces, 0 for none.
+    gint64 recurrence_id_us;
+} ClEvent;
+
+typedef struct
+{
+    gchar *path;
+    GFileMonitor *monitor;
+    guint reload_id;
+
+    GPtrArray *events;
+
+    // Sorted by start. Read as a balanced tree where the node of the range [lo, hi) is its middle,
+    // max_ends holds the latest end in the range of every node.
+    GArray *busy;
+    GArray *max_ends;
+
+    gint64 expanded_from_us;
+    gint64 expanded_to_us;
+} ClCalendar;
+
+typedef struct
+{
+    GPtrArray *events;
+
+    // Time zones by TZID, looking one up reads the zone file.
+    GHashTable *zones;
+
+    gboolean in_event;
+
+    // Depth of components inside the event, such as VALARM, whose properties are not its own.
+    guint nested;
+
+    gchar *uid;
+    GDateTime *start;
+    GDateTime *end;
+    gint64 duration_us;
+    gboolean has_duration;
+    gboolean all_day;
+    gboolean free;
+    gchar *recurrence;
+    GArray *exdates;
+    gint64 recurrence_id_us;
+} ClParser;
+
+static const char *const weekdayCodes[] = {"MO", "TU", "WE", "TH", "FR", "SA", "SU"};
+
+
+/* ============================================================================
+ * Static Variables
+ * ============================================================================ */
+
+static GPtrArray *clCalendars = NULL;
+
+
+/* ============================================================================
+ * Events
+ * ============================================================================ */
+
+static void cl_event_free(ClEvent *event)
+{
+    g_free(event->uid);
+    g_date_time_unref(event->start);
+    g_clear_pointer(&event->exdates, g_array_unref);
+    g_free(event);
+}
+
+static gint64 to_real_us(GDateTime *date_time)
+{
+    return g_date_time_to_unix(date_time) * G_USEC_PER_SEC;
+}
+
+// The key of an instance of a recurring event, for the ones moved through RECURRENCE-ID.
+static gchar *instance_key(const char *uid, gint64 start_us)
+{
+    return g_strdup_printf("%s/%" G_GINT64_FORMAT, (uid != NULL) ? uid : "", start_us);
+}
+
+static gboolean is_excluded(const ClEvent *event, gint64 start_us)
+{
+    if (event->exdates == NULL) {
+        return FALSE;
+    }
+
+    for (guint i = 0; i < event->exdates->len; i++) {
+        if (g_array_index(event->exdates, gint64, i) == start_us) {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+// A recurrence rule in the subset described in samaya-calendar.h, FALSE for any other.
+static gboolean parse_recurrence(const char *rule, GTimeZone *zone, ClEvent *event)
+{
+    g_auto(GStrv) parts = g_strsplit(rule, ";", -1);
+
+    event->interval = 1;
+
+    for (guint i = 0; parts[i] != NULL; i++) {
+        g_auto(GStrv) pair = g_strsplit(parts[i], "=", 2);
+        const char *key = pair[0];
+        const char *value = pair[1];
+
+        if (key[0] == '\0' || g_ascii_strcasecmp(key, "WKST") == 0) {
+            continue;
+        }
+        if (value == NULL) {
+            return FALSE;
+        }
+
+        if (g_ascii_strcasecmp(key, "FREQ") == 0) {
+            if (g_ascii_strcasecmp(value, "DAILY") == 0) {
+                event->frequency = ClDaily;
+            } else if (g_ascii_strcasecmp(value, "WEEKLY") == 0) {
+                event->frequency = ClWeekly;
+            } else if (g_ascii_strcasecmp(value, "MONTHLY") == 0) {
+                event->frequency = ClMonthly;
+            } else if (g_ascii_strcasecmp(value, "YEARLY") == 0) {
+                event->frequency = ClYearly;
+            } else {
+                return FALSE;
+            }
+        } else if (g_ascii_strcasecmp(key, "INTERVAL") == 0) {
+            event->interval = (guint) g_ascii_strtoull(value, NULL, 10);
+        } else if (g_ascii_strcasecmp(key, "COUNT") == 0) {
+            event->count = (guint) g_ascii_strtoull(value, NULL, 10);
+        } else if (g_ascii_strcasecmp(key, "UNTIL") == 0) {
+            gint year = 0;
+            gint month = 0;
+            gint day = 0;
+            gint hour = 23;
+            gint minute = 59;
+            gint second = 59;
+
+            if (sscanf(value, "%4d%2d%2d", &year, &month, &day) != 3) {
+                return FALSE;
+            }
+            if (strlen(value) >= 15) {
+                sscanf(value + 8, "T%2d%2d%2d", &hour, &minute, &second);
+            }
+
+            gboolean is_utc = (value[strlen(value) - 1] == 'Z');
+            g_autoptr(GTimeZone) utc = g_time_zone_new_utc();
+            g_autoptr(GDateTime) until =
+                g_date_time_new(is_utc ? utc : zone, year, month, day, hour, minute, second);
+            if (until == NULL) {
+                return FALSE;
+            }
+            event->until_us = to_real_us(until);
+        } else if (g_ascii_strcasecmp(key, "BYDAY") == 0) {
+            g_auto(GStrv) days = g_strsplit(value, ",", -1);
+
+            for (guint d = 0; days[d] != NULL; d++) {
+                guint weekday = 0;
+                while (weekday < G_N_ELEMENTS(weekdayCodes) &&
+                       g_ascii_strcasecmp(days[d], weekdayCodes[weekday]) != 0) {
+                    weekday++;
+                }
+
+                // Such as 1MO, the first Monday of a month.
+                if (weekday == G_N_ELEMENTS(weekdayCodes)) {
+                    return FALSE;
+                }
+                event->weekdays |= 1 << weekday;
+            }
+        } else {
+            return FALSE;
+        }
+    }
+
+    // Days of the week are only understood for weekly rules.
+    return event->frequency != ClOnce && event->interval > 0 &&
+           (event->weekdays == 0 || event->frequency == ClWeekly);
+}
+
+
+/* ============================================================================
+ * Parsing
+ * ============================================================================ */
+
+static void reset_event(ClParser *parser)
+{
+    g_clear_pointer(&parser->uid, g_free);
+    g_clear_pointer(&parser->start, g_date_time_unref);
+    g_clear_pointer(&parser->end, g_date_time_unref);
+    g_clear_pointer(&parser->recurrence, g_free);
+    g_clear_pointer(&parser->exdates, g_array_unref);
+
+    parser->nested = 0;
+    parser->duration_us = 0;
+    parser->has_duration = FALSE;
+    parser->all_day = FALSE;
+    parser->free = FALSE;
+    parser->recurrence_id_us = 0;
+}
+
+static GTimeZone *lookup_zone(ClParser *parser, const char *tzid)
+{
+    if (tzid == NULL) {
+        return NULL;
+    }
+
+    GTimeZone *zone = g_hash_table_lookup(parser->zones, tzid);
+    if (zone == NULL) {
+        zone = g_time_zone_new_identifier(tzid);
+        if (zone == NULL) {
+            g_info("Unknown time zone %s in calendar, using the local one", tzid);
+            zone = g_time_zone_new_local();
+        }
+        g_hash_table_insert(parser->zones, g_strdup(tzid), zone);
+    }
+
+    return zone;
+}
+
+// DATE or DATE-TIME values, in UTC, in the given zone or floating in the local one.
+static GDateTime *parse_date_time(const char *value, GTimeZone *zone, gboolean *is_date)
+{
+    gint year = 0;
+    gint month = 0;
+    gint day = 0;
+    gint hour = 0;
+    gint minute = 0;
+    gint second = 0;
+    gint consumed = 0;
+
+    if (sscanf(value, "%4d%2d%2d%n", &year, &month, &day, &consumed) != 3 || consumed != 8) {
+        return NULL;
+    }
+
+    *is_date = (value[8] == '\0');
+    if (!*is_date && (sscanf(value + 8, "T%2d%2d%2d%n", &hour, &minute, &second, &consumed) != 3 ||
+                      consumed != 7)) {
+        return NULL;
+    }
+
+    if (!*is_date && value[15] == 'Z') {
+        g_autoptr(GTimeZone) utc = g_time_zone_new_utc();
+        return g_date_time_new(utc, year, month, day, hour, minute, second);
+    }
+    if (zone == NULL) {
+        g_autoptr(GTimeZone) local = g_time_zone_new_local();
+        return g_date_time_new(local, year, month, day, hour, minute, second);
+    }
+
+    return g_date_time_new(zone, year, month, day, hour, minute, second);
+}
+
+static gboolean parse_duration(const char *value, gint64 *duration_us)
+{
+    const char *cursor = value;
+    gboolean negative = FALSE;
+    gboolean in_time = FALSE;
+    gint64 seconds = 0;
+
+    if (*cursor == '+' || *cursor == '-') {
+        negative = (*cursor == '-');
+        cursor++;
+    }
+    if (*cursor++ != 'P') {
+        return FALSE;
+    }
+
+    while (*cursor != '\0') {
+        if (*cursor == 'T') {
+            in_time = TRUE;
+            cursor++;
+            continue;
+        }
+
+        gchar *end = NULL;
+        gint64 amount = (gint64) g_ascii_strtoull(cursor, &end, 10);
+        if (end == cursor) {
+            return FALSE;
+        }
+
+        if (*end == 'W' && !in_time) {
+            seconds += amount * 7 * 86400;
+        } else if (*end == 'D' && !in_time) {
+            seconds += amount * 86400;
+        } else if (*end == 'H' && in_time) {
+            seconds += amount * 3600;
+        } else if (*end == 'M' && in_time) {
+            seconds += amount * 60;
+        } else if (*end == 'S' && in_time) {
+            seconds += amount;
+        } else {
+            return FALSE;
+        }
+        cursor = end + 1;
+    }
+
+    *duration_us = (negative ? -seconds : seconds) * G_USEC_PER_SEC;
+    return TRUE;
+}
+
+static void finish_event(ClParser *parser)
+{
+    if (parser->start == NULL) {
+        return;
+    }
+
+    gint64 duration_us = parser->duration_us;
+    if (parser->end != NULL) {
+        duration_us = g_date_time_difference(parser->end, parser->start);
+    } else if (!parser->has_duration && parser->all_day) {
+        duration_us = DAY_US;
+    }
+
+    // Reminders without a length, like all day events, do not take any time away.
+    gboolean free = parser->free || parser->all_day || duration_us <= 0;
+    if (free && parser->recurrence_id_us == 0) {
+        return;
+    }
+
+    ClEvent *event = g_new0(ClEvent, 1);
+    event->uid = g_steal_pointer(&parser->uid);
+    event->start = g_date_time_ref(parser->start);
+    event->duration_us = duration_us;
+    event->free = free;
+    event->exdates = g_steal_pointer(&parser->exdates);
+    event->recurrence_id_us = parser->recurrence_id_us;
+
+    if (parser->recurrence != NULL && event->recurrence_id_us == 0 &&
+        !parse_recurrence(parser->recurrence, g_date_time_get_timezone(event->start), event)) {
+        g_info("Recurrence %s of calendar event %s not understood, only its first occurrence "
+               "counts",
+               parser->recurrence, (event->uid != NULL) ? event->uid : "without UID");
+        event->frequency = ClOnce;
+        event->count = 0;
+        event->until_us = 0;
+        event->weekdays = 0;
+    }
+
+    g_ptr_array_add(parser->events, event);
+}
+
+// Where the value of a content line starts, parameter values may contain colons when quoted.
+static char *find_value(char *line)
+{
+    gboolean quoted = FALSE;
+
+    for (char *cursor = line; *cursor != '\0'; cursor++) {
+        if (*cursor == '"') {
+            quoted = !quoted;
+        } else if (*cursor == ':' && !quoted) {
+            *cursor = '\0';
+            return cursor + 1;
+        }
+    }
+
+    return NULL;
+}
+
+static void parse_line(ClParser *parser, char *line)
+{
+    char *value = find_value(line);
+    if (value == NULL) {
+        return;
+    }
+
+    gsize name_length = strcspn(line, ";");
+    const char *params = line + name_length;
+    line[name_length] = '\0';
+    const char *name = line;
+
+    if (g_ascii_strcasecmp(name, "BEGIN") == 0) {
+        if (parser->in_event) {
+            parser->nested++;
+        } else if (g_ascii_strcasecmp(value, "VEVENT") == 0) {
+            reset_event(parser);
+            parser->in_event = TRUE;
+        }
+        return;
+    }
+    if (g_ascii_strcasecmp(name, "END") == 0) {
+        if (parser->in_event && parser->nested > 0) {
+            parser->nested--;
+        } else if (parser->in_event) {
+            finish_event(parser);
+            parser->in_event = FALSE;
+        }
+        return;
+    }
+    if (!parser->in_event || parser->nested > 0) {
+        return;
+    }
+
+    // The parameters start with the ; the name ended at.
+    g_autofree gchar *tzid = NULL;
+    if (*params != '\0') {
+        g_auto(GStrv) pairs = g_strsplit(params + 1, ";", -1);
+
+        for (guint i = 0; pairs[i] != NULL; i++) {
+            if (g_ascii_strncasecmp(pairs[i], "TZID=", 5) == 0) {
+                tzid = g_strdup(pairs[i] + 5);
+                g_strdelimit(tzid, "\"", ' ');
+                g_strstrip(tzid);
+            }
+        }
+    }
+    GTimeZone *zone = lookup_zone(parser, tzid);
+    gboolean is_date = FALSE;
+
+    if (g_ascii_strcasecmp(name, "UID") == 0) {
+        g_free(parser->uid);
+        parser->uid = g_strdup(value);
+    } else if (g_ascii_strcasecmp(name, "DTSTART") == 0) {
+        g_clear_pointer(&parser->start, g_date_time_unref);
+        parser->start = parse_date_time(value, zone, &is_date);
+        parser->all_day = is_date;
+    } else if (g_ascii_strcasecmp(name, "DTEND") == 0) {
+        g_clear_pointer(&parser->end, g_date_time_unref);
+        parser->end = parse_date_time(value, zone, &is_date);
+    } else if (g_ascii_strcasecmp(name, "DURATION") == 0) {
+        parser->has_duration = parse_duration(value, &parser->duration_us);
+    } else if (g_ascii_strcasecmp(name, "RRULE") == 0) {
+        g_free(parser->recurrence);
+        parser->recurrence = g_strdup(value);
+    } else if (g_ascii_strcasecmp(name, "EXDATE") == 0) {
+        g_auto(GStrv) dates = g_strsplit(value, ",", -1);
+
+        if (parser->exdates == NULL) {
+            parser->exdates = g_array_new(FALSE, FALSE, sizeof(gint64));
+        }
+        for (guint i = 0; dates[i] != NULL; i++) {
+            g_autoptr(GDateTime) date = parse_date_time(dates[i], zone, &is_date);
+            if (date != NULL) {
+                gint64 date_us = to_real_us(date);
+                g_array_append_val(parser->exdates, date_us);
+            }
+        }
+    } else if (g_ascii_strcasecmp(name, "RECURRENCE-ID") == 0) {
+        g_autoptr(GDateTime) date = parse_date_time(value, zone, &is_date);
+        parser->recurrence_id_us = (date != NULL) ? to_real_us(date) : 0;
+    } else if (g_ascii_strcasecmp(name, "STATUS") == 0) {
+        parser->free |= (g_ascii_strcasecmp(value, "CANCELLED") == 0);
+    } else if (g_ascii_strcasecmp(name, "TRANSP") == 0) {
+        parser->free |= (g_ascii_strcasecmp(value, "TRANSPARENT") == 0);
+    }
+}
+
+// Splits the text into content lines, joining the ones folded over several lines of the file.
+static void parse_calendar(const char *text, gsize length, GPtrArray *events)
+{
+    ClParser parser = {
+        .events = events,
+        .zones = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                       (GDestroyNotify) g_time_zone_unref),
+    };
+    g_autoptr(GString) line = g_string_new(NULL);
+    const char *end = text + length;
+
+    for (const char *cursor = text; cursor < end;) {
+        const char *newline = memchr(cursor, '\n', (gsize) (end - cursor));
+        const char *line_end = (newline != NULL) ? newline : end;
+        const char *next = (newline != NULL) ? newline + 1 : end;
+
+        if (line_end > cursor && line_end[-1] == '\r') {
+            line_end--;
+        }
+
+        if (cursor < line_end && (*cursor == ' ' || *cursor == '\t')) {
+            g_string_append_len(line, cursor + 1, line_end - cursor - 1);
+        } else {
+            if (line->len > 0) {
+                parse_line(&parser, line->str);
+            }
+            g_string_truncate(line, 0);
+            g_string_append_len(line, cursor, line_end - cursor);
+        }
+
+        cursor = next;
+    }
+    if (line->len > 0) {
+        parse_line(&parser, line->str);
+    }
+
+    reset_event(&parser);
+    g_hash_table_unref(parser.zones);
+}
+
+
+/* ============================================================================
+ * Interval Tree
+ * ============================================================================ */
+
+static gint compare_intervals(gconstpointer a, gconstpointer b)
+{
+    const ClInterval *first = a;
+    const ClInterval *second = b;
+
+    if (first->start_us != second->start_us) {
+        return (first->start_us < second->start_us) ? -1 : 1;
+    }
+    if (first->end_us != second->end_us) {
+        return (first->end_us < second->end_us) ? -1 : 1;
+    }
+    return 0;
+}
+
+static gint64 build_max_ends(ClCalendar *calendar, guint lo, guint hi)
+{
+    if (lo >= hi) {
+        return G_MININT64;
+    }
+
+    guint mid = lo + (hi - lo) / 2;
+    gint64 left_end = build_max_ends(calendar, lo, mid);
+    gint64 right_end = build_max_ends(calendar, mid + 1, hi);
+    gint64 max_end = MAX(g_array_index(calendar->busy, ClInterval, mid).end_us,
+                         MAX(left_end, right_end));
+
+    g_array_index(calendar->max_ends, gint64, mid) = max_end;
+    return max_end;
+}
+
+// The first interval by start in [lo, hi) that overlaps [start_us, end_us), -1 for none.
+static gint find_first_overlap(const ClCalendar *calendar, guint lo, guint hi, gint64 start_us,
+                               gint64 end_us)
+{
+    if (lo >= hi) {
+        return -1;
+    }
+
+    guint mid = lo + (hi - lo) / 2;
+
+    // Everything in this range ended before the interval.
+    if (g_array_index(calendar->max_ends, gint64, mid) <= start_us) {
+        return -1;
+    }
+
+    gint found = find_first_overlap(calendar, lo, mid, start_us, end_us);
+    if (found >= 0) {
+        return found;
+    }
+
+    const ClInterval *interval = &g_array_index(calendar->busy, ClInterval, mid);
+    if (interval->start_us >= end_us) {
+        return -1;
+    }
+    if (interval->end_us > start_us) {
+        return (gint) mid;
+    }
+
+    return find_first_overlap(calendar, mid + 1, hi, start_us, end_us);
+}
+
+
+/* ============================================================================
+ * Expansion
+ * ============================================================================ */
+
+static gint64 get_period_us(const ClEvent *event)
+{
+    // The longest a step can take, with an hour for daylight saving.
+    switch (event->frequency) {
+        case ClDaily:
+            return DAY_US + HOUR_US;
+        case ClWeekly:
+            return 7 * DAY_US + HOUR_US;
+        case ClMonthly:
+            return 31 * DAY_US + HOUR_US;
+        case ClYearly:
+            return 366 * DAY_US + HOUR_US;
+        case ClOnce:
+        default:
+            return 0;
+    }
+}
+
+// The start of the nth step, NULL when it falls on a day the month or year does not have.
+static GDateTime *step_start(const ClEvent *event, GDateTime *base, guint step)
+{
+    gint amount = (gint) (step * event->interval);
+    GDateTime *start = NULL;
+
+    switch (event->frequency) {
+        case ClDaily:
+            return g_date_time_add_days(base, amount);
+        case ClWeekly:
+            return g_date_time_add_weeks(base, amount);
+        case ClMonthly:
+            start = g_date_time_add_months(base, amount);
+            break;
+        case ClYearly:
+            start = g_date_time_add_years(base, amount);
+            break;
+        case ClOnce:
+        default:
+            return g_date_time_ref(base);
+    }
+
+    // Like the 31st in April or the 29th of February outside leap years.
+    if (start != NULL &&
+        g_date_time_get_day_of_month(start) != g_date_time_get_day_of_month(base)) {
+        g_clear_pointer(&start, g_date_time_unref);
+    }
+
+    return start;
+}
+
+typedef struct
+{
+    GArray *busy;
+    GHashTable *moved;
+    gint64 from_us;
+    gint64 to_us;
+    guint n_seen;
+} ClExpansion;
+
+// FALSE once the recurrence is over or past the window.
+static gboolean add_occurrence(ClExpansion *expansion, const ClEvent *event, GDateTime *start)
+{
+    gint64 start_us = to_real_us(start);
+
+    expansion->n_seen++;
+    if ((event->count > 0 && expansion->n_seen > event->count) ||
+        (event->until_us > 0 && start_us > event->until_us) || start_us >= expansion->to_us) {
+        return FALSE;
+    }
+
+    if (start_us + event->duration_us <= expansion->from_us || is_excluded(event, start_us)) {
+        return TRUE;
+    }
+    if (event->frequency != ClOnce && g_hash_table_size(expansion->moved) > 0) {
+        g_autofree gchar *key = instance_key(event->uid, start_us);
+        if (g_hash_table_contains(expansion->moved, key)) {
+            return TRUE;
+        }
+    }
+
+    ClInterval interval = {.start_us = start_us, .end_us = start_us + event->duration_us};
+    g_array_append_val(expansion->busy, interval);
+    return TRUE;
+}
+
+static void expand_event(ClExpansion *expansion, const ClEvent *event)
+{
+    if (event->free) {
+        return;
+    }
+    if (event->frequency == ClOnce) {
+        add_occurrence(expansion, event, event->start);
+        return;
+    }
+
+    // Without a count the steps before the window can be skipped, none of them is needed.
+    guint first_step = 0;
+    gint64 skippable_us = expansion->from_us - to_real_us(event->start) - event->duration_us;
+    if (event->count == 0 && skippable_us > 0) {
+        first_step = (guint) (skippable_us / (get_period_us(event) * event->interval));
+    }
+    expansion->n_seen = 0;
+
+    // Weekly rules with days go through the weeks from the Monday of the start.
+    g_autoptr(GDateTime) base = NULL;
+    if (event->weekdays != 0) {
+        gint weekday = g_date_time_get_day_of_week(event->start) - 1;
+        base = g_date_time_add_days(event->start, -weekday);
+    } else {
+        base = g_date_time_ref(event->start);
+    }
+
+    for (guint step = first_step; step < first_step + MAX_OCCURRENCES; step++) {
+        g_autoptr(GDateTime) start = step_start(event, base, step);
+        if (start == NULL) {
+            continue;
+        }
+
+        if (event->weekdays == 0) {
+            if (!add_occurrence(expansion, event, start)) {
+                return;
+            }
+            continue;
+        }
+
+        for (gint day = 0; day < 7; day++) {
+            if (!(event->weekdays & (1 << day))) {
+                continue;
+            }
+
+            g_autoptr(GDateTime) day_start = g_date_time_add_days(start, day);
+            if (g_date_time_compare(day_start, event->start) < 0) {
+                continue;
+            }
+            if (!add_occurrence(expansion, event, day_start)) {
+                return;
+            }
+        }
+    }
+}
+
+static void expand_calendar(ClCalendar *calendar, gint64 from_us, gint64 to_us)
+{
+    ClExpansion expansion = {
+        .busy = calendar->busy,
+        .moved = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL),
+        .from_us = from_us,
+        .to_us = to_us,
+    };
+
+    g_array_set_size(calendar->busy, 0);
+
+    for (guint i = 0; i < calendar->events->len; i++) {
+        const ClEvent *event = g_ptr_array_index(calendar->events, i);
+
+        if (event->recurrence_id_us != 0) {
+            g_hash_table_add(expansion.moved, instance_key(event->uid, event->recurrence_id_us));
+        }
+    }
+
+    for (guint i = 0; i < calendar->events->len; i++) {
+        expand_event(&expansion, g_ptr_array_index(calendar->events, i));
+    }
+
+    g_array_sort(calendar->busy, compare_intervals);
+    g_array_set_size(calendar->max_ends, calendar->busy->len);
+    build_max_ends(calendar, 0, calendar->busy->len);
+
+    calendar->expanded_from_us = from_us;
+    calendar->expanded_to_us = to_us;
+
+    g_hash_table_unref(expansion.moved);
+}
+
+static void ensure_expanded(ClCalendar *calendar, gint64 start_us, gint64 end_us)
+{
+    if (start_us >= calendar->expanded_from_us && end_us <= calendar->expanded_to_us) {
+        return;
+    }
+
+    // From a day back, for the meetings under way.
+    expand_calendar(calendar, start_us - DAY_US,
+                    MAX(end_us, start_us + CL_WINDOW_DAYS * DAY_US));
+}
+
+
+/* ============================================================================
+ * Files
+ * ============================================================================ */
+
+static void load_calendar(ClCalendar *calendar)
+{
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GMappedFile) mapped = g_mapped_file_new(calendar->path, FALSE, &error);
+
+    g_ptr_array_set_size(calendar->events, 0);
+    g_array_set_size(calendar->busy, 0);
+    g_array_set_size(calendar->max_ends, 0);
+    calendar->expanded_from_us = 0;
+    calendar->expanded_to_us = 0;
+
+    // It may well show up later, the monitor catches that.
+    if (mapped == NULL) {
+        g_info("Calendar %s not loaded: %s", calendar->path, error->message);
+        return;
+    }
+
+    if (g_mapped_file_get_length(mapped) > 0) {
+        parse_calendar(g_mapped_file_get_contents(mapped), g_mapped_file_get_length(mapped),
+                       calendar->events);
+    }
+    g_info("Loaded %u events from %s", calendar->events->len, calendar->path);
+}
+
+static gboolean on_reload_timeout(gpointer user_data)
+{
+    ClCalendar *calendar = user_data;
+
+    calendar->reload_id = 0;
+    load_calendar(calendar);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void on_calendar_changed(GFileMonitor *monitor, GFile *file, GFile *other_file,
+                                GFileMonitorEvent event_type, gpointer user_data)
+{
+    ClCalendar *calendar = user_data;
+
+    if (event_type == G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED) {
+        return;
+    }
+
+    g_clear_handle_id(&calendar->reload_id, g_source_remove);
+    calendar->reload_id = g_timeout_add(CL_RELOAD_DELAY_MS, on_reload_timeout, calendar);
+}
+
+static void cl_calendar_free(ClCalendar *calendar)
+{
+    g_clear_handle_id(&calendar->reload_id, g_source_remove);
+    if (calendar->monitor != NULL) {
+        g_signal_handlers_disconnect_by_data(calendar->monitor, calendar);
+        g_object_unref(calendar->monitor);
+    }
+
+    g_ptr_array_unref(calendar->events);
+    g_array_unref(calendar->busy);
+    g_array_unref(calendar->max_ends);
+    g_free(calendar->path);
+    g_free(calendar);
+}
+
+static ClCalendar *cl_calendar_new(const char *path)
+{
+    ClCalendar *calendar = g_new0(ClCalendar, 1);
+    calendar->path = g_strdup(path);
+    calendar->events = g_ptr_array_new_with_free_func((GDestroyNotify) cl_event_free);
+    calendar->busy = g_array_new(FALSE, FALSE, sizeof(ClInterval));
+    calendar->max_ends = g_array_new(FALSE, FALSE, sizeof(gint64));
+
+    load_calendar(calendar);
+
+    g_autoptr(GFile) file = g_file_new_for_path(path);
+    calendar->monitor = g_file_monitor_file(file, G_FILE_MONITOR_NONE, NULL, NULL);
+    if (calendar->monitor != NULL) {
+        g_signal_connect(calendar->monitor, "changed", G_CALLBACK(on_calendar_changed), calendar);
+    }
+
+    return calendar;
+}
+
+
+/* ============================================================================
+ * Public API
+ * ============================================================================ */
+
+void cl_enable(const char *const *paths)
+{
+    cl_disable();
+
+    clCalendars = g_ptr_array_new_with_free_func((GDestroyNotify) cl_calendar_free);
+    for (guint i = 0; paths != NULL && paths[i] != NULL; i++) {
+        g_ptr_array_add(clCalendars, cl_calendar_new(paths[i]));
+    }
+}
+
+void cl_disable(void)
+{
+    g_clear_pointer(&clCalendars, g_ptr_array_unref);
+}
+
+gboolean cl_is_enabled(void)
+{
+    return clCalendars != NULL;
+}
+
+gboolean cl_find_busy(gint64 start_us, gint64 end_us, ClInterval *busy)
+{
+    gboolean found = FALSE;
+
+    for (guint i = 0; clCalendars != NULL && i < clCalendars->len; i++) {
+        ClCalendar *calendar = g_ptr_array_index(clCalendars, i);
+
+        ensure_expanded(calendar, start_us, end_us);
+
+        gint index = find_first_overlap(calendar, 0, calendar->busy->len, start_us, end_us);
+        if (index < 0) {
+            continue;
+        }
+
+        const ClInterval *interval = &g_array_index(calendar->busy, ClInterval, index);
+        if (!found || interval->start_us < busy->start_us) {
+            *busy = *interval;
+            found = TRUE;
+        }
+    }
+
+    return found;
+}
+
+gint64 cl_get_free_from(gint64 real_us)
+{
+    ClInterval busy;
+
+    // Through back to back and overlapping meetings, one at a time.
+    while (cl_find_busy(real_us, real_us + 1, &busy)) {
+        real_us = busy.end_us;
+    }
+
+    return real_us;
+}
+
+guint cl_get_n_intervals(void)
+{
+    guint n_intervals = 0;
+
+    for (guint i = 0; clCalendars != NULL && i < clCalendars->len; i++) {
+        ClCalendar *calendar = g_ptr_array_index(clCalendars, i);
+        n_intervals += calendar->busy->len;
+    }
+
+    return n_intervals;
+}
+
+SmPlanDecision cl_plan_work_session(gint64 start_real_us, guint64 duration_ms, gboolean automatic,
+                                    guint64 *value_ms, gpointer user_data)
+{
+    ClInterval busy;
+
+    if (!cl_find_busy(start_real_us, start_real_us + (gint64) duration_ms * 1000, &busy)) {
+        return SmPlanStart;
+    }
+
+    gint64 free_ms = (busy.start_us - start_real_us) / 1000;
+    if (free_ms >= CL_MIN_SESSION_MS) {
+        *value_ms = (guint64) free_ms;
+        return SmPlanShorten;
+    }
+
+    // Started by hand in or right before a meeting, the user knows best.
+    if (!automatic) {
+        return SmPlanStart;
+    }
+
+    gint64 free_from_us = cl_get_free_from(busy.start_us);
+    *value_ms = (guint64) MAX((free_from_us - start_real_us) / 1000, 1);
+    return SmPlanDefer;
+}
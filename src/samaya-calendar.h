@@ -0,0 +1,77 @@
+/* samaya-calendar.h
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <glib.h>
+#include "samaya-session.h"
+
+/*  Meetings from local iCalendar (.ics) files, so work sessions do not run into them.
+
+    Each file is parsed once into its events, and again only when a file monitor reports that it
+    changed, leaving the other files alone. The events are expanded over a window of
+    CL_WINDOW_DAYS into an interval tree per file: the busy intervals sorted by start in an array,
+    read as an implicit balanced tree whose nodes also keep the latest end below them. Finding the
+    first meeting that overlaps a session is then logarithmic in the number of meetings. Lookups
+    past the window expand the parsed events again, without reading the file.
+
+    Understood are VEVENTs with DTSTART and DTEND or DURATION, in UTC, local time or a TZID the
+    system knows, recurring through an RRULE with FREQ, INTERVAL, COUNT, UNTIL and BYDAY for weekly
+    rules, with EXDATEs and instances moved through RECURRENCE-ID. Other recurrences only count
+    their first occurrence. All day, cancelled and free (TRANSP:TRANSPARENT) events never block.
+*/
+
+#define CL_WINDOW_DAYS 35
+
+// Sessions are shortened to end before a meeting, but not below this.
+#define CL_MIN_SESSION_MS (10 * 60 * 1000)
+
+// A file is parsed again once it has not changed for this long, it may still be written.
+#define CL_RELOAD_DELAY_MS 500
+
+// Wall clock times in microseconds, the end is exclusive.
+typedef struct
+{
+    gint64 start_us;
+    gint64 end_us;
+} ClInterval;
+
+// Loads the files and follows them for changes, replacing any that were followed before.
+void cl_enable(const char *const *paths);
+
+void cl_disable(void);
+
+gboolean cl_is_enabled(void);
+
+// The meeting starting first of those overlapping the interval, FALSE when it is free.
+gboolean cl_find_busy(gint64 start_us, gint64 end_us, ClInterval *busy);
+
+// The first time from the given one on that is not taken by a meeting.
+gint64 cl_get_free_from(gint64 real_us);
+
+// Busy intervals expanded from all files so far.
+guint cl_get_n_intervals(void);
+
+/*  Plans a work session around the meetings, see SmPlanFunc. One that would run into a meeting is
+    shortened to end when it starts, or when that leaves less than CL_MIN_SESSION_MS, put off until
+    the meetings are over. Sessions started by hand are never put off.
+*/
+SmPlanDecision cl_plan_work_session(gint64 start_real_us, guint64 duration_ms, gboolean automatic,
+                                    guint64 *value_ms, gpointer user_data);
@@ -0,0 +1,118 @@
+/* samaya-checkpoint.c
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include <gio/gio.h>
+#include <string.h>
+#include "samaya-checkpoint.h"
+
+
+/* ============================================================================
+ * Static Variables
+ * ============================================================================ */
+
+static gchar *checkpointPath = NULL;
+
+// The checkpoint last written, to skip rewriting an identical one.
+static CpCheckpoint lastCheckpoint;
+static gboolean hasLastCheckpoint = FALSE;
+
+
+/* ============================================================================
+ * Public API
+ * ============================================================================ */
+
+void cp_enable(const char *path)
+{
+    g_autofree gchar *directory = g_path_get_dirname(path);
+
+    if (g_mkdir_with_parents(directory, 0700) != 0) {
+        g_warning("Failed to create %s, the session will not be checkpointed.", directory);
+        return;
+    }
+
+    g_free(checkpointPath);
+    checkpointPath = g_strdup(path);
+    hasLastCheckpoint = FALSE;
+}
+
+void cp_disable(void)
+{
+    g_clear_pointer(&checkpointPath, g_free);
+    hasLastCheckpoint = FALSE;
+}
+
+gboolean cp_is_enabled(void)
+{
+    return checkpointPath != NULL;
+}
+
+void cp_write(CpCheckpoint *checkpoint)
+{
+    if (checkpointPath == NULL) {
+        return;
+    }
+
+    memcpy(checkpoint->magic, CP_FILE_MAGIC, sizeof(checkpoint->magic));
+    checkpoint->version = CP_FILE_VERSION;
+    checkpoint->size = sizeof(CpCheckpoint);
+    memset(checkpoint->reserved, 0, sizeof(checkpoint->reserved));
+
+    if (hasLastCheckpoint && memcmp(checkpoint, &lastCheckpoint, sizeof(CpCheckpoint)) == 0) {
+        return;
+    }
+
+    g_autoptr(GError) error = NULL;
+
+    if (!g_file_set_contents_full(checkpointPath, (const gchar *) checkpoint,
+                                  sizeof(CpCheckpoint), G_FILE_SET_CONTENTS_CONSISTENT, 0600,
+                                  &error)) {
+        g_warning("Failed to write session checkpoint: %s", error->message);
+        return;
+    }
+
+    lastCheckpoint = *checkpoint;
+    hasLastCheckpoint = TRUE;
+}
+
+gboolean cp_read(const char *path, CpCheckpoint *checkpoint, GError **error)
+{
+    g_autofree gchar *contents = NULL;
+    gsize length = 0;
+
+    if (!g_file_get_contents(path, &contents, &length, error)) {
+        return FALSE;
+    }
+
+    if (length != sizeof(CpCheckpoint)) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                    "%s has the wrong size for a session checkpoint", path);
+        return FALSE;
+    }
+    memcpy(checkpoint, contents, sizeof(CpCheckpoint));
+
+    if (memcmp(checkpoint->magic, CP_FILE_MAGIC, sizeof(checkpoint->magic)) != 0 ||
+        checkpoint->version != CP_FILE_VERSION || checkpoint->size != sizeof(CpCheckpoint)) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                    "%s is not a version %d Samaya checkpoint", path, CP_FILE_VERSION);
+        return FALSE;
+    }
+
+    return TRUE;
+}
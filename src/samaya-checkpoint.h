@@ -0,0 +1,77 @@
+/* samaya-checkpoint.h
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <glib.h>
+
+/*  Checkpoint of the running session, so a pomodoro survives Samaya being killed or the user
+    logging out.
+
+    The checkpoint is a single fixed size record, rewritten atomically through a rename whenever
+    the timer changes state. Nothing is written while the timer is just ticking: a running timer
+    is stored as the wall clock time it will run out at, from which the remaining time can be
+    worked out again however long Samaya was gone for.
+
+    Like trace files, checkpoints are stored in host byte order.
+*/
+
+#define CP_FILE_MAGIC "SMYCKPT\0"
+#define CP_FILE_VERSION 1
+
+typedef struct
+{
+    gchar magic[8];
+    guint32 version;
+    guint32 size;
+
+    // Real time in microseconds the running timer runs out at, 0 when it is not running.
+    gint64 deadline_real_us;
+
+    // Real time in microseconds the routine was first started, 0 when it has not been yet.
+    gint64 session_start_real_us;
+
+    guint64 initial_time_ms;
+    guint64 remaining_time_ms;
+    guint64 total_sessions_counted;
+
+    guint8 routine;
+    guint8 state;
+    guint8 sessions_completed;
+    guint8 reserved[5];
+} CpCheckpoint;
+
+G_STATIC_ASSERT(sizeof(CpCheckpoint) == 64);
+
+// Starts writing checkpoints to the given path, creating its directory if needed.
+void cp_enable(const char *path);
+
+// Stops writing checkpoints, the last written one is left in place.
+void cp_disable(void);
+
+gboolean cp_is_enabled(void);
+
+/*  Atomically replaces the checkpoint file with the given checkpoint, the header fields are filled
+    in here. Does nothing when checkpointing is disabled or nothing changed since the last write.
+*/
+void cp_write(CpCheckpoint *checkpoint);
+
+// Reads and validates a checkpoint file.
+gboolean cp_read(const char *path, CpCheckpoint *checkpoint, GError **error);
@@ -0,0 +1,328 @@
+/* samaya-clock.c
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+#include "samaya-clock.h"
+#include <string.h>
+
+// Longest text shown, "MMMMM:SS.T" and the terminator.
+#define CLOCK_MAX_TEXT 11
+#define CLOCK_MAX_MINUTES 99999
+
+enum
+{
+    GLYPH_COLON = 10,
+    GLYPH_POINT,
+    N_GLYPHS,
+};
+
+static const char *const glyphTexts[N_GLYPHS] = {"0", "1", "2", "3", "4", "5",
+                                                 "6", "7", "8", "9", ":", "."};
+
+struct _SamayaClock
+{
+    GtkWidget parent_instance;
+
+    gint64 remaining_ms;
+    gint64 deadline_us;
+    gboolean show_tenths;
+    guint tick_callback_id;
+
+    char text[CLOCK_MAX_TEXT];
+    gsize n_minute_digits;
+
+    // Laid out glyphs for the current font and color, built on first use after a style change.
+    GskRenderNode *glyph_nodes[N_GLYPHS];
+    int glyph_widths[N_GLYPHS];
+    int digit_width;
+    int glyph_height;
+    gboolean glyphs_ready;
+};
+
+G_DEFINE_FINAL_TYPE(SamayaClock, samaya_clock, GTK_TYPE_WIDGET)
+
+
+/* ============================================================================
+ * Internal Implementation
+ * ============================================================================ */
+
+static void clear_glyphs(SamayaClock *self)
+{
+    for (guint i = 0; i < N_GLYPHS; i++) {
+        g_clear_pointer(&self->glyph_nodes[i], gsk_render_node_unref);
+    }
+    self->glyphs_ready = FALSE;
+}
+
+static void ensure_glyphs(SamayaClock *self)
+{
+    GtkWidget *widget = GTK_WIDGET(self);
+
+    if (self->glyphs_ready) {
+        return;
+    }
+
+    GdkRGBA color;
+    gtk_widget_get_color(widget, &color);
+
+    self->digit_width = 0;
+    self->glyph_height = 0;
+
+    for (guint i = 0; i < N_GLYPHS; i++) {
+        PangoLayout *layout = gtk_widget_create_pango_layout(widget, glyphTexts[i]);
+        int height = 0;
+
+        pango_layout_get_pixel_size(layout, &self->glyph_widths[i], &height);
+        self->glyph_height = MAX(self->glyph_height, height);
+        if (i < GLYPH_COLON) {
+            self->digit_width = MAX(self->digit_width, self->glyph_widths[i]);
+        }
+
+        GtkSnapshot *snapshot = gtk_snapshot_new();
+        gtk_snapshot_append_layout(snapshot, layout, &color);
+        self->glyph_nodes[i] = gtk_snapshot_free_to_node(snapshot);
+
+        g_object_unref(layout);
+    }
+
+    self->glyphs_ready = TRUE;
+}
+
+static guint get_glyph(char c)
+{
+    if (c == ':') {
+        return GLYPH_COLON;
+    }
+
+    return c == '.' ? GLYPH_POINT : (guint) (c - '0');
+}
+
+static int get_glyph_advance(SamayaClock *self, guint glyph)
+{
+    return glyph < GLYPH_COLON ? self->digit_width : self->glyph_widths[glyph];
+}
+
+// Width of any text with the current number of minute digits.
+static int get_text_width(SamayaClock *self)
+{
+    int width = (int) (self->n_minute_digits + 2) * self->digit_width +
+                self->glyph_widths[GLYPH_COLON];
+
+    if (self->show_tenths) {
+        width += self->glyph_widths[GLYPH_POINT] + self->digit_width;
+    }
+
+    return width;
+}
+
+static void update_text(SamayaClock *self)
+{
+    gint64 remaining_ms = MAX(self->remaining_ms, 0);
+    gint64 seconds = remaining_ms / 1000;
+    gint64 minutes = MIN(seconds / 60, CLOCK_MAX_MINUTES);
+    char text[CLOCK_MAX_TEXT];
+
+    if (self->show_tenths) {
+        g_snprintf(text, sizeof(text), "%02" G_GINT64_FORMAT ":%02d.%d", minutes,
+                   (int) (seconds % 60), (int) (remaining_ms / 100 % 10));
+    } else {
+        g_snprintf(text, sizeof(text), "%02" G_GINT64_FORMAT ":%02d", minutes,
+                   (int) (seconds % 60));
+    }
+
+    if (strcmp(text, self->text) == 0) {
+        return;
+    }
+
+    gsize n_minute_digits = (gsize) (strchr(text, ':') - text);
+    gboolean seconds_changed = strncmp(text, self->text, n_minute_digits + 3) != 0;
+
+    memcpy(self->text, text, sizeof(text));
+
+    if (n_minute_digits != self->n_minute_digits) {
+        self->n_minute_digits = n_minute_digits;
+        gtk_widget_queue_resize(GTK_WIDGET(self));
+    } else {
+        gtk_widget_queue_draw(GTK_WIDGET(self));
+    }
+
+    // Tenths would keep a screen reader busy, it is told about whole seconds.
+    if (seconds_changed) {
+        text[n_minute_digits + 3] = '\0';
+        gtk_accessible_update_property(GTK_ACCESSIBLE(self), GTK_ACCESSIBLE_PROPERTY_LABEL, text,
+                                       -1);
+    }
+}
+
+static gboolean on_frame(GtkWidget *widget, GdkFrameClock *frame_clock, gpointer user_data)
+{
+    SamayaClock *self = SAMAYA_CLOCK(widget);
+
+    self->remaining_ms = (self->deadline_us - gdk_frame_clock_get_frame_time(frame_clock)) / 1000;
+    update_text(self);
+
+    return G_SOURCE_CONTINUE;
+}
+
+// Tenths only change between the ticks of the timer, so they are the only reason to run per frame.
+static void update_tick_callback(SamayaClock *self)
+{
+    gboolean follows_frames = self->show_tenths && self->deadline_us != 0;
+
+    if (follows_frames && self->tick_callback_id == 0) {
+        self->tick_callback_id = gtk_widget_add_tick_callback(GTK_WIDGET(self), on_frame, NULL,
+                                                              NULL);
+    } else if (!follows_frames && self->tick_callback_id != 0) {
+        gtk_widget_remove_tick_callback(GTK_WIDGET(self), self->tick_callback_id);
+        self->tick_callback_id = 0;
+    }
+}
+
+
+/* ============================================================================
+ * Samaya Clock Methods
+ * ============================================================================ */
+
+static void samaya_clock_measure(GtkWidget *widget, GtkOrientation orientation, int for_size,
+                                 int *minimum, int *natural, int *minimum_baseline,
+                                 int *natural_baseline)
+{
+    SamayaClock *self = SAMAYA_CLOCK(widget);
+
+    ensure_glyphs(self);
+
+    if (orientation == GTK_ORIENTATION_HORIZONTAL) {
+        *minimum = *natural = get_text_width(self);
+    } else {
+        *minimum = *natural = self->glyph_height;
+    }
+}
+
+static void samaya_clock_snapshot(GtkWidget *widget, GtkSnapshot *snapshot)
+{
+    SamayaClock *self = SAMAYA_CLOCK(widget);
+
+    ensure_glyphs(self);
+
+    int x = (gtk_widget_get_width(widget) - get_text_width(self)) / 2;
+    int y = (gtk_widget_get_height(widget) - self->glyph_height) / 2;
+
+    for (const char *c = self->text; *c != '\0'; c++) {
+        guint glyph = get_glyph(*c);
+        int advance = get_glyph_advance(self, glyph);
+
+        if (self->glyph_nodes[glyph] != NULL) {
+            gtk_snapshot_save(snapshot);
+            gtk_snapshot_translate(
+                snapshot, &GRAPHENE_POINT_INIT(x + (advance - self->glyph_widths[glyph]) / 2, y));
+            gtk_snapshot_append_node(snapshot, self->glyph_nodes[glyph]);
+            gtk_snapshot_restore(snapshot);
+        }
+
+        x += advance;
+    }
+}
+
+static void samaya_clock_css_changed(GtkWidget *widget, GtkCssStyleChange *change)
+{
+    GTK_WIDGET_CLASS(samaya_clock_parent_class)->css_changed(widget, change);
+
+    // The font may have changed as well as the color.
+    clear_glyphs(SAMAYA_CLOCK(widget));
+    gtk_widget_queue_resize(widget);
+}
+
+static void samaya_clock_dispose(GObject *object)
+{
+    SamayaClock *self = SAMAYA_CLOCK(object);
+
+    if (self->tick_callback_id != 0) {
+        gtk_widget_remove_tick_callback(GTK_WIDGET(self), self->tick_callback_id);
+        self->tick_callback_id = 0;
+    }
+    clear_glyphs(self);
+
+    G_OBJECT_CLASS(samaya_clock_parent_class)->dispose(object);
+}
+
+static void samaya_clock_class_init(SamayaClockClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS(klass);
+    GtkWidgetClass *widget_class = GTK_WIDGET_CLASS(klass);
+
+    object_class->dispose = samaya_clock_dispose;
+
+    widget_class->measure = samaya_clock_measure;
+    widget_class->snapshot = samaya_clock_snapshot;
+    widget_class->css_changed = samaya_clock_css_changed;
+
+    gtk_widget_class_set_css_name(widget_class, "clock");
+    gtk_widget_class_set_accessible_role(widget_class, GTK_ACCESSIBLE_ROLE_TIMER);
+}
+
+static void samaya_clock_init(SamayaClock *self)
+{
+    update_text(self);
+}
+
+SamayaClock *samaya_clock_new(void)
+{
+    return g_object_new(SAMAYA_TYPE_CLOCK, NULL);
+}
+
+void samaya_clock_set_time(SamayaClock *self, gint64 remaining_ms)
+{
+    g_return_if_fail(SAMAYA_IS_CLOCK(self));
+
+    // The frame clock is closer to the time shown next than the last tick of the timer.
+    if (self->tick_callback_id != 0) {
+        return;
+    }
+
+    self->remaining_ms = remaining_ms;
+    update_text(self);
+}
+
+void samaya_clock_set_deadline(SamayaClock *self, gint64 deadline_us)
+{
+    g_return_if_fail(SAMAYA_IS_CLOCK(self));
+
+    self->deadline_us = deadline_us;
+    update_tick_callback(self);
+}
+
+void samaya_clock_set_show_tenths(SamayaClock *self, gboolean show_tenths)
+{
+    g_return_if_fail(SAMAYA_IS_CLOCK(self));
+
+    if (self->show_tenths == show_tenths) {
+        return;
+    }
+
+    self->show_tenths = show_tenths;
+    update_tick_callback(self);
+    update_text(self);
+    gtk_widget_queue_resize(GTK_WIDGET(self));
+}
+
+const char *samaya_clock_get_text(SamayaClock *self)
+{
+    g_return_val_if_fail(SAMAYA_IS_CLOCK(self), NULL);
+
+    return self->text;
+}
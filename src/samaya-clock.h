@@ -0,0 +1,53 @@
+/* samaya-clock.h
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+#pragma once
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define SAMAYA_TYPE_CLOCK (samaya_clock_get_type())
+
+G_DECLARE_FINAL_TYPE(SamayaClock, samaya_clock, SAMAYA, CLOCK, GtkWidget)
+
+/*  Countdown clock showing minutes and seconds, and optionally tenths of a second.
+
+    The digits, the colon and the decimal point are laid out once for the current font and color
+    and kept as render nodes, a frame only places them next to each other. Every digit takes the
+    width of the widest one, so the clock keeps its size while it counts down and only has to be
+    measured again when the number of minute digits changes.
+*/
+SamayaClock *samaya_clock_new(void);
+
+// Shows the given time, rounded down to what is shown. Only redraws when the text changes.
+void samaya_clock_set_time(SamayaClock *self, gint64 remaining_ms);
+
+/*  Follows a running timer ending at the given monotonic time, in microseconds. With tenths shown
+    the time is then taken from the frame clock on every frame, 0 stops following it and leaves
+    the time to samaya_clock_set_time().
+*/
+void samaya_clock_set_deadline(SamayaClock *self, gint64 deadline_us);
+
+void samaya_clock_set_show_tenths(SamayaClock *self, gboolean show_tenths);
+
+// The text shown, in the "MM:SS" or "MM:SS.T" format.
+const char *samaya_clock_get_text(SamayaClock *self);
+
+G_END_DECLS
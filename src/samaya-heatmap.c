@@ -0,0 +1,444 @@
+/* samaya-heatmap.c
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "samaya-heatmap.h"
+#include <glib/gi18n.h>
+#include <string.h>
+#include <time.h>
+#include "samaya-session.h"
+
+#define HEATMAP_WEEKS 53
+#define HEATMAP_DAYS (HEATMAP_WEEKS * 7)
+// 53 weeks can touch the months at both ends of a year and a bit.
+#define HEATMAP_MAX_TILES 14
+
+#define CELL_GAP 2
+#define MIN_CELL_SIZE 4
+#define MAX_CELL_SIZE 12
+
+#define SECONDS_PER_DAY (24 * 60 * 60)
+
+// Work time from which a day gets the next shade, in milliseconds.
+static const guint32 levelThresholdsMs[] = {1, 25 * 60 * 1000, 75 * 60 * 1000, 150 * 60 * 1000};
+static const float levelAlphas[] = {0.12f, 0.35f, 0.55f, 0.78f, 1.0f};
+
+struct _SamayaHeatmap
+{
+    GtkWidget parent_instance;
+
+    gchar *history_path;
+
+    // Days since the epoch in local time of the first cell, always a Monday, and of today.
+    gint64 first_day;
+    gint64 today;
+
+    guint32 work_ms[HEATMAP_DAYS];
+
+    // Index of the first day of every month, the last entry is one past today.
+    guint tile_starts[HEATMAP_MAX_TILES + 1];
+    guint n_tiles;
+
+    // The cells of every month but today's, drawn for the width in tiles_width.
+    GskRenderNode *tile_nodes[HEATMAP_MAX_TILES];
+    int tiles_width;
+
+    guint midnight_source_id;
+};
+
+G_DEFINE_FINAL_TYPE(SamayaHeatmap, samaya_heatmap, GTK_TYPE_WIDGET)
+
+
+/* ============================================================================
+ * Internal Implementation
+ * ============================================================================ */
+
+static gint64 get_local_day(gint64 real_us)
+{
+    time_t seconds = (time_t) (real_us / G_USEC_PER_SEC);
+    struct tm local_time;
+
+    if (localtime_r(&seconds, &local_time) == NULL) {
+        return seconds / SECONDS_PER_DAY;
+    }
+
+    return ((gint64) seconds + local_time.tm_gmtoff) / SECONDS_PER_DAY;
+}
+
+// Months are counted from the year 1900, days since the epoch are dates in UTC.
+static gint get_month_of_day(gint64 day)
+{
+    time_t seconds = (time_t) (day * SECONDS_PER_DAY);
+    struct tm date;
+
+    gmtime_r(&seconds, &date);
+
+    return date.tm_year * 12 + date.tm_mon;
+}
+
+static int get_cell_size(int width)
+{
+    return CLAMP((width + CELL_GAP) / HEATMAP_WEEKS - CELL_GAP, MIN_CELL_SIZE, MAX_CELL_SIZE);
+}
+
+static guint get_level(guint32 work_ms)
+{
+    guint level = 0;
+
+    while (level < G_N_ELEMENTS(levelThresholdsMs) && work_ms >= levelThresholdsMs[level]) {
+        level++;
+    }
+
+    return level;
+}
+
+static void clear_tiles(SamayaHeatmap *self)
+{
+    for (guint i = 0; i < HEATMAP_MAX_TILES; i++) {
+        g_clear_pointer(&self->tile_nodes[i], gsk_render_node_unref);
+    }
+}
+
+static guint get_tile_of_day(SamayaHeatmap *self, guint index)
+{
+    guint tile = 0;
+
+    while (tile + 1 < self->n_tiles && self->tile_starts[tile + 1] <= index) {
+        tile++;
+    }
+
+    return tile;
+}
+
+// Moves the calendar so that it ends on the given day, forgetting all the work times.
+static void set_today(SamayaHeatmap *self, gint64 today)
+{
+    // The epoch was a Thursday.
+    gint64 weekday = (today + 3) % 7;
+
+    self->today = today;
+    self->first_day = today - weekday - (HEATMAP_WEEKS - 1) * 7;
+    memset(self->work_ms, 0, sizeof(self->work_ms));
+
+    guint n_days = (guint) (today - self->first_day + 1);
+    gint month = -1;
+
+    self->n_tiles = 0;
+    for (guint i = 0; i < n_days; i++) {
+        gint day_month = get_month_of_day(self->first_day + i);
+
+        if (day_month != month && self->n_tiles < HEATMAP_MAX_TILES) {
+            self->tile_starts[self->n_tiles++] = i;
+            month = day_month;
+        }
+    }
+    self->tile_starts[self->n_tiles] = n_days;
+
+    clear_tiles(self);
+}
+
+static void add_work(SamayaHeatmap *self, const HsRecord *record)
+{
+    if (record->routine != Working) {
+        return;
+    }
+
+    gint64 day = get_local_day(record->start_real_us);
+    if (day < self->first_day || day > self->today) {
+        return;
+    }
+
+    guint index = (guint) (day - self->first_day);
+    self->work_ms[index] = (guint32) MIN((guint64) self->work_ms[index] + record->duration_ms,
+                                         G_MAXUINT32);
+}
+
+static void get_cell_rect(SamayaHeatmap *self, int width, guint index, graphene_rect_t *rect)
+{
+    int cell_size = get_cell_size(width);
+    int step = cell_size + CELL_GAP;
+    int x_offset = (width - (HEATMAP_WEEKS * step - CELL_GAP)) / 2;
+
+    graphene_rect_init(rect, x_offset + (index / 7) * step, (index % 7) * step, cell_size,
+                       cell_size);
+}
+
+static void append_cell(SamayaHeatmap *self, GtkSnapshot *snapshot, int width, guint index,
+                        const GdkRGBA *color)
+{
+    GdkRGBA cell_color = *color;
+    cell_color.alpha *= levelAlphas[get_level(self->work_ms[index])];
+
+    graphene_rect_t rect;
+    get_cell_rect(self, width, index, &rect);
+
+    gtk_snapshot_append_color(snapshot, &cell_color, &rect);
+}
+
+static GskRenderNode *draw_tile(SamayaHeatmap *self, guint tile, int width, const GdkRGBA *color)
+{
+    GtkSnapshot *snapshot = gtk_snapshot_new();
+    guint today_index = (guint) (self->today - self->first_day);
+
+    for (guint i = self->tile_starts[tile]; i < self->tile_starts[tile + 1]; i++) {
+        if (i != today_index) {
+            append_cell(self, snapshot, width, i, color);
+        }
+    }
+
+    return gtk_snapshot_free_to_node(snapshot);
+}
+
+static gboolean on_midnight(gpointer user_data)
+{
+    SamayaHeatmap *self = SAMAYA_HEATMAP(user_data);
+
+    self->midnight_source_id = 0;
+    samaya_heatmap_load_history(self, self->history_path);
+
+    return G_SOURCE_REMOVE;
+}
+
+// Reloads the calendar once the day is over, so that today moves on to the next cell.
+static void schedule_midnight(SamayaHeatmap *self)
+{
+    time_t now_seconds = (time_t) (g_get_real_time() / G_USEC_PER_SEC);
+    struct tm local_time;
+    gint64 seconds_left = SECONDS_PER_DAY;
+
+    if (localtime_r(&now_seconds, &local_time) != NULL) {
+        seconds_left -= ((gint64) now_seconds + local_time.tm_gmtoff) % SECONDS_PER_DAY;
+    }
+
+    g_clear_handle_id(&self->midnight_source_id, g_source_remove);
+    self->midnight_source_id = g_timeout_add_seconds((guint) seconds_left + 1, on_midnight, self);
+}
+
+
+/* ============================================================================
+ * Samaya Heatmap Methods
+ * ============================================================================ */
+
+static GtkSizeRequestMode samaya_heatmap_get_request_mode(GtkWidget *widget)
+{
+    return GTK_SIZE_REQUEST_HEIGHT_FOR_WIDTH;
+}
+
+static void samaya_heatmap_measure(GtkWidget *widget, GtkOrientation orientation, int for_size,
+                                   int *minimum, int *natural, int *minimum_baseline,
+                                   int *natural_baseline)
+{
+    if (orientation == GTK_ORIENTATION_HORIZONTAL) {
+        *minimum = *natural = HEATMAP_WEEKS * (MIN_CELL_SIZE + CELL_GAP) - CELL_GAP;
+        return;
+    }
+
+    int cell_size = get_cell_size(for_size < 0 ? 0 : for_size);
+    *minimum = *natural = 7 * (cell_size + CELL_GAP) - CELL_GAP;
+}
+
+static void samaya_heatmap_snapshot(GtkWidget *widget, GtkSnapshot *snapshot)
+{
+    SamayaHeatmap *self = SAMAYA_HEATMAP(widget);
+    int width = gtk_widget_get_width(widget);
+
+    if (width != self->tiles_width) {
+        clear_tiles(self);
+        self->tiles_width = width;
+    }
+
+    GdkRGBA color;
+    gtk_widget_get_color(widget, &color);
+
+    for (guint tile = 0; tile < self->n_tiles; tile++) {
+        if (self->tile_nodes[tile] == NULL) {
+            self->tile_nodes[tile] = draw_tile(self, tile, width, &color);
+        }
+
+        if (self->tile_nodes[tile] != NULL) {
+            gtk_snapshot_append_node(snapshot, self->tile_nodes[tile]);
+        }
+    }
+
+    append_cell(self, snapshot, width, (guint) (self->today - self->first_day), &color);
+}
+
+static void samaya_heatmap_css_changed(GtkWidget *widget, GtkCssStyleChange *change)
+{
+    GTK_WIDGET_CLASS(samaya_heatmap_parent_class)->css_changed(widget, change);
+
+    // The cells are shades of the foreground color.
+    clear_tiles(SAMAYA_HEATMAP(widget));
+}
+
+static gboolean samaya_heatmap_query_tooltip(GtkWidget *widget, int x, int y,
+                                             gboolean keyboard_tooltip, GtkTooltip *tooltip)
+{
+    SamayaHeatmap *self = SAMAYA_HEATMAP(widget);
+    int width = gtk_widget_get_width(widget);
+    int step = get_cell_size(width) + CELL_GAP;
+    int x_offset = (width - (HEATMAP_WEEKS * step - CELL_GAP)) / 2;
+
+    if (x < x_offset || y < 0 || (y / step) >= 7) {
+        return FALSE;
+    }
+
+    guint index = (guint) ((x - x_offset) / step * 7 + y / step);
+    if (self->first_day + index > self->today) {
+        return FALSE;
+    }
+
+    g_autoptr(GDateTime) date =
+        g_date_time_new_from_unix_utc((self->first_day + index) * SECONDS_PER_DAY);
+    // Translators: date of a day in the work calendar, see g_date_time_format().
+    g_autofree gchar *day = g_date_time_format(date, _("%e %B %Y"));
+    guint minutes = self->work_ms[index] / (60 * 1000);
+    g_autofree gchar *text =
+        g_strdup_printf(ngettext("%u minute of work on %s", "%u minutes of work on %s", minutes),
+                        minutes, g_strstrip(day));
+
+    gtk_tooltip_set_text(tooltip, text);
+
+    return TRUE;
+}
+
+static void samaya_heatmap_dispose(GObject *object)
+{
+    SamayaHeatmap *self = SAMAYA_HEATMAP(object);
+
+    g_clear_handle_id(&self->midnight_source_id, g_source_remove);
+    clear_tiles(self);
+
+    G_OBJECT_CLASS(samaya_heatmap_parent_class)->dispose(object);
+}
+
+static void samaya_heatmap_finalize(GObject *object)
+{
+    SamayaHeatmap *self = SAMAYA_HEATMAP(object);
+
+    g_free(self->history_path);
+
+    G_OBJECT_CLASS(samaya_heatmap_parent_class)->finalize(object);
+}
+
+static void samaya_heatmap_class_init(SamayaHeatmapClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS(klass);
+    GtkWidgetClass *widget_class = GTK_WIDGET_CLASS(klass);
+
+    object_class->dispose = samaya_heatmap_dispose;
+    object_class->finalize = samaya_heatmap_finalize;
+
+    widget_class->get_request_mode = samaya_heatmap_get_request_mode;
+    widget_class->measure = samaya_heatmap_measure;
+    widget_class->snapshot = samaya_heatmap_snapshot;
+    widget_class->css_changed = samaya_heatmap_css_changed;
+    widget_class->query_tooltip = samaya_heatmap_query_tooltip;
+
+    gtk_widget_class_set_css_name(widget_class, "heatmap");
+}
+
+static void samaya_heatmap_init(SamayaHeatmap *self)
+{
+    gtk_widget_set_has_tooltip(GTK_WIDGET(self), TRUE);
+
+    set_today(self, get_local_day(g_get_real_time()));
+}
+
+SamayaHeatmap *samaya_heatmap_new(void)
+{
+    return g_object_new(SAMAYA_TYPE_HEATMAP, NULL);
+}
+
+void samaya_heatmap_load_history(SamayaHeatmap *self, const char *history_path)
+{
+    g_return_if_fail(SAMAYA_IS_HEATMAP(self));
+    g_return_if_fail(history_path != NULL);
+
+    if (self->history_path != history_path) {
+        g_free(self->history_path);
+        self->history_path = g_strdup(history_path);
+    }
+
+    set_today(self, get_local_day(g_get_real_time()));
+    schedule_midnight(self);
+    gtk_widget_queue_draw(GTK_WIDGET(self));
+
+    g_autoptr(GError) error = NULL;
+    const HsRecord *records = NULL;
+    gsize n_records = 0;
+
+    g_autoptr(GMappedFile) mapped = hs_map(history_path, &records, &n_records, &error);
+    if (mapped == NULL) {
+        if (!g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+            g_warning("Failed to load the session history: %s", error->message);
+        }
+        return;
+    }
+
+    /*  Records are appended as sessions end, so they are sorted by time and only the last year
+        has to be read however long the history is. A day is searched back from the first cell and
+        past today to make up for time zones, add_work() drops whatever is out of range.
+    */
+    gint64 cutoff_us = (self->first_day - 1) * SECONDS_PER_DAY * G_USEC_PER_SEC;
+    gsize low = 0;
+    gsize high = n_records;
+
+    while (low < high) {
+        gsize middle = low + (high - low) / 2;
+
+        if (records[middle].start_real_us < cutoff_us) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    gint64 end_us = (self->today + 2) * SECONDS_PER_DAY * G_USEC_PER_SEC;
+
+    for (gsize i = low; i < n_records && records[i].start_real_us < end_us; i++) {
+        add_work(self, &records[i]);
+    }
+}
+
+void samaya_heatmap_add_record(SamayaHeatmap *self, const HsRecord *record)
+{
+    g_return_if_fail(SAMAYA_IS_HEATMAP(self));
+
+    if (record->routine != Working) {
+        return;
+    }
+
+    // The first session of a new day, the record is already in the history file.
+    if (get_local_day(record->end_real_us) > self->today && self->history_path != NULL) {
+        samaya_heatmap_load_history(self, self->history_path);
+        return;
+    }
+
+    add_work(self, record);
+
+    // Only a session that started on an earlier day touches a cached month.
+    gint64 day = get_local_day(record->start_real_us);
+    if (day >= self->first_day && day < self->today) {
+        guint tile = get_tile_of_day(self, (guint) (day - self->first_day));
+        g_clear_pointer(&self->tile_nodes[tile], gsk_render_node_unref);
+    }
+
+    gtk_widget_queue_draw(GTK_WIDGET(self));
+}
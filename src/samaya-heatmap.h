@@ -0,0 +1,47 @@
+/* samaya-heatmap.h
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gtk/gtk.h>
+#include "samaya-history.h"
+
+G_BEGIN_DECLS
+
+#define SAMAYA_TYPE_HEATMAP (samaya_heatmap_get_type())
+
+G_DECLARE_FINAL_TYPE(SamayaHeatmap, samaya_heatmap, SAMAYA, HEATMAP, GtkWidget)
+
+/*  Yearly calendar of the time spent working, one cell per day and one column per week, with
+    today in the last column.
+
+    The cells of each month are drawn once into a render node and reused for every frame after
+    that, only the cell of today is drawn live, so adding a session to today does not redraw the
+    rest of the year.
+*/
+SamayaHeatmap *samaya_heatmap_new(void);
+
+// Sums up the work sessions of the last year from a history file, replacing what was shown.
+void samaya_heatmap_load_history(SamayaHeatmap *self, const char *history_path);
+
+// Adds a session that was just appended to the history, only work sessions are counted.
+void samaya_heatmap_add_record(SamayaHeatmap *self, const HsRecord *record);
+
+G_END_DECLS
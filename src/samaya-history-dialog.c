@@ -0,0 +1,288 @@
+/* samaya-history-dialog.c
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "samaya-history-dialog.h"
+#include <glib/gi18n.h>
+#include <time.h>
+#include "samaya-session.h"
+#include "samaya-tags.h"
+
+struct _SamayaHistoryDialog
+{
+    AdwDialog parent_instance;
+
+    AdwToggleGroup *routine_filter_group;
+    GtkStack *content_stack;
+    GtkListView *list_view;
+
+    SamayaHistoryModel *model;
+};
+
+G_DEFINE_FINAL_TYPE(SamayaHistoryDialog, samaya_history_dialog, ADW_TYPE_DIALOG)
+
+
+/* ============================================================================
+ * Formatting Helpers
+ * ============================================================================ */
+
+static const char *routine_to_label(guint8 routine)
+{
+    switch ((RoutineType) routine) {
+        case Working:
+            return _("Pomodoro");
+        case ShortBreak:
+            return _("Short Break");
+        case LongBreak:
+            return _("Long Break");
+        default:
+            return "";
+    }
+}
+
+// Rows are rebound on every scroll step, so their text is formatted on the stack.
+static void format_time_of_day(gint64 real_us, char *buffer, gsize size)
+{
+    time_t seconds = (time_t) (real_us / G_USEC_PER_SEC);
+    struct tm local_time;
+
+    if (localtime_r(&seconds, &local_time) == NULL ||
+        strftime(buffer, size, "%H:%M", &local_time) == 0) {
+        g_strlcpy(buffer, "--:--", size);
+    }
+}
+
+static gchar *format_day(gint64 real_us)
+{
+    g_autoptr(GDateTime) day = g_date_time_new_from_unix_local(real_us / G_USEC_PER_SEC);
+    g_autoptr(GDateTime) today = g_date_time_new_now_local();
+    g_autoptr(GDateTime) yesterday = g_date_time_add_days(today, -1);
+
+    gint year = 0;
+    gint month = 0;
+    gint day_of_month = 0;
+    g_date_time_get_ymd(day, &year, &month, &day_of_month);
+
+    if (g_date_time_get_year(today) == year && g_date_time_get_month(today) == month &&
+        g_date_time_get_day_of_month(today) == day_of_month) {
+        return g_strdup(_("Today"));
+    }
+
+    if (g_date_time_get_year(yesterday) == year && g_date_time_get_month(yesterday) == month &&
+        g_date_time_get_day_of_month(yesterday) == day_of_month) {
+        return g_strdup(_("Yesterday"));
+    }
+
+    // Translators: date of a day in the session history, see g_date_time_format().
+    return g_date_time_format(day, _("%A, %e %B %Y"));
+}
+
+
+/* ============================================================================
+ * List Item Factories
+ * ============================================================================ */
+
+static void on_row_setup(GtkSignalListItemFactory *factory, GtkListItem *list_item,
+                         gpointer user_data)
+{
+    GtkWidget *row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 12);
+    gtk_widget_set_margin_top(row, 6);
+    gtk_widget_set_margin_bottom(row, 6);
+
+    GtkWidget *time_label = gtk_label_new(NULL);
+    gtk_widget_add_css_class(time_label, "numeric");
+    gtk_box_append(GTK_BOX(row), time_label);
+
+    GtkWidget *routine_label = gtk_label_new(NULL);
+    gtk_label_set_xalign(GTK_LABEL(routine_label), 0.0f);
+    gtk_label_set_ellipsize(GTK_LABEL(routine_label), PANGO_ELLIPSIZE_END);
+    gtk_widget_set_hexpand(routine_label, TRUE);
+    gtk_box_append(GTK_BOX(row), routine_label);
+
+    GtkWidget *skipped_label = gtk_label_new(_("Skipped"));
+    gtk_widget_add_css_class(skipped_label, "caption");
+    gtk_widget_add_css_class(skipped_label, "dim-label");
+    gtk_box_append(GTK_BOX(row), skipped_label);
+
+    GtkWidget *duration_label = gtk_label_new(NULL);
+    gtk_widget_add_css_class(duration_label, "numeric");
+    gtk_widget_add_css_class(duration_label, "dim-label");
+    gtk_box_append(GTK_BOX(row), duration_label);
+
+    gtk_list_item_set_activatable(list_item, FALSE);
+    gtk_list_item_set_child(list_item, row);
+}
+
+static void on_row_bind(GtkSignalListItemFactory *factory, GtkListItem *list_item,
+                        gpointer user_data)
+{
+    const HsRecord *record =
+        samaya_history_item_get_record(SAMAYA_HISTORY_ITEM(gtk_list_item_get_item(list_item)));
+
+    GtkWidget *time_label = gtk_widget_get_first_child(gtk_list_item_get_child(list_item));
+    GtkWidget *routine_label = gtk_widget_get_next_sibling(time_label);
+    GtkWidget *skipped_label = gtk_widget_get_next_sibling(routine_label);
+    GtkWidget *duration_label = gtk_widget_get_next_sibling(skipped_label);
+
+    char start[16];
+    char end[16];
+    char text[48];
+
+    format_time_of_day(record->start_real_us, start, sizeof(start));
+    format_time_of_day(record->end_real_us, end, sizeof(end));
+    g_snprintf(text, sizeof(text), "%s – %s", start, end);
+    gtk_label_set_text(GTK_LABEL(time_label), text);
+
+    const char *tag_name = tg_get_name(record->tag_id);
+    if (tag_name != NULL) {
+        char routine[TG_MAX_NAME_LENGTH + 48];
+        g_snprintf(routine, sizeof(routine), "%s · %s", routine_to_label(record->routine),
+                   tag_name);
+        gtk_label_set_text(GTK_LABEL(routine_label), routine);
+    } else {
+        gtk_label_set_text(GTK_LABEL(routine_label), routine_to_label(record->routine));
+    }
+    gtk_widget_set_visible(skipped_label, record->outcome == HsSkipped);
+
+    guint seconds = record->duration_ms / 1000;
+    g_snprintf(text, sizeof(text), "%u:%02u", seconds / 60, seconds % 60);
+    gtk_label_set_text(GTK_LABEL(duration_label), text);
+}
+
+static void on_header_setup(GtkSignalListItemFactory *factory, GtkListHeader *list_header,
+                            gpointer user_data)
+{
+    GtkWidget *label = gtk_label_new(NULL);
+    gtk_label_set_xalign(GTK_LABEL(label), 0.0f);
+    gtk_widget_add_css_class(label, "heading");
+
+    gtk_list_header_set_child(list_header, label);
+}
+
+static void on_header_bind(GtkSignalListItemFactory *factory, GtkListHeader *list_header,
+                           gpointer user_data)
+{
+    const HsRecord *record =
+        samaya_history_item_get_record(SAMAYA_HISTORY_ITEM(gtk_list_header_get_item(list_header)));
+    g_autofree gchar *day = format_day(record->start_real_us);
+
+    gtk_label_set_text(GTK_LABEL(gtk_list_header_get_child(list_header)), day);
+}
+
+
+/* ============================================================================
+ * Signal Handlers
+ * ============================================================================ */
+
+static void sync_empty_state(SamayaHistoryDialog *self)
+{
+    gboolean is_empty = g_list_model_get_n_items(G_LIST_MODEL(self->model)) == 0;
+
+    gtk_stack_set_visible_child_name(self->content_stack, is_empty ? "empty" : "list");
+}
+
+static void on_routine_filter_changed(AdwToggleGroup *toggle_group, GParamSpec *pspec,
+                                      gpointer user_data)
+{
+    SamayaHistoryDialog *self = SAMAYA_HISTORY_DIALOG(user_data);
+    const char *name = adw_toggle_group_get_active_name(toggle_group);
+    gint routine = -1;
+
+    if (g_strcmp0(name, "pomodoro") == 0) {
+        routine = Working;
+    } else if (g_strcmp0(name, "short-break") == 0) {
+        routine = ShortBreak;
+    } else if (g_strcmp0(name, "long-break") == 0) {
+        routine = LongBreak;
+    }
+
+    if (self->model != NULL) {
+        samaya_history_model_set_routine_filter(self->model, routine);
+        sync_empty_state(self);
+    }
+}
+
+
+/* ============================================================================
+ * Samaya History Dialog Methods
+ * ============================================================================ */
+
+static void samaya_history_dialog_dispose(GObject *object)
+{
+    SamayaHistoryDialog *self = SAMAYA_HISTORY_DIALOG(object);
+
+    gtk_widget_dispose_template(GTK_WIDGET(self), SAMAYA_TYPE_HISTORY_DIALOG);
+    g_clear_object(&self->model);
+
+    G_OBJECT_CLASS(samaya_history_dialog_parent_class)->dispose(object);
+}
+
+static void samaya_history_dialog_class_init(SamayaHistoryDialogClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS(klass);
+    GtkWidgetClass *widget_class = GTK_WIDGET_CLASS(klass);
+
+    object_class->dispose = samaya_history_dialog_dispose;
+
+    gtk_widget_class_set_template_from_resource(widget_class,
+                                                "/io/github/redddfoxxyy/samaya/history-dialog.ui");
+
+    gtk_widget_class_bind_template_child(widget_class, SamayaHistoryDialog, routine_filter_group);
+    gtk_widget_class_bind_template_child(widget_class, SamayaHistoryDialog, content_stack);
+    gtk_widget_class_bind_template_child(widget_class, SamayaHistoryDialog, list_view);
+
+    gtk_widget_class_bind_template_callback(widget_class, on_routine_filter_changed);
+}
+
+static void samaya_history_dialog_init(SamayaHistoryDialog *self)
+{
+    gtk_widget_init_template(GTK_WIDGET(self));
+
+    g_autoptr(GtkListItemFactory) factory = gtk_signal_list_item_factory_new();
+    g_signal_connect(factory, "setup", G_CALLBACK(on_row_setup), NULL);
+    g_signal_connect(factory, "bind", G_CALLBACK(on_row_bind), NULL);
+    gtk_list_view_set_factory(self->list_view, factory);
+
+    g_autoptr(GtkListItemFactory) header_factory = gtk_signal_list_item_factory_new();
+    g_signal_connect(header_factory, "setup", G_CALLBACK(on_header_setup), NULL);
+    g_signal_connect(header_factory, "bind", G_CALLBACK(on_header_bind), NULL);
+    gtk_list_view_set_header_factory(self->list_view, header_factory);
+}
+
+SamayaHistoryDialog *samaya_history_dialog_new(SamayaHistoryModel *model)
+{
+    g_return_val_if_fail(SAMAYA_IS_HISTORY_MODEL(model), NULL);
+
+    SamayaHistoryDialog *self = g_object_new(SAMAYA_TYPE_HISTORY_DIALOG, NULL);
+
+    self->model = g_object_ref(model);
+    g_autoptr(GtkNoSelection) selection = gtk_no_selection_new(g_object_ref(G_LIST_MODEL(model)));
+    gtk_list_view_set_model(self->list_view, GTK_SELECTION_MODEL(selection));
+
+    sync_empty_state(self);
+
+    return self;
+}
+
+void samaya_history_dialog_scroll_to(SamayaHistoryDialog *self, guint position)
+{
+    g_return_if_fail(SAMAYA_IS_HISTORY_DIALOG(self));
+
+    gtk_list_view_scroll_to(self->list_view, position, GTK_LIST_SCROLL_NONE, NULL);
+}
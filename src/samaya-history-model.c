@@ -0,0 +1,360 @@
+/* samaya-history-model.c
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "samaya-history-model.h"
+
+// Matches of the routine filter are counted per block of this many records.
+#define FILTER_BLOCK_RECORDS 256
+
+// Records counted per main loop iteration, a few milliseconds with the history paged in.
+#define FILTER_STEP_RECORDS (256 * FILTER_BLOCK_RECORDS)
+
+struct _SamayaHistoryItem
+{
+    GObject parent_instance;
+
+    HsRecord record;
+};
+
+G_DEFINE_FINAL_TYPE(SamayaHistoryItem, samaya_history_item, G_TYPE_OBJECT)
+
+struct _SamayaHistoryModel
+{
+    GObject parent_instance;
+
+    GMappedFile *mapped;
+    const HsRecord *records;
+    gsize n_records;
+
+    // The routine kept by the filter, or -1 for all of them.
+    gint routine;
+
+    /*  Matches counted up to the end of each block, newest block first. Blocks are filled in
+        chunks from the main loop, the positions of the matches found so far are already shown.
+    */
+    GArray *block_ends;
+    gsize n_scanned;
+    guint n_matches;
+    guint scan_id;
+
+    // The last section handed out, list views ask for the same one for every row they bind.
+    guint section_start;
+    guint section_end;
+};
+
+static void samaya_history_model_list_model_init(GListModelInterface *iface);
+static void samaya_history_model_section_model_init(GtkSectionModelInterface *iface);
+
+G_DEFINE_FINAL_TYPE_WITH_CODE(SamayaHistoryModel, samaya_history_model, G_TYPE_OBJECT,
+                              G_IMPLEMENT_INTERFACE(G_TYPE_LIST_MODEL,
+                                                    samaya_history_model_list_model_init)
+                                  G_IMPLEMENT_INTERFACE(GTK_TYPE_SECTION_MODEL,
+                                                        samaya_history_model_section_model_init))
+
+
+/* ============================================================================
+ * Samaya History Item Methods
+ * ============================================================================ */
+
+static void samaya_history_item_class_init(SamayaHistoryItemClass *klass)
+{
+}
+
+static void samaya_history_item_init(SamayaHistoryItem *self)
+{
+}
+
+const HsRecord *samaya_history_item_get_record(SamayaHistoryItem *self)
+{
+    g_return_val_if_fail(SAMAYA_IS_HISTORY_ITEM(self), NULL);
+
+    return &self->record;
+}
+
+
+/* ============================================================================
+ * Internal Implementation
+ * ============================================================================ */
+
+static guint get_n_positions(SamayaHistoryModel *self)
+{
+    return self->routine >= 0 ? self->n_matches : (guint) self->n_records;
+}
+
+// Records count from the newest, which is the last one in the file.
+static const HsRecord *get_newest(SamayaHistoryModel *self, gsize nth)
+{
+    return &self->records[self->n_records - 1 - nth];
+}
+
+// Positions count from the newest record, within a block of the filter only matches count.
+static const HsRecord *get_record_at(SamayaHistoryModel *self, guint position)
+{
+    if (self->routine < 0) {
+        return get_newest(self, position);
+    }
+
+    // The first block whose matches reach past the position.
+    guint low = 0;
+    guint high = self->block_ends->len;
+    while (low < high) {
+        guint middle = low + (high - low) / 2;
+
+        if (g_array_index(self->block_ends, guint32, middle) <= position) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    guint skip = position - (low > 0 ? g_array_index(self->block_ends, guint32, low - 1) : 0);
+    gsize end = MIN(((gsize) low + 1) * FILTER_BLOCK_RECORDS, self->n_records);
+
+    for (gsize nth = (gsize) low * FILTER_BLOCK_RECORDS; nth < end; nth++) {
+        const HsRecord *record = get_newest(self, nth);
+
+        if (record->routine == self->routine && skip-- == 0) {
+            return record;
+        }
+    }
+
+    g_return_val_if_reached(get_newest(self, 0));
+}
+
+// Counts the matches of the next blocks, up to the given number of records.
+static void scan_blocks(SamayaHistoryModel *self, gsize n_records)
+{
+    gsize scan_end = MIN(self->n_scanned + n_records, self->n_records);
+
+    while (self->n_scanned < scan_end) {
+        gsize block_end = MIN(self->n_scanned + FILTER_BLOCK_RECORDS, self->n_records);
+
+        for (; self->n_scanned < block_end; self->n_scanned++) {
+            self->n_matches += (get_newest(self, self->n_scanned)->routine == self->routine);
+        }
+        g_array_append_val(self->block_ends, self->n_matches);
+    }
+}
+
+static gboolean on_scan_step(gpointer user_data)
+{
+    SamayaHistoryModel *self = SAMAYA_HISTORY_MODEL(user_data);
+    guint n_shown = self->n_matches;
+
+    scan_blocks(self, FILTER_STEP_RECORDS);
+
+    // The day of the last shown position may continue in the new ones.
+    self->section_start = 0;
+    self->section_end = 0;
+
+    if (self->n_matches > n_shown) {
+        g_list_model_items_changed(G_LIST_MODEL(self), n_shown, 0, self->n_matches - n_shown);
+    }
+
+    if (self->n_scanned < self->n_records) {
+        return G_SOURCE_CONTINUE;
+    }
+
+    self->scan_id = 0;
+    return G_SOURCE_REMOVE;
+}
+
+// Bounds of the local day the given real time falls in, in real microseconds.
+static void get_local_day_bounds(gint64 real_us, gint64 *day_start_us, gint64 *day_end_us)
+{
+    g_autoptr(GDateTime) time = g_date_time_new_from_unix_local(real_us / G_USEC_PER_SEC);
+    g_autoptr(GDateTime) midnight = g_date_time_new_local(
+        g_date_time_get_year(time), g_date_time_get_month(time),
+        g_date_time_get_day_of_month(time), 0, 0, 0);
+    g_autoptr(GDateTime) next_midnight = g_date_time_add_days(midnight, 1);
+
+    *day_start_us = g_date_time_to_unix(midnight) * G_USEC_PER_SEC;
+    *day_end_us = g_date_time_to_unix(next_midnight) * G_USEC_PER_SEC;
+}
+
+// First position in [low, high) whose record started before the given time, high if none did.
+static guint find_first_before(SamayaHistoryModel *self, guint low, guint high, gint64 real_us)
+{
+    while (low < high) {
+        guint middle = low + (high - low) / 2;
+
+        if (get_record_at(self, middle)->start_real_us < real_us) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+
+    return low;
+}
+
+
+/* ============================================================================
+ * List Model Implementation
+ * ============================================================================ */
+
+static GType samaya_history_model_get_item_type(GListModel *list)
+{
+    return SAMAYA_TYPE_HISTORY_ITEM;
+}
+
+static guint samaya_history_model_get_n_items(GListModel *list)
+{
+    return get_n_positions(SAMAYA_HISTORY_MODEL(list));
+}
+
+static gpointer samaya_history_model_get_item(GListModel *list, guint position)
+{
+    SamayaHistoryModel *self = SAMAYA_HISTORY_MODEL(list);
+
+    if (position >= get_n_positions(self)) {
+        return NULL;
+    }
+
+    SamayaHistoryItem *item = g_object_new(SAMAYA_TYPE_HISTORY_ITEM, NULL);
+    item->record = *get_record_at(self, position);
+
+    return item;
+}
+
+static void samaya_history_model_list_model_init(GListModelInterface *iface)
+{
+    iface->get_item_type = samaya_history_model_get_item_type;
+    iface->get_n_items = samaya_history_model_get_n_items;
+    iface->get_item = samaya_history_model_get_item;
+}
+
+/*  Sessions are grouped by the local day they started on. Records are appended in the order they
+    end, so start times only go down with the position and both ends of a day are found with a
+    binary search. Should a clock change break that order, the section still contains the
+    requested position, it just splits the day.
+*/
+static void samaya_history_model_get_section(GtkSectionModel *model, guint position,
+                                             guint *out_start, guint *out_end)
+{
+    SamayaHistoryModel *self = SAMAYA_HISTORY_MODEL(model);
+    guint n_positions = get_n_positions(self);
+
+    if (position >= n_positions) {
+        *out_start = n_positions;
+        *out_end = G_MAXUINT;
+        return;
+    }
+
+    if (position < self->section_start || position >= self->section_end) {
+        gint64 day_start_us = 0;
+        gint64 day_end_us = 0;
+        get_local_day_bounds(get_record_at(self, position)->start_real_us, &day_start_us,
+                             &day_end_us);
+
+        self->section_start = find_first_before(self, 0, position, day_end_us);
+        self->section_end = find_first_before(self, position + 1, n_positions, day_start_us);
+    }
+
+    *out_start = self->section_start;
+    *out_end = self->section_end;
+}
+
+static void samaya_history_model_section_model_init(GtkSectionModelInterface *iface)
+{
+    iface->get_section = samaya_history_model_get_section;
+}
+
+
+/* ============================================================================
+ * Samaya History Model Methods
+ * ============================================================================ */
+
+static void samaya_history_model_finalize(GObject *object)
+{
+    SamayaHistoryModel *self = SAMAYA_HISTORY_MODEL(object);
+
+    g_clear_handle_id(&self->scan_id, g_source_remove);
+    g_clear_pointer(&self->block_ends, g_array_unref);
+    g_clear_pointer(&self->mapped, g_mapped_file_unref);
+
+    G_OBJECT_CLASS(samaya_history_model_parent_class)->finalize(object);
+}
+
+static void samaya_history_model_class_init(SamayaHistoryModelClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS(klass);
+
+    object_class->finalize = samaya_history_model_finalize;
+}
+
+static void samaya_history_model_init(SamayaHistoryModel *self)
+{
+    self->routine = -1;
+    self->block_ends = g_array_new(FALSE, FALSE, sizeof(guint32));
+}
+
+SamayaHistoryModel *samaya_history_model_new(const char *history_path, GError **error)
+{
+    g_autoptr(GError) local_error = NULL;
+    g_autoptr(SamayaHistoryModel) self = g_object_new(SAMAYA_TYPE_HISTORY_MODEL, NULL);
+
+    self->mapped = hs_map(history_path, &self->records, &self->n_records, &local_error);
+    if (self->mapped == NULL) {
+        if (!g_error_matches(local_error, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+            g_propagate_error(error, g_steal_pointer(&local_error));
+            return NULL;
+        }
+
+        self->records = NULL;
+        self->n_records = 0;
+    }
+
+    return g_steal_pointer(&self);
+}
+
+void samaya_history_model_set_routine_filter(SamayaHistoryModel *self, gint routine)
+{
+    g_return_if_fail(SAMAYA_IS_HISTORY_MODEL(self));
+
+    guint n_removed = get_n_positions(self);
+
+    g_clear_handle_id(&self->scan_id, g_source_remove);
+    g_array_set_size(self->block_ends, 0);
+    self->n_scanned = 0;
+    self->n_matches = 0;
+    self->routine = MAX(routine, -1);
+
+    // The newest sessions are shown straight away, the rest follow as they are counted.
+    if (self->routine >= 0) {
+        scan_blocks(self, FILTER_STEP_RECORDS);
+
+        if (self->n_scanned < self->n_records) {
+            self->scan_id = g_idle_add(on_scan_step, self);
+        }
+    }
+
+    self->section_start = 0;
+    self->section_end = 0;
+
+    g_list_model_items_changed(G_LIST_MODEL(self), 0, n_removed, get_n_positions(self));
+}
+
+gboolean samaya_history_model_is_filtering(SamayaHistoryModel *self)
+{
+    g_return_val_if_fail(SAMAYA_IS_HISTORY_MODEL(self), FALSE);
+
+    return self->scan_id != 0;
+}
@@ -0,0 +1,57 @@
+/* samaya-history-model.h
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gtk/gtk.h>
+#include "samaya-history.h"
+
+G_BEGIN_DECLS
+
+#define SAMAYA_TYPE_HISTORY_ITEM (samaya_history_item_get_type())
+
+G_DECLARE_FINAL_TYPE(SamayaHistoryItem, samaya_history_item, SAMAYA, HISTORY_ITEM, GObject)
+
+const HsRecord *samaya_history_item_get_record(SamayaHistoryItem *self);
+
+#define SAMAYA_TYPE_HISTORY_MODEL (samaya_history_model_get_type())
+
+G_DECLARE_FINAL_TYPE(SamayaHistoryModel, samaya_history_model, SAMAYA, HISTORY_MODEL, GObject)
+
+/*  List model over a history file, newest session first, with one section per day.
+
+    The file is mapped rather than read, and items are only created for the positions a list view
+    asks for, so opening a history of millions of sessions costs about as much as opening an empty
+    one. A missing history file gives an empty model.
+*/
+SamayaHistoryModel *samaya_history_model_new(const char *history_path, GError **error);
+
+/*  Only keeps sessions of the given RoutineType, or all of them when routine is negative.
+
+    The matches of the newest sessions are shown at once, older ones are appended from the main
+    loop in chunks. Only the number of matches per block of 256 records is kept, 4 bytes per block,
+    and a position is found by scanning its block.
+*/
+void samaya_history_model_set_routine_filter(SamayaHistoryModel *self, gint routine);
+
+// Whether older sessions are still being matched against the routine filter.
+gboolean samaya_history_model_is_filtering(SamayaHistoryModel *self);
+
+G_END_DECLS
@@ -0,0 +1,457 @@
+/* samaya-history.c
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "samaya-history.h"
+#include "samaya-session.h"
+
+// Records read from the history file at a time while exporting.
+#define HS_EXPORT_CHUNK_RECORDS 4096
+
+// Formatted output is handed to the output stream whenever this much of it has piled up.
+#define HS_EXPORT_BUFFER_SIZE (64 * 1024)
+
+typedef struct
+{
+    gchar *history_path;
+    GFile *destination;
+    HsExportFormat format;
+} HsExportJob;
+
+
+/* ============================================================================
+ * Static Variables
+ * ============================================================================ */
+
+static int historyFd = -1;
+
+
+/* ============================================================================
+ * Internal Implementation
+ * ============================================================================ */
+
+static void hs_fill_header(HsFileHeader *header)
+{
+    memcpy(header->magic, HS_FILE_MAGIC, sizeof(header->magic));
+    header->version = HS_FILE_VERSION;
+    header->record_size = sizeof(HsRecord);
+}
+
+static gboolean hs_header_is_valid(const HsFileHeader *header)
+{
+    return memcmp(header->magic, HS_FILE_MAGIC, sizeof(header->magic)) == 0 &&
+           header->version == HS_FILE_VERSION && header->record_size == sizeof(HsRecord);
+}
+
+static gboolean hs_write_all(int fd, const void *data, gsize size)
+{
+    const guint8 *bytes = data;
+
+    while (size > 0) {
+        ssize_t written = write(fd, bytes, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return FALSE;
+        }
+
+        bytes += written;
+        size -= (gsize) written;
+    }
+
+    return TRUE;
+}
+
+// Writes the header of a new history file, or checks the header of an existing one and cuts off a
+// record torn by a crash, so appended records stay aligned.
+static gboolean hs_prepare_file(int fd, const char *path)
+{
+    struct stat file_stat;
+    HsFileHeader header;
+
+    if (fstat(fd, &file_stat) != 0) {
+        g_warning("Failed to stat %s: %s", path, g_strerror(errno));
+        return FALSE;
+    }
+
+    if (file_stat.st_size < (off_t) sizeof(header)) {
+        hs_fill_header(&header);
+
+        if (ftruncate(fd, 0) != 0 || !hs_write_all(fd, &header, sizeof(header))) {
+            g_warning("Failed to write the header of %s: %s", path, g_strerror(errno));
+            return FALSE;
+        }
+        return TRUE;
+    }
+
+    if (pread(fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header) ||
+        !hs_header_is_valid(&header)) {
+        g_warning("%s is not a version %d Samaya history, sessions will not be recorded.", path,
+                  HS_FILE_VERSION);
+        return FALSE;
+    }
+
+    off_t torn_size = (file_stat.st_size - (off_t) sizeof(header)) % (off_t) sizeof(HsRecord);
+    if (torn_size != 0 && ftruncate(fd, file_stat.st_size - torn_size) != 0) {
+        g_warning("Failed to drop the torn record at the end of %s: %s", path, g_strerror(errno));
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+const char *hs_routine_to_string(guint8 routine)
+{
+    switch ((RoutineType) routine) {
+        case Working:
+            return "work";
+        case ShortBreak:
+            return "short-break";
+        case LongBreak:
+            return "long-break";
+        default:
+            return "unknown";
+    }
+}
+
+static const char *hs_outcome_to_string(guint8 outcome)
+{
+    switch ((HsOutcome) outcome) {
+        case HsCompleted:
+            return "completed";
+        case HsSkipped:
+            return "skipped";
+        default:
+            return "unknown";
+    }
+}
+
+// ISO 8601 in local time with the UTC offset. Formatted on the stack rather than through a
+// GDateTime or g_string_append_printf, so exporting a record allocates nothing.
+static void hs_append_timestamp(GString *buffer, gint64 real_us)
+{
+    time_t seconds = (time_t) (real_us / G_USEC_PER_SEC);
+    struct tm local;
+    gchar text[48];
+
+    if (localtime_r(&seconds, &local) == NULL) {
+        memset(&local, 0, sizeof(local));
+    }
+
+    glong offset_minutes = local.tm_gmtoff / 60;
+    gchar offset_sign = (offset_minutes < 0) ? '-' : '+';
+    offset_minutes = ABS(offset_minutes);
+
+    gint length = g_snprintf(text, sizeof(text), "%04d-%02d-%02dT%02d:%02d:%02d%c%02ld:%02ld",
+                             local.tm_year + 1900, local.tm_mon + 1, local.tm_mday, local.tm_hour,
+                             local.tm_min, local.tm_sec, offset_sign, offset_minutes / 60,
+                             offset_minutes % 60);
+    g_string_append_len(buffer, text, MIN(length, (gint) sizeof(text) - 1));
+}
+
+static void hs_append_seconds(GString *buffer, guint32 milliseconds)
+{
+    gchar text[24];
+
+    gint length = g_snprintf(text, sizeof(text), "%u.%03u", milliseconds / 1000,
+                             milliseconds % 1000);
+    g_string_append_len(buffer, text, MIN(length, (gint) sizeof(text) - 1));
+}
+
+static void hs_append_csv_record(GString *buffer, const HsRecord *record)
+{
+    g_string_append(buffer, hs_routine_to_string(record->routine));
+    g_string_append_c(buffer, ',');
+    g_string_append(buffer, hs_outcome_to_string(record->outcome));
+    g_string_append_c(buffer, ',');
+    hs_append_timestamp(buffer, record->start_real_us);
+    g_string_append_c(buffer, ',');
+    hs_append_timestamp(buffer, record->end_real_us);
+    g_string_append_c(buffer, ',');
+    hs_append_seconds(buffer, record->duration_ms);
+    g_string_append_c(buffer, ',');
+    hs_append_seconds(buffer, record->planned_ms);
+    g_string_append_c(buffer, '\n');
+}
+
+static void hs_append_json_record(GString *buffer, const HsRecord *record, gboolean first)
+{
+    g_string_append(buffer, first ? "\n  {\"routine\": \"" : ",\n  {\"routine\": \"");
+    g_string_append(buffer, hs_routine_to_string(record->routine));
+    g_string_append(buffer, "\", \"outcome\": \"");
+    g_string_append(buffer, hs_outcome_to_string(record->outcome));
+    g_string_append(buffer, "\", \"start\": \"");
+    hs_append_timestamp(buffer, record->start_real_us);
+    g_string_append(buffer, "\", \"end\": \"");
+    hs_append_timestamp(buffer, record->end_real_us);
+    g_string_append(buffer, "\", \"duration_seconds\": ");
+    hs_append_seconds(buffer, record->duration_ms);
+    g_string_append(buffer, ", \"planned_seconds\": ");
+    hs_append_seconds(buffer, record->planned_ms);
+    g_string_append_c(buffer, '}');
+}
+
+static gboolean hs_flush_buffer(GOutputStream *output, GString *buffer, GCancellable *cancellable,
+                                GError **error)
+{
+    if (!g_output_stream_write_all(output, buffer->str, buffer->len, NULL, cancellable, error)) {
+        return FALSE;
+    }
+
+    g_string_truncate(buffer, 0);
+    return TRUE;
+}
+
+static void hs_export_job_free(gpointer data)
+{
+    HsExportJob *job = data;
+
+    g_free(job->history_path);
+    g_object_unref(job->destination);
+    g_free(job);
+}
+
+static void hs_export_thread(GTask *task, gpointer source_object, gpointer task_data,
+                             GCancellable *cancellable)
+{
+    HsExportJob *job = task_data;
+    GError *error = NULL;
+
+    g_autoptr(GFileOutputStream) output = g_file_replace(
+        job->destination, NULL, FALSE, G_FILE_CREATE_REPLACE_DESTINATION, cancellable, &error);
+    if (output == NULL) {
+        g_task_return_error(task, error);
+        return;
+    }
+
+    if (!hs_export_and_close(job->history_path, G_OUTPUT_STREAM(output), job->format,
+                             cancellable, &error)) {
+        g_task_return_error(task, error);
+        return;
+    }
+
+    g_task_return_boolean(task, TRUE);
+}
+
+
+/* ============================================================================
+ * Public API
+ * ============================================================================ */
+
+void hs_enable(const char *path)
+{
+    g_autofree gchar *directory = g_path_get_dirname(path);
+
+    hs_disable();
+
+    if (g_mkdir_with_parents(directory, 0700) != 0) {
+        g_warning("Failed to create %s, sessions will not be recorded.", directory);
+        return;
+    }
+
+    int fd = open(path, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        g_warning("Failed to open %s, sessions will not be recorded: %s", path, g_strerror(errno));
+        return;
+    }
+
+    if (!hs_prepare_file(fd, path)) {
+        close(fd);
+        return;
+    }
+
+    historyFd = fd;
+}
+
+void hs_disable(void)
+{
+    if (historyFd >= 0) {
+        close(historyFd);
+        historyFd = -1;
+    }
+}
+
+gboolean hs_is_enabled(void)
+{
+    return historyFd >= 0;
+}
+
+void hs_append(const HsRecord *record)
+{
+    if (historyFd < 0) {
+        return;
+    }
+
+    if (!hs_write_all(historyFd, record, sizeof(HsRecord))) {
+        g_warning("Failed to record the session: %s", g_strerror(errno));
+    }
+}
+
+GMappedFile *hs_map(const char *path, const HsRecord **records, gsize *n_records, GError **error)
+{
+    g_autoptr(GMappedFile) mapped = g_mapped_file_new(path, FALSE, error);
+    if (mapped == NULL) {
+        return NULL;
+    }
+
+    const gchar *contents = g_mapped_file_get_contents(mapped);
+    gsize length = g_mapped_file_get_length(mapped);
+
+    if (length < sizeof(HsFileHeader) || !hs_header_is_valid((const HsFileHeader *) contents)) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                    "%s is not a version %d Samaya history", path, HS_FILE_VERSION);
+        return NULL;
+    }
+
+    // The mapping is page aligned, so the records following the header are aligned as well.
+    *records = (const HsRecord *) (contents + sizeof(HsFileHeader));
+    *n_records = (length - sizeof(HsFileHeader)) / sizeof(HsRecord);
+
+    return g_steal_pointer(&mapped);
+}
+
+gboolean hs_export(const char *history_path, GOutputStream *output, HsExportFormat format,
+                   GCancellable *cancellable, GError **error)
+{
+    g_autoptr(GFile) history_file = g_file_new_for_path(history_path);
+    g_autoptr(GFileInputStream) input = g_file_read(history_file, cancellable, error);
+    if (input == NULL) {
+        return FALSE;
+    }
+
+    HsFileHeader header;
+    gsize bytes_read = 0;
+
+    if (!g_input_stream_read_all(G_INPUT_STREAM(input), &header, sizeof(header), &bytes_read,
+                                 cancellable, error)) {
+        return FALSE;
+    }
+
+    if (bytes_read != sizeof(header) || !hs_header_is_valid(&header)) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                    "%s is not a version %d Samaya history", history_path, HS_FILE_VERSION);
+        return FALSE;
+    }
+
+    g_autofree HsRecord *chunk = g_new(HsRecord, HS_EXPORT_CHUNK_RECORDS);
+    g_autoptr(GString) buffer = g_string_sized_new(HS_EXPORT_BUFFER_SIZE + 256);
+    gboolean first = TRUE;
+
+    if (format == HsFormatCsv) {
+        g_string_append(buffer, "routine,outcome,start,end,duration_seconds,planned_seconds\n");
+    } else {
+        g_string_append_c(buffer, '[');
+    }
+
+    do {
+        if (!g_input_stream_read_all(G_INPUT_STREAM(input), chunk,
+                                     HS_EXPORT_CHUNK_RECORDS * sizeof(HsRecord), &bytes_read,
+                                     cancellable, error)) {
+            return FALSE;
+        }
+
+        // A record still being appended at the very end of the file is left out.
+        gsize n_records = bytes_read / sizeof(HsRecord);
+
+        for (gsize i = 0; i < n_records; i++) {
+            if (format == HsFormatCsv) {
+                hs_append_csv_record(buffer, &chunk[i]);
+            } else {
+                hs_append_json_record(buffer, &chunk[i], first);
+            }
+            first = FALSE;
+
+            if (buffer->len >= HS_EXPORT_BUFFER_SIZE &&
+                !hs_flush_buffer(output, buffer, cancellable, error)) {
+                return FALSE;
+            }
+        }
+    } while (bytes_read == HS_EXPORT_CHUNK_RECORDS * sizeof(HsRecord));
+
+    if (format == HsFormatJson) {
+        g_string_append(buffer, first ? "]\n" : "\n]\n");
+    }
+
+    return hs_flush_buffer(output, buffer, cancellable, error) &&
+           g_output_stream_flush(output, cancellable, error);
+}
+
+gboolean hs_export_and_close(const char *history_path, GOutputStream *output,
+                             HsExportFormat format, GCancellable *cancellable, GError **error)
+{
+    if (hs_export(history_path, output, format, cancellable, error) &&
+        g_output_stream_close(output, cancellable, error)) {
+        return TRUE;
+    }
+
+    // Closing with a cancelled cancellable leaves the destination as it was.
+    g_autoptr(GCancellable) abort_close = g_cancellable_new();
+    g_cancellable_cancel(abort_close);
+    g_output_stream_close(output, abort_close, NULL);
+
+    return FALSE;
+}
+
+void hs_export_async(const char *history_path, GFile *destination, HsExportFormat format,
+                     GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data)
+{
+    HsExportJob *job = g_new0(HsExportJob, 1);
+    job->history_path = g_strdup(history_path);
+    job->destination = g_object_ref(destination);
+    job->format = format;
+
+    g_autoptr(GTask) task = g_task_new(NULL, cancellable, callback, user_data);
+    g_task_set_source_tag(task, hs_export_async);
+    g_task_set_task_data(task, job, hs_export_job_free);
+    g_task_run_in_thread(task, hs_export_thread);
+}
+
+gboolean hs_export_finish(GAsyncResult *result, GError **error)
+{
+    g_return_val_if_fail(g_task_is_valid(result, NULL), FALSE);
+
+    return g_task_propagate_boolean(G_TASK(result), error);
+}
+
+gboolean hs_export_format_from_string(const char *name, HsExportFormat *format)
+{
+    if (g_ascii_strcasecmp(name, "csv") == 0) {
+        *format = HsFormatCsv;
+        return TRUE;
+    }
+
+    if (g_ascii_strcasecmp(name, "json") == 0) {
+        *format = HsFormatJson;
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+HsExportFormat hs_export_format_for_path(const char *path)
+{
+    return g_str_has_suffix(path, ".json") ? HsFormatJson : HsFormatCsv;
+}
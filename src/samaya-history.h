@@ -0,0 +1,125 @@
+/* samaya-history.h
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+/*  History of the sessions the user went through.
+
+    Every routine that was started and then either ran out or was skipped is appended to the
+    history file as one fixed size record. Records are only ever appended, so the file can be read
+    while Samaya keeps writing to it, and a record torn by a crash is dropped the next time the
+    file is opened for writing.
+
+    Like trace files, history files store the records in host byte order.
+*/
+
+#define HS_FILE_MAGIC "SMYHIST\0"
+#define HS_FILE_VERSION 1
+
+typedef enum
+{
+    HsCompleted,
+    HsSkipped,
+} HsOutcome;
+
+typedef enum
+{
+    HsFormatCsv,
+    HsFormatJson,
+} HsExportFormat;
+
+typedef struct
+{
+    // Real time in microseconds the routine was first started and when it ran out or was skipped.
+    gint64 start_real_us;
+    gint64 end_real_us;
+
+    // Time the timer actually ran for, and the time it was set to run for.
+    guint32 duration_ms;
+    guint32 planned_ms;
+
+    guint8 routine;
+    guint8 outcome;
+    guint8 reserved[2];
+
+    // Tag the user attached to a work session, see samaya-tags.h, 0 when there is none. Files
+    // written before tags existed have 0 here.
+    guint32 tag_id;
+} HsRecord;
+
+G_STATIC_ASSERT(sizeof(HsRecord) == 32);
+
+typedef struct
+{
+    gchar magic[8];
+    guint32 version;
+    guint32 record_size;
+} HsFileHeader;
+
+G_STATIC_ASSERT(sizeof(HsFileHeader) == 16);
+
+// Starts appending records to the given history file, creating it and its directory if needed.
+void hs_enable(const char *path);
+
+// Stops recording and closes the history file.
+void hs_disable(void);
+
+gboolean hs_is_enabled(void);
+
+// Appends a record to the history file, does nothing when recording is disabled.
+void hs_append(const HsRecord *record);
+
+/*  Maps a history file read only, without copying it into memory. On success records points at
+    the records from oldest to newest, which stay valid for as long as the returned mapping.
+
+    A record still being appended at the end of the file is left out.
+*/
+GMappedFile *hs_map(const char *path, const HsRecord **records, gsize *n_records, GError **error);
+
+/*  Writes every record of the history file to output as CSV or JSON, one record at a time.
+
+    Records are read and formatted in fixed size chunks, so memory use does not grow with the size
+    of the history. The output stream is flushed but not closed.
+*/
+gboolean hs_export(const char *history_path, GOutputStream *output, HsExportFormat format,
+                   GCancellable *cancellable, GError **error);
+
+/*  Runs hs_export and closes the output. When either fails, the close is aborted instead, so a
+    stream from g_file_replace() leaves the file it would have replaced as it was.
+*/
+gboolean hs_export_and_close(const char *history_path, GOutputStream *output,
+                             HsExportFormat format, GCancellable *cancellable, GError **error);
+
+// Runs hs_export in a worker thread, replacing the destination file with the export.
+void hs_export_async(const char *history_path, GFile *destination, HsExportFormat format,
+                     GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data);
+
+gboolean hs_export_finish(GAsyncResult *result, GError **error);
+
+// Parses "csv" or "json", returns FALSE for anything else.
+gboolean hs_export_format_from_string(const char *name, HsExportFormat *format);
+
+// Name of the routine as written in exports, work, short-break or long-break.
+const char *hs_routine_to_string(guint8 routine);
+
+// Picks the export format from the extension of a file name, CSV unless it ends in ".json".
+HsExportFormat hs_export_format_for_path(const char *path);
@@ -0,0 +1,330 @@
+/* samaya-hooks.c
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include <gio/gio.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "samaya-hooks.h"
+
+
+typedef struct
+{
+    HkEvent event;
+    gchar **envp;
+
+    // Monotonic time the event happened at.
+    gint64 queued_us;
+
+    GSubprocess *process;
+    guint timeout_id;
+} HkJob;
+
+
+/* ============================================================================
+ * Static Variables
+ * ============================================================================ */
+
+static gboolean hkEnabled = FALSE;
+static guint hkTimeoutMs = 0;
+static gchar **hkCommands[HK_N_EVENTS] = {NULL};
+
+static GQueue hkQueued = G_QUEUE_INIT;
+static GQueue hkRunning = G_QUEUE_INIT;
+static guint hkDispatchId = 0;
+static GCancellable *hkCancellable = NULL;
+
+static HkStats hkStats = {0};
+
+
+/* ============================================================================
+ * Internal Implementation
+ * ============================================================================ */
+
+static void job_free(HkJob *job)
+{
+    g_clear_handle_id(&job->timeout_id, g_source_remove);
+    g_clear_object(&job->process);
+    g_strfreev(job->envp);
+    g_free(job);
+}
+
+static gchar **environ_set_uint(gchar **envp, const char *name, guint64 value)
+{
+    gchar buffer[24];
+    g_snprintf(buffer, sizeof(buffer), "%" G_GUINT64_FORMAT, value);
+
+    return g_environ_setenv(envp, name, buffer, TRUE);
+}
+
+static gchar **build_environment(HkEvent event, const HkContext *context)
+{
+    gchar **envp = g_get_environ();
+
+    envp = g_environ_setenv(envp, "SAMAYA_EVENT", hk_event_to_string(event), TRUE);
+    envp = g_environ_setenv(envp, "SAMAYA_ROUTINE", context->routine, TRUE);
+    if (context->tag != NULL && context->tag[0] != '\0') {
+        envp = g_environ_setenv(envp, "SAMAYA_TAG", context->tag, TRUE);
+    } else {
+        envp = g_environ_unsetenv(envp, "SAMAYA_TAG");
+    }
+
+    envp = environ_set_uint(envp, "SAMAYA_PLANNED_MS", context->planned_ms);
+    envp = environ_set_uint(envp, "SAMAYA_ELAPSED_MS", context->elapsed_ms);
+    envp = environ_set_uint(envp, "SAMAYA_START_TIME",
+                            (guint64) MAX(context->start_real_us, 0) / G_USEC_PER_SEC);
+    envp = environ_set_uint(envp, "SAMAYA_EVENT_TIME",
+                            (guint64) MAX(context->event_real_us, 0) / G_USEC_PER_SEC);
+    envp = environ_set_uint(envp, "SAMAYA_TOTAL_SESSIONS", context->total_sessions);
+
+    return envp;
+}
+
+static void schedule_dispatch(void);
+
+static void on_job_exited(GObject *source_object, GAsyncResult *result, gpointer user_data)
+{
+    g_autoptr(GError) error = NULL;
+
+    gboolean exited = g_subprocess_wait_finish(G_SUBPROCESS(source_object), result, &error);
+
+    // The job is gone already when hooks were disabled in the meantime.
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        return;
+    }
+
+    HkJob *job = user_data;
+
+    // A killed hook was counted as such when its timeout ran out.
+    if (job->timeout_id != 0 && (!exited || !g_subprocess_get_successful(job->process))) {
+        hkStats.n_failed++;
+        g_info("The %s hook failed", hk_event_to_string(job->event));
+    }
+
+    g_queue_remove(&hkRunning, job);
+    job_free(job);
+
+    schedule_dispatch();
+}
+
+// Runs in the child, so whatever a hook starts in turn can be killed along with it.
+static void setup_hook_process(gpointer user_data)
+{
+    setpgid(0, 0);
+}
+
+// Kills the whole process group of the hook, not only the command itself.
+static void kill_job(HkJob *job)
+{
+    const gchar *identifier = g_subprocess_get_identifier(job->process);
+
+    // Already exited and reaped, the process group may be gone or belong to someone else.
+    if (identifier == NULL) {
+        return;
+    }
+
+    kill(-(pid_t) atoi(identifier), SIGKILL);
+}
+
+static gboolean on_job_timeout(gpointer user_data)
+{
+    HkJob *job = user_data;
+
+    job->timeout_id = 0;
+    hkStats.n_killed++;
+    g_info("The %s hook ran for longer than %u ms, killing it", hk_event_to_string(job->event),
+           hkTimeoutMs);
+
+    // Still waited for as usual, which reaps it.
+    kill_job(job);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void start_job(HkJob *job)
+{
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GSubprocessLauncher) launcher = g_subprocess_launcher_new(G_SUBPROCESS_FLAGS_NONE);
+
+    g_subprocess_launcher_set_environ(launcher, job->envp);
+    g_subprocess_launcher_set_child_setup(launcher, setup_hook_process, NULL, NULL);
+
+    // The command may have changed while the job was queued, the current one is run.
+    gchar **argv = hkCommands[job->event];
+    if (argv == NULL) {
+        job_free(job);
+        return;
+    }
+
+    job->process = g_subprocess_launcher_spawnv(launcher, (const gchar *const *) argv, &error);
+
+    gint64 latency_us = g_get_monotonic_time() - job->queued_us;
+    hkStats.last_spawn_latency_us = latency_us;
+    hkStats.max_spawn_latency_us = MAX(hkStats.max_spawn_latency_us, latency_us);
+    hkStats.total_spawn_latency_us += latency_us;
+
+    if (job->process == NULL) {
+        hkStats.n_failed++;
+        g_info("Failed to run the %s hook: %s", hk_event_to_string(job->event), error->message);
+        job_free(job);
+        return;
+    }
+    hkStats.n_spawned++;
+
+    if (hkTimeoutMs > 0) {
+        job->timeout_id = g_timeout_add(hkTimeoutMs, on_job_timeout, job);
+    }
+
+    g_queue_push_tail(&hkRunning, job);
+    g_subprocess_wait_async(job->process, hkCancellable, on_job_exited, job);
+}
+
+static gboolean on_dispatch(gpointer user_data)
+{
+    hkDispatchId = 0;
+
+    while (hkRunning.length < HK_MAX_RUNNING && !g_queue_is_empty(&hkQueued)) {
+        start_job(g_queue_pop_head(&hkQueued));
+    }
+
+    hkStats.n_running = hkRunning.length;
+    hkStats.n_queued = hkQueued.length;
+
+    return G_SOURCE_REMOVE;
+}
+
+static void schedule_dispatch(void)
+{
+    if (hkDispatchId == 0) {
+        hkDispatchId = g_idle_add(on_dispatch, NULL);
+    }
+}
+
+
+/* ============================================================================
+ * Public API
+ * ============================================================================ */
+
+void hk_enable(guint timeout_ms)
+{
+    hk_disable();
+
+    hkEnabled = TRUE;
+    hkTimeoutMs = timeout_ms;
+    hkCancellable = g_cancellable_new();
+    hkStats = (HkStats) {0};
+}
+
+void hk_disable(void)
+{
+    if (!hkEnabled) {
+        return;
+    }
+
+    g_cancellable_cancel(hkCancellable);
+    g_clear_object(&hkCancellable);
+    g_clear_handle_id(&hkDispatchId, g_source_remove);
+
+    g_queue_clear_full(&hkQueued, (GDestroyNotify) job_free);
+
+    HkJob *job;
+    while ((job = g_queue_pop_head(&hkRunning)) != NULL) {
+        kill_job(job);
+        job_free(job);
+    }
+
+    for (guint event = 0; event < HK_N_EVENTS; event++) {
+        g_clear_pointer(&hkCommands[event], g_strfreev);
+    }
+
+    hkStats.n_running = 0;
+    hkStats.n_queued = 0;
+    hkEnabled = FALSE;
+}
+
+gboolean hk_is_enabled(void)
+{
+    return hkEnabled;
+}
+
+gboolean hk_set_command(HkEvent event, const char *command_line, GError **error)
+{
+    g_return_val_if_fail(event < HK_N_EVENTS, FALSE);
+
+    gchar **argv = NULL;
+    if (command_line != NULL && command_line[0] != '\0' &&
+        !g_shell_parse_argv(command_line, NULL, &argv, error)) {
+        return FALSE;
+    }
+
+    g_strfreev(hkCommands[event]);
+    hkCommands[event] = argv;
+
+    return TRUE;
+}
+
+void hk_set_timeout(guint timeout_ms)
+{
+    hkTimeoutMs = timeout_ms;
+}
+
+void hk_run(HkEvent event, const HkContext *context)
+{
+    g_return_if_fail(event < HK_N_EVENTS);
+
+    if (!hkEnabled || hkCommands[event] == NULL) {
+        return;
+    }
+
+    if (hkQueued.length >= HK_MAX_QUEUED) {
+        hkStats.n_dropped++;
+        g_info("Too many hooks are waiting, dropping the %s hook", hk_event_to_string(event));
+        return;
+    }
+
+    HkJob *job = g_new0(HkJob, 1);
+    job->event = event;
+    job->envp = build_environment(event, context);
+    job->queued_us = g_get_monotonic_time();
+
+    g_queue_push_tail(&hkQueued, job);
+    hkStats.n_queued = hkQueued.length;
+
+    schedule_dispatch();
+}
+
+const HkStats *hk_get_stats(void)
+{
+    return &hkStats;
+}
+
+const char *hk_event_to_string(HkEvent event)
+{
+    switch (event) {
+        case HkSessionStart:
+            return "start";
+        case HkSessionEnd:
+            return "end";
+        case HkSessionSkip:
+            return "skip";
+        default:
+            return "unknown";
+    }
+}
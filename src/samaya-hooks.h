@@ -0,0 +1,107 @@
+/* samaya-hooks.h
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <glib.h>
+
+/*  User commands run when a routine starts, runs out or is skipped, to mute a chat, turn on do not
+    disturb or log the session to a time tracker.
+
+    Commands are never run from the transition that fired them. They are queued and spawned from
+    the main loop, at most HK_MAX_RUNNING at a time, and nothing waits for them to exit, so a slow
+    or hanging hook cannot hold up the timer or the window. Each hook runs in a process group of
+    its own, which is killed when the hook is still running after its timeout or when hooks are
+    disabled, so a shell script does not leave the commands it started behind.
+
+    Every hook is run with the environment of Samaya plus:
+
+        SAMAYA_EVENT            start, end or skip
+        SAMAYA_ROUTINE          work, short-break or long-break
+        SAMAYA_TAG              tag of a work session, unset when there is none
+        SAMAYA_PLANNED_MS       length the routine was started with
+        SAMAYA_ELAPSED_MS       time the routine ran for so far
+        SAMAYA_START_TIME       unix time in seconds the routine was first started
+        SAMAYA_EVENT_TIME       unix time in seconds the event happened at
+        SAMAYA_TOTAL_SESSIONS   work sessions completed so far
+*/
+
+#define HK_MAX_RUNNING 4
+
+// Hooks queued beyond this while others still run are dropped.
+#define HK_MAX_QUEUED 32
+
+typedef enum
+{
+    HkSessionStart,
+    HkSessionEnd,
+    HkSessionSkip,
+} HkEvent;
+
+#define HK_N_EVENTS 3
+
+typedef struct
+{
+    const char *routine;
+    const char *tag;
+    guint64 planned_ms;
+    guint64 elapsed_ms;
+    gint64 start_real_us;
+    gint64 event_real_us;
+    guint64 total_sessions;
+} HkContext;
+
+typedef struct
+{
+    guint64 n_spawned;
+    guint64 n_failed;
+    guint64 n_killed;
+    guint64 n_dropped;
+
+    guint n_running;
+    guint n_queued;
+
+    // Time from the event to the hook having been spawned, which includes waiting in the queue.
+    gint64 last_spawn_latency_us;
+    gint64 max_spawn_latency_us;
+    gint64 total_spawn_latency_us;
+} HkStats;
+
+// Starts running hooks, killing any that run for longer than the given timeout.
+void hk_enable(guint timeout_ms);
+
+// Drops the queued hooks, kills the running ones and forgets all commands.
+void hk_disable(void);
+
+gboolean hk_is_enabled(void);
+
+/*  Sets the command line run for the event, split like a shell would without running one. An
+    empty or NULL command line removes the hook.
+*/
+gboolean hk_set_command(HkEvent event, const char *command_line, GError **error);
+
+void hk_set_timeout(guint timeout_ms);
+
+// Queues the hook of the event, if there is one.
+void hk_run(HkEvent event, const HkContext *context);
+
+const HkStats *hk_get_stats(void);
+
+const char *hk_event_to_string(HkEvent event);
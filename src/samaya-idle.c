@@ -0,0 +1,264 @@
+/* samaya-idle.c
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "samaya-idle.h"
+#include "samaya-session.h"
+#include "samaya-timer.h"
+
+
+/* ============================================================================
+ * Static Variables
+ * ============================================================================ */
+
+static GDBusConnection *imConnection = NULL;
+static GCancellable *imCancellable = NULL;
+
+static guint imNameWatchId = 0;
+static guint imSignalId = 0;
+
+// Watch ids handed out by the idle monitor, 0 while not watching.
+static guint32 imIdleWatchId = 0;
+static guint32 imActiveWatchId = 0;
+
+static guint64 imIdleTimeoutMs = 0;
+static gboolean imSubtractIdleTime = FALSE;
+
+// Set while a work session is paused because the user went idle, along with its remaining time.
+static gboolean imPausedForIdle = FALSE;
+static guint64 imPausedRemainingMs = 0;
+
+
+/* ============================================================================
+ * Internal Implementation
+ * ============================================================================ */
+
+static void on_idle_watch_added(GObject *source_object, GAsyncResult *result, gpointer user_data)
+{
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GVariant) reply =
+        g_dbus_connection_call_finish(G_DBUS_CONNECTION(source_object), result, &error);
+
+    if (reply == NULL) {
+        if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+            g_warning("Failed to watch for the user going idle: %s", error->message);
+        }
+        return;
+    }
+
+    g_variant_get(reply, "(u)", &imIdleWatchId);
+}
+
+static void on_active_watch_added(GObject *source_object, GAsyncResult *result, gpointer user_data)
+{
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GVariant) reply =
+        g_dbus_connection_call_finish(G_DBUS_CONNECTION(source_object), result, &error);
+
+    if (reply == NULL) {
+        if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+            g_warning("Failed to watch for the user coming back: %s", error->message);
+        }
+        return;
+    }
+
+    g_variant_get(reply, "(u)", &imActiveWatchId);
+}
+
+static void add_idle_watch(void)
+{
+    g_dbus_connection_call(imConnection, IM_BUS_NAME, IM_OBJECT_PATH, IM_INTERFACE, "AddIdleWatch",
+                           g_variant_new("(t)", imIdleTimeoutMs), G_VARIANT_TYPE("(u)"),
+                           G_DBUS_CALL_FLAGS_NONE, -1, imCancellable, on_idle_watch_added, NULL);
+}
+
+// User active watches fire once, on the first input after they were added.
+static void add_active_watch(void)
+{
+    g_dbus_connection_call(imConnection, IM_BUS_NAME, IM_OBJECT_PATH, IM_INTERFACE,
+                           "AddUserActiveWatch", NULL, G_VARIANT_TYPE("(u)"),
+                           G_DBUS_CALL_FLAGS_NONE, -1, imCancellable, on_active_watch_added, NULL);
+}
+
+static void remove_watch(guint32 *watch_id)
+{
+    if (*watch_id == 0) {
+        return;
+    }
+
+    g_dbus_connection_call(imConnection, IM_BUS_NAME, IM_OBJECT_PATH, IM_INTERFACE, "RemoveWatch",
+                           g_variant_new("(u)", *watch_id), NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL,
+                           NULL, NULL);
+    *watch_id = 0;
+}
+
+static void on_user_idle(void)
+{
+    SessionManagerPtr session_manager = sm_get_default();
+    if (session_manager == NULL) {
+        return;
+    }
+
+    TimerPtr timer = session_manager->timer_instance;
+    if (tm_get_state(timer) != StRunning || session_manager->current_routine != Working) {
+        return;
+    }
+
+    tm_trigger_event(timer, EvStop);
+
+    imPausedForIdle = TRUE;
+    imPausedRemainingMs = timer->remaining_time_ms;
+
+    add_active_watch();
+}
+
+static void on_user_active(void)
+{
+    SessionManagerPtr session_manager = sm_get_default();
+    if (!imPausedForIdle || session_manager == NULL) {
+        return;
+    }
+    imPausedForIdle = FALSE;
+
+    // Left alone if the user did something with the session while being counted as idle.
+    TimerPtr timer = session_manager->timer_instance;
+    if (tm_get_state(timer) != StPaused || session_manager->current_routine != Working ||
+        timer->remaining_time_ms != imPausedRemainingMs) {
+        return;
+    }
+
+    // The timer kept running for the whole idle timeout before the session was paused.
+    if (imSubtractIdleTime) {
+        tm_add_time(timer, imIdleTimeoutMs);
+    }
+
+    tm_trigger_event(timer, EvStart);
+}
+
+static void on_watch_fired(GDBusConnection *connection, const gchar *sender_name,
+                           const gchar *object_path, const gchar *interface_name,
+                           const gchar *signal_name, GVariant *parameters, gpointer user_data)
+{
+    guint32 watch_id = 0;
+
+    if (!g_variant_is_of_type(parameters, G_VARIANT_TYPE("(u)"))) {
+        return;
+    }
+    g_variant_get(parameters, "(u)", &watch_id);
+
+    if (watch_id == 0) {
+        return;
+    }
+
+    if (watch_id == imIdleWatchId) {
+        on_user_idle();
+    } else if (watch_id == imActiveWatchId) {
+        imActiveWatchId = 0;
+        on_user_active();
+    }
+}
+
+static void on_name_appeared(GDBusConnection *connection, const gchar *name,
+                             const gchar *name_owner, gpointer user_data)
+{
+    add_idle_watch();
+
+    // The compositor restarted while the session was paused for being idle.
+    if (imPausedForIdle) {
+        add_active_watch();
+    }
+}
+
+// Watches live in the compositor and are gone along with it.
+static void on_name_vanished(GDBusConnection *connection, const gchar *name, gpointer user_data)
+{
+    imIdleWatchId = 0;
+    imActiveWatchId = 0;
+}
+
+
+/* ============================================================================
+ * Public API
+ * ============================================================================ */
+
+void im_enable(GDBusConnection *connection, guint64 idle_timeout_ms, gboolean subtract_idle_time)
+{
+    g_return_if_fail(G_IS_DBUS_CONNECTION(connection));
+
+    im_disable();
+
+    imConnection = g_object_ref(connection);
+    imCancellable = g_cancellable_new();
+    imIdleTimeoutMs = MAX(idle_timeout_ms, 1);
+    imSubtractIdleTime = subtract_idle_time;
+
+    imSignalId = g_dbus_connection_signal_subscribe(
+        imConnection, IM_BUS_NAME, IM_INTERFACE, "WatchFired", IM_OBJECT_PATH, NULL,
+        G_DBUS_SIGNAL_FLAGS_NONE, on_watch_fired, NULL, NULL);
+
+    imNameWatchId =
+        g_bus_watch_name_on_connection(imConnection, IM_BUS_NAME, G_BUS_NAME_WATCHER_FLAGS_NONE,
+                                       on_name_appeared, on_name_vanished, NULL, NULL);
+}
+
+void im_disable(void)
+{
+    if (imConnection == NULL) {
+        return;
+    }
+
+    g_cancellable_cancel(imCancellable);
+    g_clear_object(&imCancellable);
+
+    remove_watch(&imIdleWatchId);
+    remove_watch(&imActiveWatchId);
+
+    g_clear_handle_id(&imNameWatchId, g_bus_unwatch_name);
+    if (imSignalId != 0) {
+        g_dbus_connection_signal_unsubscribe(imConnection, imSignalId);
+        imSignalId = 0;
+    }
+
+    imPausedForIdle = FALSE;
+    g_clear_object(&imConnection);
+}
+
+gboolean im_is_enabled(void)
+{
+    return imConnection != NULL;
+}
+
+void im_set_idle_timeout(guint64 idle_timeout_ms)
+{
+    idle_timeout_ms = MAX(idle_timeout_ms, 1);
+    if (idle_timeout_ms == imIdleTimeoutMs) {
+        return;
+    }
+    imIdleTimeoutMs = idle_timeout_ms;
+
+    if (imConnection != NULL && imIdleWatchId != 0) {
+        remove_watch(&imIdleWatchId);
+        add_idle_watch();
+    }
+}
+
+void im_set_subtract_idle_time(gboolean subtract_idle_time)
+{
+    imSubtractIdleTime = subtract_idle_time;
+}
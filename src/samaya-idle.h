@@ -0,0 +1,53 @@
+/* samaya-idle.h
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+/*  Pauses work sessions while the user is away from the computer.
+
+    The compositor's idle monitor is asked to tell us once there has been no input for the idle
+    timeout, at which point a running work session is stopped, and again on the first input after
+    that, at which point the session is started again. Nothing is polled, both are D-Bus signals.
+
+    Only the GNOME idle monitor (org.gnome.Mutter.IdleMonitor) is supported. When the compositor
+    does not provide it, nothing is paused. When the compositor restarts, the watches are added
+    again as soon as it is back on the bus.
+*/
+
+#define IM_BUS_NAME "org.gnome.Mutter.IdleMonitor"
+#define IM_OBJECT_PATH "/org/gnome/Mutter/IdleMonitor/Core"
+#define IM_INTERFACE "org.gnome.Mutter.IdleMonitor"
+
+/*  Starts following the idle monitor on the given bus, pausing after idle_timeout_ms without
+    input. With subtract_idle_time, the idle timeout that ran before the session was paused is
+    given back to it when it is resumed.
+*/
+void im_enable(GDBusConnection *connection, guint64 idle_timeout_ms, gboolean subtract_idle_time);
+
+// Removes the watches from the idle monitor, a session paused for being idle stays paused.
+void im_disable(void);
+
+gboolean im_is_enabled(void);
+
+void im_set_idle_timeout(guint64 idle_timeout_ms);
+
+void im_set_subtract_idle_time(gboolean subtract_idle_time);
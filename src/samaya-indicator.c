@@ -0,0 +1,448 @@
+/* samaya-indicator.c
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include <gdk/gdk.h>
+#include <glib/gi18n.h>
+#include "samaya-indicator.h"
+#include "samaya-progress-ring.h"
+#include "samaya-session.h"
+#include "samaya-timer.h"
+
+// The ring is drawn at this size and scaled down, so the stroke stays thick enough for a panel.
+#define SI_RING_SIZE 96.0
+
+#define SI_N_ROUTINES 3
+#define SI_FRAME_SIZE (SI_ICON_SIZE * SI_ICON_SIZE * 4)
+
+static const char siIntrospectionXml[] =
+    "<node>"
+    "  <interface name='" SI_INTERFACE "'>"
+    "    <property name='Category' type='s' access='read'/>"
+    "    <property name='Id' type='s' access='read'/>"
+    "    <property name='Title' type='s' access='read'/>"
+    "    <property name='Status' type='s' access='read'/>"
+    "    <property name='IconName' type='s' access='read'/>"
+    "    <property name='IconPixmap' type='a(iiay)' access='read'/>"
+    "    <property name='ToolTip' type='(sa(iiay)ss)' access='read'/>"
+    "    <property name='ItemIsMenu' type='b' access='read'/>"
+    "    <method name='Activate'>"
+    "      <arg name='x' type='i' direction='in'/>"
+    "      <arg name='y' type='i' direction='in'/>"
+    "    </method>"
+    "    <method name='SecondaryActivate'>"
+    "      <arg name='x' type='i' direction='in'/>"
+    "      <arg name='y' type='i' direction='in'/>"
+    "    </method>"
+    "    <method name='ContextMenu'>"
+    "      <arg name='x' type='i' direction='in'/>"
+    "      <arg name='y' type='i' direction='in'/>"
+    "    </method>"
+    "    <method name='Scroll'>"
+    "      <arg name='delta' type='i' direction='in'/>"
+    "      <arg name='orientation' type='s' direction='in'/>"
+    "    </method>"
+    "    <signal name='NewIcon'/>"
+    "    <signal name='NewToolTip'/>"
+    "  </interface>"
+    "</node>";
+
+// Same colours as the .routine-* classes in samaya-style.css, indexed by RoutineType.
+static const GdkRGBA siRoutineColors[SI_N_ROUTINES] = {
+    {0x35 / 255.0f, 0x84 / 255.0f, 0xe4 / 255.0f, 1.0f},
+    {0x33 / 255.0f, 0xd1 / 255.0f, 0x7a / 255.0f, 1.0f},
+    {0xff / 255.0f, 0xa3 / 255.0f, 0x48 / 255.0f, 1.0f},
+};
+
+
+/* ============================================================================
+ * Static Variables
+ * ============================================================================ */
+
+static GDBusConnection *siConnection = NULL;
+static GCancellable *siCancellable = NULL;
+
+static guint siRegistrationId = 0;
+static guint siWatcherWatchId = 0;
+static gboolean siRegistered = FALSE;
+
+static SiCallback siActivate = NULL;
+static SiCallback siSecondaryActivate = NULL;
+static SiCallback siRegistrationChanged = NULL;
+static gpointer siUserData = NULL;
+
+// Every frame of the icon, SI_ATLAS_STEPS + 1 per routine, as ARGB32 in network byte order.
+static GBytes *siAtlas = NULL;
+
+// What the panel was last told about, -1 before it was told anything.
+static gint siIconRoutine = -1;
+static gint siIconStep = -1;
+
+static gint siTooltipRoutine = -1;
+static gint siTooltipState = -1;
+static gint64 siTooltipMinutes = -1;
+
+
+/* ============================================================================
+ * Icon Atlas
+ * ============================================================================ */
+
+// Cairo keeps premultiplied native endian pixels, the item spec wants straight ARGB bytes.
+static void copy_frame(cairo_surface_t *surface, guint8 *frame)
+{
+    const guint8 *data = cairo_image_surface_get_data(surface);
+    int stride = cairo_image_surface_get_stride(surface);
+
+    for (int y = 0; y < SI_ICON_SIZE; y++) {
+        const guint32 *row = (const guint32 *) (data + (gsize) y * stride);
+
+        for (int x = 0; x < SI_ICON_SIZE; x++) {
+            guint32 pixel = row[x];
+            guint alpha = pixel >> 24;
+            guint red = (pixel >> 16) & 0xff;
+            guint green = (pixel >> 8) & 0xff;
+            guint blue = pixel & 0xff;
+
+            if (alpha > 0 && alpha < 0xff) {
+                red = (red * 0xff + alpha / 2) / alpha;
+                green = (green * 0xff + alpha / 2) / alpha;
+                blue = (blue * 0xff + alpha / 2) / alpha;
+            }
+
+            frame[0] = (guint8) alpha;
+            frame[1] = (guint8) red;
+            frame[2] = (guint8) green;
+            frame[3] = (guint8) blue;
+            frame += 4;
+        }
+    }
+}
+
+static GBytes *build_atlas(void)
+{
+    gsize n_frames = SI_N_ROUTINES * (SI_ATLAS_STEPS + 1);
+    guint8 *pixels = g_malloc(n_frames * SI_FRAME_SIZE);
+    guint8 *frame = pixels;
+
+    cairo_surface_t *surface =
+        cairo_image_surface_create(CAIRO_FORMAT_ARGB32, SI_ICON_SIZE, SI_ICON_SIZE);
+
+    for (gint routine = 0; routine < SI_N_ROUTINES; routine++) {
+        for (gint step = 0; step <= SI_ATLAS_STEPS; step++) {
+            cairo_t *cr = cairo_create(surface);
+
+            cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
+            cairo_paint(cr);
+            cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+
+            cairo_scale(cr, SI_ICON_SIZE / SI_RING_SIZE, SI_ICON_SIZE / SI_RING_SIZE);
+            pr_draw_ring(cr, (int) SI_RING_SIZE, (int) SI_RING_SIZE,
+                         (gfloat) step / SI_ATLAS_STEPS, &siRoutineColors[routine]);
+            cairo_destroy(cr);
+
+            cairo_surface_flush(surface);
+            copy_frame(surface, frame);
+            frame += SI_FRAME_SIZE;
+        }
+    }
+
+    cairo_surface_destroy(surface);
+
+    return g_bytes_new_take(pixels, n_frames * SI_FRAME_SIZE);
+}
+
+static gint get_icon_step(gfloat progress)
+{
+    return CLAMP((gint) (progress * SI_ATLAS_STEPS + 0.5f), 0, SI_ATLAS_STEPS);
+}
+
+static GVariant *get_icon_pixmap(void)
+{
+    gint routine = CLAMP(siIconRoutine, 0, SI_N_ROUTINES - 1);
+    gint step = CLAMP(siIconStep, 0, SI_ATLAS_STEPS);
+    gsize offset = (gsize) (routine * (SI_ATLAS_STEPS + 1) + step) * SI_FRAME_SIZE;
+
+    g_autoptr(GBytes) frame = g_bytes_new_from_bytes(siAtlas, offset, SI_FRAME_SIZE);
+    GVariant *pixmap = g_variant_new("(ii@ay)", SI_ICON_SIZE, SI_ICON_SIZE,
+                                     g_variant_new_from_bytes(G_VARIANT_TYPE_BYTESTRING, frame,
+                                                              TRUE));
+
+    return g_variant_new_array(G_VARIANT_TYPE("(iiay)"), &pixmap, 1);
+}
+
+
+/* ============================================================================
+ * Tooltip
+ * ============================================================================ */
+
+static const char *get_routine_name(gint routine)
+{
+    switch (routine) {
+        case ShortBreak:
+            return _("Short Break");
+        case LongBreak:
+            return _("Long Break");
+        case Working:
+        default:
+            return _("Pomodoro");
+    }
+}
+
+static GVariant *get_tooltip(void)
+{
+    const char *routine_name = get_routine_name(siTooltipRoutine);
+    gint minutes = (gint) siTooltipMinutes;
+    g_autofree gchar *description = NULL;
+
+    switch (siTooltipState) {
+        case StRunning:
+            description = g_strdup_printf(
+                ngettext("%s, %d minute left", "%s, %d minutes left", minutes), routine_name,
+                minutes);
+            break;
+        case StPaused:
+            description = g_strdup_printf(
+                ngettext("%s, paused with %d minute left", "%s, paused with %d minutes left",
+                         minutes),
+                routine_name, minutes);
+            break;
+        default:
+            description = g_strdup_printf(_("%s, not started"), routine_name);
+            break;
+    }
+
+    GVariant *no_pixmaps = g_variant_new_array(G_VARIANT_TYPE("(iiay)"), NULL, 0);
+
+    return g_variant_new("(s@a(iiay)ss)", "", no_pixmaps, _("Samaya"), description);
+}
+
+
+/* ============================================================================
+ * Status Notifier Item
+ * ============================================================================ */
+
+static void emit_signal(const char *signal_name)
+{
+    g_autoptr(GError) error = NULL;
+
+    if (!siRegistered) {
+        return;
+    }
+
+    if (!g_dbus_connection_emit_signal(siConnection, NULL, SI_OBJECT_PATH, SI_INTERFACE,
+                                       signal_name, NULL, &error)) {
+        g_warning("Failed to update the indicator: %s", error->message);
+    }
+}
+
+static void on_method_call(GDBusConnection *connection, const gchar *sender,
+                           const gchar *object_path, const gchar *interface_name,
+                           const gchar *method_name, GVariant *parameters,
+                           GDBusMethodInvocation *invocation, gpointer user_data)
+{
+    // There is no menu, so a right click shows the window like a left one.
+    if (g_strcmp0(method_name, "Activate") == 0 || g_strcmp0(method_name, "ContextMenu") == 0) {
+        if (siActivate) {
+            siActivate(siUserData);
+        }
+    } else if (g_strcmp0(method_name, "SecondaryActivate") == 0) {
+        if (siSecondaryActivate) {
+            siSecondaryActivate(siUserData);
+        }
+    }
+
+    g_dbus_method_invocation_return_value(invocation, NULL);
+}
+
+static GVariant *on_get_property(GDBusConnection *connection, const gchar *sender,
+                                 const gchar *object_path, const gchar *interface_name,
+                                 const gchar *property_name, GError **error, gpointer user_data)
+{
+    if (g_strcmp0(property_name, "Category") == 0) {
+        return g_variant_new_string("ApplicationStatus");
+    } else if (g_strcmp0(property_name, "Id") == 0) {
+        return g_variant_new_string("samaya");
+    } else if (g_strcmp0(property_name, "Title") == 0) {
+        return g_variant_new_string(_("Samaya"));
+    } else if (g_strcmp0(property_name, "Status") == 0) {
+        return g_variant_new_string("Active");
+    } else if (g_strcmp0(property_name, "IconName") == 0) {
+        // Left empty, panels prefer an icon name over the pixmap.
+        return g_variant_new_string("");
+    } else if (g_strcmp0(property_name, "IconPixmap") == 0) {
+        return get_icon_pixmap();
+    } else if (g_strcmp0(property_name, "ToolTip") == 0) {
+        return get_tooltip();
+    } else if (g_strcmp0(property_name, "ItemIsMenu") == 0) {
+        return g_variant_new_boolean(FALSE);
+    }
+
+    g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_PROPERTY, "Unknown property %s",
+                property_name);
+    return NULL;
+}
+
+static const GDBusInterfaceVTable siVTable = {
+    .method_call = on_method_call,
+    .get_property = on_get_property,
+};
+
+static void set_registered(gboolean registered)
+{
+    if (siRegistered == registered) {
+        return;
+    }
+    siRegistered = registered;
+
+    if (siRegistrationChanged) {
+        siRegistrationChanged(siUserData);
+    }
+}
+
+static void on_item_registered(GObject *source_object, GAsyncResult *result, gpointer user_data)
+{
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GVariant) reply =
+        g_dbus_connection_call_finish(G_DBUS_CONNECTION(source_object), result, &error);
+
+    if (reply == NULL) {
+        if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+            g_warning("Failed to register the indicator: %s", error->message);
+        }
+        return;
+    }
+
+    set_registered(TRUE);
+}
+
+static void on_watcher_appeared(GDBusConnection *connection, const gchar *name,
+                                const gchar *name_owner, gpointer user_data)
+{
+    // The watcher finds the item at SI_OBJECT_PATH when given just our bus name.
+    g_dbus_connection_call(connection, SI_WATCHER_BUS_NAME, SI_WATCHER_OBJECT_PATH,
+                           SI_WATCHER_INTERFACE, "RegisterStatusNotifierItem",
+                           g_variant_new("(s)", g_dbus_connection_get_unique_name(connection)),
+                           NULL, G_DBUS_CALL_FLAGS_NONE, -1, siCancellable, on_item_registered,
+                           NULL);
+}
+
+static void on_watcher_vanished(GDBusConnection *connection, const gchar *name,
+                                gpointer user_data)
+{
+    set_registered(FALSE);
+}
+
+
+/* ============================================================================
+ * Public API
+ * ============================================================================ */
+
+void si_enable(GDBusConnection *connection, SiCallback activate, SiCallback secondary_activate,
+               SiCallback registration_changed, gpointer user_data)
+{
+    g_autoptr(GError) error = NULL;
+
+    g_return_if_fail(G_IS_DBUS_CONNECTION(connection));
+
+    si_disable();
+
+    g_autoptr(GDBusNodeInfo) node_info = g_dbus_node_info_new_for_xml(siIntrospectionXml, &error);
+    g_assert_no_error(error);
+
+    siRegistrationId = g_dbus_connection_register_object(
+        connection, SI_OBJECT_PATH, node_info->interfaces[0], &siVTable, NULL, NULL, &error);
+    if (siRegistrationId == 0) {
+        g_warning("Failed to export the indicator: %s", error->message);
+        return;
+    }
+
+    siConnection = g_object_ref(connection);
+    siCancellable = g_cancellable_new();
+    siActivate = activate;
+    siSecondaryActivate = secondary_activate;
+    siRegistrationChanged = registration_changed;
+    siUserData = user_data;
+
+    siAtlas = build_atlas();
+    si_update();
+
+    siWatcherWatchId = g_bus_watch_name_on_connection(
+        siConnection, SI_WATCHER_BUS_NAME, G_BUS_NAME_WATCHER_FLAGS_NONE, on_watcher_appeared,
+        on_watcher_vanished, NULL, NULL);
+}
+
+void si_disable(void)
+{
+    if (siConnection == NULL) {
+        return;
+    }
+
+    g_cancellable_cancel(siCancellable);
+    g_clear_object(&siCancellable);
+
+    g_clear_handle_id(&siWatcherWatchId, g_bus_unwatch_name);
+    g_dbus_connection_unregister_object(siConnection, siRegistrationId);
+    siRegistrationId = 0;
+    siRegistered = FALSE;
+
+    siActivate = NULL;
+    siSecondaryActivate = NULL;
+    siRegistrationChanged = NULL;
+    siUserData = NULL;
+
+    g_clear_pointer(&siAtlas, g_bytes_unref);
+    siIconRoutine = siIconStep = -1;
+    siTooltipRoutine = siTooltipState = -1;
+    siTooltipMinutes = -1;
+
+    g_clear_object(&siConnection);
+}
+
+gboolean si_is_registered(void)
+{
+    return siRegistered;
+}
+
+void si_update(void)
+{
+    SessionManagerPtr session_manager = sm_get_default();
+    if (siConnection == NULL || session_manager == NULL) {
+        return;
+    }
+
+    TimerPtr timer = session_manager->timer_instance;
+    gint routine = CLAMP((gint) session_manager->current_routine, 0, SI_N_ROUTINES - 1);
+    gint step = get_icon_step(tm_get_progress(timer));
+
+    if (routine != siIconRoutine || step != siIconStep) {
+        siIconRoutine = routine;
+        siIconStep = step;
+        emit_signal("NewIcon");
+    }
+
+    gint state = tm_get_state(timer);
+    gint64 minutes = (tm_get_remaining_time_ms(timer) + 59999) / 60000;
+
+    if (routine != siTooltipRoutine || state != siTooltipState || minutes != siTooltipMinutes) {
+        siTooltipRoutine = routine;
+        siTooltipState = state;
+        siTooltipMinutes = minutes;
+        emit_signal("NewToolTip");
+    }
+}
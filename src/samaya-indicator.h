@@ -0,0 +1,68 @@
+/* samaya-indicator.h
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+/*  Shows the timer in the panel, as a StatusNotifierItem.
+
+    The icon is the progress ring in the colour of the current routine. Every ring it can show is
+    drawn once when the indicator is enabled, into an atlas of SI_ATLAS_STEPS + 1 frames per
+    routine, so an update only ever hands out a slice of it. The panel is only told about a new
+    icon when the ring moved on to the next step, and about a new tooltip when the minute left in
+    it changed, a few dozen updates per session instead of one every second.
+
+    The item is registered with the StatusNotifierWatcher whenever one is on the bus, so it comes
+    back on its own when the panel restarts.
+*/
+
+#define SI_OBJECT_PATH "/StatusNotifierItem"
+#define SI_INTERFACE "org.kde.StatusNotifierItem"
+
+#define SI_WATCHER_BUS_NAME "org.kde.StatusNotifierWatcher"
+#define SI_WATCHER_OBJECT_PATH "/StatusNotifierWatcher"
+#define SI_WATCHER_INTERFACE "org.kde.StatusNotifierWatcher"
+
+// Edge of the icon in pixels.
+#define SI_ICON_SIZE 32
+
+// Number of steps the ring moves through over a session.
+#define SI_ATLAS_STEPS 24
+
+typedef void (*SiCallback)(gpointer user_data);
+
+/*  Exports the indicator on the given bus and registers it with the watcher once there is one.
+
+    activate is called when the item is clicked, secondary_activate when it is middle clicked and
+    registration_changed whenever the item got registered with a watcher or lost it.
+*/
+void si_enable(GDBusConnection *connection, SiCallback activate, SiCallback secondary_activate,
+               SiCallback registration_changed, gpointer user_data);
+
+void si_disable(void);
+
+// Whether a panel is showing the indicator right now.
+gboolean si_is_registered(void);
+
+/*  Brings the indicator in line with the current session. Cheap when nothing the indicator shows
+    changed, so it is fine to call on every tick.
+*/
+void si_update(void);
@@ -0,0 +1,257 @@
+/* samaya-low-power.c
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "samaya-low-power.h"
+
+
+typedef enum
+{
+    LpActiveProfile,
+    LpOnBattery,
+} LpProperty;
+
+
+/* ============================================================================
+ * Static Variables
+ * ============================================================================ */
+
+static GDBusConnection *lpConnection = NULL;
+static GCancellable *lpCancellable = NULL;
+
+static guint lpProfilesWatchId = 0;
+static guint lpProfilesSignalId = 0;
+static guint lpUPowerWatchId = 0;
+static guint lpUPowerSignalId = 0;
+
+static gboolean lpPowerSaver = FALSE;
+static gboolean lpOnBattery = FALSE;
+static gboolean lpLowPower = FALSE;
+
+static LpChangedFunc lpChanged = NULL;
+static gpointer lpUserData = NULL;
+
+
+/* ============================================================================
+ * Internal Implementation
+ * ============================================================================ */
+
+static void update_low_power(void)
+{
+    gboolean low_power = lpPowerSaver || lpOnBattery;
+    if (low_power == lpLowPower) {
+        return;
+    }
+    lpLowPower = low_power;
+
+    if (lpChanged != NULL) {
+        lpChanged(low_power, lpUserData);
+    }
+}
+
+static void set_active_profile(GVariant *value)
+{
+    if (g_variant_is_of_type(value, G_VARIANT_TYPE_STRING)) {
+        lpPowerSaver = g_strcmp0(g_variant_get_string(value, NULL), "power-saver") == 0;
+    }
+}
+
+static void set_on_battery(GVariant *value)
+{
+    if (g_variant_is_of_type(value, G_VARIANT_TYPE_BOOLEAN)) {
+        lpOnBattery = g_variant_get_boolean(value);
+    }
+}
+
+static void on_properties_changed(GDBusConnection *connection, const gchar *sender_name,
+                                  const gchar *object_path, const gchar *interface_name,
+                                  const gchar *signal_name, GVariant *parameters,
+                                  gpointer user_data)
+{
+    const gchar *changed_interface = NULL;
+    g_autoptr(GVariant) changed = NULL;
+
+    if (!g_variant_is_of_type(parameters, G_VARIANT_TYPE("(sa{sv}as)"))) {
+        return;
+    }
+    g_variant_get(parameters, "(&s@a{sv}@as)", &changed_interface, &changed, NULL);
+
+    g_autoptr(GVariant) value = NULL;
+
+    if (g_strcmp0(changed_interface, LP_PROFILES_INTERFACE) == 0) {
+        value = g_variant_lookup_value(changed, "ActiveProfile", NULL);
+        if (value != NULL) {
+            set_active_profile(value);
+        }
+    } else if (g_strcmp0(changed_interface, LP_UPOWER_INTERFACE) == 0) {
+        value = g_variant_lookup_value(changed, "OnBattery", NULL);
+        if (value != NULL) {
+            set_on_battery(value);
+        }
+    }
+
+    update_low_power();
+}
+
+// The user data is the LpProperty that was read.
+static void on_property_read(GObject *source_object, GAsyncResult *result, gpointer user_data)
+{
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GVariant) reply =
+        g_dbus_connection_call_finish(G_DBUS_CONNECTION(source_object), result, &error);
+
+    if (reply == NULL) {
+        if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+            g_warning("Failed to read the power state: %s", error->message);
+        }
+        return;
+    }
+
+    g_autoptr(GVariant) value = NULL;
+    g_variant_get(reply, "(v)", &value);
+
+    switch ((LpProperty) GPOINTER_TO_INT(user_data)) {
+        case LpActiveProfile:
+            set_active_profile(value);
+            break;
+        case LpOnBattery:
+            set_on_battery(value);
+            break;
+        default:
+            break;
+    }
+
+    update_low_power();
+}
+
+static void read_property(const gchar *bus_name, const gchar *object_path,
+                          const gchar *interface_name, const gchar *property_name,
+                          LpProperty property)
+{
+    g_dbus_connection_call(lpConnection, bus_name, object_path, "org.freedesktop.DBus.Properties",
+                           "Get", g_variant_new("(ss)", interface_name, property_name),
+                           G_VARIANT_TYPE("(v)"), G_DBUS_CALL_FLAGS_NONE, -1, lpCancellable,
+                           on_property_read, GINT_TO_POINTER(property));
+}
+
+static void on_profiles_appeared(GDBusConnection *connection, const gchar *name,
+                                 const gchar *name_owner, gpointer user_data)
+{
+    read_property(LP_PROFILES_BUS_NAME, LP_PROFILES_OBJECT_PATH, LP_PROFILES_INTERFACE,
+                  "ActiveProfile", LpActiveProfile);
+}
+
+static void on_profiles_vanished(GDBusConnection *connection, const gchar *name,
+                                 gpointer user_data)
+{
+    lpPowerSaver = FALSE;
+    update_low_power();
+}
+
+static void on_upower_appeared(GDBusConnection *connection, const gchar *name,
+                               const gchar *name_owner, gpointer user_data)
+{
+    read_property(LP_UPOWER_BUS_NAME, LP_UPOWER_OBJECT_PATH, LP_UPOWER_INTERFACE, "OnBattery",
+                  LpOnBattery);
+}
+
+static void on_upower_vanished(GDBusConnection *connection, const gchar *name, gpointer user_data)
+{
+    lpOnBattery = FALSE;
+    update_low_power();
+}
+
+static guint subscribe_properties(const gchar *bus_name, const gchar *object_path,
+                                  const gchar *interface_name)
+{
+    return g_dbus_connection_signal_subscribe(
+        lpConnection, bus_name, "org.freedesktop.DBus.Properties", "PropertiesChanged",
+        object_path, interface_name, G_DBUS_SIGNAL_FLAGS_NONE, on_properties_changed, NULL, NULL);
+}
+
+static void unsubscribe(guint *signal_id)
+{
+    if (*signal_id != 0) {
+        g_dbus_connection_signal_unsubscribe(lpConnection, *signal_id);
+        *signal_id = 0;
+    }
+}
+
+
+/* ============================================================================
+ * Public API
+ * ============================================================================ */
+
+void lp_enable(GDBusConnection *connection, LpChangedFunc changed, gpointer user_data)
+{
+    g_return_if_fail(G_IS_DBUS_CONNECTION(connection));
+
+    lp_disable();
+
+    lpConnection = g_object_ref(connection);
+    lpCancellable = g_cancellable_new();
+    lpChanged = changed;
+    lpUserData = user_data;
+
+    lpProfilesSignalId =
+        subscribe_properties(LP_PROFILES_BUS_NAME, LP_PROFILES_OBJECT_PATH, LP_PROFILES_INTERFACE);
+    lpUPowerSignalId =
+        subscribe_properties(LP_UPOWER_BUS_NAME, LP_UPOWER_OBJECT_PATH, LP_UPOWER_INTERFACE);
+
+    lpProfilesWatchId = g_bus_watch_name_on_connection(
+        lpConnection, LP_PROFILES_BUS_NAME, G_BUS_NAME_WATCHER_FLAGS_NONE, on_profiles_appeared,
+        on_profiles_vanished, NULL, NULL);
+    lpUPowerWatchId = g_bus_watch_name_on_connection(
+        lpConnection, LP_UPOWER_BUS_NAME, G_BUS_NAME_WATCHER_FLAGS_NONE, on_upower_appeared,
+        on_upower_vanished, NULL, NULL);
+}
+
+void lp_disable(void)
+{
+    if (lpConnection == NULL) {
+        return;
+    }
+
+    g_cancellable_cancel(lpCancellable);
+    g_clear_object(&lpCancellable);
+
+    g_clear_handle_id(&lpProfilesWatchId, g_bus_unwatch_name);
+    g_clear_handle_id(&lpUPowerWatchId, g_bus_unwatch_name);
+    unsubscribe(&lpProfilesSignalId);
+    unsubscribe(&lpUPowerSignalId);
+
+    // Told about leaving low power mode as well, whoever followed it should not get stuck there.
+    lpPowerSaver = FALSE;
+    lpOnBattery = FALSE;
+    update_low_power();
+
+    lpChanged = NULL;
+    lpUserData = NULL;
+    g_clear_object(&lpConnection);
+}
+
+gboolean lp_is_enabled(void)
+{
+    return lpConnection != NULL;
+}
+
+gboolean lp_is_low_power(void)
+{
+    return lpLowPower;
+}
@@ -0,0 +1,52 @@
+/* samaya-low-power.h
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+/*  Tells when the system would rather save power, which is while it runs on battery or while the
+    power-saver profile is active.
+
+    Both are properties on the system bus, ActiveProfile of power-profiles-daemon and OnBattery of
+    UPower. They are read once either service appears and then followed through PropertiesChanged,
+    nothing is polled. A service that is not running counts as not asking to save power.
+*/
+
+#define LP_PROFILES_BUS_NAME "net.hadess.PowerProfiles"
+#define LP_PROFILES_OBJECT_PATH "/net/hadess/PowerProfiles"
+#define LP_PROFILES_INTERFACE "net.hadess.PowerProfiles"
+
+#define LP_UPOWER_BUS_NAME "org.freedesktop.UPower"
+#define LP_UPOWER_OBJECT_PATH "/org/freedesktop/UPower"
+#define LP_UPOWER_INTERFACE "org.freedesktop.UPower"
+
+// Called whenever the system starts or stops asking to save power.
+typedef void (*LpChangedFunc)(gboolean low_power, gpointer user_data);
+
+// Starts following both services on the given bus, which is the system bus outside of tests.
+void lp_enable(GDBusConnection *connection, LpChangedFunc changed, gpointer user_data);
+
+// Stops following them, the system then no longer counts as asking to save power.
+void lp_disable(void);
+
+gboolean lp_is_enabled(void);
+
+gboolean lp_is_low_power(void);
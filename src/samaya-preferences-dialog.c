@@ -20,6 +20,7 @@
 
 #include "samaya-preferences-dialog.h"
 #include <glib/gi18n.h>
+#include "samaya-idle.h"
 #include "samaya-session.h"
 
 struct _SamayaPreferencesDialog
@@ -31,9 +32,17 @@ struct _SamayaPreferencesDialog
     AdwSpinRow *long_break_row;
 
     AdwSpinRow *sessions_count_row;
+    AdwSpinRow *day_end_row;
 
     AdwSwitchRow *auto_start_breaks_row;
     AdwSwitchRow *auto_start_work_row;
+
+    AdwSwitchRow *show_tenths_row;
+    AdwSwitchRow *count_suspended_time_row;
+
+    AdwSwitchRow *pause_when_idle_row;
+    AdwSpinRow *idle_timeout_row;
+    AdwSwitchRow *subtract_idle_time_row;
 };
 
 G_DEFINE_FINAL_TYPE(SamayaPreferencesDialog, samaya_preferences_dialog, ADW_TYPE_PREFERENCES_DIALOG)
@@ -96,6 +105,14 @@ static void on_sessions_count_changed(AdwSpinRow *row, GParamSpec *pspec, gpoint
     }
 }
 
+// Only the window's plan reads it, straight from GSettings.
+static void on_day_end_changed(AdwSpinRow *row, GParamSpec *pspec, gpointer user_data)
+{
+    GSettings *settings = g_settings_new("io.github.redddfoxxyy.samaya");
+    g_settings_set_double(settings, "day-end-hour", adw_spin_row_get_value(row));
+    g_object_unref(settings);
+}
+
 static void on_auto_start_breaks_changed(AdwSwitchRow *row, GParamSpec *pspec, gpointer user_data)
 {
     SessionManagerPtr session_manager = sm_get_default();
@@ -122,6 +139,108 @@ static void on_auto_start_work_changed(AdwSwitchRow *row, GParamSpec *pspec, gpo
     }
 }
 
+// Only the window's clock reads it, straight from GSettings.
+static void on_show_tenths_changed(AdwSwitchRow *row, GParamSpec *pspec, gpointer user_data)
+{
+    GSettings *settings = g_settings_new("io.github.redddfoxxyy.samaya");
+    g_settings_set_boolean(settings, "show-tenths", adw_switch_row_get_active(row));
+    g_object_unref(settings);
+}
+
+static void on_count_suspended_time_changed(AdwSwitchRow *row, GParamSpec *pspec,
+                                            gpointer user_data)
+{
+    SessionManagerPtr session_manager = sm_get_default();
+    gboolean val = adw_switch_row_get_active(row);
+
+    if (session_manager) {
+        sm_set_count_suspended_time(session_manager, val);
+    }
+
+    GSettings *settings = g_settings_new("io.github.redddfoxxyy.samaya");
+    g_settings_set_boolean(settings, "count-suspended-time", val);
+    g_object_unref(settings);
+}
+
+static void on_pause_when_idle_changed(AdwSwitchRow *row, GParamSpec *pspec, gpointer user_data)
+{
+    gboolean val = adw_switch_row_get_active(row);
+
+    GSettings *settings = g_settings_new("io.github.redddfoxxyy.samaya");
+    g_settings_set_boolean(settings, "pause-when-idle", val);
+
+    GDBusConnection *connection = g_application_get_dbus_connection(g_application_get_default());
+    if (val && connection != NULL) {
+        im_enable(connection, g_settings_get_double(settings, "idle-timeout") * 60 * 1000,
+                  g_settings_get_boolean(settings, "subtract-idle-time"));
+    } else {
+        im_disable();
+    }
+    g_object_unref(settings);
+}
+
+static void on_idle_timeout_changed(AdwSpinRow *row, GParamSpec *pspec, gpointer user_data)
+{
+    gdouble val = adw_spin_row_get_value(row);
+    im_set_idle_timeout((guint64) (val * 60 * 1000));
+
+    GSettings *settings = g_settings_new("io.github.redddfoxxyy.samaya");
+    g_settings_set_double(settings, "idle-timeout", val);
+    g_object_unref(settings);
+}
+
+static void on_subtract_idle_time_changed(AdwSwitchRow *row, GParamSpec *pspec,
+                                          gpointer user_data)
+{
+    gboolean val = adw_switch_row_get_active(row);
+    im_set_subtract_idle_time(val);
+
+    GSettings *settings = g_settings_new("io.github.redddfoxxyy.samaya");
+    g_settings_set_boolean(settings, "subtract-idle-time", val);
+    g_object_unref(settings);
+}
+
+// Idle detection, the clock, the day plan and the clock the timer counts with are not kept by the
+// session manager, their settings are read back from GSettings.
+static void set_initial_settings_values(SamayaPreferencesDialog *self)
+{
+    GSettings *settings = g_settings_new("io.github.redddfoxxyy.samaya");
+
+    g_signal_handlers_block_by_func(self->pause_when_idle_row, on_pause_when_idle_changed, self);
+    adw_switch_row_set_active(self->pause_when_idle_row,
+                              g_settings_get_boolean(settings, "pause-when-idle"));
+    g_signal_handlers_unblock_by_func(self->pause_when_idle_row, on_pause_when_idle_changed, self);
+
+    g_signal_handlers_block_by_func(self->idle_timeout_row, on_idle_timeout_changed, self);
+    adw_spin_row_set_value(self->idle_timeout_row, g_settings_get_double(settings, "idle-timeout"));
+    g_signal_handlers_unblock_by_func(self->idle_timeout_row, on_idle_timeout_changed, self);
+
+    g_signal_handlers_block_by_func(self->show_tenths_row, on_show_tenths_changed, self);
+    adw_switch_row_set_active(self->show_tenths_row,
+                              g_settings_get_boolean(settings, "show-tenths"));
+    g_signal_handlers_unblock_by_func(self->show_tenths_row, on_show_tenths_changed, self);
+
+    g_signal_handlers_block_by_func(self->count_suspended_time_row,
+                                    on_count_suspended_time_changed, self);
+    adw_switch_row_set_active(self->count_suspended_time_row,
+                              g_settings_get_boolean(settings, "count-suspended-time"));
+    g_signal_handlers_unblock_by_func(self->count_suspended_time_row,
+                                      on_count_suspended_time_changed, self);
+
+    g_signal_handlers_block_by_func(self->day_end_row, on_day_end_changed, self);
+    adw_spin_row_set_value(self->day_end_row, g_settings_get_double(settings, "day-end-hour"));
+    g_signal_handlers_unblock_by_func(self->day_end_row, on_day_end_changed, self);
+
+    g_signal_handlers_block_by_func(self->subtract_idle_time_row, on_subtract_idle_time_changed,
+                                    self);
+    adw_switch_row_set_active(self->subtract_idle_time_row,
+                              g_settings_get_boolean(settings, "subtract-idle-time"));
+    g_signal_handlers_unblock_by_func(self->subtract_idle_time_row, on_subtract_idle_time_changed,
+                                      self);
+
+    g_object_unref(settings);
+}
+
 static void set_initial_preference_values(SessionManagerPtr session_manager,
                                           SamayaPreferencesDialog *self)
 {
@@ -176,17 +295,32 @@ static void samaya_preferences_dialog_class_init(SamayaPreferencesDialogClass *k
     gtk_widget_class_bind_template_child(widget_class, SamayaPreferencesDialog, short_break_row);
     gtk_widget_class_bind_template_child(widget_class, SamayaPreferencesDialog, long_break_row);
     gtk_widget_class_bind_template_child(widget_class, SamayaPreferencesDialog, sessions_count_row);
+    gtk_widget_class_bind_template_child(widget_class, SamayaPreferencesDialog, day_end_row);
     gtk_widget_class_bind_template_child(widget_class, SamayaPreferencesDialog,
                                          auto_start_breaks_row);
     gtk_widget_class_bind_template_child(widget_class, SamayaPreferencesDialog,
                                          auto_start_work_row);
+    gtk_widget_class_bind_template_child(widget_class, SamayaPreferencesDialog, show_tenths_row);
+    gtk_widget_class_bind_template_child(widget_class, SamayaPreferencesDialog,
+                                         count_suspended_time_row);
+    gtk_widget_class_bind_template_child(widget_class, SamayaPreferencesDialog,
+                                         pause_when_idle_row);
+    gtk_widget_class_bind_template_child(widget_class, SamayaPreferencesDialog, idle_timeout_row);
+    gtk_widget_class_bind_template_child(widget_class, SamayaPreferencesDialog,
+                                         subtract_idle_time_row);
 
     gtk_widget_class_bind_template_callback(widget_class, on_work_duration_changed);
     gtk_widget_class_bind_template_callback(widget_class, on_short_break_changed);
     gtk_widget_class_bind_template_callback(widget_class, on_long_break_changed);
     gtk_widget_class_bind_template_callback(widget_class, on_sessions_count_changed);
+    gtk_widget_class_bind_template_callback(widget_class, on_day_end_changed);
     gtk_widget_class_bind_template_callback(widget_class, on_auto_start_breaks_changed);
     gtk_widget_class_bind_template_callback(widget_class, on_auto_start_work_changed);
+    gtk_widget_class_bind_template_callback(widget_class, on_show_tenths_changed);
+    gtk_widget_class_bind_template_callback(widget_class, on_count_suspended_time_changed);
+    gtk_widget_class_bind_template_callback(widget_class, on_pause_when_idle_changed);
+    gtk_widget_class_bind_template_callback(widget_class, on_idle_timeout_changed);
+    gtk_widget_class_bind_template_callback(widget_class, on_subtract_idle_time_changed);
 }
 
 static void samaya_preferences_dialog_init(SamayaPreferencesDialog *self)
@@ -196,6 +330,7 @@ static void samaya_preferences_dialog_init(SamayaPreferencesDialog *self)
     SessionManagerPtr session_manager = sm_get_default();
 
     set_initial_preference_values(session_manager, self);
+    set_initial_settings_values(self);
 }
 
 SamayaPreferencesDialog *samaya_preferences_dialog_new(void)
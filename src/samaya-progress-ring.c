@@ -0,0 +1,44 @@
+/* samaya-progress-ring.c
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include <math.h>
+#include "samaya-progress-ring.h"
+
+void pr_draw_ring(cairo_t *cr, int width, int height, gfloat progress, const GdkRGBA *color)
+{
+    double center_x = width / 2.0;
+    double center_y = height / 2.0;
+    double radius = MIN(width, height) / 2.0 - PR_LINE_WIDTH;
+
+    cairo_set_line_width(cr, PR_LINE_WIDTH);
+    cairo_set_line_cap(cr, CAIRO_LINE_CAP_ROUND);
+
+    cairo_set_source_rgba(cr, color->red, color->green, color->blue, 0.2);
+    cairo_arc(cr, center_x, center_y, radius, 0, 2 * M_PI);
+    cairo_stroke(cr);
+
+
+    gdk_cairo_set_source_rgba(cr, color);
+
+    double start_angle = -M_PI / 2;
+    double end_angle = start_angle + (2 * M_PI * progress);
+    cairo_arc(cr, center_x, center_y, radius, start_angle, end_angle);
+    cairo_stroke(cr);
+}
@@ -0,0 +1,33 @@
+/* samaya-progress-ring.h
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gdk/gdk.h>
+
+// Width of the ring stroke in logical pixels.
+#define PR_LINE_WIDTH 10.0
+
+/*  Draws the progress ring into the given cairo context.
+
+    The ring is centered in the width x height area, the track is drawn with the given color at a
+    low alpha and the arc covers the given progress (1 means a full ring, 0 an empty one).
+*/
+void pr_draw_ring(cairo_t *cr, int width, int height, gfloat progress, const GdkRGBA *color);
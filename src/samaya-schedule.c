@@ -0,0 +1,540 @@
+/* samaya-schedule.c
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include <errno.h>
+#include <glib-unix.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+#include "samaya-schedule.h"
+
+#define ALL_DAYS 0x7f
+#define WEEK_WORDS ((SC_MINUTES_PER_WEEK + 63) / 64)
+
+static const char *const dayNames[] = {
+    "monday", "tuesday", "wednesday", "thursday", "friday", "saturday", "sunday",
+};
+
+
+/* ============================================================================
+ * Static Variables
+ * ============================================================================ */
+
+// Bit n is set when some rule starts a session n minutes into the week, counted from Monday.
+static guint64 scMinutes[WEEK_WORDS] = {0};
+static gboolean scHasRules = FALSE;
+
+static gboolean scEnabled = FALSE;
+static ScTriggerFunc scTrigger = NULL;
+static gpointer scUserData = NULL;
+
+static gint scTimerFd = -1;
+static guint scTimerSourceId = 0;
+static guint scFallbackId = 0;
+static GFileMonitor *scZoneMonitor = NULL;
+
+static gint64 scArmedRealUs = 0;
+
+// Two weeks of wall clock time without a change of the UTC offset, from a local Monday 00:00.
+static time_t scSpanStart = 0;
+static time_t scSpanEnd = 0;
+
+
+/* ============================================================================
+ * Rule Parsing
+ * ============================================================================ */
+
+static gboolean parse_day(const char *name, guint *day)
+{
+    gsize length = strlen(name);
+    if (length < 3) {
+        return FALSE;
+    }
+
+    for (guint i = 0; i < G_N_ELEMENTS(dayNames); i++) {
+        if (length <= strlen(dayNames[i]) && g_ascii_strncasecmp(name, dayNames[i], length) == 0) {
+            *day = i;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static gboolean parse_days(const char *text, guint8 *weekdays, GError **error)
+{
+    if (g_ascii_strcasecmp(text, "daily") == 0) {
+        *weekdays = ALL_DAYS;
+        return TRUE;
+    }
+    if (g_ascii_strcasecmp(text, "weekdays") == 0) {
+        *weekdays = 0x1f;
+        return TRUE;
+    }
+    if (g_ascii_strcasecmp(text, "weekends") == 0) {
+        *weekdays = 0x60;
+        return TRUE;
+    }
+
+    g_auto(GStrv) items = g_strsplit(text, ",", -1);
+    *weekdays = 0;
+
+    for (guint i = 0; items[i] != NULL; i++) {
+        g_auto(GStrv) range = g_strsplit(items[i], "-", 2);
+        guint first = 0;
+        guint last = 0;
+
+        if (!parse_day(range[0], &first) || (range[1] != NULL && !parse_day(range[1], &last))) {
+            g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "Unknown days “%s”",
+                        items[i]);
+            return FALSE;
+        }
+        if (range[1] == NULL) {
+            last = first;
+        }
+
+        // Ranges may wrap around the end of the week, like fri-mon.
+        for (guint day = first;; day = (day + 1) % 7) {
+            *weekdays |= 1 << day;
+            if (day == last) {
+                break;
+            }
+        }
+    }
+
+    return TRUE;
+}
+
+// Takes H:MM or HH:MM, and 24:00 as the end of a window.
+static gboolean parse_time(const char *text, guint16 *minute_of_day, GError **error)
+{
+    guint hours = 0;
+    guint minutes = 0;
+    gint consumed = 0;
+
+    if (sscanf(text, "%2u:%2u%n", &hours, &minutes, &consumed) != 2 || text[consumed] != '\0' ||
+        minutes > 59 || hours * 60 + minutes > SC_MINUTES_PER_DAY) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "Invalid time “%s”", text);
+        return FALSE;
+    }
+
+    *minute_of_day = (guint16) (hours * 60 + minutes);
+    return TRUE;
+}
+
+static gboolean parse_every(const char *text, guint16 *every_minutes, GError **error)
+{
+    gchar *end = NULL;
+    guint64 minutes = g_ascii_strtoull(text, &end, 10);
+
+    if (end == text || (*end != '\0' && g_strcmp0(end, "m") != 0 && g_strcmp0(end, "min") != 0) ||
+        minutes == 0 || minutes > SC_MINUTES_PER_DAY) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "Invalid interval “%s”",
+                    text);
+        return FALSE;
+    }
+
+    *every_minutes = (guint16) minutes;
+    return TRUE;
+}
+
+static const char *next_token(GStrv tokens, guint *index)
+{
+    while (tokens[*index] != NULL && tokens[*index][0] == '\0') {
+        (*index)++;
+    }
+
+    return (tokens[*index] != NULL) ? tokens[(*index)++] : NULL;
+}
+
+
+/* ============================================================================
+ * Next Start
+ * ============================================================================ */
+
+static void set_minute(guint minute_of_week)
+{
+    scMinutes[minute_of_week / 64] |= G_GUINT64_CONSTANT(1) << (minute_of_week % 64);
+}
+
+static void add_rule(const ScRule *rule)
+{
+    for (guint day = 0; day < 7; day++) {
+        if (!(rule->weekdays & (1 << day))) {
+            continue;
+        }
+
+        if (rule->every_minutes == 0) {
+            set_minute(day * SC_MINUTES_PER_DAY + rule->start_minute % SC_MINUTES_PER_DAY);
+            continue;
+        }
+
+        for (guint minute = rule->start_minute; minute < MIN(rule->end_minute, SC_MINUTES_PER_DAY);
+             minute += rule->every_minutes) {
+            set_minute(day * SC_MINUTES_PER_DAY + minute);
+        }
+    }
+}
+
+// Minutes from the given minute of the week to the first start at or after it, or -1 for none.
+static gint minutes_to_next_start(guint minute_of_week)
+{
+    guint word = minute_of_week / 64;
+    guint64 bits = scMinutes[word] & (G_MAXUINT64 << (minute_of_week % 64));
+
+    // Once around the week, back into the first word for the minutes before the given one.
+    for (guint i = 0; i <= WEEK_WORDS; i++) {
+        if (bits != 0) {
+            guint minute = ((word + i) % WEEK_WORDS) * 64 + (guint) __builtin_ctzll(bits);
+            return (gint) ((minute + SC_MINUTES_PER_WEEK - minute_of_week) % SC_MINUTES_PER_WEEK);
+        }
+        bits = scMinutes[(word + i + 1) % WEEK_WORDS];
+    }
+
+    return -1;
+}
+
+// The local time some minutes after the start of the given minute, honouring daylight saving.
+static time_t add_local_minutes(const struct tm *local, gint minutes, gint is_dst)
+{
+    struct tm start = *local;
+
+    start.tm_sec = 0;
+    start.tm_min += minutes;
+    start.tm_isdst = is_dst;
+
+    return mktime(&start);
+}
+
+
+// Lets the next calls find the minute of the week and the starts in it without asking libc.
+static void cache_offset_span(time_t now, const struct tm *local)
+{
+    guint weekday = (guint) (local->tm_wday + 6) % 7;
+    time_t start = now - local->tm_sec - (local->tm_hour * 60 + local->tm_min) * 60 -
+                   (time_t) weekday * SC_MINUTES_PER_DAY * 60;
+    time_t end = start + 2 * (time_t) SC_MINUTES_PER_WEEK * 60;
+    time_t last = end - 1;
+    struct tm at_start;
+    struct tm at_last;
+
+    scSpanStart = 0;
+    scSpanEnd = 0;
+
+    // A week around a change to or from daylight saving is left to mktime().
+    if (localtime_r(&start, &at_start) == NULL || localtime_r(&last, &at_last) == NULL ||
+        at_start.tm_gmtoff != local->tm_gmtoff || at_last.tm_gmtoff != local->tm_gmtoff ||
+        at_start.tm_hour != 0 || at_start.tm_min != 0) {
+        return;
+    }
+
+    scSpanStart = start;
+    scSpanEnd = end;
+}
+
+
+/* ============================================================================
+ * Arming
+ * ============================================================================ */
+
+static void arm_next_start(gint64 after_real_us);
+
+static void run_due_start(void)
+{
+    gint64 late_us = g_get_real_time() - scArmedRealUs;
+
+    if (late_us < SC_MAX_LATE_US) {
+        if (scTrigger != NULL) {
+            scTrigger(scUserData);
+        }
+    } else {
+        g_info("Not starting the session scheduled %" G_GINT64_FORMAT " minutes ago",
+               late_us / (60 * G_USEC_PER_SEC));
+    }
+
+    // A fallback timeout may run a little early, the same start is not armed again.
+    arm_next_start(MAX(g_get_real_time(), scArmedRealUs));
+}
+
+static gboolean on_timer_fd_ready(gint fd, GIOCondition condition, gpointer user_data)
+{
+    guint64 expirations = 0;
+
+    if (read(fd, &expirations, sizeof(expirations)) < 0) {
+        // The wall clock was set, the armed start may be hours away now.
+        if (errno == ECANCELED) {
+            scSpanEnd = 0;
+            arm_next_start(g_get_real_time());
+        }
+        return G_SOURCE_CONTINUE;
+    }
+
+    run_due_start();
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean on_fallback_timeout(gpointer user_data)
+{
+    scFallbackId = 0;
+    run_due_start();
+
+    return G_SOURCE_REMOVE;
+}
+
+static void on_zone_changed(GFileMonitor *monitor, GFile *file, GFile *other_file,
+                            GFileMonitorEvent event_type, gpointer user_data)
+{
+    sc_time_zone_changed();
+}
+
+static void arm_next_start(gint64 after_real_us)
+{
+    scArmedRealUs = sc_next_start_after(after_real_us);
+
+    if (scTimerFd >= 0) {
+        struct itimerspec spec = {0};
+        spec.it_value.tv_sec = (time_t) (scArmedRealUs / G_USEC_PER_SEC);
+
+        // Disarmed again with a zero time when there is nothing to start.
+        if (timerfd_settime(scTimerFd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &spec, NULL) <
+            0) {
+            g_warning("Failed to arm the schedule: %s", g_strerror(errno));
+        }
+        return;
+    }
+
+    g_clear_handle_id(&scFallbackId, g_source_remove);
+    if (scArmedRealUs > 0) {
+        gint64 delay_ms = MAX(scArmedRealUs - g_get_real_time(), 0) / 1000;
+        scFallbackId = g_timeout_add((guint) delay_ms, on_fallback_timeout, NULL);
+    }
+}
+
+
+/* ============================================================================
+ * Public API
+ * ============================================================================ */
+
+gboolean sc_parse_rule(const char *text, ScRule *rule, GError **error)
+{
+    g_auto(GStrv) tokens = g_strsplit_set(text, " \t", -1);
+    guint index = 0;
+    const char *token = next_token(tokens, &index);
+
+    ScRule parsed = {.weekdays = ALL_DAYS, .end_minute = SC_MINUTES_PER_DAY};
+    gboolean has_time = FALSE;
+    gboolean has_window = FALSE;
+
+    if (token != NULL && !g_ascii_isdigit(token[0]) && g_strcmp0(token, "every") != 0) {
+        if (!parse_days(token, &parsed.weekdays, error)) {
+            return FALSE;
+        }
+        token = next_token(tokens, &index);
+    }
+
+    if (token != NULL && g_ascii_isdigit(token[0])) {
+        g_auto(GStrv) window = g_strsplit(token, "-", 2);
+
+        if (!parse_time(window[0], &parsed.start_minute, error) ||
+            (window[1] != NULL && !parse_time(window[1], &parsed.end_minute, error))) {
+            return FALSE;
+        }
+        has_time = TRUE;
+        has_window = (window[1] != NULL);
+        token = next_token(tokens, &index);
+    }
+
+    if (g_strcmp0(token, "every") == 0) {
+        token = next_token(tokens, &index);
+        if (token == NULL || !parse_every(token, &parsed.every_minutes, error)) {
+            if (token == NULL) {
+                g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                            "Missing interval after “every”");
+            }
+            return FALSE;
+        }
+        token = next_token(tokens, &index);
+    }
+
+    if (token != NULL) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT, "Unexpected “%s”", token);
+        return FALSE;
+    }
+    if (!has_time && parsed.every_minutes == 0) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                    "A rule needs a time or an interval");
+        return FALSE;
+    }
+    if (has_window && (parsed.every_minutes == 0 || parsed.end_minute <= parsed.start_minute)) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                    "A window needs an interval and has to end after it starts");
+        return FALSE;
+    }
+    if (parsed.start_minute >= SC_MINUTES_PER_DAY) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                    "Starts have to be before 24:00");
+        return FALSE;
+    }
+
+    *rule = parsed;
+    return TRUE;
+}
+
+void sc_set_rules(const ScRule *rules, guint n_rules)
+{
+    memset(scMinutes, 0, sizeof(scMinutes));
+    scHasRules = FALSE;
+
+    for (guint i = 0; i < n_rules; i++) {
+        add_rule(&rules[i]);
+        scHasRules |= (rules[i].weekdays & ALL_DAYS) != 0;
+    }
+
+    if (scEnabled) {
+        arm_next_start(g_get_real_time());
+    }
+}
+
+gint64 sc_next_start_after(gint64 real_us)
+{
+    time_t now = (time_t) (real_us / G_USEC_PER_SEC);
+    struct tm local;
+
+    if (!scHasRules) {
+        return 0;
+    }
+
+    // No daylight saving change until the end of the span, a start is just minutes away.
+    if (now >= scSpanStart && now < scSpanEnd) {
+        gint64 minutes_in = (now - scSpanStart) / 60;
+        gint minutes = minutes_to_next_start((guint) ((minutes_in + 1) % SC_MINUTES_PER_WEEK));
+        if (minutes < 0) {
+            return 0;
+        }
+
+        time_t start = scSpanStart + (time_t) (minutes_in + 1 + minutes) * 60;
+        if (start < scSpanEnd) {
+            return (gint64) start * G_USEC_PER_SEC;
+        }
+    }
+
+    if (localtime_r(&now, &local) == NULL) {
+        return 0;
+    }
+    if (now < scSpanStart || now >= scSpanEnd) {
+        cache_offset_span(now, &local);
+    }
+
+    guint weekday = (guint) (local.tm_wday + 6) % 7;
+    guint minute_of_day = (guint) (local.tm_hour * 60 + local.tm_min);
+    guint minute_of_week = weekday * SC_MINUTES_PER_DAY + minute_of_day;
+
+    // Starts are on the minute, so the one under way has already gone by.
+    for (gint after = 1; after <= SC_MINUTES_PER_WEEK; after++) {
+        gint minutes = minutes_to_next_start((minute_of_week + after) % SC_MINUTES_PER_WEEK);
+        if (minutes < 0) {
+            return 0;
+        }
+        after += minutes;
+
+        time_t start = add_local_minutes(&local, after, -1);
+
+        // The clock went back an hour and this is the second pass over that minute.
+        if (start <= now) {
+            start = add_local_minutes(&local, after, 0);
+        }
+        if (start > now) {
+            return (gint64) start * G_USEC_PER_SEC;
+        }
+    }
+
+    return 0;
+}
+
+void sc_enable(ScTriggerFunc trigger, gpointer user_data)
+{
+    sc_disable();
+
+    scEnabled = TRUE;
+    scTrigger = trigger;
+    scUserData = user_data;
+
+    tzset();
+    scSpanEnd = 0;
+
+    scTimerFd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (scTimerFd >= 0) {
+        scTimerSourceId = g_unix_fd_add(scTimerFd, G_IO_IN, on_timer_fd_ready, NULL);
+    } else {
+        g_info("No timerfd (%s), the schedule does not follow changes to the clock",
+               g_strerror(errno));
+    }
+
+    g_autoptr(GFile) zone_file = g_file_new_for_path("/etc/localtime");
+    scZoneMonitor = g_file_monitor_file(zone_file, G_FILE_MONITOR_NONE, NULL, NULL);
+    if (scZoneMonitor != NULL) {
+        g_signal_connect(scZoneMonitor, "changed", G_CALLBACK(on_zone_changed), NULL);
+    }
+
+    arm_next_start(g_get_real_time());
+}
+
+void sc_disable(void)
+{
+    if (!scEnabled) {
+        return;
+    }
+
+    g_clear_handle_id(&scTimerSourceId, g_source_remove);
+    g_clear_handle_id(&scFallbackId, g_source_remove);
+    if (scTimerFd >= 0) {
+        close(scTimerFd);
+        scTimerFd = -1;
+    }
+    g_clear_object(&scZoneMonitor);
+
+    scArmedRealUs = 0;
+    scTrigger = NULL;
+    scUserData = NULL;
+    scEnabled = FALSE;
+}
+
+void sc_time_zone_changed(void)
+{
+    // Makes localtime_r() and mktime() pick up the new zone.
+    tzset();
+    scSpanEnd = 0;
+
+    if (scEnabled) {
+        arm_next_start(g_get_real_time());
+    }
+}
+
+gboolean sc_is_enabled(void)
+{
+    return scEnabled;
+}
+
+gint64 sc_get_armed_real_us(void)
+{
+    return scEnabled ? scArmedRealUs : 0;
+}
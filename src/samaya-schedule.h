@@ -0,0 +1,86 @@
+/* samaya-schedule.h
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+/*  Starting work sessions on a schedule, such as at 09:00 and 13:30 on weekdays or on every half
+    hour.
+
+    All rules are folded into one bitmap of the minutes of a week, so finding the next start is a
+    scan over a few hundred words however many rules there are. Only that next start is ever
+    armed, as a single timerfd on the wall clock that the kernel cancels when the clock is set. It
+    is then armed again, as it is when the time zone changes. Nothing is polled.
+
+    The UTC offset is cached for two weeks at a time from a local Monday, as long as it does not
+    change within them, so the next start is found without localtime_r() or mktime().
+
+    Rules are written as `[DAYS] [HH:MM | HH:MM-HH:MM] [every N[m]]`:
+
+        weekdays 09:00              at nine on Monday to Friday
+        mon,wed,fri 13:30           at half past one on those days
+        every 30m                   on the hour and the half hour, every day
+        sat-sun 10:00-18:00 every 45m
+
+    DAYS is daily, weekdays, weekends or a comma separated list of day names and ranges, daily
+    when left out. A repeating rule without a window repeats over the whole day.
+*/
+
+#define SC_MINUTES_PER_DAY (24 * 60)
+#define SC_MINUTES_PER_WEEK (7 * SC_MINUTES_PER_DAY)
+
+// A start found this much later than planned, after a suspend say, is let go.
+#define SC_MAX_LATE_US (5 * 60 * G_USEC_PER_SEC)
+
+typedef struct
+{
+    // Bit 0 is Monday, bit 6 Sunday.
+    guint8 weekdays;
+
+    guint16 start_minute;
+
+    // Repeating rules only: the end of their window, exclusive, and how far apart the starts are.
+    guint16 end_minute;
+    guint16 every_minutes;
+} ScRule;
+
+// Called when a scheduled start is due.
+typedef void (*ScTriggerFunc)(gpointer user_data);
+
+gboolean sc_parse_rule(const char *text, ScRule *rule, GError **error);
+
+// Replaces the rules and arms the next start, if there is one.
+void sc_set_rules(const ScRule *rules, guint n_rules);
+
+// Wall clock time of the first start after the given one, 0 when there are no rules.
+gint64 sc_next_start_after(gint64 real_us);
+
+void sc_enable(ScTriggerFunc trigger, gpointer user_data);
+
+void sc_disable(void);
+
+// Picks up a new TZ or /etc/localtime, and arms the next start again when enabled.
+void sc_time_zone_changed(void);
+
+gboolean sc_is_enabled(void);
+
+// Wall clock time of the armed start, 0 when nothing is armed.
+gint64 sc_get_armed_real_us(void);
@@ -0,0 +1,39 @@
+/* samaya-session-private.h
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <glib.h>
+#include "samaya-session.h"
+
+/*  Internal entry points of the session manager.
+
+    These are only exposed so that benchmarks and developer tools can drive the session manager
+    directly, application code should always go through the API in samaya-session.h.
+*/
+
+// Formats the given time into the remaining time string of the session manager.
+void sm_format_time(SessionManagerPtr self, gint64 timeMS);
+
+// Moves to the next routine, notify is NULL when the session was skipped instead of completed.
+void on_session_complete(gpointer notify);
+
+// Starts the timer like sm_start(), or like an auto start when automatic is TRUE.
+void sm_start_planned(SessionManagerPtr self, gboolean automatic);
@@ -19,9 +19,17 @@
  */
 
 #include <gio/gio.h>
-#include <glib/gi18n.h>
+#include <string.h>
+#include "samaya-checkpoint.h"
+#include "samaya-history.h"
+#include "samaya-hooks.h"
+#include "samaya-schedule.h"
+#include "samaya-session-private.h"
 #include "samaya-session.h"
+#include "samaya-tags.h"
 #include "samaya-timer.h"
+#include "samaya-trace.h"
+#include "samaya-utils.h"
 
 
 /* ============================================================================
@@ -35,6 +43,14 @@
 // whether the window is being displayed or not.
 static SessionManagerPtr globalSessionManagerPtr = NULL;
 
+// The published SmSnapshot as words, so readers can copy it with atomic loads while it changes.
+#define SNAPSHOT_WORDS ((sizeof(SmSnapshot) + sizeof(guint64) - 1) / sizeof(guint64))
+
+static guint64 snapshotWords[SNAPSHOT_WORDS];
+
+// Odd while a snapshot is being written.
+static guint64 snapshotSequence = 0;
+
 
 /* ============================================================================
  * Methods for Static Variables
@@ -56,11 +72,9 @@ SessionManagerPtr sm_get_default(void)
  * Function Definitions
  * ============================================================================ */
 
-static void play_completion_sound(GSoundContext *g_sound_ctx);
-
-static void display_notification(SessionManagerPtr session_manager);
+static void announce_completion(SessionManagerPtr self, RoutineType ended_routine);
 
-static void sm_format_time(SessionManagerPtr self, gint64 timeMS);
+static void publish_snapshot(SessionManagerPtr self);
 
 
 /* ============================================================================
@@ -75,21 +89,160 @@ static void on_timer_tick(gpointer remaining_time_ms)
     }
 
     sm_format_time(session_manager, *(guint64 *) remaining_time_ms);
+    publish_snapshot(session_manager);
 
     if (session_manager->sm_timer_tick_callback) {
         session_manager->sm_timer_tick_callback(session_manager->user_data);
     }
 }
 
-static void on_session_complete(gpointer notify)
+// Wall clock time the timer event being handled happened at, which is in the past for a routine
+// that ran out while the system was asleep.
+static gint64 get_event_real_us(TimerPtr timer)
+{
+    if (timer->dispatch_time_us == 0) {
+        return g_get_real_time();
+    }
+
+    return g_get_real_time() - MAX(timer->tm_clock() - timer->dispatch_time_us, 0);
+}
+
+static guint64 get_remaining_time_ms(TimerPtr timer)
+{
+    // Skipped while running, the last tick can be up to a second old.
+    gint64 deadline_us = tm_get_deadline_us(timer);
+    if (deadline_us > 0) {
+        return (guint64) MAX(deadline_us - timer->tm_clock(), 0) / 1000;
+    }
+
+    return timer->remaining_time_ms;
+}
+
+// Like the history, only routines that were started ever run hooks.
+static void run_hook(SessionManagerPtr self, HkEvent event, gint64 event_real_us)
+{
+    if (!hk_is_enabled() || self->session_start_real_us == 0) {
+        return;
+    }
+
+    TimerPtr timer = self->timer_instance;
+
+    HkContext context = {
+        .routine = hs_routine_to_string(self->current_routine),
+        .tag = (self->current_routine == Working) ? tg_get_name(self->current_tag_id) : NULL,
+        .planned_ms = timer->initial_time_ms,
+        .elapsed_ms = guint64_sat_sub(timer->initial_time_ms, get_remaining_time_ms(timer)),
+        .start_real_us = self->session_start_real_us,
+        .event_real_us = event_real_us,
+        .total_sessions = self->total_sessions_counted,
+    };
+
+    hk_run(event, &context);
+}
+
+// Appends the routine to the history if it was ever started, it ended at the given time.
+static void record_history(SessionManagerPtr self, gint64 end_real_us)
+{
+    gint64 start_real_us = self->session_start_real_us;
+    if (start_real_us == 0) {
+        return;
+    }
+    self->session_start_real_us = 0;
+
+    if (!hs_is_enabled() && !tg_is_enabled() && self->sm_history_callback == NULL) {
+        return;
+    }
+
+    TimerPtr timer = self->timer_instance;
+    guint64 remaining_time_ms = get_remaining_time_ms(timer);
+
+    HsRecord record = {
+        .start_real_us = start_real_us,
+        .end_real_us = end_real_us,
+        .duration_ms =
+            (guint32) MIN(guint64_sat_sub(timer->initial_time_ms, remaining_time_ms), G_MAXUINT32),
+        .planned_ms = (guint32) MIN(timer->initial_time_ms, G_MAXUINT32),
+        .routine = self->current_routine,
+        .outcome = (remaining_time_ms == 0) ? HsCompleted : HsSkipped,
+        .tag_id = (self->current_routine == Working) ? self->current_tag_id : TG_NO_TAG,
+    };
+
+    hs_append(&record);
+    tg_add_record(&record);
+
+    if (self->sm_history_callback) {
+        self->sm_history_callback(&record, self->user_data);
+    }
+}
+
+// Tracks when the routine was started, passes the change on to the tick callback and checkpoints
+// the session whenever the timer changes state, ticks are never written out.
+static void on_timer_event(gpointer timer)
 {
     SessionManagerPtr session_manager = sm_get_default();
+    if (session_manager == NULL) {
+        return;
+    }
+
+    TimerPtr timer_instance = timer;
+    TmState state = tm_get_state(timer_instance);
+
+    if (state == StIdle) {
+        session_manager->session_start_real_us = 0;
+    } else if (session_manager->session_start_real_us == 0) {
+        session_manager->session_start_real_us = get_event_real_us(timer_instance);
+        run_hook(session_manager, HkSessionStart, session_manager->session_start_real_us);
+    }
+
+    publish_snapshot(session_manager);
 
-    if (notify != NULL) {
-        play_completion_sound(session_manager->gsound_ctx);
-        display_notification(session_manager);
+    // Whoever shows the time shows the state as well, which does not always come with a tick.
+    if (session_manager->sm_timer_tick_callback) {
+        session_manager->sm_timer_tick_callback(session_manager->user_data);
     }
 
+    if (!cp_is_enabled()) {
+        return;
+    }
+
+    gint64 deadline_us = tm_get_deadline_us(timer_instance);
+
+    CpCheckpoint checkpoint = {
+        .initial_time_ms = timer_instance->initial_time_ms,
+        .remaining_time_ms = timer_instance->remaining_time_ms,
+        .session_start_real_us = session_manager->session_start_real_us,
+        .total_sessions_counted = session_manager->total_sessions_counted,
+        .routine = session_manager->current_routine,
+        .state = state,
+        .sessions_completed = session_manager->sessions_completed,
+    };
+
+    if (deadline_us > 0) {
+        checkpoint.deadline_real_us =
+            g_get_real_time() + (deadline_us - timer_instance->tm_clock());
+    }
+
+    cp_write(&checkpoint);
+}
+
+void on_session_complete(gpointer notify)
+{
+    SessionManagerPtr session_manager = sm_get_default();
+
+    tr_record(TrComplete, session_manager->current_routine, notify != NULL, 0);
+    tr_begin_internal();
+
+    gint64 end_real_us = get_event_real_us(session_manager->timer_instance);
+    gboolean ran_out = get_remaining_time_ms(session_manager->timer_instance) == 0;
+    run_hook(session_manager, ran_out ? HkSessionEnd : HkSessionSkip, end_real_us);
+    record_history(session_manager, end_real_us);
+
+    // Routines caught up with after a suspend are announced together once that is done.
+    if (notify != NULL && !session_manager->catching_up) {
+        announce_completion(session_manager, session_manager->current_routine);
+    }
+    session_manager->last_completed_routine = session_manager->current_routine;
+
     switch (session_manager->current_routine) {
         case Working:
             session_manager->sessions_completed++;
@@ -119,57 +272,178 @@ static void on_session_complete(gpointer notify)
     gboolean should_autostart = (is_working_session && session_manager->auto_start_work) ||
                                 (!is_working_session && session_manager->auto_start_breaks);
     if (should_autostart && notify != NULL) {
-        tm_trigger_event(session_manager->timer_instance, EvStart);
+        sm_start_planned(session_manager, TRUE);
     }
+
+    tr_end_internal();
 }
 
-static void play_completion_sound(GSoundContext *g_sound_ctx)
+static void announce_completion(SessionManagerPtr self, RoutineType ended_routine)
 {
-    if (!g_sound_ctx) {
-        g_warning("Failed to play completion sound, gSound Context is not set.");
+    const SmBackend *backend = self->backend;
+    if (backend == NULL) {
         return;
     }
 
-    char *sound_path = g_build_filename("/app", "share", "sounds", "bell.oga", NULL);
-
-    gsound_context_play_full(g_sound_ctx, NULL, NULL, NULL, GSOUND_ATTR_MEDIA_FILENAME, sound_path,
-                             NULL);
+    if (backend->play_completion_sound) {
+        backend->play_completion_sound(self->backend_data);
+    }
+    if (backend->show_completion) {
+        backend->show_completion(ended_routine, self->backend_data);
+    }
 }
 
-static void display_notification(SessionManagerPtr session_manager)
+// A routine the user already started, or paused, is left alone.
+static void on_scheduled_start(gpointer user_data)
 {
-    GApplication *app = G_APPLICATION(session_manager->user_data);
-    if (app == NULL) {
+    SessionManagerPtr self = user_data;
+
+    if (tm_get_state(self->timer_instance) != StIdle) {
+        g_info("Scheduled start skipped, a routine is under way");
         return;
     }
 
-    const char *title = _("Samaya");
-    const char *body = NULL;
+    if (self->current_routine != Working) {
+        sm_set_routine(Working, self);
+    }
+    sm_start_planned(self, TRUE);
+}
+
+static gboolean on_deferred_start(gpointer user_data)
+{
+    SessionManagerPtr self = user_data;
 
-    switch (session_manager->current_routine) {
+    self->deferred_start_id = 0;
+    sm_start_planned(self, TRUE);
+
+    return G_SOURCE_REMOVE;
+}
+
+static gfloat get_routine_duration(SessionManagerPtr self, RoutineType routine)
+{
+    switch (routine) {
         case Working:
-            body = _("Focus session complete! Time for a break.");
-            break;
+            return self->work_duration;
         case ShortBreak:
+            return self->short_break_duration;
         case LongBreak:
-            body = _("Break over! Time to get back to work.");
+            return self->long_break_duration;
+        default:
+            g_critical("Invalid Routine Type! Work duration is being used as default value.");
+            return self->work_duration;
+    }
+}
+
+static guint32 duration_to_trace_value(gdouble minutes)
+{
+    return (guint32) (minutes * 60 * 1000);
+}
+
+static guint64 duration_to_ms(gdouble minutes)
+{
+    return (guint64) (minutes * 60 * 1000);
+}
+
+// Brings the projection in line with the routine, the settings and the sessions completed.
+static void update_projection(SessionManagerPtr self)
+{
+    SmProjection *projection = &self->projection;
+    guint64 work_ms = duration_to_ms(self->work_duration);
+    guint64 short_break_ms = duration_to_ms(self->short_break_duration);
+    guint64 long_break_ms = duration_to_ms(self->long_break_duration);
+    guint32 sessions = MAX(self->sessions_to_complete, 1);
+    guint32 completed = MIN(self->sessions_completed, sessions);
+
+    projection->work_ms = work_ms;
+    projection->work_period_ms = MAX(short_break_ms + work_ms, 1);
+    projection->cycle_ms =
+        MAX(sessions * work_ms + (sessions - 1) * short_break_ms + long_break_ms, 1);
+
+    switch (self->current_routine) {
+        case Working:
+            // The current work session is the next one to complete in the cycle.
+            projection->work_sessions_left = sessions - MIN(completed + 1, sessions);
+            projection->first_work_end_ms = short_break_ms + work_ms;
             break;
+        case ShortBreak:
+            projection->work_sessions_left = sessions - completed;
+            projection->first_work_end_ms = work_ms;
+            break;
+        case LongBreak:
         default:
-            body = _("Timer finished.");
+            projection->work_sessions_left = sessions;
+            projection->first_work_end_ms = work_ms;
             break;
     }
 
-    GNotification *note = g_notification_new(title);
-    g_notification_set_body(note, body);
-    g_notification_set_priority(note, G_NOTIFICATION_PRIORITY_HIGH);
+    projection->long_break_start_ms = 0;
+    if (projection->work_sessions_left > 0) {
+        projection->long_break_start_ms =
+            projection->first_work_end_ms +
+            (projection->work_sessions_left - 1) * projection->work_period_ms;
+    }
+    projection->long_break_end_ms = projection->long_break_start_ms + long_break_ms;
+
+    projection->waits_for_user = !self->auto_start_breaks || !self->auto_start_work;
+
+    // Depends on everything the snapshot holds besides the timer, which publishes on its own.
+    publish_snapshot(self);
+}
+
+// Only ever called on the main thread, so there is a single writer.
+static void publish_snapshot(SessionManagerPtr self)
+{
+    TimerPtr timer = self->timer_instance;
+    guint64 sequence = __atomic_load_n(&snapshotSequence, __ATOMIC_RELAXED);
+
+    SmSnapshot snapshot = {
+        .sequence = sequence / 2 + 1,
+        .state = tm_get_state(timer),
+        .routine = self->current_routine,
+        .deadline_us = tm_get_deadline_us(timer),
+        .clock = timer->tm_clock,
+        .remaining_ms = timer->remaining_time_ms,
+        .initial_ms = timer->initial_time_ms,
+        .session_start_real_us = self->session_start_real_us,
+        .total_sessions_counted = self->total_sessions_counted,
+        .tag_id = self->current_tag_id,
+        .sessions_completed = self->sessions_completed,
+        .sessions_to_complete = self->sessions_to_complete,
+        .auto_start_breaks = self->auto_start_breaks,
+        .auto_start_work = self->auto_start_work,
+        .work_duration = self->work_duration,
+        .short_break_duration = self->short_break_duration,
+        .long_break_duration = self->long_break_duration,
+    };
+
+    guint64 words[SNAPSHOT_WORDS] = {0};
+    memcpy(words, &snapshot, sizeof(snapshot));
+
+    __atomic_store_n(&snapshotSequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    for (gsize i = 0; i < SNAPSHOT_WORDS; i++) {
+        __atomic_store_n(&snapshotWords[i], words[i], __ATOMIC_RELAXED);
+    }
+
+    __atomic_store_n(&snapshotSequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+// Wall clock time the current routine ends at, right now for one that is not running.
+static gint64 get_session_end_real_us(SessionManagerPtr self)
+{
+    TimerPtr timer = self->timer_instance;
+    gint64 deadline_us = tm_get_deadline_us(timer);
+    gint64 left_us = (gint64) timer->remaining_time_ms * 1000;
 
-    g_notification_set_default_action(note, "app.activate");
+    if (deadline_us > 0) {
+        left_us = MAX(deadline_us - timer->tm_clock(), 0);
+    }
 
-    g_application_send_notification(app, "timer-complete", note);
-    g_object_unref(note);
+    return g_get_real_time() + left_us;
 }
 
-static void sm_format_time(SessionManagerPtr self, gint64 timeMS)
+void sm_format_time(SessionManagerPtr self, gint64 timeMS)
 {
     GString *input_string = self->remaining_time_minutes_string;
 
@@ -177,7 +451,10 @@ static void sm_format_time(SessionManagerPtr self, gint64 timeMS)
     gint64 minutes = total_seconds / 60;
     gint64 seconds = total_seconds % 60;
 
-    g_string_printf(input_string, "%02" G_GINT64_FORMAT ":%02" G_GINT64_FORMAT, minutes, seconds);
+    // Runs on every tick, g_string_printf() would allocate a temporary string each time.
+    gchar text[32];
+    g_snprintf(text, sizeof(text), "%02" G_GINT64_FORMAT ":%02" G_GINT64_FORMAT, minutes, seconds);
+    g_string_assign(input_string, text);
 }
 
 
@@ -207,14 +484,14 @@ SessionManagerPtr sm_init(guint16 sessions_to_complete, gdouble work_duration,
         .total_sessions_counted = 0,
         .remaining_time_minutes_string = g_string_new(NULL),
 
-        .timer_instance = tm_new(work_duration, on_session_complete, on_timer_tick, NULL),
-        .gsound_ctx = gsound_context_new(NULL, NULL),
+        .timer_instance = tm_new(work_duration, on_session_complete, on_timer_tick, on_timer_event),
 
         .user_data = user_data,
 
         .sm_timer_tick_callback = timer_instance_tick_callback,
     };
     sm_format_time(session_manager, session_manager->timer_instance->initial_time_ms);
+    update_projection(session_manager);
     globalSessionManagerPtr = session_manager;
     return session_manager;
 }
@@ -223,10 +500,15 @@ void sm_deinit(SessionManager *session_manager)
 {
     Timer *timer = session_manager->timer_instance;
 
+    sc_disable();
+    g_clear_handle_id(&session_manager->deferred_start_id, g_source_remove);
+
     if (timer) {
         tm_free(session_manager->timer_instance);
     }
 
+    g_string_free(session_manager->remaining_time_minutes_string, TRUE);
+
     globalSessionManagerPtr = NULL;
 
     g_free(session_manager);
@@ -237,88 +519,280 @@ void sm_skip_session(void)
     on_session_complete(FALSE);
 }
 
+void sm_start(SessionManagerPtr self)
+{
+    sm_start_planned(self, FALSE);
+}
+
+void sm_start_planned(SessionManagerPtr self, gboolean automatic)
+{
+    TimerPtr timer = self->timer_instance;
+
+    g_clear_handle_id(&self->deferred_start_id, g_source_remove);
+
+    // Resumed routines, breaks and the ones caught up with after a suspend are not planned.
+    if (self->planner == NULL || self->current_routine != Working ||
+        tm_get_state(timer) != StIdle || self->catching_up) {
+        tm_trigger_event(timer, EvStart);
+        return;
+    }
+
+    // A session shortened for a meeting and then reset is planned again at its full length.
+    gfloat duration = get_routine_duration(self, Working);
+    tm_set_duration(timer, duration);
+
+    guint64 value_ms = 0;
+    SmPlanDecision decision = self->planner(g_get_real_time(), timer->initial_time_ms, automatic,
+                                            &value_ms, self->planner_data);
+
+    // What follows is replayed from this record, a replay has no planner of its own.
+    tr_record(TrPlan, decision, automatic, (guint32) MIN(value_ms, G_MAXUINT32));
+    tr_begin_internal();
+
+    switch (decision) {
+        case SmPlanShorten:
+            tm_set_duration(timer, (gfloat) value_ms / (60.0f * 1000.0f));
+            tm_trigger_event(timer, EvStart);
+            break;
+        case SmPlanDefer:
+            g_info("Work session put off by %" G_GUINT64_FORMAT " minutes", value_ms / 60000);
+            self->deferred_start_id =
+                g_timeout_add((guint) MIN(value_ms, G_MAXUINT), on_deferred_start, self);
+            break;
+        case SmPlanStart:
+        default:
+            tm_trigger_event(timer, EvStart);
+            break;
+    }
+
+    tr_end_internal();
+}
+
 void sm_set_work_duration(SessionManagerPtr self, gdouble value)
 {
     self->work_duration = (gfloat) value;
+    tr_record(TrSetting, TrWorkDuration, 0, duration_to_trace_value(value));
     TimerPtr timer = self->timer_instance;
     gboolean is_work_session = (self->current_routine == Working);
 
 
     if (is_work_session) {
+        tr_begin_internal();
         tm_trigger_event(timer, EvReset);
         tm_set_duration(timer, self->work_duration);
+        tr_end_internal();
     }
+    update_projection(self);
 }
 
 void sm_set_short_break_duration(SessionManagerPtr self, gdouble value)
 {
     self->short_break_duration = (gfloat) value;
+    tr_record(TrSetting, TrShortBreakDuration, 0, duration_to_trace_value(value));
     Timer *timer = self->timer_instance;
     gboolean is_short_break_session = (self->current_routine == ShortBreak);
 
     if (is_short_break_session) {
+        tr_begin_internal();
         tm_trigger_event(timer, EvReset);
         tm_set_duration(timer, self->short_break_duration);
+        tr_end_internal();
     }
+    update_projection(self);
 }
 
 void sm_set_long_break_duration(SessionManagerPtr self, gdouble value)
 {
     self->long_break_duration = (gfloat) value;
+    tr_record(TrSetting, TrLongBreakDuration, 0, duration_to_trace_value(value));
     Timer *timer = self->timer_instance;
     gboolean is_long_break_session = (self->current_routine == LongBreak);
 
     if (is_long_break_session) {
+        tr_begin_internal();
         tm_trigger_event(timer, EvReset);
         tm_set_duration(timer, self->long_break_duration);
+        tr_end_internal();
     }
+    update_projection(self);
 }
 
 void sm_set_sessions_to_complete(SessionManager *session_manager, guint16 value)
 {
     session_manager->sessions_to_complete = value;
+    tr_record(TrSetting, TrSessionsToComplete, 0, value);
+
+    update_projection(session_manager);
 }
 
 void sm_set_auto_start_breaks(SessionManagerPtr self, gboolean value)
 {
     self->auto_start_breaks = value;
+    tr_record(TrSetting, TrAutoStartBreaks, 0, value);
+
+    update_projection(self);
 }
 
 void sm_set_auto_start_work(SessionManagerPtr self, gboolean value)
 {
     self->auto_start_work = value;
+    tr_record(TrSetting, TrAutoStartWork, 0, value);
+
+    update_projection(self);
 }
 
 void sm_set_routine(RoutineType routine, SessionManager *session_manager)
 {
+    tr_record(TrRoutine, routine, 0, 0);
+    tr_begin_internal();
+
     session_manager->current_routine = routine;
+    g_clear_handle_id(&session_manager->deferred_start_id, g_source_remove);
 
     Timer *timer = session_manager->timer_instance;
-
-    gfloat duration;
-
-    switch (routine) {
-        case Working:
-            duration = session_manager->work_duration;
-            break;
-        case ShortBreak:
-            duration = session_manager->short_break_duration;
-            break;
-        case LongBreak:
-            duration = session_manager->long_break_duration;
-            break;
-        default:
-            g_critical("Invalid Routine Type! Work duration is being used as default value.");
-            duration = session_manager->work_duration;
-            break;
-    }
+    gfloat duration = get_routine_duration(session_manager, routine);
 
     tm_set_duration(timer, duration);
     tm_trigger_event(timer, EvReset);
 
+    // Also reached from on_session_complete(), once the completed sessions were counted.
+    update_projection(session_manager);
+
     if (session_manager->sm_routine_update_callback) {
         session_manager->sm_routine_update_callback(session_manager->user_data);
     }
+
+    tr_end_internal();
+}
+
+void sm_set_tag(SessionManagerPtr self, guint32 tag_id)
+{
+    self->current_tag_id = tag_id;
+    publish_snapshot(self);
+}
+
+void sm_trace_snapshot(SessionManagerPtr self)
+{
+    TimerPtr timer = self->timer_instance;
+    gint64 now_us = timer->tm_clock();
+
+    tr_record_full(now_us, TrSetting, TrWorkDuration, 0, TR_FLAG_SNAPSHOT,
+                   duration_to_trace_value(self->work_duration));
+    tr_record_full(now_us, TrSetting, TrShortBreakDuration, 0, TR_FLAG_SNAPSHOT,
+                   duration_to_trace_value(self->short_break_duration));
+    tr_record_full(now_us, TrSetting, TrLongBreakDuration, 0, TR_FLAG_SNAPSHOT,
+                   duration_to_trace_value(self->long_break_duration));
+    tr_record_full(now_us, TrSetting, TrSessionsToComplete, 0, TR_FLAG_SNAPSHOT,
+                   self->sessions_to_complete);
+    tr_record_full(now_us, TrSetting, TrAutoStartBreaks, 0, TR_FLAG_SNAPSHOT,
+                   self->auto_start_breaks);
+    tr_record_full(now_us, TrSetting, TrAutoStartWork, 0, TR_FLAG_SNAPSHOT, self->auto_start_work);
+    tr_record_full(now_us, TrRoutine, self->current_routine, 0, TR_FLAG_SNAPSHOT, 0);
+
+    // A restored session can already be underway, it is stamped with the time of its last tick.
+    TmState state = tm_get_state(timer);
+    if (state != StIdle) {
+        gint64 time_us = (state == StRunning) ? (gint64) timer->last_updated_time_us : now_us;
+        tr_record_full(time_us, TrTick, state, 0, TR_FLAG_SNAPSHOT,
+                       (guint32) MIN(timer->remaining_time_ms, G_MAXUINT32));
+    }
+}
+
+void sm_restore_checkpoint(SessionManagerPtr self, const CpCheckpoint *checkpoint)
+{
+    if (checkpoint->routine > LongBreak || checkpoint->state > StPaused) {
+        g_warning("Ignoring session checkpoint with routine %u and state %u.", checkpoint->routine,
+                  checkpoint->state);
+        return;
+    }
+
+    self->current_routine = checkpoint->routine;
+    self->sessions_completed = checkpoint->sessions_completed;
+    self->total_sessions_counted = checkpoint->total_sessions_counted;
+    self->session_start_real_us = checkpoint->session_start_real_us;
+    update_projection(self);
+
+    TimerPtr timer = self->timer_instance;
+    TmState state = checkpoint->state;
+    guint64 remaining_time_ms = checkpoint->remaining_time_ms;
+
+    if (state == StIdle) {
+        tm_set_duration(timer, get_routine_duration(self, self->current_routine));
+        return;
+    }
+
+    if (state == StRunning) {
+        gint64 left_us = checkpoint->deadline_real_us - g_get_real_time();
+
+        if (left_us <= 0) {
+            // Ran out while Samaya was not running, too late to ring the bell for it.
+            tm_restore(timer, StIdle, checkpoint->initial_time_ms, 0);
+            record_history(self, checkpoint->deadline_real_us);
+            on_session_complete(NULL);
+            return;
+        }
+
+        // The wall clock may have been set back, the session can not have gained time.
+        remaining_time_ms = MIN((guint64) left_us / 1000, remaining_time_ms);
+    }
+
+    tm_restore(timer, state, checkpoint->initial_time_ms, remaining_time_ms);
+}
+
+void sm_set_count_suspended_time(SessionManagerPtr self, gboolean value)
+{
+    tm_set_clock(self->timer_instance, value ? tm_boottime_clock : NULL);
+    publish_snapshot(self);
+}
+
+void sm_set_low_power(SessionManagerPtr self, gboolean low_power)
+{
+    tm_set_coarse_ticks(self->timer_instance, low_power);
+}
+
+void sm_set_schedule(SessionManagerPtr self, const ScRule *rules, guint n_rules)
+{
+    sc_set_rules(rules, n_rules);
+
+    if (n_rules == 0) {
+        sc_disable();
+    } else if (!sc_is_enabled()) {
+        sc_enable(on_scheduled_start, self);
+    }
+}
+
+void sm_prepare_for_sleep(SessionManagerPtr self)
+{
+    tm_suspend_ticks(self->timer_instance);
+}
+
+void sm_resume_from_sleep(SessionManagerPtr self)
+{
+    self->catching_up = TRUE;
+    guint n_completed = tm_resume_ticks(self->timer_instance);
+    self->catching_up = FALSE;
+
+    if (n_completed > 0) {
+        g_info("Caught up with %u routines that ran out while asleep", n_completed);
+
+        announce_completion(self, self->last_completed_routine);
+    }
+}
+
+void sm_set_planner(SessionManagerPtr self, SmPlanFunc planner, gpointer planner_data)
+{
+    self->planner = planner;
+    self->planner_data = planner_data;
+
+    if (planner == NULL) {
+        g_clear_handle_id(&self->deferred_start_id, g_source_remove);
+    }
+}
+
+void sm_set_backend(SessionManagerPtr self, const SmBackend *backend, gpointer backend_data)
+{
+    self->backend = backend;
+    self->backend_data = backend_data;
 }
 
 void sm_set_timer_tick_callback(gboolean (*timer_instance_tick_callback)(gpointer user_data))
@@ -357,6 +831,14 @@ void sm_set_routine_update_callback(gboolean (*routine_update_callback)(gpointer
     }
 }
 
+void sm_set_history_callback(void (*history_callback)(const HsRecord *, gpointer))
+{
+    SessionManager *session_manager = sm_get_default();
+    if (session_manager) {
+        session_manager->sm_history_callback = history_callback;
+    }
+}
+
 gdouble sm_get_work_duration(SessionManagerPtr session_manager)
 {
     return session_manager->work_duration;
@@ -392,3 +874,94 @@ gchar *sm_get_formatted_time(SessionManagerPtr self)
     gchar *time_str = self->remaining_time_minutes_string->str;
     return time_str;
 }
+
+void sm_snapshot(SmSnapshot *snapshot)
+{
+    guint64 words[SNAPSHOT_WORDS];
+    guint64 sequence_before;
+    guint64 sequence_after;
+
+    do {
+        sequence_before = __atomic_load_n(&snapshotSequence, __ATOMIC_ACQUIRE);
+
+        for (gsize i = 0; i < SNAPSHOT_WORDS; i++) {
+            words[i] = __atomic_load_n(&snapshotWords[i], __ATOMIC_RELAXED);
+        }
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        sequence_after = __atomic_load_n(&snapshotSequence, __ATOMIC_RELAXED);
+    } while ((sequence_before & 1) != 0 || sequence_before != sequence_after);
+
+    memcpy(snapshot, words, sizeof(*snapshot));
+}
+
+guint64 sm_snapshot_get_remaining_ms(const SmSnapshot *snapshot)
+{
+    if (snapshot->deadline_us == 0 || snapshot->clock == NULL) {
+        return snapshot->remaining_ms;
+    }
+
+    return (guint64) MAX(snapshot->deadline_us - snapshot->clock(), 0) / 1000;
+}
+
+void sm_get_projection(SessionManagerPtr self, SmProjectedTimes *times)
+{
+    const SmProjection *projection = &self->projection;
+    gint64 session_end_real_us = get_session_end_real_us(self);
+
+    *times = (SmProjectedTimes) {
+        .session_end_real_us = session_end_real_us,
+        .long_break_start_real_us =
+            session_end_real_us + (gint64) projection->long_break_start_ms * 1000,
+        .long_break_end_real_us =
+            session_end_real_us + (gint64) projection->long_break_end_ms * 1000,
+        .work_sessions_left =
+            projection->work_sessions_left + (self->current_routine == Working ? 1 : 0),
+        .waits_for_user =
+            projection->waits_for_user || tm_get_state(self->timer_instance) != StRunning,
+    };
+}
+
+guint32 sm_count_sessions_before(SessionManagerPtr self, gint64 target_real_us)
+{
+    const SmProjection *projection = &self->projection;
+    gint64 session_end_real_us = get_session_end_real_us(self);
+
+    if (target_real_us < session_end_real_us) {
+        return 0;
+    }
+
+    guint64 budget_ms = (guint64) (target_real_us - session_end_real_us) / 1000;
+    guint32 count = (self->current_routine == Working) ? 1 : 0;
+
+    // What is left of the current cycle.
+    if (projection->work_sessions_left > 0) {
+        if (budget_ms < projection->first_work_end_ms) {
+            return count;
+        }
+
+        guint64 fitting =
+            1 + (budget_ms - projection->first_work_end_ms) / projection->work_period_ms;
+        if (fitting < projection->work_sessions_left) {
+            return count + (guint32) fitting;
+        }
+    }
+    count += projection->work_sessions_left;
+
+    if (budget_ms < projection->long_break_end_ms) {
+        return count;
+    }
+    budget_ms -= projection->long_break_end_ms;
+
+    // Whole cycles after it, then the start of the one the target falls into.
+    guint32 sessions = MAX(self->sessions_to_complete, 1);
+    count += (guint32) (budget_ms / projection->cycle_ms) * sessions;
+    budget_ms %= projection->cycle_ms;
+
+    if (budget_ms >= projection->work_ms) {
+        count += (guint32) MIN(sessions, 1 + (budget_ms - projection->work_ms) /
+                                                 projection->work_period_ms);
+    }
+
+    return count;
+}
@@ -21,7 +21,9 @@
 #pragma once
 
 #include <glib.h>
-#include <gsound.h>
+#include "samaya-checkpoint.h"
+#include "samaya-history.h"
+#include "samaya-schedule.h"
 #include "samaya-timer.h"
 
 typedef enum
@@ -31,6 +33,117 @@ typedef enum
     LongBreak,
 } RoutineType;
 
+/*  What happens besides keeping time when a routine runs out, supplied by whoever embeds the
+    session. Without a backend, or with NULL members, completions go by quietly, which is what
+    headless users of the core want.
+*/
+typedef struct
+{
+    void (*play_completion_sound)(gpointer backend_data);
+
+    // Tells the user the routine ended, the session has moved on to the next one by then.
+    void (*show_completion)(RoutineType ended_routine, gpointer backend_data);
+} SmBackend;
+
+typedef enum
+{
+    SmPlanStart,
+    SmPlanShorten,
+    SmPlanDefer,
+} SmPlanDecision;
+
+/*  Decides how a work session about to start from the beginning fits into the day, see
+    samaya-calendar.h. Returns SmPlanShorten with the length to run it for in value_ms, or
+    SmPlanDefer with the time until it should be started instead. Automatic is FALSE for sessions
+    the user started, which should not be put off.
+*/
+typedef SmPlanDecision (*SmPlanFunc)(gint64 start_real_us, guint64 duration_ms, gboolean automatic,
+                                     guint64 *value_ms, gpointer user_data);
+
+/*  Where the current cycle is heading, assuming every routine starts as soon as the one before it
+    ended.
+
+    Only changes with the routine, the settings and the sessions completed, so it is brought up to
+    date by the transitions and setters changing those rather than recomputed on every tick. All
+    durations count from the end of the current routine, sm_get_projection() turns them into wall
+    clock times.
+*/
+typedef struct
+{
+    guint64 work_ms;
+
+    // One work session along with the short break before it.
+    guint64 work_period_ms;
+
+    // A whole cycle, from the first work session to the end of the long break.
+    guint64 cycle_ms;
+
+    // Work sessions before the next long break, not counting the current routine.
+    guint32 work_sessions_left;
+
+    // Until the end of the first of those work sessions.
+    guint64 first_work_end_ms;
+
+    // Until the next long break, which is never the current routine, starts and ends.
+    guint64 long_break_start_ms;
+    guint64 long_break_end_ms;
+
+    // Some routine along the way is not started automatically.
+    gboolean waits_for_user;
+} SmProjection;
+
+// The projection in wall clock times, as microseconds since the epoch.
+typedef struct
+{
+    gint64 session_end_real_us;
+    gint64 long_break_start_real_us;
+    gint64 long_break_end_real_us;
+
+    // Work sessions left before the long break, counting the current one.
+    guint32 work_sessions_left;
+
+    // The times move on when the user does not start a routine right away, or resumes it later.
+    gboolean waits_for_user;
+} SmProjectedTimes;
+
+/*  Consistent copy of the session state, for reading it from threads other than the main one.
+
+    The main thread publishes a new one on every timer transition and tick and on every change to
+    the routine or the settings, under a sequence lock: readers copy it while watching a counter
+    the publisher bumps before and after writing, and copy again in the rare case they overlapped.
+    Neither side ever blocks the other.
+*/
+typedef struct
+{
+    // Bumped with every publication.
+    guint64 sequence;
+
+    TmState state;
+    RoutineType routine;
+
+    // On the clock below, 0 while the timer is not running.
+    gint64 deadline_us;
+    TmClockFunc clock;
+
+    // As of the last tick, see sm_snapshot_get_remaining_ms() for the running timer.
+    guint64 remaining_ms;
+    guint64 initial_ms;
+
+    gint64 session_start_real_us;
+    guint64 total_sessions_counted;
+    guint32 tag_id;
+    guint8 sessions_completed;
+    guint8 sessions_to_complete;
+
+    gboolean auto_start_breaks;
+    gboolean auto_start_work;
+
+    // In minutes, like the settings.
+    gfloat work_duration;
+    gfloat short_break_duration;
+    gfloat long_break_duration;
+} SmSnapshot;
+
 typedef struct
 {
     gfloat work_duration;
@@ -47,16 +160,39 @@ typedef struct
     guint8 sessions_completed;
     guint64 total_sessions_counted;
 
+    // Real time in microseconds the current routine was first started, 0 when it has not been yet.
+    gint64 session_start_real_us;
+
+    // Tag work sessions are recorded with, see samaya-tags.h.
+    guint32 current_tag_id;
+
+    // Set while routines that ran out during a suspend are completed, see sm_resume_from_sleep().
+    gboolean catching_up;
+    RoutineType last_completed_routine;
+
     GString *remaining_time_minutes_string;
 
+    SmProjection projection;
+
     TimerPtr timer_instance;
-    GSoundContext *gsound_ctx;
+
+    const SmBackend *backend;
+    gpointer backend_data;
+
+    SmPlanFunc planner;
+    gpointer planner_data;
+
+    // Starts a work session the planner put off.
+    guint deferred_start_id;
 
     gpointer user_data;
 
     gboolean (*sm_timer_tick_callback)(gpointer user_data);
 
     gboolean (*sm_routine_update_callback)(gpointer user_data);
+
+    // Called with every routine that ends up in the history, whether or not it is being written.
+    void (*sm_history_callback)(const HsRecord *record, gpointer user_data);
 } SessionManager;
 
 typedef SessionManager *SessionManagerPtr;
@@ -86,8 +222,49 @@ void sm_set_auto_start_work(SessionManagerPtr self, gboolean value);
 
 void sm_set_routine(RoutineType routine, SessionManager *session_manager);
 
+// Attaches the tag to the current work session and the ones after it, TG_NO_TAG for none.
+void sm_set_tag(SessionManagerPtr self, guint32 tag_id);
+
 void sm_skip_session(void);
 
+// Starts or resumes the timer for the user, a new work session is planned first.
+void sm_start(SessionManagerPtr self);
+
+// Records the current settings and routine into the event trace, so a replay starts from them.
+void sm_trace_snapshot(SessionManagerPtr self);
+
+/*  Resumes the session saved in a checkpoint. A session that ran out in the meantime is counted
+    as completed and the next routine is set up, without notifying or auto starting it.
+*/
+void sm_restore_checkpoint(SessionManagerPtr self, const CpCheckpoint *checkpoint);
+
+// Whether time spent suspended counts towards the running routine, see tm_boottime_clock().
+void sm_set_count_suspended_time(SessionManagerPtr self, gboolean value);
+
+// Ticks the running routine only once a minute and when it runs out, see samaya-low-power.h.
+void sm_set_low_power(SessionManagerPtr self, gboolean low_power);
+
+/*  Starts a work session at the times the rules give, see samaya-schedule.h. A routine that is
+    running or paused at that time is left alone. No rules turn the schedule off.
+*/
+void sm_set_schedule(SessionManagerPtr self, const ScRule *rules, guint n_rules);
+
+// Stops ticking the running routine, the system is about to go to sleep.
+void sm_prepare_for_sleep(SessionManagerPtr self);
+
+/*  Brings the session up to date after the system woke up, in one step rather than a tick at a
+    time. Routines that ran out while asleep are recorded as completed at their deadlines, and
+    the ones auto started after them are caught up with as well. The last completion is announced
+    once, the rest go by quietly.
+*/
+void sm_resume_from_sleep(SessionManagerPtr self);
+
+// Plans work sessions before they start, NULL to always run them as they are.
+void sm_set_planner(SessionManagerPtr self, SmPlanFunc planner, gpointer planner_data);
+
+// Sets how completions are announced, the backend has to outlive the session.
+void sm_set_backend(SessionManagerPtr self, const SmBackend *backend, gpointer backend_data);
+
 void sm_set_timer_tick_callback(gboolean (*timer_instance_tick_callback)(gpointer));
 
 void sm_set_timer_tick_callback_with_data(gboolean (*timer_instance_tick_callback)(gpointer),
@@ -95,6 +272,8 @@ void sm_set_timer_tick_callback_with_data(gboolean (*timer_instance_tick_callbac
 
 void sm_set_routine_update_callback(gboolean (*routine_update_callback)(gpointer));
 
+void sm_set_history_callback(void (*history_callback)(const HsRecord *, gpointer));
+
 gdouble sm_get_work_duration(SessionManagerPtr session_manager);
 
 gdouble sm_get_short_break_duration(SessionManagerPtr session_manager);
@@ -107,4 +286,19 @@ gboolean sm_get_auto_start_breaks(SessionManagerPtr self);
 
 gboolean sm_get_auto_start_work(SessionManagerPtr self);
 
+// Only for the main thread, the string is rewritten on every tick. Other threads use sm_snapshot().
 gchar *sm_get_formatted_time(SessionManagerPtr self);
+
+// Copies the last published session state, from any thread and without taking a lock.
+void sm_snapshot(SmSnapshot *snapshot);
+
+// Time left in the snapshot, worked out from the deadline while the timer runs.
+guint64 sm_snapshot_get_remaining_ms(const SmSnapshot *snapshot);
+
+/*  Projects the current cycle onto the wall clock. A routine that is not running is taken to be
+    resumed right now.
+*/
+void sm_get_projection(SessionManagerPtr self, SmProjectedTimes *times);
+
+// Work sessions that would be over by the given wall clock time, counting the current one.
+guint32 sm_count_sessions_before(SessionManagerPtr self, gint64 target_real_us);
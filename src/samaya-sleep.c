@@ -0,0 +1,188 @@
+/* samaya-sleep.c
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include <gio/gunixfdlist.h>
+#include <glib/gstdio.h>
+#include "samaya-session.h"
+#include "samaya-sleep.h"
+
+
+/* ============================================================================
+ * Static Variables
+ * ============================================================================ */
+
+static GDBusConnection *slConnection = NULL;
+static GCancellable *slCancellable = NULL;
+
+static guint slNameWatchId = 0;
+static guint slSignalId = 0;
+
+// Delay inhibitor lock handed out by logind, -1 while not holding one.
+static gint slInhibitorFd = -1;
+static gboolean slInhibitPending = FALSE;
+
+
+/* ============================================================================
+ * Internal Implementation
+ * ============================================================================ */
+
+static void release_inhibitor(void)
+{
+    if (slInhibitorFd >= 0) {
+        g_close(slInhibitorFd, NULL);
+        slInhibitorFd = -1;
+    }
+}
+
+static void on_inhibitor_taken(GObject *source_object, GAsyncResult *result, gpointer user_data)
+{
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GUnixFDList) fd_list = NULL;
+    g_autoptr(GVariant) reply = g_dbus_connection_call_with_unix_fd_list_finish(
+        G_DBUS_CONNECTION(source_object), &fd_list, result, &error);
+
+    if (reply == NULL) {
+        if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+            slInhibitPending = FALSE;
+            g_warning("Failed to delay the system going to sleep: %s", error->message);
+        }
+        return;
+    }
+    slInhibitPending = FALSE;
+
+    gint32 fd_index = 0;
+    g_variant_get(reply, "(h)", &fd_index);
+
+    gint fd = (fd_list != NULL) ? g_unix_fd_list_get(fd_list, fd_index, &error) : -1;
+    if (fd < 0) {
+        g_warning("logind did not hand out an inhibitor lock: %s",
+                  error ? error->message : "no file descriptor");
+        return;
+    }
+
+    release_inhibitor();
+    slInhibitorFd = fd;
+}
+
+static void take_inhibitor(void)
+{
+    if (slInhibitorFd >= 0 || slInhibitPending) {
+        return;
+    }
+    slInhibitPending = TRUE;
+
+    g_dbus_connection_call_with_unix_fd_list(
+        slConnection, SL_BUS_NAME, SL_OBJECT_PATH, SL_INTERFACE, "Inhibit",
+        g_variant_new("(ssss)", "sleep", "Samaya", "Stopping the timer before the system sleeps",
+                      "delay"),
+        G_VARIANT_TYPE("(h)"), G_DBUS_CALL_FLAGS_NONE, -1, NULL, slCancellable,
+        on_inhibitor_taken, NULL);
+}
+
+static void on_prepare_for_sleep(GDBusConnection *connection, const gchar *sender_name,
+                                 const gchar *object_path, const gchar *interface_name,
+                                 const gchar *signal_name, GVariant *parameters,
+                                 gpointer user_data)
+{
+    gboolean going_to_sleep = FALSE;
+
+    if (!g_variant_is_of_type(parameters, G_VARIANT_TYPE("(b)"))) {
+        return;
+    }
+    g_variant_get(parameters, "(b)", &going_to_sleep);
+
+    SessionManagerPtr session_manager = sm_get_default();
+
+    if (going_to_sleep) {
+        if (session_manager != NULL) {
+            sm_prepare_for_sleep(session_manager);
+        }
+
+        // Done with everything the lock was held for, the system sleeps once it is gone.
+        release_inhibitor();
+    } else {
+        if (session_manager != NULL) {
+            sm_resume_from_sleep(session_manager);
+        }
+
+        take_inhibitor();
+    }
+}
+
+static void on_name_appeared(GDBusConnection *connection, const gchar *name,
+                             const gchar *name_owner, gpointer user_data)
+{
+    take_inhibitor();
+}
+
+// A lock held on a logind that went away does not delay anything anymore.
+static void on_name_vanished(GDBusConnection *connection, const gchar *name, gpointer user_data)
+{
+    release_inhibitor();
+}
+
+
+/* ============================================================================
+ * Public API
+ * ============================================================================ */
+
+void sl_enable(GDBusConnection *connection)
+{
+    g_return_if_fail(G_IS_DBUS_CONNECTION(connection));
+
+    sl_disable();
+
+    slConnection = g_object_ref(connection);
+    slCancellable = g_cancellable_new();
+
+    slSignalId = g_dbus_connection_signal_subscribe(
+        slConnection, SL_BUS_NAME, SL_INTERFACE, "PrepareForSleep", SL_OBJECT_PATH, NULL,
+        G_DBUS_SIGNAL_FLAGS_NONE, on_prepare_for_sleep, NULL, NULL);
+
+    slNameWatchId =
+        g_bus_watch_name_on_connection(slConnection, SL_BUS_NAME, G_BUS_NAME_WATCHER_FLAGS_NONE,
+                                       on_name_appeared, on_name_vanished, NULL, NULL);
+}
+
+void sl_disable(void)
+{
+    if (slConnection == NULL) {
+        return;
+    }
+
+    g_cancellable_cancel(slCancellable);
+    g_clear_object(&slCancellable);
+    slInhibitPending = FALSE;
+
+    release_inhibitor();
+
+    g_clear_handle_id(&slNameWatchId, g_bus_unwatch_name);
+    if (slSignalId != 0) {
+        g_dbus_connection_signal_unsubscribe(slConnection, slSignalId);
+        slSignalId = 0;
+    }
+
+    g_clear_object(&slConnection);
+}
+
+gboolean sl_is_enabled(void)
+{
+    return slConnection != NULL;
+}
@@ -0,0 +1,45 @@
+/* samaya-sleep.h
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+/*  Keeps the running routine in step with the system going to sleep and waking up.
+
+    logind announces both with the PrepareForSleep signal. Before the system sleeps, the timer
+    stops ticking, and once it is awake again the session is brought up to date in one step, see
+    sm_resume_from_sleep(). A delay inhibitor lock is held while awake, so that the tick source is
+    gone before the system actually sleeps, and is let go of as soon as it is.
+
+    Without logind on the bus nothing happens, the timer then simply catches up on its next tick.
+*/
+
+#define SL_BUS_NAME "org.freedesktop.login1"
+#define SL_OBJECT_PATH "/org/freedesktop/login1"
+#define SL_INTERFACE "org.freedesktop.login1.Manager"
+
+// Starts following logind on the given bus, which is the system bus outside of tests.
+void sl_enable(GDBusConnection *connection);
+
+// Stops following logind and lets go of the inhibitor lock.
+void sl_disable(void);
+
+gboolean sl_is_enabled(void);
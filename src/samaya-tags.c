@@ -0,0 +1,491 @@
+/* samaya-tags.c
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <gio/gio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "samaya-session.h"
+#include "samaya-tags.h"
+
+typedef struct
+{
+    gchar *history_path;
+    // Records in the history and tags in the table when it was enabled, later ones are not summed.
+    gsize n_records;
+    guint32 n_tags;
+} TgTotalsJob;
+
+
+/* ============================================================================
+ * Static Variables
+ * ============================================================================ */
+
+static int tagsFd = -1;
+
+// Names and case folded names of the tags, indexed by id, both kept in the string pool.
+static GStringChunk *tagsPool = NULL;
+static GPtrArray *tagsNames = NULL;
+static GPtrArray *tagsKeys = NULL;
+
+static GHashTable *tagsIds = NULL;
+
+// Ids of the tags, sorted by case folded name for completion.
+static GArray *tagsSorted = NULL;
+
+// TgTotals of the tags, indexed by id. The history is added to them once tagsTotalsReady.
+static GArray *tagsTotals = NULL;
+static gboolean tagsTotalsReady = FALSE;
+static GCancellable *tagsTotalsCancellable = NULL;
+
+
+/* ============================================================================
+ * Internal Implementation
+ * ============================================================================ */
+
+static gboolean tg_write_all(int fd, const void *data, gsize size)
+{
+    const guint8 *bytes = data;
+
+    while (size > 0) {
+        ssize_t written = write(fd, bytes, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return FALSE;
+        }
+
+        bytes += written;
+        size -= (gsize) written;
+    }
+
+    return TRUE;
+}
+
+// A tag is one line of the table file, of valid UTF-8 and without surrounding whitespace.
+static gchar *tg_normalize_name(const char *name)
+{
+    gchar *normalized = g_utf8_make_valid(name, -1);
+
+    for (gchar *c = normalized; *c != '\0'; c++) {
+        if (*c == '\n' || *c == '\r' || *c == '\t') {
+            *c = ' ';
+        }
+    }
+
+    if (strlen(normalized) > TG_MAX_NAME_LENGTH) {
+        gchar *end = normalized + TG_MAX_NAME_LENGTH;
+
+        // Steps back over continuation bytes to the start of the character that did not fit.
+        while (end > normalized && (*end & 0xc0) == 0x80) {
+            end--;
+        }
+        *end = '\0';
+    }
+
+    return g_strstrip(normalized);
+}
+
+static gint tg_compare_keys(guint32 tag_id, const char *key, const char *name)
+{
+    gint result = strcmp(g_ptr_array_index(tagsKeys, tag_id), key);
+
+    return result != 0 ? result : strcmp(g_ptr_array_index(tagsNames, tag_id), name);
+}
+
+static gint tg_compare_ids(gconstpointer a, gconstpointer b)
+{
+    guint32 tag_b = *(const guint32 *) b;
+
+    return tg_compare_keys(*(const guint32 *) a, g_ptr_array_index(tagsKeys, tag_b),
+                           g_ptr_array_index(tagsNames, tag_b));
+}
+
+// Position of the first tag in the sorted index that does not come before the given key.
+static guint tg_lower_bound(const char *key, const char *name)
+{
+    guint low = 0;
+    guint high = tagsSorted->len;
+
+    while (low < high) {
+        guint middle = low + (high - low) / 2;
+        guint32 tag_id = g_array_index(tagsSorted, guint32, middle);
+
+        if (tg_compare_keys(tag_id, key, name) < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+/*  Gives the next id to the name. The sorted index is only kept sorted when asked to, loading the
+    table sorts it once at the end instead.
+*/
+static guint32 tg_add_to_table(const char *name, gboolean keep_sorted)
+{
+    guint32 tag_id = tagsNames->len;
+    g_autofree gchar *folded = g_utf8_casefold(name, -1);
+
+    const char *pooled_name = g_string_chunk_insert(tagsPool, name);
+    const char *pooled_key = g_string_chunk_insert(tagsPool, folded);
+
+    g_ptr_array_add(tagsNames, (gpointer) pooled_name);
+    g_ptr_array_add(tagsKeys, (gpointer) pooled_key);
+    g_array_set_size(tagsTotals, tag_id + 1);
+
+    // An empty or repeated line still takes up an id, only the first one gets looked up.
+    if (*name == '\0' || g_hash_table_contains(tagsIds, name)) {
+        return tag_id;
+    }
+
+    g_hash_table_insert(tagsIds, (gpointer) pooled_name, GUINT_TO_POINTER(tag_id));
+
+    if (keep_sorted) {
+        g_array_insert_val(tagsSorted, tg_lower_bound(pooled_key, pooled_name), tag_id);
+    } else {
+        g_array_append_val(tagsSorted, tag_id);
+    }
+
+    return tag_id;
+}
+
+// Reads the table, dropping a line torn by a crash so appended tags keep their ids.
+static gboolean tg_load_file(int fd, const char *path)
+{
+    g_autoptr(GError) error = NULL;
+    g_autofree gchar *contents = NULL;
+    gsize length = 0;
+
+    if (!g_file_get_contents(path, &contents, &length, &error)) {
+        g_warning("Failed to read %s, tags will not be saved: %s", path, error->message);
+        return FALSE;
+    }
+
+    gchar *end = contents + length;
+    while (end > contents && end[-1] != '\n') {
+        end--;
+    }
+
+    if (end != contents + length && ftruncate(fd, end - contents) != 0) {
+        g_warning("Failed to drop the torn tag at the end of %s: %s", path, g_strerror(errno));
+        return FALSE;
+    }
+
+    for (gchar *line = contents; line < end;) {
+        gchar *newline = memchr(line, '\n', end - line);
+        *newline = '\0';
+
+        tg_add_to_table(line, FALSE);
+        line = newline + 1;
+    }
+
+    g_array_sort(tagsSorted, tg_compare_ids);
+
+    return TRUE;
+}
+
+// Opens the table file for appending and loads it, returning -1 when tags cannot be saved.
+static int tg_open_file(const char *path)
+{
+    g_autofree gchar *directory = g_path_get_dirname(path);
+
+    if (g_mkdir_with_parents(directory, 0700) != 0) {
+        g_warning("Failed to create %s, tags will not be saved.", directory);
+        return -1;
+    }
+
+    int fd = open(path, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        g_warning("Failed to open %s, tags will not be saved: %s", path, g_strerror(errno));
+        return -1;
+    }
+
+    if (!tg_load_file(fd, path)) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static void tg_add_to_totals(GArray *totals_array, const HsRecord *record)
+{
+    if (record->routine != Working || record->tag_id == TG_NO_TAG ||
+        record->tag_id >= totals_array->len) {
+        return;
+    }
+
+    TgTotals *totals = &g_array_index(totals_array, TgTotals, record->tag_id);
+    totals->work_ms += record->duration_ms;
+
+    if (record->outcome == HsCompleted) {
+        totals->completed_sessions++;
+    }
+}
+
+static void tg_totals_job_free(gpointer data)
+{
+    TgTotalsJob *job = data;
+
+    g_free(job->history_path);
+    g_free(job);
+}
+
+static void tg_sum_totals_thread(GTask *task, gpointer source_object, gpointer task_data,
+                                 GCancellable *cancellable)
+{
+    TgTotalsJob *job = task_data;
+    GError *error = NULL;
+    const HsRecord *records = NULL;
+    gsize n_records = 0;
+
+    g_autoptr(GMappedFile) mapped = hs_map(job->history_path, &records, &n_records, &error);
+    if (mapped == NULL) {
+        g_task_return_error(task, error);
+        return;
+    }
+
+    GArray *totals = g_array_sized_new(FALSE, TRUE, sizeof(TgTotals), job->n_tags);
+    g_array_set_size(totals, job->n_tags);
+
+    for (gsize i = 0; i < MIN(n_records, job->n_records); i++) {
+        tg_add_to_totals(totals, &records[i]);
+    }
+
+    g_task_return_pointer(task, totals, (GDestroyNotify) g_array_unref);
+}
+
+// Adds the summed up history to the sessions that ended while it was being read.
+static void on_totals_summed(GObject *source_object, GAsyncResult *result, gpointer user_data)
+{
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GArray) totals = g_task_propagate_pointer(G_TASK(result), &error);
+
+    // Disabled in the meantime, the totals may already belong to a table enabled anew.
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        return;
+    }
+
+    g_clear_object(&tagsTotalsCancellable);
+    tagsTotalsReady = TRUE;
+
+    if (totals == NULL) {
+        if (!g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+            g_warning("Failed to sum up the time spent on tags: %s", error->message);
+        }
+        return;
+    }
+
+    for (guint i = 0; i < totals->len && i < tagsTotals->len; i++) {
+        TgTotals *summed = &g_array_index(totals, TgTotals, i);
+        TgTotals *current = &g_array_index(tagsTotals, TgTotals, i);
+
+        current->work_ms += summed->work_ms;
+        current->completed_sessions += summed->completed_sessions;
+    }
+}
+
+/*  Sums up the history on a worker thread, up to the records it holds now. Every session ending
+    after that goes through tg_add_record, so none is counted twice.
+*/
+static void tg_start_totals(const char *history_path)
+{
+    struct stat file_stat;
+
+    if (stat(history_path, &file_stat) != 0 || file_stat.st_size <= (off_t) sizeof(HsFileHeader)) {
+        tagsTotalsReady = TRUE;
+        return;
+    }
+
+    TgTotalsJob *job = g_new0(TgTotalsJob, 1);
+    job->history_path = g_strdup(history_path);
+    job->n_records = (file_stat.st_size - sizeof(HsFileHeader)) / sizeof(HsRecord);
+    job->n_tags = tagsTotals->len;
+
+    tagsTotalsCancellable = g_cancellable_new();
+
+    g_autoptr(GTask) task = g_task_new(NULL, tagsTotalsCancellable, on_totals_summed, NULL);
+    g_task_set_source_tag(task, tg_start_totals);
+    g_task_set_task_data(task, job, tg_totals_job_free);
+    g_task_run_in_thread(task, tg_sum_totals_thread);
+}
+
+
+/* ============================================================================
+ * Public API
+ * ============================================================================ */
+
+void tg_enable(const char *tags_path, const char *history_path)
+{
+    tg_disable();
+
+    tagsPool = g_string_chunk_new(4096);
+    tagsNames = g_ptr_array_new();
+    tagsKeys = g_ptr_array_new();
+    tagsIds = g_hash_table_new(g_str_hash, g_str_equal);
+    tagsSorted = g_array_new(FALSE, FALSE, sizeof(guint32));
+    tagsTotals = g_array_new(FALSE, TRUE, sizeof(TgTotals));
+
+    // Id 0 is TG_NO_TAG.
+    g_ptr_array_add(tagsNames, NULL);
+    g_ptr_array_add(tagsKeys, NULL);
+    g_array_set_size(tagsTotals, 1);
+
+    tagsFd = tg_open_file(tags_path);
+    tg_start_totals(history_path);
+}
+
+void tg_disable(void)
+{
+    if (tagsFd >= 0) {
+        close(tagsFd);
+        tagsFd = -1;
+    }
+
+    if (tagsTotalsCancellable != NULL) {
+        g_cancellable_cancel(tagsTotalsCancellable);
+        g_clear_object(&tagsTotalsCancellable);
+    }
+
+    g_clear_pointer(&tagsIds, g_hash_table_unref);
+    g_clear_pointer(&tagsNames, g_ptr_array_unref);
+    g_clear_pointer(&tagsKeys, g_ptr_array_unref);
+    g_clear_pointer(&tagsSorted, g_array_unref);
+    g_clear_pointer(&tagsTotals, g_array_unref);
+    g_clear_pointer(&tagsPool, g_string_chunk_free);
+    tagsTotalsReady = FALSE;
+}
+
+gboolean tg_is_enabled(void)
+{
+    return tagsNames != NULL;
+}
+
+guint32 tg_intern(const char *name)
+{
+    if (tagsNames == NULL || name == NULL) {
+        return TG_NO_TAG;
+    }
+
+    g_autofree gchar *normalized = tg_normalize_name(name);
+    if (*normalized == '\0') {
+        return TG_NO_TAG;
+    }
+
+    gpointer tag_id = NULL;
+    if (g_hash_table_lookup_extended(tagsIds, normalized, NULL, &tag_id)) {
+        return GPOINTER_TO_UINT(tag_id);
+    }
+
+    // Written out first, an id that did not make it into the file would be handed out again.
+    if (tagsFd < 0) {
+        return TG_NO_TAG;
+    }
+
+    g_autofree gchar *line = g_strconcat(normalized, "\n", NULL);
+    if (!tg_write_all(tagsFd, line, strlen(line))) {
+        g_warning("Failed to save the tag, tags will not be saved anymore: %s",
+                  g_strerror(errno));
+        close(tagsFd);
+        tagsFd = -1;
+        return TG_NO_TAG;
+    }
+
+    return tg_add_to_table(normalized, TRUE);
+}
+
+guint32 tg_lookup(const char *name)
+{
+    if (tagsIds == NULL || name == NULL) {
+        return TG_NO_TAG;
+    }
+
+    g_autofree gchar *normalized = tg_normalize_name(name);
+
+    return GPOINTER_TO_UINT(g_hash_table_lookup(tagsIds, normalized));
+}
+
+const char *tg_get_name(guint32 tag_id)
+{
+    if (tagsNames == NULL || tag_id >= tagsNames->len) {
+        return NULL;
+    }
+
+    return g_ptr_array_index(tagsNames, tag_id);
+}
+
+guint32 tg_get_n_tags(void)
+{
+    return tagsSorted != NULL ? tagsSorted->len : 0;
+}
+
+guint tg_complete(const char *prefix, guint32 *tag_ids, guint max_tags)
+{
+    if (tagsSorted == NULL || prefix == NULL) {
+        return 0;
+    }
+
+    g_autofree gchar *normalized = g_utf8_make_valid(prefix, -1);
+    g_autofree gchar *key = g_utf8_casefold(g_strchug(normalized), -1);
+    gsize key_length = strlen(key);
+    guint n_found = 0;
+
+    for (guint i = tg_lower_bound(key, ""); i < tagsSorted->len && n_found < max_tags; i++) {
+        guint32 tag_id = g_array_index(tagsSorted, guint32, i);
+
+        if (strncmp(g_ptr_array_index(tagsKeys, tag_id), key, key_length) != 0) {
+            break;
+        }
+        tag_ids[n_found++] = tag_id;
+    }
+
+    return n_found;
+}
+
+TgTotals tg_get_totals(guint32 tag_id)
+{
+    TgTotals totals = {0};
+
+    if (tagsTotals == NULL || tag_id == TG_NO_TAG || tag_id >= tagsTotals->len) {
+        return totals;
+    }
+
+    return g_array_index(tagsTotals, TgTotals, tag_id);
+}
+
+void tg_add_record(const HsRecord *record)
+{
+    if (tagsTotals == NULL) {
+        return;
+    }
+
+    tg_add_to_totals(tagsTotals, record);
+}
+
+gboolean tg_totals_are_ready(void)
+{
+    return tagsTotalsReady;
+}
@@ -0,0 +1,85 @@
+/* samaya-tags.h
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <glib.h>
+#include "samaya-history.h"
+
+/*  Tags the user attaches to work sessions, to tell which project they went into.
+
+    Tags are interned into a table of small ids, which is what history records store. The table is
+    kept in a text file with one tag per line, the id of a tag being its line number, and is only
+    ever appended to, so ids stay valid for as long as the history lives.
+
+    The time and sessions that went into each tag are summed up from the history on a worker thread
+    when the table is enabled, and kept up to date with every session that ends from then on.
+    Completion looks tags up by prefix in an index sorted by their case folded names.
+*/
+
+#define TG_NO_TAG 0
+
+// Longest tag name in bytes, longer ones are cut at a character boundary.
+#define TG_MAX_NAME_LENGTH 128
+
+typedef struct
+{
+    // Time the work sessions with the tag ran for, and how many of them ran out.
+    guint64 work_ms;
+    guint32 completed_sessions;
+} TgTotals;
+
+/*  Loads the tag table from tags_path, creating it and its directory if needed, and starts summing
+    up the totals from history_path. The totals are added in the thread-default main context.
+*/
+void tg_enable(const char *tags_path, const char *history_path);
+
+void tg_disable(void);
+
+gboolean tg_is_enabled(void);
+
+/*  Returns the id of the tag with the given name, adding it to the table when it is new. Leading
+    and trailing whitespace is dropped, an empty name gives TG_NO_TAG.
+*/
+guint32 tg_intern(const char *name);
+
+// Returns the id of the tag with the given name, TG_NO_TAG when there is none.
+guint32 tg_lookup(const char *name);
+
+// Name of the tag, NULL for TG_NO_TAG and unknown ids. Valid until the table is disabled.
+const char *tg_get_name(guint32 tag_id);
+
+guint32 tg_get_n_tags(void);
+
+/*  Fills tag_ids with up to max_tags tags whose name starts with the given prefix, ignoring case,
+    in alphabetical order. Returns how many were found.
+*/
+guint tg_complete(const char *prefix, guint32 *tag_ids, guint max_tags);
+
+/*  Totals of the tag, zero for TG_NO_TAG and unknown ids. Until tg_totals_are_ready, only the
+    sessions that ended since the table was enabled are counted.
+*/
+TgTotals tg_get_totals(guint32 tag_id);
+
+// Adds a session that just ended to the totals of its tag.
+void tg_add_record(const HsRecord *record);
+
+// Whether the history from before the table was enabled has been added to the totals.
+gboolean tg_totals_are_ready(void);
@@ -0,0 +1,36 @@
+/* samaya-timer-private.h
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <glib.h>
+#include "samaya-timer.h"
+
+/*  Internal entry points of the timer state machine.
+
+    These are only exposed so that benchmarks and developer tools can drive the state machine
+    directly, application code should always go through the API in samaya-timer.h.
+*/
+
+// Looks up the transition for the current state and event, and runs its action.
+void tm_process_transition(TimerPtr self, TmEvent event);
+
+// Tick source callback of a running timer, returns G_SOURCE_REMOVE once the timer stops.
+gboolean tm_run_tick(gpointer timer_ptr);
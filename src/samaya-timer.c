@@ -18,8 +18,11 @@
  * SPDX-License-Identifier: AGPL-3.0-or-later
  */
 
+#include <time.h>
 #include "glib.h"
+#include "samaya-timer-private.h"
 #include "samaya-timer.h"
+#include "samaya-trace.h"
 #include "samaya-utils.h"
 
 
@@ -27,18 +30,33 @@
  * Internal Implementation
  * ============================================================================ */
 
-static gboolean tm_run_tick(gpointer user_data);
-
-typedef void (*TmTransitionAction)(TimerPtr self);
+typedef void (*TmTransitionAction)(TimerPtr self, gint64 now_us);
 
 typedef struct
 {
-    TmState current_state;
-    TmEvent event;
+    gboolean valid;
     TmState next_state;
     TmTransitionAction action;
 } TmStateTransition;
 
+static const char *const tmStateNames[TM_N_STATES] = {
+    [StIdle] = "Idle",
+    [StRunning] = "Running",
+    [StPaused] = "Paused",
+    [StExited] = "Exited",
+};
+
+static const char *const tmEventNames[TM_N_EVENTS] = {
+    [EvStart] = "Start",
+    [EvStop] = "Stop",
+    [EvReset] = "Reset",
+};
+
+static inline gint64 tm_now(TimerPtr self)
+{
+    return self->tm_clock();
+}
+
 static void update_progress(TimerPtr self)
 {
     if (self->initial_time_ms > 0) {
@@ -53,7 +71,7 @@ static gfloat get_instant_progress(TimerPtr self)
     if (self->initial_time_ms <= 0)
         return 0.0f;
 
-    guint64 current_time_us = g_get_monotonic_time();
+    guint64 current_time_us = tm_now(self);
     guint64 elapsed_since_update_us = guint64_sat_sub(current_time_us, self->last_updated_time_us);
 
     guint64 elapsed_since_update_ms = elapsed_since_update_us / 1000;
@@ -71,23 +89,54 @@ static void notify_time_update(TimerPtr self)
     }
 }
 
-static void action_start_timer(TimerPtr self)
+static void notify_event_update(TimerPtr self)
 {
-    self->last_updated_time_us = g_get_monotonic_time();
+    if (self->tm_event_update) {
+        self->tm_event_update(self);
+    }
+}
+
+static guint get_tick_interval_ms(TimerPtr self)
+{
+    if (!self->coarse_ticks) {
+        return TM_TICK_INTERVAL_MS;
+    }
+
+    guint64 since_update_ms = guint64_sat_sub(tm_now(self), self->last_updated_time_us) / 1000;
+    guint64 left_ms = guint64_sat_sub(self->remaining_time_ms, since_update_ms);
+
+    guint64 to_minute_ms = left_ms % TM_COARSE_TICK_INTERVAL_MS;
+    guint64 interval_ms = (to_minute_ms > TM_COARSE_TICK_LEAD_MS)
+                              ? to_minute_ms - TM_COARSE_TICK_LEAD_MS
+                              : to_minute_ms + TM_COARSE_TICK_INTERVAL_MS - TM_COARSE_TICK_LEAD_MS;
+
+    // The last tick lands on the deadline itself.
+    return (guint) MAX(MIN(interval_ms, left_ms), 1);
+}
 
+static void schedule_tick(TimerPtr self)
+{
     if (self->tick_source_id > 0) {
         g_source_remove(self->tick_source_id);
     }
 
-    self->tick_source_id = g_timeout_add(1000, tm_run_tick, self);
+    self->tick_interval_ms = get_tick_interval_ms(self);
+    self->tick_source_id = g_timeout_add(self->tick_interval_ms, tm_run_tick, self);
+}
+
+static void action_start_timer(TimerPtr self, gint64 now_us)
+{
+    self->last_updated_time_us = now_us;
+
+    schedule_tick(self);
 }
 
 // TODO: This function, tm_run_tick and get_instant_progress all are basically doing the same
 // calcualation but code is repeated again and again in all 3. Make a single function for this and
 // call that function instead.
-static void action_stop_timer(TimerPtr self)
+static void action_stop_timer(TimerPtr self, gint64 now_us)
 {
-    guint64 current_time_us = g_get_monotonic_time();
+    guint64 current_time_us = now_us;
     guint64 elapsed_time_us = guint64_sat_sub(current_time_us, self->last_updated_time_us);
 
     gint64 elapsed_time_ms = elapsed_time_us / 1000;
@@ -102,9 +151,9 @@ static void action_stop_timer(TimerPtr self)
     }
 }
 
-static void action_reset(TimerPtr self)
+static void action_reset(TimerPtr self, gint64 now_us)
 {
-    action_stop_timer(self);
+    action_stop_timer(self, now_us);
 
     self->remaining_time_ms = self->initial_time_ms;
     self->timer_progress = 1.0f;
@@ -113,51 +162,89 @@ static void action_reset(TimerPtr self)
     g_info("Session Reset");
 }
 
-static void action_sync_time(TimerPtr self)
+static void action_sync_time(TimerPtr self, gint64 now_us)
 {
-    self->last_updated_time_us = g_get_monotonic_time();
-    action_start_timer(self);
+    self->last_updated_time_us = now_us;
+    action_start_timer(self, now_us);
 }
 
+/*  Every event in every state, either leading to the next state through an action (NULL to only
+    change the state) or rejected.
+
+    Each pair has to be listed exactly once: a missing one fails the count below and a repeated one
+    overrides an initializer, which -Woverride-init turns into an error.
+*/
 // clang-format off
-static const TmStateTransition tmStateTransitionMatrix[] = {
-    {StIdle,    EvStart,    StRunning,  action_start_timer },
-    {StIdle,    EvReset,    StIdle,     action_reset       },
-    {StRunning, EvStart,    StRunning,  NULL               },
-    {StRunning, EvReset,    StIdle,     action_reset       },
-    {StRunning, EvStop,     StPaused,   action_stop_timer  },
-    {StPaused,  EvStart,    StRunning,  action_sync_time   },
-    {StPaused,  EvStop,     StPaused,   NULL               },
-    {StPaused,  EvReset,    StIdle,     action_reset       }
-};
+#define TM_TRANSITION_TABLE(TRANSITION, REJECT)                         \
+    TRANSITION(StIdle,    EvStart,  StRunning,  action_start_timer)     \
+    REJECT(    StIdle,    EvStop)                                       \
+    TRANSITION(StIdle,    EvReset,  StIdle,     action_reset)           \
+    TRANSITION(StRunning, EvStart,  StRunning,  NULL)                   \
+    TRANSITION(StRunning, EvStop,   StPaused,   action_stop_timer)      \
+    TRANSITION(StRunning, EvReset,  StIdle,     action_reset)           \
+    TRANSITION(StPaused,  EvStart,  StRunning,  action_sync_time)       \
+    TRANSITION(StPaused,  EvStop,   StPaused,   NULL)                   \
+    TRANSITION(StPaused,  EvReset,  StIdle,     action_reset)           \
+    REJECT(    StExited,  EvStart)                                      \
+    REJECT(    StExited,  EvStop)                                       \
+    REJECT(    StExited,  EvReset)
 // clang-format on
 
-static void tm_process_transition(TimerPtr self, TmEvent event)
+#define TM_DEFINE_TRANSITION(state, event, next, action_func) \
+    [state][event] = {TRUE, next, action_func},
+#define TM_DEFINE_REJECT(state, event) [state][event] = {FALSE, state, NULL},
+
+static const TmStateTransition tmTransitions[TM_N_STATES][TM_N_EVENTS] = {
+    TM_TRANSITION_TABLE(TM_DEFINE_TRANSITION, TM_DEFINE_REJECT)
+};
+
+#define TM_COUNT_PAIR(...) +1
+G_STATIC_ASSERT(0 TM_TRANSITION_TABLE(TM_COUNT_PAIR, TM_COUNT_PAIR) == TM_N_STATES * TM_N_EVENTS);
+
+void tm_process_transition(TimerPtr self, TmEvent event)
 {
     TmState current_state = self->tm_state;
-    const TmStateTransition *transition = NULL;
 
-    for (guint i = 0; i < G_N_ELEMENTS(tmStateTransitionMatrix); i++) {
-        if (tmStateTransitionMatrix[i].current_state == current_state &&
-            tmStateTransitionMatrix[i].event == event) {
-            transition = &tmStateTransitionMatrix[i];
-            break;
-        }
+    // Transitions caused by a completing tick happen at the time of that tick.
+    gint64 now_us = (self->dispatch_time_us > 0) ? self->dispatch_time_us : tm_now(self);
+
+    tr_record_full(now_us, TrEvent, event, 0, 0, 0);
+
+    // Events replayed from a trace come straight from a file.
+    if ((guint) current_state >= TM_N_STATES || (guint) event >= TM_N_EVENTS) {
+        g_warning("Invalid transition. State: %d, Event: %d", current_state, event);
+        return;
     }
 
-    if (transition == NULL) {
+    const TmStateTransition *transition = &tmTransitions[current_state][event];
+    TmTransitionStats *stats = &self->transition_stats[current_state][event];
+
+    if (!transition->valid) {
+        stats->n_rejected++;
         g_warning("Invalid transition. State: %d, Event: %d", current_state, event);
         return;
     }
 
+    stats->count++;
+
     self->tm_state = transition->next_state;
+    tr_record_full(now_us, TrTransition, current_state, transition->next_state, 0, 0);
 
     if (transition->action != NULL) {
-        transition->action(self);
+        gint64 action_start_us = g_get_monotonic_time();
+
+        transition->action(self, now_us);
+
+        // The update callback writes the checkpoint and runs the hooks and the UI.
+        gint64 update_start_us = g_get_monotonic_time();
+        notify_event_update(self);
+
+        stats->action_time_us += update_start_us - action_start_us;
+        stats->update_time_us += g_get_monotonic_time() - update_start_us;
     }
 }
 
-static gboolean tm_run_tick(gpointer timer_ptr)
+gboolean tm_run_tick(gpointer timer_ptr)
 {
     TimerPtr self = timer_ptr;
 
@@ -166,23 +253,39 @@ static gboolean tm_run_tick(gpointer timer_ptr)
         return G_SOURCE_REMOVE;
     }
 
-    guint64 current_time_us = g_get_monotonic_time();
+    guint64 current_time_us = tm_now(self);
     guint64 elapsed_time_us = guint64_sat_sub(current_time_us, self->last_updated_time_us);
+    guint64 deadline_us = self->last_updated_time_us + self->remaining_time_ms * 1000;
     self->last_updated_time_us = current_time_us;
 
+    self->tick_stats.n_ticks++;
+    self->tick_stats.last_jitter_us = (gint64) elapsed_time_us - self->tick_interval_ms * 1000;
+    if (elapsed_time_us >= self->remaining_time_ms * 1000) {
+        self->tick_stats.completion_latency_us =
+            (gint64) (elapsed_time_us - self->remaining_time_ms * 1000);
+    }
+
     gint64 elapsed_time_ms = elapsed_time_us / 1000;
     self->remaining_time_ms = guint64_sat_sub(self->remaining_time_ms, elapsed_time_ms);
+    tr_record_full(current_time_us, TrTick, 0, 0, 0,
+                   (guint32) MIN(self->remaining_time_ms, G_MAXUINT32));
 
     update_progress(self);
     notify_time_update(self);
 
     if (self->remaining_time_ms == 0) {
         self->tm_state = StIdle;
+        tr_record_full(current_time_us, TrTransition, StRunning, StIdle, 0, 0);
 
+        // The next routine starts when this one ran out, however late the tick noticed it.
         if (self->tm_time_complete) {
+            self->dispatch_time_us = (gint64) deadline_us;
             self->tm_time_complete(self);
+            self->dispatch_time_us = 0;
         }
 
+        notify_event_update(self);
+
         if (self->tm_state != StRunning) {
             self->tick_source_id = 0;
         }
@@ -190,6 +293,12 @@ static gboolean tm_run_tick(gpointer timer_ptr)
         return G_SOURCE_REMOVE;
     }
 
+    // Coarse ticks are each scheduled for the next minute, rather than repeating.
+    if (self->coarse_ticks) {
+        schedule_tick(self);
+        return G_SOURCE_REMOVE;
+    }
+
     return G_SOURCE_CONTINUE;
 }
 
@@ -212,6 +321,9 @@ TimerPtr tm_new(float duration_minutes, TmCallback time_complete, TmCallback tim
     timer->tm_time_complete = time_complete;
     timer->tm_event_update = event_update;
 
+    timer->tm_clock = g_get_monotonic_time;
+    timer->tick_interval_ms = TM_TICK_INTERVAL_MS;
+
     return timer;
 }
 
@@ -237,6 +349,37 @@ TmState tm_get_state(TimerPtr self)
     return self->tm_state;
 }
 
+const TmTickStats *tm_get_tick_stats(TimerPtr self)
+{
+    return &self->tick_stats;
+}
+
+const TmTransitionStats *tm_get_transition_stats(TimerPtr self, TmState state, TmEvent event)
+{
+    g_return_val_if_fail((guint) state < TM_N_STATES && (guint) event < TM_N_EVENTS, NULL);
+
+    return &self->transition_stats[state][event];
+}
+
+gboolean tm_is_transition_valid(TmState state, TmEvent event)
+{
+    if ((guint) state >= TM_N_STATES || (guint) event >= TM_N_EVENTS) {
+        return FALSE;
+    }
+
+    return tmTransitions[state][event].valid;
+}
+
+const char *tm_state_to_string(TmState state)
+{
+    return (guint) state < TM_N_STATES ? tmStateNames[state] : "Unknown";
+}
+
+const char *tm_event_to_string(TmEvent event)
+{
+    return (guint) event < TM_N_EVENTS ? tmEventNames[event] : "Unknown";
+}
+
 gfloat tm_get_progress(TimerPtr self)
 {
     if (self->tm_state == StRunning) {
@@ -257,3 +400,130 @@ void tm_set_duration(TimerPtr self, gfloat initial_time_minutes)
 
     notify_time_update(self);
 }
+
+void tm_set_coarse_ticks(TimerPtr self, gboolean coarse_ticks)
+{
+    if (self->coarse_ticks == coarse_ticks) {
+        return;
+    }
+    self->coarse_ticks = coarse_ticks;
+
+    if (self->tm_state == StRunning && self->tick_source_id > 0) {
+        schedule_tick(self);
+    }
+}
+
+gint64 tm_boottime_clock(void)
+{
+#ifdef CLOCK_BOOTTIME
+    struct timespec now;
+
+    if (clock_gettime(CLOCK_BOOTTIME, &now) == 0) {
+        return (gint64) now.tv_sec * G_USEC_PER_SEC + now.tv_nsec / 1000;
+    }
+#endif
+
+    return g_get_monotonic_time();
+}
+
+void tm_set_clock(TimerPtr self, TmClockFunc clock)
+{
+    // Whatever ran since the last tick is carried over to the new clock.
+    guint64 since_update_us = guint64_sat_sub(tm_now(self), self->last_updated_time_us);
+
+    self->tm_clock = clock ? clock : g_get_monotonic_time;
+    self->last_updated_time_us = tm_now(self);
+
+    if (self->tm_state == StRunning) {
+        self->last_updated_time_us = guint64_sat_sub(self->last_updated_time_us, since_update_us);
+    }
+}
+
+void tm_suspend_ticks(TimerPtr self)
+{
+    if (self->tick_source_id > 0) {
+        g_source_remove(self->tick_source_id);
+        self->tick_source_id = 0;
+    }
+}
+
+guint tm_resume_ticks(TimerPtr self)
+{
+    guint n_completed = 0;
+    gint64 previous_deadline_us = 0;
+
+    // Every routine that ran out in the meantime completes at its own deadline, auto starting the
+    // next one from there. A routine that does not move the deadline on would never catch up.
+    while (self->tm_state == StRunning) {
+        gint64 deadline_us = tm_get_deadline_us(self);
+        if (deadline_us > tm_now(self) || deadline_us <= previous_deadline_us) {
+            break;
+        }
+        previous_deadline_us = deadline_us;
+
+        // Ticks run by hand, the source an auto started routine added is not needed yet.
+        tm_suspend_ticks(self);
+        tm_run_tick(self);
+        n_completed++;
+    }
+
+    if (self->tm_state == StRunning) {
+        tm_suspend_ticks(self);
+        tm_run_tick(self);
+    }
+
+    if (self->tm_state == StRunning) {
+        schedule_tick(self);
+
+        // Anything following the deadline on another clock has to look again, that clock did not
+        // move on while the system was asleep.
+        notify_event_update(self);
+    }
+
+    return n_completed;
+}
+
+gint64 tm_get_deadline_us(TimerPtr self)
+{
+    if (self->tm_state != StRunning) {
+        return 0;
+    }
+
+    return (gint64) (self->last_updated_time_us + self->remaining_time_ms * 1000);
+}
+
+void tm_restore(TimerPtr self, TmState state, guint64 initial_time_ms, guint64 remaining_time_ms)
+{
+    if (self->tick_source_id > 0) {
+        g_source_remove(self->tick_source_id);
+        self->tick_source_id = 0;
+    }
+
+    self->initial_time_ms = initial_time_ms;
+    self->remaining_time_ms = MIN(remaining_time_ms, initial_time_ms);
+    update_progress(self);
+
+    self->tm_state = (state == StRunning || state == StPaused) ? state : StIdle;
+    if (self->tm_state == StRunning) {
+        action_start_timer(self, tm_now(self));
+    }
+
+    notify_time_update(self);
+}
+
+void tm_add_time(TimerPtr self, guint64 time_ms)
+{
+    if (self->tm_state != StPaused) {
+        g_warning("Time can only be added to a paused timer. State: %d", self->tm_state);
+        return;
+    }
+
+    tr_record_full(tm_now(self), TrAddTime, 0, 0, 0, (guint32) MIN(time_ms, G_MAXUINT32));
+
+    self->remaining_time_ms =
+        MIN(self->remaining_time_ms + MIN(time_ms, G_MAXUINT32), self->initial_time_ms);
+    update_progress(self);
+
+    notify_time_update(self);
+    notify_event_update(self);
+}
@@ -37,20 +37,69 @@ typedef enum
     EvReset,
 } TmEvent;
 
+// Sizes of the transition table, StExited and EvReset have to stay the last of their kind.
+#define TM_N_STATES (StExited + 1)
+#define TM_N_EVENTS (EvReset + 1)
+
+// How often an event arrived in a state, and the time the transition it led to took.
+typedef struct
+{
+    // Transitions taken, the events rejected in this state are counted apart.
+    guint64 count;
+    guint64 n_rejected;
+
+    // Spent in the action of the transition, and in the event update callback that followed it.
+    gint64 action_time_us;
+    gint64 update_time_us;
+} TmTransitionStats;
+
 typedef struct Timer Timer;
 typedef Timer *TimerPtr;
 
 typedef void (*TmCallback)(gpointer callback_data);
 
+// Source of monotonic time in microseconds, g_get_monotonic_time() unless overridden.
+typedef gint64 (*TmClockFunc)(void);
+
+// Period of the tick source of a running timer.
+#define TM_TICK_INTERVAL_MS 1000
+
+/*  With coarse ticks, a running timer is ticked as its remaining time reaches a whole minute and
+    when it runs out. The minute ticks come a little before the minute, so that one running late
+    still shows the minute it was meant for.
+*/
+#define TM_COARSE_TICK_INTERVAL_MS (60 * 1000)
+#define TM_COARSE_TICK_LEAD_MS 500
+
+// How well the tick source kept time, for diagnostics.
+typedef struct
+{
+    // Ticks run since the timer was created.
+    guint64 n_ticks;
+
+    // How much later than it was scheduled for the last tick ran.
+    gint64 last_jitter_us;
+
+    // How long after its deadline the last timer to run out was noticed by a tick.
+    gint64 completion_latency_us;
+} TmTickStats;
+
 struct Timer
 {
     guint tick_source_id;
     TmState tm_state;
 
+    // See TM_COARSE_TICK_INTERVAL_MS, and the time the pending tick was scheduled after.
+    gboolean coarse_ticks;
+    guint tick_interval_ms;
+
     guint64 initial_time_ms;
     guint64 remaining_time_ms;
     guint64 last_updated_time_us;
 
+    // Time of the tick currently completing the timer, 0 outside of the completion callback.
+    gint64 dispatch_time_us;
+
     gfloat timer_progress;
 
     guint32 tm_sleep_time_ms;
@@ -58,12 +107,20 @@ struct Timer
     TmCallback tm_time_update;
     TmCallback tm_time_complete;
     TmCallback tm_event_update;
+
+    TmClockFunc tm_clock;
+
+    TmTickStats tick_stats;
+    TmTransitionStats transition_stats[TM_N_STATES][TM_N_EVENTS];
 };
 
 /*  Constructs a new instance of the timer on the heap and returns a pointer to it.
 
     Timer instance constructed using this function should be de-initialised using tm_free, or else
     will leak memory.
+
+    event_update is called with the timer after every event that changed its state, and after a
+    tick ran the timer out.
 */
 TimerPtr tm_new(float duration_minutes, TmCallback time_complete, TmCallback time_update,
                 TmCallback event_update);
@@ -83,5 +140,58 @@ gfloat tm_get_progress(TimerPtr self);
 // Get the remaining time for the timer to complete.
 gint64 tm_get_remaining_time_ms(TimerPtr self);
 
+// Time of the timer clock the running timer will run out at, 0 when it is not running.
+gint64 tm_get_deadline_us(TimerPtr self);
+
+const TmTickStats *tm_get_tick_stats(TimerPtr self);
+
+// Statistics of the given event arriving in the given state, rejected ones are counted as well.
+const TmTransitionStats *tm_get_transition_stats(TimerPtr self, TmState state, TmEvent event);
+
+// Whether the event leads anywhere from the state, events that do not are rejected with a warning.
+gboolean tm_is_transition_valid(TmState state, TmEvent event);
+
+const char *tm_state_to_string(TmState state);
+
+const char *tm_event_to_string(TmEvent event);
+
+/*  Puts the timer straight into the given state without going through the state machine, used to
+    resume a checkpointed session. A running timer starts ticking again from now.
+
+    The event update callback is not called, as nothing changed from the point of view of whoever
+    saved the state.
+*/
+void tm_restore(TimerPtr self, TmState state, guint64 initial_time_ms, guint64 remaining_time_ms);
+
+// Gives time back to a paused timer, the remaining time never grows past the initial time.
+void tm_add_time(TimerPtr self, guint64 time_ms);
+
 // Sets the duration the timer will tick.
 void tm_set_duration(TimerPtr self, gfloat initial_time_minutes);
+
+/*  Replaces the clock the timer measures elapsed time with, passing NULL restores the default
+    monotonic clock.
+
+    A running timer keeps the time it ran since its last tick. Mainly useful for driving the timer
+    with a fake clock in benchmarks and tools, or with tm_boottime_clock().
+*/
+void tm_set_clock(TimerPtr self, TmClockFunc clock);
+
+// Ticks a running timer only every minute and when it runs out instead of every second.
+void tm_set_coarse_ticks(TimerPtr self, gboolean coarse_ticks);
+
+// Monotonic clock that keeps counting while the system is suspended, where there is one.
+gint64 tm_boottime_clock(void);
+
+/*  Removes the tick source of a running timer, which stays running without being ticked. Meant for
+    right before the system goes to sleep, tm_resume_ticks() picks up from there.
+*/
+void tm_suspend_ticks(TimerPtr self);
+
+/*  Brings a running timer up to date in one go and starts ticking it again.
+
+    Every routine that ran out since the last tick completes at its own deadline, and when the
+    completion starts the next routine, that one counts from the same deadline and may run out as
+    well. Returns how many routines completed.
+*/
+guint tm_resume_ticks(TimerPtr self);
@@ -0,0 +1,348 @@
+/* samaya-trace.c
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <gio/gio.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include "samaya-trace.h"
+
+typedef struct
+{
+    TrRecord *records;
+    guint64 mask;
+    guint64 written;
+
+    guint internal_depth;
+
+    TmClockFunc clock;
+    gchar *crash_path;
+} TrBuffer;
+
+
+/* ============================================================================
+ * Static Variables
+ * ============================================================================ */
+
+static TrBuffer *activeTrace = NULL;
+
+static const int crashSignals[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+static struct sigaction previousActions[G_N_ELEMENTS(crashSignals)];
+static gboolean crashHandlersInstalled = FALSE;
+
+
+/* ============================================================================
+ * Internal Implementation
+ * ============================================================================ */
+
+static guint64 tr_buffered_count(const TrBuffer *trace)
+{
+    return MIN(trace->written, trace->mask + 1);
+}
+
+static void tr_fill_header(TrFileHeader *header, guint64 n_records)
+{
+    memcpy(header->magic, TR_FILE_MAGIC, sizeof(header->magic));
+    header->version = TR_FILE_VERSION;
+    header->record_size = sizeof(TrRecord);
+    header->n_records = n_records;
+}
+
+// Copies the buffered records in chronological order, the ring may have wrapped around.
+static void tr_copy_ordered(const TrBuffer *trace, TrRecord *dest, guint64 n_records)
+{
+    guint64 start = (trace->written - n_records) & trace->mask;
+    guint64 head_count = MIN(n_records, trace->mask + 1 - start);
+
+    memcpy(dest, &trace->records[start], head_count * sizeof(TrRecord));
+    memcpy(dest + head_count, trace->records, (n_records - head_count) * sizeof(TrRecord));
+}
+
+// Only async-signal-safe calls from here on until the end of on_fatal_signal.
+static void write_all(int fd, const void *data, gsize size)
+{
+    const guint8 *bytes = data;
+
+    while (size > 0) {
+        ssize_t written = write(fd, bytes, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+
+        bytes += written;
+        size -= (gsize) written;
+    }
+}
+
+static void on_fatal_signal(int signum)
+{
+    TrBuffer *trace = activeTrace;
+
+    if (trace != NULL && trace->crash_path != NULL) {
+        int fd = open(trace->crash_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+
+        if (fd >= 0) {
+            guint64 n_records = tr_buffered_count(trace);
+            guint64 start = (trace->written - n_records) & trace->mask;
+            guint64 head_count = MIN(n_records, trace->mask + 1 - start);
+
+            TrFileHeader header;
+            tr_fill_header(&header, n_records);
+
+            write_all(fd, &header, sizeof(header));
+            write_all(fd, &trace->records[start], head_count * sizeof(TrRecord));
+            write_all(fd, trace->records, (n_records - head_count) * sizeof(TrRecord));
+            close(fd);
+        }
+    }
+
+    // The handler was installed with SA_RESETHAND, so this ends in the default action.
+    raise(signum);
+}
+
+static void tr_install_crash_handlers(void)
+{
+    struct sigaction action;
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = on_fatal_signal;
+    action.sa_flags = SA_RESETHAND;
+    sigemptyset(&action.sa_mask);
+
+    for (guint i = 0; i < G_N_ELEMENTS(crashSignals); i++) {
+        sigaction(crashSignals[i], &action, &previousActions[i]);
+    }
+
+    crashHandlersInstalled = TRUE;
+}
+
+static void tr_remove_crash_handlers(void)
+{
+    if (!crashHandlersInstalled) {
+        return;
+    }
+
+    for (guint i = 0; i < G_N_ELEMENTS(crashSignals); i++) {
+        sigaction(crashSignals[i], &previousActions[i], NULL);
+    }
+
+    crashHandlersInstalled = FALSE;
+}
+
+
+/* ============================================================================
+ * Public API
+ * ============================================================================ */
+
+void tr_enable(guint capacity, TmClockFunc clock, const char *crash_path)
+{
+    tr_disable();
+
+    guint64 size = 1;
+    while (size < MAX(capacity, 1)) {
+        size <<= 1;
+    }
+
+    TrBuffer *trace = g_new0(TrBuffer, 1);
+
+    *trace = (TrBuffer) {
+        .records = g_new0(TrRecord, size),
+        .mask = size - 1,
+        .written = 0,
+        .internal_depth = 0,
+        .clock = clock ? clock : g_get_monotonic_time,
+        .crash_path = g_strdup(crash_path),
+    };
+
+    activeTrace = trace;
+
+    if (crash_path != NULL) {
+        tr_install_crash_handlers();
+    }
+}
+
+void tr_disable(void)
+{
+    TrBuffer *trace = activeTrace;
+    if (trace == NULL) {
+        return;
+    }
+
+    tr_remove_crash_handlers();
+    activeTrace = NULL;
+
+    g_free(trace->crash_path);
+    g_free(trace->records);
+    g_free(trace);
+}
+
+gboolean tr_is_enabled(void)
+{
+    return activeTrace != NULL;
+}
+
+void tr_record(TrRecordKind kind, guint8 arg_a, guint8 arg_b, guint32 value)
+{
+    tr_record_full(-1, kind, arg_a, arg_b, 0, value);
+}
+
+void tr_record_full(gint64 time_us, TrRecordKind kind, guint8 arg_a, guint8 arg_b, guint8 flags,
+                    guint32 value)
+{
+    TrBuffer *trace = activeTrace;
+    if (G_LIKELY(trace == NULL)) {
+        return;
+    }
+
+    trace->records[trace->written & trace->mask] = (TrRecord) {
+        .time_us = (time_us < 0) ? trace->clock() : time_us,
+        .kind = (guint8) kind,
+        .arg_a = arg_a,
+        .arg_b = arg_b,
+        .flags = flags | ((trace->internal_depth > 0) ? TR_FLAG_INTERNAL : 0),
+        .value = value,
+    };
+
+    trace->written++;
+}
+
+void tr_begin_internal(void)
+{
+    if (activeTrace != NULL) {
+        activeTrace->internal_depth++;
+    }
+}
+
+void tr_end_internal(void)
+{
+    if (activeTrace != NULL && activeTrace->internal_depth > 0) {
+        activeTrace->internal_depth--;
+    }
+}
+
+TrRecord *tr_copy_records(gsize *n_records)
+{
+    TrBuffer *trace = activeTrace;
+
+    if (trace == NULL) {
+        *n_records = 0;
+        return NULL;
+    }
+
+    guint64 count = tr_buffered_count(trace);
+    TrRecord *records = g_new(TrRecord, MAX(count, 1));
+
+    tr_copy_ordered(trace, records, count);
+
+    *n_records = count;
+    return records;
+}
+
+gboolean tr_flush(const char *path, GError **error)
+{
+    TrBuffer *trace = activeTrace;
+
+    if (trace == NULL) {
+        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_NOT_INITIALIZED,
+                            "Tracing is not enabled");
+        return FALSE;
+    }
+
+    guint64 n_records = tr_buffered_count(trace);
+    gsize size = sizeof(TrFileHeader) + n_records * sizeof(TrRecord);
+    g_autofree guint8 *contents = g_malloc(size);
+
+    tr_fill_header((TrFileHeader *) contents, n_records);
+    tr_copy_ordered(trace, (TrRecord *) (contents + sizeof(TrFileHeader)), n_records);
+
+    return g_file_set_contents_full(path, (const gchar *) contents, (gssize) size,
+                                    G_FILE_SET_CONTENTS_CONSISTENT, 0600, error);
+}
+
+TrRecord *tr_load(const char *path, gsize *n_records, GError **error)
+{
+    g_autofree gchar *contents = NULL;
+    gsize length = 0;
+
+    if (!g_file_get_contents(path, &contents, &length, error)) {
+        return NULL;
+    }
+
+    TrFileHeader header;
+    if (length < sizeof(header)) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "%s is too short to be a trace",
+                    path);
+        return NULL;
+    }
+    memcpy(&header, contents, sizeof(header));
+
+    if (memcmp(header.magic, TR_FILE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != TR_FILE_VERSION || header.record_size != sizeof(TrRecord)) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                    "%s is not a version %d Samaya trace", path, TR_FILE_VERSION);
+        return NULL;
+    }
+
+    // Compared by division first, a forged record count could wrap the multiplication round.
+    gsize n_fitting = (length - sizeof(header)) / sizeof(TrRecord);
+    if (header.n_records > n_fitting ||
+        length - sizeof(header) != header.n_records * sizeof(TrRecord)) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT,
+                    "%s is truncated, expected %" G_GUINT64_FORMAT " records", path,
+                    header.n_records);
+        return NULL;
+    }
+
+    *n_records = header.n_records;
+    if (header.n_records == 0) {
+        return g_new0(TrRecord, 1);
+    }
+
+    return g_memdup2(contents + sizeof(header), header.n_records * sizeof(TrRecord));
+}
+
+const char *tr_record_kind_to_string(TrRecordKind kind)
+{
+    switch (kind) {
+        case TrEvent:
+            return "event";
+        case TrTransition:
+            return "transition";
+        case TrTick:
+            return "tick";
+        case TrRoutine:
+            return "routine";
+        case TrSetting:
+            return "setting";
+        case TrComplete:
+            return "complete";
+        case TrAddTime:
+            return "add-time";
+        case TrPlan:
+            return "plan";
+        default:
+            return "unknown";
+    }
+}
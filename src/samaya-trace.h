@@ -0,0 +1,130 @@
+/* samaya-trace.h
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <glib.h>
+#include "samaya-timer.h"
+
+/*  Event trace of the timer and session state machine.
+
+    When enabled, every timer event, state transition, tick, routine change, setting change and
+    session completion is appended to a fixed size in memory ring buffer of compact records. The
+    buffer can be written to disk on demand, and is written by a signal handler if the process
+    crashes, so the exact sequence leading up to a bug report can be replayed with samaya-replay.
+
+    Trace files store the records in host byte order and are meant to be replayed on the same
+    kind of machine they were recorded on.
+*/
+
+#define TR_FILE_MAGIC "SMYTRACE"
+#define TR_FILE_VERSION 1
+
+// Records in the ring buffer of a live trace, around a day of a continuously running timer.
+#define TR_DEFAULT_CAPACITY (1 << 17)
+
+// Set on records produced while the session manager reacts to another record.
+#define TR_FLAG_INTERNAL (1 << 0)
+
+// Set on records describing the state at the moment tracing started.
+#define TR_FLAG_SNAPSHOT (1 << 1)
+
+typedef enum
+{
+    TrEvent,      // arg_a: TmEvent
+    TrTransition, // arg_a: previous TmState, arg_b: new TmState
+    TrTick,       // value: remaining time in milliseconds after the tick, snapshots: arg_a: TmState
+    TrRoutine,    // arg_a: RoutineType
+    TrSetting,    // arg_a: TrSettingKey, value: new value, durations in milliseconds
+    TrComplete,   // arg_a: completed RoutineType, arg_b: 1 if it ran out, 0 if it was skipped
+    TrAddTime,    // value: milliseconds given back to the paused timer
+    TrPlan,       // arg_a: SmPlanDecision, arg_b: 1 if started automatically, value: planned ms
+} TrRecordKind;
+
+typedef enum
+{
+    TrWorkDuration,
+    TrShortBreakDuration,
+    TrLongBreakDuration,
+    TrSessionsToComplete,
+    TrAutoStartBreaks,
+    TrAutoStartWork,
+} TrSettingKey;
+
+typedef struct
+{
+    gint64 time_us;
+    guint8 kind;
+    guint8 arg_a;
+    guint8 arg_b;
+    guint8 flags;
+    guint32 value;
+} TrRecord;
+
+G_STATIC_ASSERT(sizeof(TrRecord) == 16);
+
+typedef struct
+{
+    gchar magic[8];
+    guint32 version;
+    guint32 record_size;
+    guint64 n_records;
+} TrFileHeader;
+
+G_STATIC_ASSERT(sizeof(TrFileHeader) == 24);
+
+/*  Starts recording into a ring buffer holding the last capacity records (rounded up to a power
+    of two), timestamped with the given clock or g_get_monotonic_time() when NULL.
+
+    If crash_path is not NULL, the buffer is written to that file when the process receives a
+    fatal signal.
+*/
+void tr_enable(guint capacity, TmClockFunc clock, const char *crash_path);
+
+// Stops recording and frees the ring buffer.
+void tr_disable(void);
+
+gboolean tr_is_enabled(void);
+
+// Appends a record to the ring buffer, does nothing when tracing is disabled.
+void tr_record(TrRecordKind kind, guint8 arg_a, guint8 arg_b, guint32 value);
+
+/*  Same as tr_record, with extra TR_FLAG_* flags set on the record and an explicit timestamp.
+
+    Passing a negative time_us timestamps the record with the trace clock. The timer passes the
+    clock reading it actually used, so a replay reproduces its arithmetic exactly.
+*/
+void tr_record_full(gint64 time_us, TrRecordKind kind, guint8 arg_a, guint8 arg_b, guint8 flags,
+                    guint32 value);
+
+// Records made between these calls are flagged with TR_FLAG_INTERNAL, calls can be nested.
+void tr_begin_internal(void);
+void tr_end_internal(void);
+
+// Returns a copy of the buffered records from oldest to newest, free it with g_free.
+TrRecord *tr_copy_records(gsize *n_records);
+
+// Atomically writes the buffered records to a trace file.
+gboolean tr_flush(const char *path, GError **error);
+
+// Reads all records of a trace file, free the returned array with g_free.
+TrRecord *tr_load(const char *path, gsize *n_records, GError **error);
+
+const char *tr_record_kind_to_string(TrRecordKind kind);
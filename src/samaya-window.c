@@ -19,9 +19,15 @@
  */
 
 #include <glib/gi18n.h>
-#include <math.h>
 #include "samaya-application.h"
+#include "samaya-clock.h"
+#include "samaya-heatmap.h"
+#include "samaya-hooks.h"
+#include "samaya-indicator.h"
+#include "samaya-low-power.h"
+#include "samaya-progress-ring.h"
 #include "samaya-session.h"
+#include "samaya-tags.h"
 #include "samaya-timer.h"
 #include "samaya-window.h"
 
@@ -33,17 +39,78 @@ struct _SamayaWindow
     AdwToggleGroup *routine_toggle_group;
 
     GtkDrawingArea *progress_circle;
-    GtkLabel *timer_label;
+    SamayaClock *clock;
     GtkLabel *sessions_label;
 
+    GtkEntry *tag_entry;
+    GtkPopover *tag_popover;
+    GtkListBox *tag_list;
+
+    GtkLabel *plan_label;
+
+    SamayaHeatmap *heatmap;
+
+    // Debug overlay, only updated while shown.
+    GtkLabel *debug_label;
+    guint debug_source_id;
+    guint debug_redraws;
+    guint64 debug_ticks;
+    guint64 debug_wakeups;
+    gint64 debug_update_us;
+
     GtkButton *start_button;
     GtkButton *reset_button;
 
     guint tick_callback_id;
+
+    // Set in low power mode, and while animations are turned off in the desktop settings.
+    gboolean low_power;
+    gboolean animations_disabled;
+
+    // Pending update from the shared state, and the generation of it the window shows.
+    guint update_callback_id;
+    guint64 shown_generation;
+
+    // What the routine switcher and the buttons were last set up for, -1 before the first update.
+    gint shown_routine;
+    gint shown_state;
+
+    GSettings *settings;
 };
 
 G_DEFINE_FINAL_TYPE(SamayaWindow, samaya_window, ADW_TYPE_APPLICATION_WINDOW)
 
+/*  What every window shows of the session.
+
+    Brought up to date once per change of the session, however many windows are open, and applied
+    by each window on its own frame clock at most once a frame. A window that is not being drawn,
+    minimized or on a monitor that is off, does nothing until it is again.
+*/
+typedef struct
+{
+    // Bumped with every change, windows showing an older one are out of date.
+    guint64 generation;
+
+    TmState state;
+    RoutineType routine;
+    gint64 remaining_ms;
+
+    // Monotonic time, as frame clocks count, the running timer runs out at. 0 when not running.
+    gint64 deadline_us;
+
+    guint64 total_sessions;
+    gchar *sessions_text;
+
+    gdouble day_end_hour;
+
+    // Minute the shown long break starts at, the text is only rebuilt when it moves. The text is
+    // NULL while no routine runs.
+    gint64 plan_minute;
+    gchar *plan_text;
+} SharedWindowState;
+
+static SharedWindowState sharedState = {.plan_minute = -1};
+
 /* ============================================================================
  * Function Definitions
  * ============================================================================ */
@@ -71,12 +138,19 @@ static gboolean on_animate_progress(GtkWidget *widget, GdkFrameClock *frame_cloc
     return G_SOURCE_CONTINUE;
 }
 
+static gboolean should_animate(SamayaWindow *self)
+{
+    return !self->low_power && !self->animations_disabled;
+}
+
+/*  While running, the progress ring is redrawn on every frame. Without animations it is only
+    redrawn along with the rest of the window, every second or, in low power mode, every minute.
+*/
 static void update_animation_state(SamayaWindow *self)
 {
-    TimerPtr timer = sm_get_default()->timer_instance;
-    TmState state = tm_get_state(timer);
+    samaya_clock_set_deadline(self->clock, sharedState.deadline_us);
 
-    if (state == StRunning) {
+    if (sharedState.state == StRunning && should_animate(self)) {
         if (self->tick_callback_id == 0) {
             self->tick_callback_id = gtk_widget_add_tick_callback(GTK_WIDGET(self->progress_circle),
                                                                   on_animate_progress, self, NULL);
@@ -94,14 +168,13 @@ static void update_animation_state(SamayaWindow *self)
 
 static void sync_progress_style(SamayaWindow *self)
 {
-    SessionManagerPtr session_manager = sm_get_default();
     GtkWidget *widget = GTK_WIDGET(self->progress_circle);
 
     gtk_widget_remove_css_class(widget, "routine-working");
     gtk_widget_remove_css_class(widget, "routine-short-break");
     gtk_widget_remove_css_class(widget, "routine-long-break");
 
-    switch (session_manager->current_routine) {
+    switch (sharedState.routine) {
         case Working:
             gtk_widget_add_css_class(widget, "routine-working");
             break;
@@ -120,46 +193,11 @@ static void sync_progress_style(SamayaWindow *self)
     gtk_widget_queue_draw(widget);
 }
 
-static gboolean on_tick_update(gpointer user_data)
+static void sync_routine_selection(SamayaWindow *self)
 {
-    SamayaApplication *app = SAMAYA_APPLICATION(user_data);
-    GtkWindow *window = gtk_application_get_active_window(GTK_APPLICATION(app));
-    SamayaWindow *self = SAMAYA_WINDOW(window);
-
-    SessionManagerPtr session_manager = sm_get_default();
-    if (session_manager == NULL) {
-        return G_SOURCE_REMOVE;
-    }
-    TimerPtr timer = session_manager->timer_instance;
-
-    if (timer != NULL) {
-        char *formatted_time = sm_get_formatted_time(session_manager);
-
-        gtk_label_set_text(self->timer_label, formatted_time);
-    }
-
-    char *session_text =
-        g_strdup_printf("#%" G_GUINT64_FORMAT, session_manager->total_sessions_counted);
-
-    gtk_label_set_text(self->sessions_label, session_text);
-    g_free(session_text);
-
-    sync_button_state(self);
-
-    return G_SOURCE_REMOVE;
-}
-
-static gboolean sync_routine_selection(gpointer user_data)
-{
-    SamayaApplication *app = SAMAYA_APPLICATION(user_data);
-    GtkWindow *window = gtk_application_get_active_window(GTK_APPLICATION(app));
-    SamayaWindow *self = SAMAYA_WINDOW(window);
-
-    RoutineType current_routine = sm_get_default()->current_routine;
-
     const char *target_name = NULL;
 
-    switch (current_routine) {
+    switch (sharedState.routine) {
         case Working:
             target_name = "pomodoro";
             break;
@@ -180,19 +218,241 @@ static gboolean sync_routine_selection(gpointer user_data)
     g_signal_handlers_unblock_by_func(self->routine_toggle_group, on_routine_toggled, self);
 
     sync_progress_style(self);
+}
+
+static void on_history_recorded(const HsRecord *record, gpointer user_data)
+{
+    GtkApplication *app = GTK_APPLICATION(user_data);
+
+    for (GList *l = gtk_application_get_windows(app); l != NULL; l = l->next) {
+        if (SAMAYA_IS_WINDOW(l->data)) {
+            samaya_heatmap_add_record(SAMAYA_WINDOW(l->data)->heatmap, record);
+        }
+    }
+}
+
+// Local time of the given wall clock time in microseconds, as hours and minutes.
+static gchar *format_clock_time(gint64 real_us)
+{
+    g_autoptr(GDateTime) time = g_date_time_new_from_unix_local(real_us / G_USEC_PER_SEC);
+
+    return g_date_time_format(time, "%R");
+}
+
+static gint64 get_day_end_real_us(void)
+{
+    g_autoptr(GDateTime) now = g_date_time_new_now_local();
+    g_autoptr(GDateTime) midnight = g_date_time_new_local(
+        g_date_time_get_year(now), g_date_time_get_month(now), g_date_time_get_day_of_month(now), 0,
+        0, 0);
+    g_autoptr(GDateTime) day_end =
+        g_date_time_add_seconds(midnight, sharedState.day_end_hour * 3600);
+
+    return g_date_time_to_unix(day_end) * G_USEC_PER_SEC;
+}
+
+/*  Describes when the next long break is due while a routine runs. The projection is only read
+    here, it is kept up to date by the session manager, and the text only changes along with it.
+*/
+static void refresh_plan_text(void)
+{
+    SessionManagerPtr session_manager = sm_get_default();
+
+    // Until the routine runs, the plan would move on with every minute it is not started.
+    if (sharedState.state != StRunning) {
+        g_clear_pointer(&sharedState.plan_text, g_free);
+        sharedState.plan_minute = -1;
+        return;
+    }
+
+    SmProjectedTimes times;
+    sm_get_projection(session_manager, &times);
+
+    gint64 plan_minute = times.long_break_start_real_us / (60 * G_USEC_PER_SEC);
+    if (plan_minute == sharedState.plan_minute) {
+        return;
+    }
+    sharedState.plan_minute = plan_minute;
+
+    g_autofree gchar *long_break_time = format_clock_time(times.long_break_start_real_us);
+    g_autofree gchar *plan = NULL;
+
+    if (session_manager->current_routine == LongBreak) {
+        plan = g_strdup_printf(_("Next long break at %s"), long_break_time);
+    } else {
+        plan = g_strdup_printf(_("Long break at %s"), long_break_time);
+    }
+
+    gint64 day_end_real_us = get_day_end_real_us();
+    guint32 sessions_today = sm_count_sessions_before(session_manager, day_end_real_us);
+
+    g_free(sharedState.plan_text);
+
+    if (sessions_today > 0) {
+        g_autofree gchar *day_end_time = format_clock_time(day_end_real_us);
+
+        sharedState.plan_text = g_strdup_printf(
+            ngettext("%s, %u session left before %s", "%s, %u sessions left before %s",
+                     sessions_today),
+            plan, sessions_today, day_end_time);
+    } else {
+        sharedState.plan_text = g_steal_pointer(&plan);
+    }
+}
+
+// Reads everything the windows show from the session manager, formatting it only once.
+static void refresh_shared_state(void)
+{
+    SessionManagerPtr session_manager = sm_get_default();
+    TimerPtr timer = session_manager->timer_instance;
+
+    sharedState.state = tm_get_state(timer);
+    sharedState.routine = session_manager->current_routine;
+    sharedState.remaining_ms = tm_get_remaining_time_ms(timer);
+
+    // Frame times are monotonic, the timer may count time spent suspended as well.
+    sharedState.deadline_us = tm_get_deadline_us(timer);
+    if (sharedState.deadline_us > 0) {
+        sharedState.deadline_us += g_get_monotonic_time() - timer->tm_clock();
+    }
+
+    if (sharedState.sessions_text == NULL ||
+        sharedState.total_sessions != session_manager->total_sessions_counted) {
+        sharedState.total_sessions = session_manager->total_sessions_counted;
+
+        g_free(sharedState.sessions_text);
+        sharedState.sessions_text =
+            g_strdup_printf("#%" G_GUINT64_FORMAT, sharedState.total_sessions);
+    }
 
+    refresh_plan_text();
+
+    sharedState.generation++;
+}
+
+static void apply_shared_state(SamayaWindow *self)
+{
+    if (self->shown_generation == sharedState.generation) {
+        return;
+    }
+    self->shown_generation = sharedState.generation;
+
+    /*  The deadline moves with every pause, and with a suspend without a change of state. It goes
+        first, with tenths shown the clock ignores the time as long as it follows a deadline.
+    */
+    update_animation_state(self);
+    samaya_clock_set_time(self->clock, sharedState.remaining_ms);
+    gtk_label_set_text(self->sessions_label, sharedState.sessions_text);
+
+    gtk_widget_set_visible(GTK_WIDGET(self->plan_label), sharedState.plan_text != NULL);
+    if (sharedState.plan_text != NULL) {
+        gtk_label_set_text(self->plan_label, sharedState.plan_text);
+    }
+
+    if (self->shown_routine != (gint) sharedState.routine) {
+        self->shown_routine = (gint) sharedState.routine;
+        sync_routine_selection(self);
+    }
+
+    if (self->shown_state != (gint) sharedState.state) {
+        self->shown_state = (gint) sharedState.state;
+        sync_button_state(self);
+    }
+}
+
+static gboolean on_window_update(GtkWidget *widget, GdkFrameClock *frame_clock,
+                                 gpointer user_data)
+{
+    SamayaWindow *self = SAMAYA_WINDOW(widget);
+
+    self->update_callback_id = 0;
+    apply_shared_state(self);
 
     return G_SOURCE_REMOVE;
 }
 
+// Applies the shared state on the next frame of the window, however often it changes until then.
+static void queue_window_update(SamayaWindow *self)
+{
+    if (self->update_callback_id != 0 || self->shown_generation == sharedState.generation) {
+        return;
+    }
+
+    self->update_callback_id =
+        gtk_widget_add_tick_callback(GTK_WIDGET(self), on_window_update, NULL, NULL);
+}
+
+/*  Session manager callback for ticks, timer events and routine changes, for every open window.
+    The user data is the application.
+*/
+static gboolean on_session_update(gpointer user_data)
+{
+    if (sm_get_default() == NULL) {
+        return G_SOURCE_REMOVE;
+    }
+
+    refresh_shared_state();
+
+    for (GList *l = gtk_application_get_windows(GTK_APPLICATION(user_data)); l != NULL;
+         l = l->next) {
+        if (SAMAYA_IS_WINDOW(l->data)) {
+            queue_window_update(SAMAYA_WINDOW(l->data));
+        }
+    }
+
+    si_update();
+
+    return G_SOURCE_REMOVE;
+}
+
+// Every window gets the signal, the first one to see the new value updates them all.
+static void on_day_end_changed(GSettings *settings, const char *key, gpointer user_data)
+{
+    SamayaWindow *self = SAMAYA_WINDOW(user_data);
+    gdouble day_end_hour = g_settings_get_double(settings, "day-end-hour");
+
+    if (day_end_hour == sharedState.day_end_hour) {
+        return;
+    }
+    sharedState.day_end_hour = day_end_hour;
+    sharedState.plan_minute = -1;
+
+    on_session_update(gtk_window_get_application(GTK_WINDOW(self)));
+}
+
+// Tenths follow the frame clock, so they count as an animation.
+static void sync_clock_tenths(SamayaWindow *self)
+{
+    gboolean show_tenths = g_settings_get_boolean(self->settings, "show-tenths");
+
+    samaya_clock_set_show_tenths(self->clock, show_tenths && should_animate(self));
+    samaya_clock_set_time(self->clock, sharedState.remaining_ms);
+}
+
+static void on_show_tenths_changed(GSettings *settings, const char *key, gpointer user_data)
+{
+    sync_clock_tenths(SAMAYA_WINDOW(user_data));
+}
+
+static void on_enable_animations_changed(GtkSettings *gtk_settings, GParamSpec *pspec,
+                                         gpointer user_data)
+{
+    SamayaWindow *self = SAMAYA_WINDOW(user_data);
+    gboolean enable_animations = TRUE;
+
+    g_object_get(gtk_settings, "gtk-enable-animations", &enable_animations, NULL);
+    self->animations_disabled = !enable_animations;
+
+    sync_clock_tenths(self);
+    update_animation_state(self);
+}
+
 static void sync_button_state(SamayaWindow *self)
 {
-    TimerPtr timer = sm_get_default()->timer_instance;
     GtkWidget *start_btn_widget = GTK_WIDGET(self->start_button);
     GtkWidget *reset_btn_widget = GTK_WIDGET(self->reset_button);
-    TmState timer_state = tm_get_state(timer);
 
-    switch (timer_state) {
+    switch (sharedState.state) {
         case StRunning:
             gtk_button_set_label(GTK_BUTTON(start_btn_widget), _("Stop"));
             gtk_widget_remove_css_class(start_btn_widget, "suggested-action");
@@ -231,14 +491,12 @@ static void sync_button_state(SamayaWindow *self)
             gtk_widget_set_sensitive(reset_btn_widget, FALSE);
             break;
     }
-
-    update_animation_state(self);
 }
 
+// The windows follow the new routine through the session manager, this one included.
 static void on_routine_toggled(AdwToggleGroup *toggle_group, GParamSpec *pspec,
                                gpointer samaya_window)
 {
-    SamayaWindow *self = SAMAYA_WINDOW(samaya_window);
     const char *active_name = adw_toggle_group_get_active_name(toggle_group);
 
     SessionManager *session_manager = sm_get_default();
@@ -255,44 +513,422 @@ static void on_routine_toggled(AdwToggleGroup *toggle_group, GParamSpec *pspec,
     }
 
     sm_set_routine(routine, session_manager);
-
-    sync_progress_style(self);
-    sync_button_state(self);
 }
 
 static void on_action_start_stop(GtkWidget *widget, const char *action_name, GVariant *param)
 {
-    SamayaWindow *self = SAMAYA_WINDOW(widget);
-    TimerPtr timer = sm_get_default()->timer_instance;
+    SessionManagerPtr session_manager = sm_get_default();
+    TimerPtr timer = session_manager->timer_instance;
     TmState timer_state = tm_get_state(timer);
 
     if (timer_state == StRunning) {
         tm_trigger_event(timer, EvStop);
     } else {
-        tm_trigger_event(timer, EvStart);
+        sm_start(session_manager);
     }
-
-    sync_button_state(self);
 }
 
 static void on_action_reset(GtkWidget *widget, const char *action_name, GVariant *param)
 {
-    SamayaWindow *self = SAMAYA_WINDOW(widget);
     TimerPtr timer = sm_get_default()->timer_instance;
 
     tm_trigger_event(timer, EvReset);
-
-    sync_button_state(self);
 }
 
 static void on_action_skip(GtkWidget *widget, const char *action_name, GVariant *param)
+{
+    sm_skip_session();
+}
+
+/* ============================================================================
+ * Tag Entry
+ * ============================================================================ */
+
+// Most tags suggested at once.
+#define TAG_SUGGESTIONS 6
+
+static gchar *format_work_time(guint64 work_ms)
+{
+    guint minutes = (guint) (work_ms / (60 * 1000));
+
+    if (minutes < 60) {
+        return g_strdup_printf(_("%u min"), minutes);
+    }
+
+    return g_strdup_printf(_("%u h %u min"), minutes / 60, minutes % 60);
+}
+
+static GtkWidget *create_suggestion_row(guint32 tag_id)
+{
+    TgTotals totals = tg_get_totals(tag_id);
+    g_autofree gchar *work_time = format_work_time(totals.work_ms);
+
+    GtkWidget *box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 12);
+    gtk_widget_set_margin_start(box, 6);
+    gtk_widget_set_margin_end(box, 6);
+    gtk_widget_set_margin_top(box, 6);
+    gtk_widget_set_margin_bottom(box, 6);
+
+    GtkWidget *name_label = gtk_label_new(tg_get_name(tag_id));
+    gtk_label_set_xalign(GTK_LABEL(name_label), 0.0f);
+    gtk_label_set_ellipsize(GTK_LABEL(name_label), PANGO_ELLIPSIZE_END);
+    gtk_widget_set_hexpand(name_label, TRUE);
+    gtk_box_append(GTK_BOX(box), name_label);
+
+    GtkWidget *totals_label = gtk_label_new(work_time);
+    gtk_widget_add_css_class(totals_label, "numeric");
+    gtk_widget_add_css_class(totals_label, "dim-label");
+    gtk_box_append(GTK_BOX(box), totals_label);
+
+    GtkWidget *row = gtk_list_box_row_new();
+    gtk_list_box_row_set_child(GTK_LIST_BOX_ROW(row), box);
+    g_object_set_data(G_OBJECT(row), "tag-id", GUINT_TO_POINTER(tag_id));
+
+    return row;
+}
+
+static void on_tag_entry_changed(GtkEditable *editable, gpointer user_data);
+
+// Sets the entry text without bringing up suggestions for it.
+static void set_tag_entry_text(SamayaWindow *self, const char *text)
+{
+    g_signal_handlers_block_by_func(self->tag_entry, on_tag_entry_changed, self);
+    gtk_editable_set_text(GTK_EDITABLE(self->tag_entry), text != NULL ? text : "");
+    gtk_editable_set_position(GTK_EDITABLE(self->tag_entry), -1);
+    g_signal_handlers_unblock_by_func(self->tag_entry, on_tag_entry_changed, self);
+}
+
+// Records the following work sessions with the tag in the entry.
+static void commit_tag(SamayaWindow *self)
+{
+    guint32 tag_id = tg_intern(gtk_editable_get_text(GTK_EDITABLE(self->tag_entry)));
+    const char *name = tg_get_name(tag_id);
+
+    gtk_popover_popdown(self->tag_popover);
+    set_tag_entry_text(self, name);
+
+    SessionManagerPtr session_manager = sm_get_default();
+    if (session_manager->current_tag_id == tag_id) {
+        return;
+    }
+
+    sm_set_tag(session_manager, tag_id);
+    g_settings_set_string(self->settings, "current-tag", name != NULL ? name : "");
+}
+
+static void on_tag_entry_changed(GtkEditable *editable, gpointer user_data)
+{
+    SamayaWindow *self = SAMAYA_WINDOW(user_data);
+    const char *text = gtk_editable_get_text(editable);
+    guint32 tag_ids[TAG_SUGGESTIONS];
+
+    guint n_tags = tg_complete(text, tag_ids, TAG_SUGGESTIONS);
+
+    // Nothing to suggest beyond what was typed already.
+    if (*text == '\0' || n_tags == 0 ||
+        (n_tags == 1 && g_strcmp0(tg_get_name(tag_ids[0]), text) == 0)) {
+        gtk_popover_popdown(self->tag_popover);
+        return;
+    }
+
+    gtk_list_box_remove_all(self->tag_list);
+    for (guint i = 0; i < n_tags; i++) {
+        gtk_list_box_append(self->tag_list, create_suggestion_row(tag_ids[i]));
+    }
+
+    gtk_popover_popup(self->tag_popover);
+}
+
+static void on_tag_suggestion_activated(GtkListBox *list, GtkListBoxRow *row, gpointer user_data)
+{
+    SamayaWindow *self = SAMAYA_WINDOW(user_data);
+    guint32 tag_id = GPOINTER_TO_UINT(g_object_get_data(G_OBJECT(row), "tag-id"));
+
+    set_tag_entry_text(self, tg_get_name(tag_id));
+    commit_tag(self);
+    gtk_widget_grab_focus(GTK_WIDGET(self->tag_entry));
+}
+
+static void on_tag_entry_activate(GtkEntry *entry, gpointer user_data)
+{
+    commit_tag(SAMAYA_WINDOW(user_data));
+}
+
+static void on_tag_entry_focus_leave(GtkEventControllerFocus *controller, gpointer user_data)
+{
+    SamayaWindow *self = SAMAYA_WINDOW(user_data);
+
+    // Moving into the suggestions is not leaving the entry.
+    if (gtk_widget_get_visible(GTK_WIDGET(self->tag_popover))) {
+        return;
+    }
+
+    // Only activating the entry or picking a suggestion sets a tag, half typed text is dropped.
+    set_tag_entry_text(self, tg_get_name(sm_get_default()->current_tag_id));
+}
+
+// Another window set the tag, or this one did and the entry already shows it.
+static void on_current_tag_changed(GSettings *settings, const char *key, gpointer user_data)
+{
+    SamayaWindow *self = SAMAYA_WINDOW(user_data);
+
+    // Typing in this window goes on undisturbed.
+    if (gtk_widget_get_state_flags(GTK_WIDGET(self->tag_entry)) & GTK_STATE_FLAG_FOCUS_WITHIN) {
+        return;
+    }
+
+    set_tag_entry_text(self, tg_get_name(sm_get_default()->current_tag_id));
+}
+
+static gboolean on_tag_entry_key_pressed(GtkEventControllerKey *controller, guint keyval,
+                                         guint keycode, GdkModifierType state, gpointer user_data)
+{
+    SamayaWindow *self = SAMAYA_WINDOW(user_data);
+
+    if (!gtk_widget_get_visible(GTK_WIDGET(self->tag_popover))) {
+        return FALSE;
+    }
+
+    if (keyval == GDK_KEY_Down) {
+        GtkListBoxRow *row = gtk_list_box_get_row_at_index(self->tag_list, 0);
+        if (row != NULL) {
+            gtk_widget_grab_focus(GTK_WIDGET(row));
+        }
+        return TRUE;
+    }
+
+    if (keyval == GDK_KEY_Escape) {
+        gtk_popover_popdown(self->tag_popover);
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+static void setup_tag_entry(SamayaWindow *self)
+{
+    self->tag_list = GTK_LIST_BOX(gtk_list_box_new());
+    gtk_list_box_set_selection_mode(self->tag_list, GTK_SELECTION_NONE);
+    gtk_list_box_set_activate_on_single_click(self->tag_list, TRUE);
+    g_signal_connect(self->tag_list, "row-activated", G_CALLBACK(on_tag_suggestion_activated),
+                     self);
+
+    // Not closed on a click outside and not taking the focus, so typing goes on in the entry.
+    self->tag_popover = GTK_POPOVER(gtk_popover_new());
+    gtk_popover_set_child(self->tag_popover, GTK_WIDGET(self->tag_list));
+    gtk_popover_set_autohide(self->tag_popover, FALSE);
+    gtk_popover_set_has_arrow(self->tag_popover, FALSE);
+    gtk_popover_set_position(self->tag_popover, GTK_POS_BOTTOM);
+    gtk_widget_set_size_request(GTK_WIDGET(self->tag_popover), 280, -1);
+    gtk_widget_set_parent(GTK_WIDGET(self->tag_popover), GTK_WIDGET(self->tag_entry));
+
+    g_signal_connect(self->tag_entry, "changed", G_CALLBACK(on_tag_entry_changed), self);
+    g_signal_connect(self->tag_entry, "activate", G_CALLBACK(on_tag_entry_activate), self);
+
+    GtkEventController *focus_controller = gtk_event_controller_focus_new();
+    g_signal_connect(focus_controller, "leave", G_CALLBACK(on_tag_entry_focus_leave), self);
+    gtk_widget_add_controller(GTK_WIDGET(self->tag_entry), focus_controller);
+
+    GtkEventController *key_controller = gtk_event_controller_key_new();
+    g_signal_connect(key_controller, "key-pressed", G_CALLBACK(on_tag_entry_key_pressed), self);
+    gtk_widget_add_controller(GTK_WIDGET(self->tag_entry), key_controller);
+}
+
+
+/* ============================================================================
+ * Debug Overlay
+ * ============================================================================ */
+
+/*  Main loop iterations, counted by wrapping the poll function while an overlay is shown in any
+    window. Every window keeps its own count of the wakeups it already reported.
+*/
+static guint64 debugWakeups = 0;
+static guint debugOverlayUsers = 0;
+static GPollFunc debugSavedPoll = NULL;
+
+static gint count_wakeups_poll(GPollFD *fds, guint n_fds, gint timeout)
+{
+    debugWakeups++;
+
+    return debugSavedPoll(fds, n_fds, timeout);
+}
+
+static void hold_wakeup_counter(void)
+{
+    if (debugOverlayUsers++ == 0) {
+        debugSavedPoll = g_main_context_get_poll_func(NULL);
+        g_main_context_set_poll_func(NULL, count_wakeups_poll);
+    }
+}
+
+static void release_wakeup_counter(void)
+{
+    g_return_if_fail(debugOverlayUsers > 0);
+
+    if (--debugOverlayUsers == 0) {
+        g_main_context_set_poll_func(NULL, debugSavedPoll);
+        debugSavedPoll = NULL;
+    }
+}
+
+static void append_frame_stats(SamayaWindow *self, GString *text)
+{
+    GdkFrameClock *frame_clock = gtk_widget_get_frame_clock(GTK_WIDGET(self->progress_circle));
+    if (frame_clock == NULL) {
+        g_string_append(text, "Frames: not realized\n");
+        return;
+    }
+
+    if (self->tick_callback_id == 0) {
+        g_string_append(text, "Frames: ring idle\n");
+        return;
+    }
+
+    gdouble fps = gdk_frame_clock_get_fps(frame_clock);
+    g_string_append_printf(text, "Frames: %.1f fps, %.2f ms", fps, fps > 0 ? 1000.0 / fps : 0.0);
+
+    // The frame before the current one may not have been presented yet.
+    gint64 frame_counter = gdk_frame_clock_get_frame_counter(frame_clock);
+    for (gint64 counter = frame_counter; counter > frame_counter - 3; counter--) {
+        GdkFrameTimings *timings = gdk_frame_clock_get_timings(frame_clock, counter);
+        if (timings == NULL || !gdk_frame_timings_get_complete(timings)) {
+            continue;
+        }
+
+        gint64 presentation_time_us = gdk_frame_timings_get_presentation_time(timings);
+        if (presentation_time_us != 0) {
+            g_string_append_printf(
+                text, ", presented after %.2f ms",
+                (presentation_time_us - gdk_frame_timings_get_frame_time(timings)) / 1000.0);
+        }
+        break;
+    }
+
+    g_string_append_c(text, '\n');
+}
+
+/*  Transitions since the timer was created, and the one its actions spent the most time in. The
+    update that follows an action is shown apart, it includes the checkpoint, hooks and UI.
+*/
+static void append_transition_stats(GString *text)
+{
+    TimerPtr timer = sm_get_default()->timer_instance;
+    const TmTransitionStats *slowest = NULL;
+    TmState slowest_state = StIdle;
+    TmEvent slowest_event = EvStart;
+    guint64 n_transitions = 0;
+    guint64 n_rejected = 0;
+
+    for (guint state = 0; state < TM_N_STATES; state++) {
+        for (guint event = 0; event < TM_N_EVENTS; event++) {
+            const TmTransitionStats *stats = tm_get_transition_stats(timer, state, event);
+
+            n_transitions += stats->count;
+            n_rejected += stats->n_rejected;
+            if (slowest == NULL || stats->action_time_us > slowest->action_time_us) {
+                slowest = stats;
+                slowest_state = state;
+                slowest_event = event;
+            }
+        }
+    }
+
+    g_string_append_printf(text, "Transitions: %" G_GUINT64_FORMAT, n_transitions);
+    if (n_rejected > 0) {
+        g_string_append_printf(text, " (%" G_GUINT64_FORMAT " rejected)", n_rejected);
+    }
+    if (slowest != NULL && slowest->count > 0) {
+        g_string_append_printf(text, ", most time in %s on %s, %.1f µs each + %.1f µs update",
+                               tm_state_to_string(slowest_state), tm_event_to_string(slowest_event),
+                               (gdouble) slowest->action_time_us / slowest->count,
+                               (gdouble) slowest->update_time_us / slowest->count);
+    }
+    g_string_append_c(text, '\n');
+}
+
+// Only shown once a hook was run, the latency includes the time spent waiting for a free slot.
+static void append_hook_stats(GString *text)
+{
+    const HkStats *stats = hk_get_stats();
+
+    if (stats->n_spawned == 0 && stats->n_failed == 0) {
+        return;
+    }
+
+    g_string_append_printf(text,
+                           "Hooks: %" G_GUINT64_FORMAT " run, %" G_GUINT64_FORMAT
+                           " failed, %" G_GUINT64_FORMAT " killed, spawned after %.2f ms "
+                           "(max %.2f ms)\n",
+                           stats->n_spawned, stats->n_failed, stats->n_killed,
+                           stats->last_spawn_latency_us / 1000.0,
+                           stats->max_spawn_latency_us / 1000.0);
+}
+
+static gboolean on_debug_update(gpointer user_data)
+{
+    SamayaWindow *self = SAMAYA_WINDOW(user_data);
+    const TmTickStats *tick_stats = tm_get_tick_stats(sm_get_default()->timer_instance);
+    gint64 now_us = g_get_monotonic_time();
+    gdouble elapsed_s = MAX(now_us - self->debug_update_us, 1) / (gdouble) G_USEC_PER_SEC;
+
+    g_autoptr(GString) text = g_string_new(NULL);
+
+    append_frame_stats(self, text);
+    g_string_append_printf(text, "Ring redraws: %.1f/s\n", self->debug_redraws / elapsed_s);
+    g_string_append_printf(text, "Timer ticks: %.1f/s, jitter %+.2f ms\n",
+                           (tick_stats->n_ticks - self->debug_ticks) / elapsed_s,
+                           tick_stats->last_jitter_us / 1000.0);
+    g_string_append_printf(text, "Last completion: %.2f ms late\n",
+                           tick_stats->completion_latency_us / 1000.0);
+    append_transition_stats(text);
+    append_hook_stats(text);
+    g_string_append_printf(text, "Wakeups: %.1f/s",
+                           (debugWakeups - self->debug_wakeups) / elapsed_s);
+
+    gtk_label_set_text(self->debug_label, text->str);
+
+    self->debug_redraws = 0;
+    self->debug_ticks = tick_stats->n_ticks;
+    self->debug_wakeups = debugWakeups;
+    self->debug_update_us = now_us;
+
+    return G_SOURCE_CONTINUE;
+}
+
+static void stop_debug_overlay(SamayaWindow *self)
+{
+    if (self->debug_source_id == 0) {
+        return;
+    }
+
+    g_clear_handle_id(&self->debug_source_id, g_source_remove);
+    release_wakeup_counter();
+    gtk_widget_set_visible(GTK_WIDGET(self->debug_label), FALSE);
+}
+
+static void on_action_toggle_debug_overlay(GtkWidget *widget, const char *action_name,
+                                           GVariant *param)
 {
     SamayaWindow *self = SAMAYA_WINDOW(widget);
 
-    sm_skip_session();
-    sync_button_state(self);
+    if (self->debug_source_id != 0) {
+        stop_debug_overlay(self);
+        return;
+    }
+
+    self->debug_redraws = 0;
+    self->debug_ticks = tm_get_tick_stats(sm_get_default()->timer_instance)->n_ticks;
+    self->debug_wakeups = debugWakeups;
+    self->debug_update_us = g_get_monotonic_time();
+
+    hold_wakeup_counter();
+    self->debug_source_id = g_timeout_add(1000, on_debug_update, self);
+
+    gtk_label_set_text(self->debug_label, "Collecting…");
+    gtk_widget_set_visible(GTK_WIDGET(self->debug_label), TRUE);
 }
 
+
 /* ============================================================================
  * Rendering Functions
  * ============================================================================ */
@@ -300,31 +936,15 @@ static void on_action_skip(GtkWidget *widget, const char *action_name, GVariant
 static void on_progress_draw(GtkDrawingArea *area, cairo_t *cr, int width, int height,
                              gpointer user_data)
 {
-    double line_width = 10.0;
-
-    double center_x = width / 2.0;
-    double center_y = height / 2.0;
-    double radius = MIN(width, height) / 2.0 - line_width;
-
+    SamayaWindow *self = SAMAYA_WINDOW(user_data);
     gfloat progress = tm_get_progress(sm_get_default()->timer_instance);
 
+    self->debug_redraws++;
+
     GdkRGBA color;
     gtk_widget_get_color(GTK_WIDGET(area), &color);
 
-    cairo_set_line_width(cr, line_width);
-    cairo_set_line_cap(cr, CAIRO_LINE_CAP_ROUND);
-
-    cairo_set_source_rgba(cr, color.red, color.green, color.blue, 0.2);
-    cairo_arc(cr, center_x, center_y, radius, 0, 2 * M_PI);
-    cairo_stroke(cr);
-
-
-    gdk_cairo_set_source_rgba(cr, &color);
-
-    double start_angle = -M_PI / 2;
-    double end_angle = start_angle + (2 * M_PI * progress);
-    cairo_arc(cr, center_x, center_y, radius, start_angle, end_angle);
-    cairo_stroke(cr);
+    pr_draw_ring(cr, width, height, progress, &color);
 }
 
 
@@ -338,20 +958,59 @@ static void samaya_window_realize(GtkWidget *widget)
 
     GTK_WIDGET_CLASS(samaya_window_parent_class)->realize(widget);
 
-    sm_set_timer_tick_callback(on_tick_update);
-    sm_set_routine_update_callback(sync_routine_selection);
+    // Shared by every window, setting them again for another one changes nothing.
+    sm_set_timer_tick_callback(on_session_update);
+    sm_set_routine_update_callback(on_session_update);
+    sm_set_history_callback(on_history_recorded);
 
-    gtk_label_set_text(self->timer_label, sm_get_formatted_time(sm_get_default()));
+    g_autofree gchar *history_path = samaya_application_get_history_path();
+    samaya_heatmap_load_history(self->heatmap, history_path);
 
-    sync_progress_style(self);
-    sync_button_state(self);
+    set_tag_entry_text(self, tg_get_name(sm_get_default()->current_tag_id));
+
+    GtkSettings *gtk_settings = gtk_widget_get_settings(widget);
+    g_signal_connect_object(gtk_settings, "notify::gtk-enable-animations",
+                            G_CALLBACK(on_enable_animations_changed), self, 0);
+    on_enable_animations_changed(gtk_settings, NULL, self);
+
+    // The session may have been resumed from a checkpoint on some other routine than work.
+    on_session_update(gtk_window_get_application(GTK_WINDOW(self)));
+    apply_shared_state(self);
+}
+
+// A window that was hidden for a while shows the current state right away, not a frame later.
+static void samaya_window_map(GtkWidget *widget)
+{
+    GTK_WIDGET_CLASS(samaya_window_parent_class)->map(widget);
+
+    apply_shared_state(SAMAYA_WINDOW(widget));
+}
+
+static void samaya_window_dispose(GObject *object)
+{
+    SamayaWindow *self = SAMAYA_WINDOW(object);
+
+    if (self->tag_popover != NULL) {
+        gtk_widget_unparent(GTK_WIDGET(self->tag_popover));
+        self->tag_popover = NULL;
+    }
+    stop_debug_overlay(self);
+    g_clear_object(&self->settings);
+
+    G_OBJECT_CLASS(samaya_window_parent_class)->dispose(object);
 }
 
 static void samaya_window_class_init(SamayaWindowClass *klass)
 {
     GtkWidgetClass *widget_class = GTK_WIDGET_CLASS(klass);
+    GObjectClass *object_class = G_OBJECT_CLASS(klass);
 
     widget_class->realize = samaya_window_realize;
+    widget_class->map = samaya_window_map;
+    object_class->dispose = samaya_window_dispose;
+
+    g_type_ensure(SAMAYA_TYPE_CLOCK);
+    g_type_ensure(SAMAYA_TYPE_HEATMAP);
 
     gtk_widget_class_set_template_from_resource(widget_class,
                                                 "/io/github/redddfoxxyy/samaya/samaya-window.ui");
@@ -360,8 +1019,12 @@ static void samaya_window_class_init(SamayaWindowClass *klass)
     gtk_widget_class_bind_template_child(widget_class, SamayaWindow, routine_toggle_group);
 
     gtk_widget_class_bind_template_child(widget_class, SamayaWindow, progress_circle);
-    gtk_widget_class_bind_template_child(widget_class, SamayaWindow, timer_label);
+    gtk_widget_class_bind_template_child(widget_class, SamayaWindow, clock);
     gtk_widget_class_bind_template_child(widget_class, SamayaWindow, sessions_label);
+    gtk_widget_class_bind_template_child(widget_class, SamayaWindow, tag_entry);
+    gtk_widget_class_bind_template_child(widget_class, SamayaWindow, plan_label);
+    gtk_widget_class_bind_template_child(widget_class, SamayaWindow, heatmap);
+    gtk_widget_class_bind_template_child(widget_class, SamayaWindow, debug_label);
 
     gtk_widget_class_bind_template_child(widget_class, SamayaWindow, start_button);
     gtk_widget_class_bind_template_child(widget_class, SamayaWindow, reset_button);
@@ -369,6 +1032,8 @@ static void samaya_window_class_init(SamayaWindowClass *klass)
     gtk_widget_class_install_action(widget_class, "win.start-timer", NULL, on_action_start_stop);
     gtk_widget_class_install_action(widget_class, "win.reset-timer", NULL, on_action_reset);
     gtk_widget_class_install_action(widget_class, "win.skip-session", NULL, on_action_skip);
+    gtk_widget_class_install_action(widget_class, "win.toggle-debug-overlay", NULL,
+                                    on_action_toggle_debug_overlay);
 }
 
 static void samaya_window_init(SamayaWindow *self)
@@ -377,6 +1042,36 @@ static void samaya_window_init(SamayaWindow *self)
 
     gtk_drawing_area_set_draw_func(self->progress_circle, on_progress_draw, self, NULL);
 
+    self->shown_routine = -1;
+    self->shown_state = -1;
+    self->settings = g_settings_new("io.github.redddfoxxyy.samaya");
+    sharedState.day_end_hour = g_settings_get_double(self->settings, "day-end-hour");
+    g_signal_connect(self->settings, "changed::day-end-hour", G_CALLBACK(on_day_end_changed), self);
+
+    self->low_power = lp_is_low_power();
+    sync_clock_tenths(self);
+    g_signal_connect(self->settings, "changed::show-tenths", G_CALLBACK(on_show_tenths_changed),
+                     self);
+    g_signal_connect(self->settings, "changed::current-tag", G_CALLBACK(on_current_tag_changed),
+                     self);
+
+    setup_tag_entry(self);
+
     g_signal_connect(self->routine_toggle_group, "notify::active-name",
                      G_CALLBACK(on_routine_toggled), self);
 }
+
+
+/* ============================================================================
+ * Public Functions
+ * ============================================================================ */
+
+void samaya_window_set_low_power(SamayaWindow *self, gboolean low_power)
+{
+    g_return_if_fail(SAMAYA_IS_WINDOW(self));
+
+    self->low_power = low_power;
+
+    sync_clock_tenths(self);
+    update_animation_state(self);
+}
@@ -28,4 +28,7 @@ G_BEGIN_DECLS
 
 G_DECLARE_FINAL_TYPE(SamayaWindow, samaya_window, SAMAYA, WINDOW, AdwApplicationWindow)
 
+// Stops animating the progress ring and the tenths of the clock, see samaya-low-power.h.
+void samaya_window_set_low_power(SamayaWindow *self, gboolean low_power);
+
 G_END_DECLS
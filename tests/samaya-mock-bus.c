@@ -0,0 +1,159 @@
+/* samaya-mock-bus.c
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include "samaya-mock-bus.h"
+
+
+/* ============================================================================
+ * Internal Implementation
+ * ============================================================================ */
+
+static GDBusConnection *mock_bus_connect(MockBus *mock_bus)
+{
+    g_autoptr(GError) error = NULL;
+    GDBusConnection *connection = g_dbus_connection_new_for_address_sync(
+        g_test_dbus_get_bus_address(mock_bus->test_bus),
+        G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+            G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+        NULL, NULL, &error);
+    g_assert_no_error(error);
+
+    return connection;
+}
+
+static void on_name_acquired(GDBusConnection *connection, const gchar *name, gpointer user_data)
+{
+    MockBus *mock_bus = user_data;
+
+    mock_bus->n_names_acquired++;
+}
+
+static gboolean on_wakeup(gpointer user_data)
+{
+    return G_SOURCE_CONTINUE;
+}
+
+
+/* ============================================================================
+ * Public API
+ * ============================================================================ */
+
+void mock_bus_up(MockBus *mock_bus, const char *introspection_xml)
+{
+    g_autoptr(GError) error = NULL;
+
+    mock_bus->test_bus = g_test_dbus_new(G_TEST_DBUS_NONE);
+    g_test_dbus_up(mock_bus->test_bus);
+
+    mock_bus->service = mock_bus_connect(mock_bus);
+    mock_bus->client = mock_bus_connect(mock_bus);
+
+    mock_bus->node_info = g_dbus_node_info_new_for_xml(introspection_xml, &error);
+    g_assert_no_error(error);
+
+    mock_bus->registration_ids = g_array_new(FALSE, FALSE, sizeof(guint));
+    mock_bus->owner_ids = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    mock_bus->n_names_acquired = 0;
+
+    // Keeps ITERATE_UNTIL from blocking forever when nothing else happens.
+    mock_bus->wakeup_id = g_timeout_add(50, on_wakeup, NULL);
+}
+
+void mock_bus_down(MockBus *mock_bus)
+{
+    GHashTableIter iter;
+    gpointer owner_id = NULL;
+
+    g_clear_handle_id(&mock_bus->wakeup_id, g_source_remove);
+
+    g_hash_table_iter_init(&iter, mock_bus->owner_ids);
+    while (g_hash_table_iter_next(&iter, NULL, &owner_id)) {
+        g_bus_unown_name(GPOINTER_TO_UINT(owner_id));
+    }
+    g_clear_pointer(&mock_bus->owner_ids, g_hash_table_unref);
+
+    for (guint i = 0; i < mock_bus->registration_ids->len; i++) {
+        g_dbus_connection_unregister_object(mock_bus->service,
+                                            g_array_index(mock_bus->registration_ids, guint, i));
+    }
+    g_clear_pointer(&mock_bus->registration_ids, g_array_unref);
+    g_clear_pointer(&mock_bus->node_info, g_dbus_node_info_unref);
+
+    g_dbus_connection_close_sync(mock_bus->client, NULL, NULL);
+    g_dbus_connection_close_sync(mock_bus->service, NULL, NULL);
+    g_clear_object(&mock_bus->client);
+    g_clear_object(&mock_bus->service);
+
+    g_test_dbus_down(mock_bus->test_bus);
+    g_clear_object(&mock_bus->test_bus);
+}
+
+void mock_bus_register_object(MockBus *mock_bus, const char *object_path,
+                              const char *interface_name, const GDBusInterfaceVTable *vtable,
+                              gpointer user_data)
+{
+    g_autoptr(GError) error = NULL;
+
+    GDBusInterfaceInfo *interface_info =
+        g_dbus_node_info_lookup_interface(mock_bus->node_info, interface_name);
+    g_assert_nonnull(interface_info);
+
+    guint registration_id = g_dbus_connection_register_object(
+        mock_bus->service, object_path, interface_info, vtable, user_data, NULL, &error);
+    g_assert_no_error(error);
+
+    g_array_append_val(mock_bus->registration_ids, registration_id);
+}
+
+void mock_bus_own_name(MockBus *mock_bus, const char *name)
+{
+    guint n_names_acquired = mock_bus->n_names_acquired;
+
+    g_assert_false(g_hash_table_contains(mock_bus->owner_ids, name));
+
+    guint owner_id = g_bus_own_name_on_connection(mock_bus->service, name,
+                                                  G_BUS_NAME_OWNER_FLAGS_NONE, on_name_acquired,
+                                                  NULL, mock_bus, NULL);
+    g_hash_table_insert(mock_bus->owner_ids, g_strdup(name), GUINT_TO_POINTER(owner_id));
+
+    ITERATE_UNTIL(mock_bus->n_names_acquired > n_names_acquired);
+}
+
+void mock_bus_unown_name(MockBus *mock_bus, const char *name)
+{
+    g_autofree gchar *owned_name = NULL;
+    gpointer owner_id = NULL;
+
+    g_assert_true(g_hash_table_steal_extended(mock_bus->owner_ids, name, (gpointer *) &owned_name,
+                                              &owner_id));
+    g_bus_unown_name(GPOINTER_TO_UINT(owner_id));
+}
+
+void mock_bus_sync(MockBus *mock_bus)
+{
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GVariant) reply = g_dbus_connection_call_sync(
+        mock_bus->client, g_dbus_connection_get_unique_name(mock_bus->service), "/",
+        "org.freedesktop.DBus.Peer", "Ping", NULL, NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL, &error);
+    g_assert_no_error(error);
+
+    while (g_main_context_iteration(NULL, FALSE)) {
+    }
+}
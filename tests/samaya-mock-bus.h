@@ -0,0 +1,82 @@
+/* samaya-mock-bus.h
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+#include <glib.h>
+
+/*  A private bus for tests of the D-Bus clients, with mocks of the services they talk to.
+
+    The test gives the introspection XML of the mocked interfaces and a vtable for each object it
+    registers, the bus takes care of the rest: starting dbus-daemon, a connection for the mocks
+    and one for the client under test, owning the names of the services and tearing it all down.
+*/
+
+#define MOCK_BUS_WAIT_TIMEOUT_US (5 * G_USEC_PER_SEC)
+
+typedef struct
+{
+    GTestDBus *test_bus;
+    GDBusNodeInfo *node_info;
+
+    // Connection the mocks are served on, and the one handed to the client under test.
+    GDBusConnection *service;
+    GDBusConnection *client;
+
+    GArray *registration_ids;
+    GHashTable *owner_ids;
+    guint n_names_acquired;
+    guint wakeup_id;
+} MockBus;
+
+// Runs the main loop until the condition holds, failing the test if it never does.
+#define ITERATE_UNTIL(condition)                                                                  \
+    G_STMT_START                                                                                  \
+    {                                                                                             \
+        gint64 deadline_us = g_get_monotonic_time() + MOCK_BUS_WAIT_TIMEOUT_US;                   \
+        while (!(condition) && g_get_monotonic_time() < deadline_us) {                            \
+            g_main_context_iteration(NULL, TRUE);                                                 \
+        }                                                                                         \
+        g_assert_true(condition);                                                                 \
+    }                                                                                             \
+    G_STMT_END
+
+// Starts the bus and connects to it, the interfaces of the mocks are looked up in the XML.
+void mock_bus_up(MockBus *mock_bus, const char *introspection_xml);
+
+void mock_bus_down(MockBus *mock_bus);
+
+// Serves the interface at the object path with the vtable until the bus goes down.
+void mock_bus_register_object(MockBus *mock_bus, const char *object_path,
+                              const char *interface_name, const GDBusInterfaceVTable *vtable,
+                              gpointer user_data);
+
+// Owns the name on the service connection, returning once it was acquired.
+void mock_bus_own_name(MockBus *mock_bus, const char *name);
+
+// Lets go of the name, the way a service does when it exits.
+void mock_bus_unown_name(MockBus *mock_bus, const char *name);
+
+/*  Makes sure everything sent so far between the client and the mocks was handled on both ends.
+    Messages arrive in order, so once the reply to a ping is in, only the main loop has to catch
+    up.
+*/
+void mock_bus_sync(MockBus *mock_bus);
@@ -0,0 +1,383 @@
+/* test-calendar.c
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <time.h>
+#include "samaya-calendar.h"
+#include "samaya-session-private.h"
+#include "samaya-session.h"
+#include "samaya-timer.h"
+
+/*  Planning work sessions around meetings from iCalendar files.
+
+    The calendars are real files in a temporary directory, in UTC, with their meetings in the
+    week of Monday, 5 January 2026. Lookups pass their times explicitly, so the expansion window
+    follows them rather than the current date.
+*/
+
+#define WAIT_TIMEOUT_US (10 * G_USEC_PER_SEC)
+
+#define MONDAY_US (G_GINT64_CONSTANT(1767571200) * G_USEC_PER_SEC)
+#define MINUTE_US (G_GINT64_CONSTANT(60) * G_USEC_PER_SEC)
+#define HOUR_US (60 * MINUTE_US)
+#define DAY_US (24 * HOUR_US)
+
+#define WORK_MS (25 * 60 * 1000)
+
+// Runs the main loop until the condition holds, failing the test if it never does.
+#define ITERATE_UNTIL(condition)                                                                  \
+    G_STMT_START                                                                                  \
+    {                                                                                             \
+        gint64 deadline_us = g_get_monotonic_time() + WAIT_TIMEOUT_US;                            \
+        while (!(condition) && g_get_monotonic_time() < deadline_us) {                            \
+            g_main_context_iteration(NULL, TRUE);                                                 \
+        }                                                                                         \
+        g_assert_true(condition);                                                                 \
+    }                                                                                             \
+    G_STMT_END
+
+// A stand-up on Monday, Wednesday and Friday, six times, with Wednesday's dropped and Friday's
+// moved to the afternoon. A review right after Monday's, and events that do not block.
+static const char workCalendar[] =
+    "BEGIN:VCALENDAR\r\n"
+    "VERSION:2.0\r\n"
+    "BEGIN:VEVENT\r\n"
+    "UID:standup\r\n"
+    "DTSTART:20260105T103000Z\r\n"
+    "DURATION:PT15M\r\n"
+    "RRULE:FREQ=WEEKLY;BYDAY=MO,WE,FR;COUNT=\r\n"
+    " 6\r\n"
+    "EXDATE:20260107T103000Z\r\n"
+    "BEGIN:VALARM\r\n"
+    "TRIGGER:-PT15M\r\n"
+    "DURATION:PT5H\r\n"
+    "END:VALARM\r\n"
+    "END:VEVENT\r\n"
+    "BEGIN:VEVENT\r\n"
+    "UID:standup\r\n"
+    "RECURRENCE-ID:20260109T103000Z\r\n"
+    "DTSTART:20260109T140000Z\r\n"
+    "DTEND:20260109T150000Z\r\n"
+    "END:VEVENT\r\n"
+    "BEGIN:VEVENT\r\n"
+    "UID:review\r\n"
+    "DTSTART:20260105T104500Z\r\n"
+    "DTEND:20260105T113000Z\r\n"
+    "SUMMARY:Review: \"planning\"\r\n"
+    "END:VEVENT\r\n"
+    "BEGIN:VEVENT\r\n"
+    "UID:holiday\r\n"
+    "DTSTART;VALUE=DATE:20260106\r\n"
+    "END:VEVENT\r\n"
+    "BEGIN:VEVENT\r\n"
+    "UID:cancelled\r\n"
+    "STATUS:CANCELLED\r\n"
+    "DTSTART:20260106T100000Z\r\n"
+    "DTEND:20260106T120000Z\r\n"
+    "END:VEVENT\r\n"
+    "BEGIN:VEVENT\r\n"
+    "UID:focus\r\n"
+    "TRANSP:TRANSPARENT\r\n"
+    "DTSTART:20260106T130000Z\r\n"
+    "DTEND:20260106T170000Z\r\n"
+    "END:VEVENT\r\n"
+    "BEGIN:VEVENT\r\n"
+    "UID:one-on-one\r\n"
+    "DTSTART:20260105T140000\r\n"
+    "DTEND:20260105T150000\r\n"
+    "RRULE:FREQ=WEEKLY;INTERVAL=2\r\n"
+    "END:VEVENT\r\n"
+    "BEGIN:VEVENT\r\n"
+    "UID:all-hands\r\n"
+    "DTSTART:20260105T160000Z\r\n"
+    "DTEND:20260105T170000Z\r\n"
+    "RRULE:FREQ=MONTHLY;BYDAY=1MO\r\n"
+    "END:VEVENT\r\n"
+    "END:VCALENDAR\r\n";
+
+typedef struct
+{
+    gchar *directory;
+    gchar *path;
+    guint wakeup_id;
+    SessionManagerPtr session_manager;
+} CalendarFixture;
+
+typedef struct
+{
+    SmPlanDecision decision;
+    guint64 value_ms;
+    guint n_calls;
+    gboolean automatic;
+    guint64 duration_ms;
+} FakePlanner;
+
+
+/* ============================================================================
+ * Fixture
+ * ============================================================================ */
+
+static gboolean on_wakeup(gpointer user_data)
+{
+    return G_SOURCE_CONTINUE;
+}
+
+static void write_calendar(CalendarFixture *fixture, const char *contents)
+{
+    g_autoptr(GError) error = NULL;
+
+    g_assert_true(g_file_set_contents(fixture->path, contents, -1, &error));
+    g_assert_no_error(error);
+}
+
+static void fixture_setup(CalendarFixture *fixture, gconstpointer test_data)
+{
+    fixture->directory = g_dir_make_tmp("samaya-calendar-XXXXXX", NULL);
+    g_assert_nonnull(fixture->directory);
+
+    fixture->path = g_build_filename(fixture->directory, "work.ics", NULL);
+    write_calendar(fixture, workCalendar);
+
+    // Keeps ITERATE_UNTIL from blocking forever when nothing else happens.
+    fixture->wakeup_id = g_timeout_add(50, on_wakeup, NULL);
+
+    const char *const paths[] = {fixture->path, NULL};
+    cl_enable(paths);
+
+    fixture->session_manager = sm_init(4, 25.0, 5.0, 20.0, FALSE, FALSE, NULL, NULL);
+}
+
+static void fixture_teardown(CalendarFixture *fixture, gconstpointer test_data)
+{
+    sm_deinit(fixture->session_manager);
+    cl_disable();
+
+    g_source_remove(fixture->wakeup_id);
+
+    g_unlink(fixture->path);
+    g_rmdir(fixture->directory);
+
+    g_free(fixture->path);
+    g_free(fixture->directory);
+}
+
+static gint64 monday_at(guint day, guint hour, guint minute)
+{
+    return MONDAY_US + day * DAY_US + hour * HOUR_US + minute * MINUTE_US;
+}
+
+static void assert_busy(gint64 start_us, gint64 end_us, gint64 busy_start_us, gint64 busy_end_us)
+{
+    ClInterval busy = {0};
+
+    g_assert_true(cl_find_busy(start_us, end_us, &busy));
+    g_assert_cmpint(busy.start_us, ==, busy_start_us);
+    g_assert_cmpint(busy.end_us, ==, busy_end_us);
+}
+
+static void assert_free(gint64 start_us, gint64 end_us)
+{
+    ClInterval busy;
+
+    g_assert_false(cl_find_busy(start_us, end_us, &busy));
+}
+
+static SmPlanDecision fake_plan(gint64 start_real_us, guint64 duration_ms, gboolean automatic,
+                                guint64 *value_ms, gpointer user_data)
+{
+    FakePlanner *planner = user_data;
+
+    planner->n_calls++;
+    planner->automatic = automatic;
+    planner->duration_ms = duration_ms;
+    *value_ms = planner->value_ms;
+
+    return planner->decision;
+}
+
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================ */
+
+static void test_find_busy(CalendarFixture *fixture, gconstpointer test_data)
+{
+    assert_free(monday_at(0, 8, 0), monday_at(0, 10, 30));
+    assert_busy(monday_at(0, 10, 0), monday_at(0, 12, 0), monday_at(0, 10, 30),
+                monday_at(0, 10, 45));
+
+    // The first by start of the two overlapping the interval.
+    assert_busy(monday_at(0, 10, 40), monday_at(0, 11, 0), monday_at(0, 10, 30),
+                monday_at(0, 10, 45));
+    assert_busy(monday_at(0, 10, 45), monday_at(0, 11, 0), monday_at(0, 10, 45),
+                monday_at(0, 11, 30));
+
+    // All day, cancelled and free events, and alarms inside events, take no time.
+    assert_free(monday_at(1, 0, 0), monday_at(2, 0, 0));
+
+    g_assert_cmpint(cl_get_free_from(monday_at(0, 10, 30)), ==, monday_at(0, 11, 30));
+    g_assert_cmpint(cl_get_free_from(monday_at(0, 12, 0)), ==, monday_at(0, 12, 0));
+}
+
+static void test_recurrence(CalendarFixture *fixture, gconstpointer test_data)
+{
+    // Left out, then moved to the afternoon.
+    assert_free(monday_at(2, 10, 0), monday_at(2, 12, 0));
+    assert_free(monday_at(4, 10, 0), monday_at(4, 12, 0));
+    assert_busy(monday_at(4, 12, 0), monday_at(4, 16, 0), monday_at(4, 14, 0),
+                monday_at(4, 15, 0));
+
+    // The sixth and last stand-up is on the next Friday.
+    assert_busy(monday_at(11, 10, 0), monday_at(11, 12, 0), monday_at(11, 10, 30),
+                monday_at(11, 10, 45));
+    assert_free(monday_at(14, 10, 0), monday_at(14, 12, 0));
+
+    // Every other week, floating in the local zone.
+    assert_busy(monday_at(0, 13, 0), monday_at(0, 15, 0), monday_at(0, 14, 0),
+                monday_at(0, 15, 0));
+    assert_free(monday_at(7, 13, 0), monday_at(7, 15, 0));
+    assert_busy(monday_at(70, 13, 0), monday_at(70, 15, 0), monday_at(70, 14, 0),
+                monday_at(70, 15, 0));
+
+    // The first Monday of a month is not understood, only the first occurrence counts.
+    assert_busy(monday_at(0, 16, 0), monday_at(0, 17, 0), monday_at(0, 16, 0),
+                monday_at(0, 17, 0));
+    assert_free(monday_at(28, 16, 0), monday_at(28, 17, 0));
+}
+
+static void test_plan(CalendarFixture *fixture, gconstpointer test_data)
+{
+    guint64 value_ms = 0;
+
+    g_assert_cmpint(cl_plan_work_session(monday_at(0, 9, 0), WORK_MS, TRUE, &value_ms, NULL), ==,
+                    SmPlanStart);
+
+    g_assert_cmpint(cl_plan_work_session(monday_at(0, 10, 15), WORK_MS, TRUE, &value_ms, NULL), ==,
+                    SmPlanShorten);
+    g_assert_cmpuint(value_ms, ==, 15 * 60 * 1000);
+
+    // Through the stand-up and the review right after it.
+    g_assert_cmpint(cl_plan_work_session(monday_at(0, 10, 25), WORK_MS, TRUE, &value_ms, NULL), ==,
+                    SmPlanDefer);
+    g_assert_cmpuint(value_ms, ==, 65 * 60 * 1000);
+
+    g_assert_cmpint(cl_plan_work_session(monday_at(0, 10, 25), WORK_MS, FALSE, &value_ms, NULL),
+                    ==, SmPlanStart);
+}
+
+static void test_reload(CalendarFixture *fixture, gconstpointer test_data)
+{
+    assert_free(monday_at(1, 9, 0), monday_at(1, 10, 0));
+
+    write_calendar(fixture, "BEGIN:VCALENDAR\r\n"
+                            "BEGIN:VEVENT\r\n"
+                            "UID:added\r\n"
+                            "DTSTART:20260106T093000Z\r\n"
+                            "DTEND:20260106T100000Z\r\n"
+                            "END:VEVENT\r\n"
+                            "END:VCALENDAR\r\n");
+
+    ClInterval busy;
+    ITERATE_UNTIL(cl_find_busy(monday_at(1, 9, 0), monday_at(1, 10, 0), &busy));
+    g_assert_cmpint(busy.start_us, ==, monday_at(1, 9, 30));
+
+    // Everything else went with the old contents.
+    assert_free(monday_at(0, 10, 0), monday_at(0, 12, 0));
+
+    g_unlink(fixture->path);
+    ITERATE_UNTIL(!cl_find_busy(monday_at(1, 9, 0), monday_at(1, 10, 0), &busy));
+}
+
+static void test_session(CalendarFixture *fixture, gconstpointer test_data)
+{
+    SessionManagerPtr session_manager = fixture->session_manager;
+    TimerPtr timer = session_manager->timer_instance;
+    FakePlanner planner = {.decision = SmPlanShorten, .value_ms = 15 * 60 * 1000};
+
+    sm_set_planner(session_manager, fake_plan, &planner);
+
+    sm_start(session_manager);
+    g_assert_cmpuint(planner.n_calls, ==, 1);
+    g_assert_false(planner.automatic);
+    g_assert_cmpint(tm_get_state(timer), ==, StRunning);
+    g_assert_cmpuint(timer->initial_time_ms, ==, 15 * 60 * 1000);
+
+    // Resuming is not planned again.
+    tm_trigger_event(timer, EvStop);
+    sm_start(session_manager);
+    g_assert_cmpuint(planner.n_calls, ==, 1);
+
+    // Reset, the next start is planned and run at full length again.
+    tm_trigger_event(timer, EvStop);
+    tm_trigger_event(timer, EvReset);
+    planner.decision = SmPlanStart;
+
+    sm_start(session_manager);
+    g_assert_cmpuint(planner.n_calls, ==, 2);
+    g_assert_cmpuint(planner.duration_ms, ==, WORK_MS);
+    g_assert_cmpuint(timer->initial_time_ms, ==, WORK_MS);
+
+    // Put off, then started once the time is up.
+    sm_set_routine(Working, session_manager);
+    g_assert_cmpuint(timer->initial_time_ms, ==, WORK_MS);
+    planner = (FakePlanner) {.decision = SmPlanDefer, .value_ms = 50};
+
+    sm_start_planned(session_manager, TRUE);
+    g_assert_cmpint(tm_get_state(timer), ==, StIdle);
+    planner.decision = SmPlanStart;
+
+    ITERATE_UNTIL(tm_get_state(timer) == StRunning);
+    g_assert_cmpuint(planner.n_calls, ==, 2);
+    g_assert_true(planner.automatic);
+    g_assert_cmpuint(timer->initial_time_ms, ==, WORK_MS);
+
+    // Breaks are never planned.
+    sm_set_routine(ShortBreak, session_manager);
+    sm_start(session_manager);
+    g_assert_cmpuint(planner.n_calls, ==, 2);
+    g_assert_cmpint(tm_get_state(timer), ==, StRunning);
+}
+
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(int argc, char *argv[])
+{
+    g_setenv("TZ", "UTC", TRUE);
+    tzset();
+
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add("/calendar/find-busy", CalendarFixture, NULL, fixture_setup, test_find_busy,
+               fixture_teardown);
+    g_test_add("/calendar/recurrence", CalendarFixture, NULL, fixture_setup, test_recurrence,
+               fixture_teardown);
+    g_test_add("/calendar/plan", CalendarFixture, NULL, fixture_setup, test_plan,
+               fixture_teardown);
+    g_test_add("/calendar/reload", CalendarFixture, NULL, fixture_setup, test_reload,
+               fixture_teardown);
+    g_test_add("/calendar/session", CalendarFixture, NULL, fixture_setup, test_session,
+               fixture_teardown);
+
+    return g_test_run();
+}
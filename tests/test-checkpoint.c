@@ -0,0 +1,191 @@
+/* test-checkpoint.c
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include "samaya-checkpoint.h"
+#include "samaya-session.h"
+#include "samaya-timer.h"
+
+/*  Checkpointing and resuming of the session.
+
+    Every case checkpoints a session manager into a temporary directory, then resumes a fresh one
+    from the file, the way Samaya does when it starts again after being killed.
+*/
+
+typedef struct
+{
+    gchar *directory;
+    gchar *path;
+    SessionManagerPtr session_manager;
+} CheckpointFixture;
+
+
+/* ============================================================================
+ * Fixture
+ * ============================================================================ */
+
+static SessionManagerPtr new_session_manager(void)
+{
+    return sm_init(4, 25.0, 5.0, 20.0, FALSE, FALSE, NULL, NULL);
+}
+
+static void fixture_setup(CheckpointFixture *fixture, gconstpointer test_data)
+{
+    fixture->directory = g_dir_make_tmp("samaya-checkpoint-XXXXXX", NULL);
+    g_assert_nonnull(fixture->directory);
+
+    fixture->path = g_build_filename(fixture->directory, "checkpoint.bin", NULL);
+    fixture->session_manager = new_session_manager();
+
+    cp_enable(fixture->path);
+}
+
+static void fixture_teardown(CheckpointFixture *fixture, gconstpointer test_data)
+{
+    cp_disable();
+
+    if (fixture->session_manager) {
+        sm_deinit(fixture->session_manager);
+    }
+
+    g_unlink(fixture->path);
+    g_rmdir(fixture->directory);
+
+    g_free(fixture->path);
+    g_free(fixture->directory);
+}
+
+// Drops the running session manager and resumes a new one from the checkpoint file.
+static SessionManagerPtr restart(CheckpointFixture *fixture)
+{
+    g_autoptr(GError) error = NULL;
+    CpCheckpoint checkpoint;
+
+    sm_deinit(fixture->session_manager);
+    fixture->session_manager = new_session_manager();
+
+    g_assert_true(cp_read(fixture->path, &checkpoint, &error));
+    g_assert_no_error(error);
+
+    sm_restore_checkpoint(fixture->session_manager, &checkpoint);
+
+    return fixture->session_manager;
+}
+
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================ */
+
+static void test_running(CheckpointFixture *fixture, gconstpointer test_data)
+{
+    tm_trigger_event(fixture->session_manager->timer_instance, EvStart);
+
+    SessionManagerPtr session_manager = restart(fixture);
+    TimerPtr timer = session_manager->timer_instance;
+
+    g_assert_cmpint(tm_get_state(timer), ==, StRunning);
+    g_assert_cmpint(session_manager->current_routine, ==, Working);
+    g_assert_cmpint(tm_get_remaining_time_ms(timer), <=, 25 * 60 * 1000);
+    g_assert_cmpint(tm_get_remaining_time_ms(timer), >, 25 * 60 * 1000 - 5000);
+}
+
+static void test_paused(CheckpointFixture *fixture, gconstpointer test_data)
+{
+    SessionManagerPtr session_manager = fixture->session_manager;
+
+    sm_set_routine(ShortBreak, session_manager);
+    session_manager->total_sessions_counted = 7;
+    session_manager->sessions_completed = 3;
+    tm_trigger_event(session_manager->timer_instance, EvStart);
+    tm_trigger_event(session_manager->timer_instance, EvStop);
+
+    gint64 paused_remaining_ms = tm_get_remaining_time_ms(session_manager->timer_instance);
+
+    session_manager = restart(fixture);
+
+    g_assert_cmpint(tm_get_state(session_manager->timer_instance), ==, StPaused);
+    g_assert_cmpint(tm_get_remaining_time_ms(session_manager->timer_instance), ==,
+                    paused_remaining_ms);
+    g_assert_cmpint(session_manager->current_routine, ==, ShortBreak);
+    g_assert_cmpuint(session_manager->total_sessions_counted, ==, 7);
+    g_assert_cmpuint(session_manager->sessions_completed, ==, 3);
+}
+
+static void test_ran_out(CheckpointFixture *fixture, gconstpointer test_data)
+{
+    CpCheckpoint checkpoint = {
+        .deadline_real_us = g_get_real_time() - G_TIME_SPAN_MINUTE,
+        .initial_time_ms = 25 * 60 * 1000,
+        .remaining_time_ms = 60 * 1000,
+        .total_sessions_counted = 2,
+        .routine = Working,
+        .state = StRunning,
+        .sessions_completed = 1,
+    };
+    cp_write(&checkpoint);
+
+    SessionManagerPtr session_manager = restart(fixture);
+
+    // The work session finished while Samaya was gone, the break is waiting to be started.
+    g_assert_cmpint(tm_get_state(session_manager->timer_instance), ==, StIdle);
+    g_assert_cmpint(session_manager->current_routine, ==, ShortBreak);
+    g_assert_cmpuint(session_manager->sessions_completed, ==, 2);
+    g_assert_cmpuint(session_manager->total_sessions_counted, ==, 3);
+
+    // And that is checkpointed, so resuming again does not count the session twice.
+    session_manager = restart(fixture);
+    g_assert_cmpint(session_manager->current_routine, ==, ShortBreak);
+    g_assert_cmpuint(session_manager->total_sessions_counted, ==, 3);
+}
+
+static void test_invalid(CheckpointFixture *fixture, gconstpointer test_data)
+{
+    g_autoptr(GError) error = NULL;
+    CpCheckpoint checkpoint;
+
+    g_assert_true(g_file_set_contents(fixture->path, "not a checkpoint", -1, NULL));
+
+    g_assert_false(cp_read(fixture->path, &checkpoint, &error));
+    g_assert_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+}
+
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add("/checkpoint/running", CheckpointFixture, NULL, fixture_setup, test_running,
+               fixture_teardown);
+    g_test_add("/checkpoint/paused", CheckpointFixture, NULL, fixture_setup, test_paused,
+               fixture_teardown);
+    g_test_add("/checkpoint/ran-out", CheckpointFixture, NULL, fixture_setup, test_ran_out,
+               fixture_teardown);
+    g_test_add("/checkpoint/invalid", CheckpointFixture, NULL, fixture_setup, test_invalid,
+               fixture_teardown);
+
+    return g_test_run();
+}
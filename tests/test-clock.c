@@ -0,0 +1,149 @@
+/* test-clock.c
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+#include <gtk/gtk.h>
+#include "samaya-clock.h"
+
+/*  The countdown clock widget, measured and formatted without being shown.
+
+    Needs a display for the fonts, meson runs it through samaya-headless.sh to give it one. When no
+    display can be opened the test is reported as skipped.
+*/
+
+#define MINUTE_MS (60 * 1000)
+
+
+/* ============================================================================
+ * Helpers
+ * ============================================================================ */
+
+static int get_natural_width(SamayaClock *clock)
+{
+    int natural = 0;
+
+    gtk_widget_measure(GTK_WIDGET(clock), GTK_ORIENTATION_HORIZONTAL, -1, NULL, &natural, NULL,
+                       NULL);
+
+    return natural;
+}
+
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================ */
+
+static void test_format(void)
+{
+    SamayaClock *clock = g_object_ref_sink(samaya_clock_new());
+
+    samaya_clock_set_time(clock, 25 * MINUTE_MS);
+    g_assert_cmpstr(samaya_clock_get_text(clock), ==, "25:00");
+
+    // Rounded down, like the timer counts.
+    samaya_clock_set_time(clock, 1999);
+    g_assert_cmpstr(samaya_clock_get_text(clock), ==, "00:01");
+
+    samaya_clock_set_time(clock, -40);
+    g_assert_cmpstr(samaya_clock_get_text(clock), ==, "00:00");
+
+    samaya_clock_set_time(clock, 120 * MINUTE_MS);
+    g_assert_cmpstr(samaya_clock_get_text(clock), ==, "120:00");
+
+    samaya_clock_set_show_tenths(clock, TRUE);
+    samaya_clock_set_time(clock, MINUTE_MS + 1299);
+    g_assert_cmpstr(samaya_clock_get_text(clock), ==, "01:01.2");
+
+    g_object_unref(clock);
+}
+
+static void test_fixed_width(void)
+{
+    SamayaClock *clock = g_object_ref_sink(samaya_clock_new());
+
+    samaya_clock_set_time(clock, 25 * MINUTE_MS);
+    int width = get_natural_width(clock);
+    g_assert_cmpint(width, >, 0);
+
+    // Counting down never changes the size.
+    static const gint64 times_ms[] = {11 * MINUTE_MS + 11000, 10 * MINUTE_MS, 88 * MINUTE_MS,
+                                      1000, 0};
+    for (gsize i = 0; i < G_N_ELEMENTS(times_ms); i++) {
+        samaya_clock_set_time(clock, times_ms[i]);
+        g_assert_cmpint(get_natural_width(clock), ==, width);
+    }
+
+    // Only another number of minute digits or the tenths do.
+    samaya_clock_set_time(clock, 100 * MINUTE_MS);
+    g_assert_cmpint(get_natural_width(clock), >, width);
+
+    samaya_clock_set_time(clock, 25 * MINUTE_MS);
+    g_assert_cmpint(get_natural_width(clock), ==, width);
+
+    samaya_clock_set_show_tenths(clock, TRUE);
+    g_assert_cmpint(get_natural_width(clock), >, width);
+
+    g_object_unref(clock);
+}
+
+static void test_deadline(void)
+{
+    SamayaClock *clock = g_object_ref_sink(samaya_clock_new());
+    gint64 deadline_us = g_get_monotonic_time() + 10 * G_USEC_PER_SEC;
+
+    samaya_clock_set_time(clock, 10000);
+
+    // Whole seconds still come from the ticks of the timer.
+    samaya_clock_set_deadline(clock, deadline_us);
+    samaya_clock_set_time(clock, 9000);
+    g_assert_cmpstr(samaya_clock_get_text(clock), ==, "00:09");
+
+    // Tenths are left to the frame clock while the timer runs.
+    samaya_clock_set_show_tenths(clock, TRUE);
+    g_assert_cmpstr(samaya_clock_get_text(clock), ==, "00:09.0");
+    samaya_clock_set_time(clock, 8000);
+    g_assert_cmpstr(samaya_clock_get_text(clock), ==, "00:09.0");
+
+    // And back to the timer once it stops.
+    samaya_clock_set_deadline(clock, 0);
+    samaya_clock_set_time(clock, 7500);
+    g_assert_cmpstr(samaya_clock_get_text(clock), ==, "00:07.5");
+
+    g_object_unref(clock);
+}
+
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    if (!gtk_init_check()) {
+        g_printerr("No display available, skipping clock test.\n");
+        return 77;
+    }
+
+    g_test_add_func("/clock/format", test_format);
+    g_test_add_func("/clock/fixed-width", test_fixed_width);
+    g_test_add_func("/clock/deadline", test_deadline);
+
+    return g_test_run();
+}
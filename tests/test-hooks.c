@@ -0,0 +1,338 @@
+/* test-hooks.c
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include "samaya-hooks.h"
+#include "samaya-session.h"
+#include "samaya-timer.h"
+
+/*  Running user hooks.
+
+    Hooks are real processes started through /bin/sh, which write what they were given into a
+    temporary directory, so every case waits on the main loop for them to exit.
+*/
+
+#define WAIT_TIMEOUT_US (10 * G_USEC_PER_SEC)
+#define HOOK_TIMEOUT_MS (10 * 1000)
+
+typedef struct
+{
+    gchar *directory;
+    gchar *path;
+    guint wakeup_id;
+} HooksFixture;
+
+// Runs the main loop until the condition holds, failing the test if it never does.
+#define ITERATE_UNTIL(condition)                                                                  \
+    G_STMT_START                                                                                  \
+    {                                                                                             \
+        gint64 deadline_us = g_get_monotonic_time() + WAIT_TIMEOUT_US;                            \
+        while (!(condition) && g_get_monotonic_time() < deadline_us) {                            \
+            g_main_context_iteration(NULL, TRUE);                                                 \
+        }                                                                                         \
+        g_assert_true(condition);                                                                 \
+    }                                                                                             \
+    G_STMT_END
+
+static const HkContext workContext = {
+    .routine = "work",
+    .tag = "writing",
+    .planned_ms = 25 * 60 * 1000,
+    .elapsed_ms = 60 * 1000,
+    .start_real_us = G_GINT64_CONSTANT(1700000000) * G_USEC_PER_SEC,
+    .event_real_us = G_GINT64_CONSTANT(1700000060) * G_USEC_PER_SEC,
+    .total_sessions = 3,
+};
+
+
+/* ============================================================================
+ * Fixture
+ * ============================================================================ */
+
+static gboolean on_wakeup(gpointer user_data)
+{
+    return G_SOURCE_CONTINUE;
+}
+
+static void fixture_setup(HooksFixture *fixture, gconstpointer test_data)
+{
+    fixture->directory = g_dir_make_tmp("samaya-hooks-XXXXXX", NULL);
+    g_assert_nonnull(fixture->directory);
+
+    fixture->path = g_build_filename(fixture->directory, "hook.txt", NULL);
+
+    // Keeps ITERATE_UNTIL from blocking forever when nothing else happens.
+    fixture->wakeup_id = g_timeout_add(50, on_wakeup, NULL);
+
+    hk_enable(HOOK_TIMEOUT_MS);
+}
+
+static void fixture_teardown(HooksFixture *fixture, gconstpointer test_data)
+{
+    hk_disable();
+
+    g_source_remove(fixture->wakeup_id);
+
+    g_unlink(fixture->path);
+    g_rmdir(fixture->directory);
+
+    g_free(fixture->path);
+    g_free(fixture->directory);
+}
+
+// Sets a hook appending the given shell snippet's output to the fixture's file.
+static void set_appending_hook(HooksFixture *fixture, HkEvent event, const char *snippet)
+{
+    g_autoptr(GError) error = NULL;
+    g_autofree gchar *quoted_path = g_shell_quote(fixture->path);
+    g_autofree gchar *script = g_strdup_printf("%s >> %s", snippet, quoted_path);
+    g_autofree gchar *quoted_script = g_shell_quote(script);
+    g_autofree gchar *command_line = g_strdup_printf("/bin/sh -c %s", quoted_script);
+
+    g_assert_true(hk_set_command(event, command_line, &error));
+    g_assert_no_error(error);
+}
+
+static gchar *read_output(HooksFixture *fixture)
+{
+    g_autoptr(GError) error = NULL;
+    gchar *contents = NULL;
+
+    g_assert_true(g_file_get_contents(fixture->path, &contents, NULL, &error));
+    g_assert_no_error(error);
+
+    return contents;
+}
+
+static gboolean all_hooks_done(guint64 n_started)
+{
+    const HkStats *stats = hk_get_stats();
+
+    return stats->n_spawned + stats->n_failed >= n_started && stats->n_running == 0 &&
+           stats->n_queued == 0;
+}
+
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================ */
+
+static void test_environment(HooksFixture *fixture, gconstpointer test_data)
+{
+    set_appending_hook(fixture, HkSessionEnd, "env | grep ^SAMAYA_ | LC_ALL=C sort");
+
+    hk_run(HkSessionEnd, &workContext);
+    ITERATE_UNTIL(all_hooks_done(1));
+
+    g_autofree gchar *output = read_output(fixture);
+    g_assert_cmpstr(output, ==,
+                    "SAMAYA_ELAPSED_MS=60000\n"
+                    "SAMAYA_EVENT=end\n"
+                    "SAMAYA_EVENT_TIME=1700000060\n"
+                    "SAMAYA_PLANNED_MS=1500000\n"
+                    "SAMAYA_ROUTINE=work\n"
+                    "SAMAYA_START_TIME=1700000000\n"
+                    "SAMAYA_TAG=writing\n"
+                    "SAMAYA_TOTAL_SESSIONS=3\n");
+
+    const HkStats *stats = hk_get_stats();
+    g_assert_cmpuint(stats->n_spawned, ==, 1);
+    g_assert_cmpuint(stats->n_failed, ==, 0);
+    g_assert_cmpint(stats->last_spawn_latency_us, >, 0);
+    g_assert_cmpint(stats->max_spawn_latency_us, >=, stats->last_spawn_latency_us);
+}
+
+// Nothing is spawned from hk_run() itself, however slow the hook.
+static void test_does_not_block(HooksFixture *fixture, gconstpointer test_data)
+{
+    g_assert_true(hk_set_command(HkSessionStart, "/bin/sleep 30", NULL));
+
+    gint64 start_us = g_get_monotonic_time();
+    hk_run(HkSessionStart, &workContext);
+    gint64 elapsed_us = g_get_monotonic_time() - start_us;
+
+    g_assert_cmpuint(hk_get_stats()->n_spawned, ==, 0);
+    g_assert_cmpuint(hk_get_stats()->n_queued, ==, 1);
+    g_assert_cmpint(elapsed_us, <, 50 * 1000);
+
+    ITERATE_UNTIL(hk_get_stats()->n_running == 1);
+}
+
+static void test_bounded_pool(HooksFixture *fixture, gconstpointer test_data)
+{
+    set_appending_hook(fixture, HkSessionStart, "sleep 0.2; echo done");
+
+    guint n_hooks = HK_MAX_RUNNING * 2 + 1;
+    for (guint i = 0; i < n_hooks; i++) {
+        hk_run(HkSessionStart, &workContext);
+    }
+
+    guint max_running = 0;
+    gint64 deadline_us = g_get_monotonic_time() + WAIT_TIMEOUT_US;
+    while (!all_hooks_done(n_hooks) && g_get_monotonic_time() < deadline_us) {
+        g_main_context_iteration(NULL, TRUE);
+        max_running = MAX(max_running, hk_get_stats()->n_running);
+    }
+
+    g_assert_true(all_hooks_done(n_hooks));
+    g_assert_cmpuint(max_running, ==, HK_MAX_RUNNING);
+
+    g_autofree gchar *output = read_output(fixture);
+    g_auto(GStrv) lines = g_strsplit(output, "\n", -1);
+    g_assert_cmpuint(g_strv_length(lines), ==, n_hooks + 1);
+}
+
+static void test_queue_limit(HooksFixture *fixture, gconstpointer test_data)
+{
+    g_assert_true(hk_set_command(HkSessionSkip, "/bin/true", NULL));
+
+    for (guint i = 0; i < HK_MAX_QUEUED + 3; i++) {
+        hk_run(HkSessionSkip, &workContext);
+    }
+
+    g_assert_cmpuint(hk_get_stats()->n_queued, ==, HK_MAX_QUEUED);
+    g_assert_cmpuint(hk_get_stats()->n_dropped, ==, 3);
+
+    ITERATE_UNTIL(all_hooks_done(HK_MAX_QUEUED));
+    g_assert_cmpuint(hk_get_stats()->n_spawned, ==, HK_MAX_QUEUED);
+}
+
+static void test_killed_on_timeout(HooksFixture *fixture, gconstpointer test_data)
+{
+    hk_set_timeout(100);
+    g_assert_true(hk_set_command(HkSessionStart, "/bin/sleep 30", NULL));
+
+    gint64 start_us = g_get_monotonic_time();
+    hk_run(HkSessionStart, &workContext);
+
+    ITERATE_UNTIL(all_hooks_done(1));
+    g_assert_cmpuint(hk_get_stats()->n_killed, ==, 1);
+    g_assert_cmpuint(hk_get_stats()->n_failed, ==, 0);
+    g_assert_cmpint(g_get_monotonic_time() - start_us, <, 5 * G_USEC_PER_SEC);
+}
+
+// Running and not waiting to be reaped.
+static gboolean is_process_alive(const char *pid)
+{
+    g_autofree gchar *stat_path = g_build_filename("/proc", pid, "stat", NULL);
+    g_autofree gchar *stat = NULL;
+
+    if (!g_file_get_contents(stat_path, &stat, NULL, NULL)) {
+        return FALSE;
+    }
+
+    const char *state = strrchr(stat, ')');
+    return state != NULL && state[1] == ' ' && state[2] != 'Z' && state[2] != 'X';
+}
+
+static void test_killed_with_children(HooksFixture *fixture, gconstpointer test_data)
+{
+    g_autofree gchar *quoted_path = g_shell_quote(fixture->path);
+    g_autofree gchar *script = g_strdup_printf("sleep 30 & echo $! > %s; wait", quoted_path);
+    g_autofree gchar *quoted_script = g_shell_quote(script);
+    g_autofree gchar *command_line = g_strdup_printf("/bin/sh -c %s", quoted_script);
+
+    hk_set_timeout(500);
+    g_assert_true(hk_set_command(HkSessionStart, command_line, NULL));
+    hk_run(HkSessionStart, &workContext);
+
+    ITERATE_UNTIL(all_hooks_done(1));
+    g_assert_cmpuint(hk_get_stats()->n_killed, ==, 1);
+
+    // The sleep the shell started went down with it.
+    g_autofree gchar *output = read_output(fixture);
+    g_strstrip(output);
+    g_assert_cmpstr(output, !=, "");
+    ITERATE_UNTIL(!is_process_alive(output));
+}
+
+static void test_failures(HooksFixture *fixture, gconstpointer test_data)
+{
+    g_autoptr(GError) error = NULL;
+
+    g_assert_false(hk_set_command(HkSessionStart, "echo 'unbalanced", &error));
+    g_assert_error(error, G_SHELL_ERROR, G_SHELL_ERROR_BAD_QUOTING);
+
+    g_assert_true(hk_set_command(HkSessionStart, "/nonexistent/samaya-hook", NULL));
+    g_assert_true(hk_set_command(HkSessionEnd, "/bin/false", NULL));
+
+    hk_run(HkSessionStart, &workContext);
+    hk_run(HkSessionEnd, &workContext);
+
+    ITERATE_UNTIL(hk_get_stats()->n_failed == 2 && all_hooks_done(2));
+    g_assert_cmpuint(hk_get_stats()->n_spawned, ==, 1);
+}
+
+static void test_session_events(HooksFixture *fixture, gconstpointer test_data)
+{
+    SessionManagerPtr session_manager = sm_init(4, 25.0, 5.0, 20.0, FALSE, FALSE, NULL, NULL);
+
+    set_appending_hook(fixture, HkSessionStart, "echo $SAMAYA_EVENT $SAMAYA_ROUTINE");
+    set_appending_hook(fixture, HkSessionSkip, "echo $SAMAYA_EVENT $SAMAYA_ROUTINE");
+
+    // Pausing and resuming is still the same routine, only the first start runs the hook.
+    tm_trigger_event(session_manager->timer_instance, EvStart);
+    tm_trigger_event(session_manager->timer_instance, EvStop);
+    tm_trigger_event(session_manager->timer_instance, EvStart);
+    ITERATE_UNTIL(all_hooks_done(1));
+
+    sm_skip_session();
+    ITERATE_UNTIL(all_hooks_done(2));
+
+    // A routine that never started has nothing to skip.
+    sm_skip_session();
+
+    g_autofree gchar *output = read_output(fixture);
+    g_assert_cmpstr(output, ==, "start work\nskip work\n");
+    g_assert_cmpuint(hk_get_stats()->n_queued, ==, 0);
+
+    sm_deinit(session_manager);
+}
+
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add("/hooks/environment", HooksFixture, NULL, fixture_setup, test_environment,
+               fixture_teardown);
+    g_test_add("/hooks/does-not-block", HooksFixture, NULL, fixture_setup, test_does_not_block,
+               fixture_teardown);
+    g_test_add("/hooks/bounded-pool", HooksFixture, NULL, fixture_setup, test_bounded_pool,
+               fixture_teardown);
+    g_test_add("/hooks/queue-limit", HooksFixture, NULL, fixture_setup, test_queue_limit,
+               fixture_teardown);
+    g_test_add("/hooks/killed-on-timeout", HooksFixture, NULL, fixture_setup,
+               test_killed_on_timeout, fixture_teardown);
+    g_test_add("/hooks/killed-with-children", HooksFixture, NULL, fixture_setup,
+               test_killed_with_children, fixture_teardown);
+    g_test_add("/hooks/failures", HooksFixture, NULL, fixture_setup, test_failures,
+               fixture_teardown);
+    g_test_add("/hooks/session-events", HooksFixture, NULL, fixture_setup, test_session_events,
+               fixture_teardown);
+
+    return g_test_run();
+}
@@ -0,0 +1,260 @@
+/* test-idle.c
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include <gio/gio.h>
+#include <glib.h>
+#include "samaya-idle.h"
+#include "samaya-mock-bus.h"
+#include "samaya-session.h"
+#include "samaya-timer.h"
+
+/*  Pausing work sessions while the user is idle.
+
+    Every case runs against a private bus with a mock of the GNOME idle monitor on it, which
+    hands out watch ids and lets the test fire them, the way Mutter does once there has been no
+    input for a while and again on the next input.
+*/
+
+#define IDLE_TIMEOUT_MS (60 * 1000)
+
+static const char mockIntrospectionXml[] =
+    "<node>"
+    "  <interface name='" IM_INTERFACE "'>"
+    "    <method name='AddIdleWatch'>"
+    "      <arg name='interval' direction='in' type='t'/>"
+    "      <arg name='id' direction='out' type='u'/>"
+    "    </method>"
+    "    <method name='AddUserActiveWatch'>"
+    "      <arg name='id' direction='out' type='u'/>"
+    "    </method>"
+    "    <method name='RemoveWatch'>"
+    "      <arg name='id' direction='in' type='u'/>"
+    "    </method>"
+    "    <signal name='WatchFired'>"
+    "      <arg name='id' type='u'/>"
+    "    </signal>"
+    "  </interface>"
+    "</node>";
+
+typedef struct
+{
+    MockBus mock_bus;
+
+    // Watches handed out by the mock idle monitor.
+    guint32 next_watch_id;
+    guint32 idle_watch_id;
+    guint64 idle_interval_ms;
+    guint32 active_watch_id;
+    guint n_removed_watches;
+
+    SessionManagerPtr session_manager;
+} IdleFixture;
+
+
+/* ============================================================================
+ * Mock Idle Monitor
+ * ============================================================================ */
+
+static void on_mock_method_call(GDBusConnection *connection, const gchar *sender,
+                                const gchar *object_path, const gchar *interface_name,
+                                const gchar *method_name, GVariant *parameters,
+                                GDBusMethodInvocation *invocation, gpointer user_data)
+{
+    IdleFixture *fixture = user_data;
+
+    if (g_strcmp0(method_name, "AddIdleWatch") == 0) {
+        g_variant_get(parameters, "(t)", &fixture->idle_interval_ms);
+        fixture->idle_watch_id = ++fixture->next_watch_id;
+        g_dbus_method_invocation_return_value(invocation,
+                                              g_variant_new("(u)", fixture->idle_watch_id));
+    } else if (g_strcmp0(method_name, "AddUserActiveWatch") == 0) {
+        fixture->active_watch_id = ++fixture->next_watch_id;
+        g_dbus_method_invocation_return_value(invocation,
+                                              g_variant_new("(u)", fixture->active_watch_id));
+    } else if (g_strcmp0(method_name, "RemoveWatch") == 0) {
+        fixture->n_removed_watches++;
+        g_dbus_method_invocation_return_value(invocation, NULL);
+    } else {
+        g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR,
+                                              G_DBUS_ERROR_UNKNOWN_METHOD, "Unknown method %s",
+                                              method_name);
+    }
+}
+
+static const GDBusInterfaceVTable mockVTable = {.method_call = on_mock_method_call};
+
+static void fire_watch(IdleFixture *fixture, guint32 watch_id)
+{
+    g_autoptr(GError) error = NULL;
+
+    const gchar *client_name = g_dbus_connection_get_unique_name(fixture->mock_bus.client);
+
+    g_dbus_connection_emit_signal(fixture->mock_bus.service, client_name, IM_OBJECT_PATH,
+                                  IM_INTERFACE, "WatchFired", g_variant_new("(u)", watch_id),
+                                  &error);
+    g_assert_no_error(error);
+}
+
+
+/* ============================================================================
+ * Fixture
+ * ============================================================================ */
+
+static void fixture_setup(IdleFixture *fixture, gconstpointer test_data)
+{
+    mock_bus_up(&fixture->mock_bus, mockIntrospectionXml);
+    mock_bus_register_object(&fixture->mock_bus, IM_OBJECT_PATH, IM_INTERFACE, &mockVTable,
+                             fixture);
+    mock_bus_own_name(&fixture->mock_bus, IM_BUS_NAME);
+
+    fixture->session_manager = sm_init(4, 25.0, 5.0, 20.0, FALSE, FALSE, NULL, NULL);
+}
+
+static void fixture_teardown(IdleFixture *fixture, gconstpointer test_data)
+{
+    im_disable();
+    sm_deinit(fixture->session_manager);
+
+    mock_bus_down(&fixture->mock_bus);
+}
+
+// Starts following the mock and waits until the idle watch was added.
+static void enable(IdleFixture *fixture, gboolean subtract_idle_time)
+{
+    im_enable(fixture->mock_bus.client, IDLE_TIMEOUT_MS, subtract_idle_time);
+
+    ITERATE_UNTIL(fixture->idle_watch_id != 0);
+    g_assert_cmpuint(fixture->idle_interval_ms, ==, IDLE_TIMEOUT_MS);
+
+    mock_bus_sync(&fixture->mock_bus);
+}
+
+// Runs a session of the given routine with at most ten minutes left.
+static TimerPtr start_session(IdleFixture *fixture, RoutineType routine)
+{
+    TimerPtr timer = fixture->session_manager->timer_instance;
+
+    sm_set_routine(routine, fixture->session_manager);
+    tm_restore(timer, StRunning, timer->initial_time_ms, 10 * 60 * 1000);
+
+    return timer;
+}
+
+// Fires the idle watch and waits for the user active watch the session now waits on.
+static void go_idle(IdleFixture *fixture)
+{
+    fire_watch(fixture, fixture->idle_watch_id);
+
+    ITERATE_UNTIL(fixture->active_watch_id != 0);
+    mock_bus_sync(&fixture->mock_bus);
+}
+
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================ */
+
+static void test_pause_and_resume(IdleFixture *fixture, gconstpointer test_data)
+{
+    TimerPtr timer = start_session(fixture, Working);
+    enable(fixture, TRUE);
+
+    go_idle(fixture);
+    g_assert_cmpint(tm_get_state(timer), ==, StPaused);
+
+    fire_watch(fixture, fixture->active_watch_id);
+    ITERATE_UNTIL(tm_get_state(timer) == StRunning);
+
+    // The minute the user was idle before the pause is given back.
+    g_assert_cmpint(tm_get_remaining_time_ms(timer), >, 11 * 60 * 1000 - 5000);
+    g_assert_cmpint(tm_get_remaining_time_ms(timer), <=, 11 * 60 * 1000);
+}
+
+static void test_keep_idle_time(IdleFixture *fixture, gconstpointer test_data)
+{
+    TimerPtr timer = start_session(fixture, Working);
+    enable(fixture, FALSE);
+
+    go_idle(fixture);
+    fire_watch(fixture, fixture->active_watch_id);
+    ITERATE_UNTIL(tm_get_state(timer) == StRunning);
+
+    g_assert_cmpint(tm_get_remaining_time_ms(timer), <=, 10 * 60 * 1000);
+}
+
+static void test_breaks_keep_running(IdleFixture *fixture, gconstpointer test_data)
+{
+    TimerPtr timer = start_session(fixture, ShortBreak);
+    enable(fixture, TRUE);
+
+    fire_watch(fixture, fixture->idle_watch_id);
+    mock_bus_sync(&fixture->mock_bus);
+
+    g_assert_cmpint(tm_get_state(timer), ==, StRunning);
+    g_assert_cmpuint(fixture->active_watch_id, ==, 0);
+}
+
+static void test_user_took_over(IdleFixture *fixture, gconstpointer test_data)
+{
+    TimerPtr timer = start_session(fixture, Working);
+    enable(fixture, TRUE);
+
+    go_idle(fixture);
+
+    // Reset from the window, say, before the next input was noticed.
+    tm_trigger_event(timer, EvReset);
+
+    fire_watch(fixture, fixture->active_watch_id);
+    mock_bus_sync(&fixture->mock_bus);
+
+    g_assert_cmpint(tm_get_state(timer), ==, StIdle);
+}
+
+static void test_disable(IdleFixture *fixture, gconstpointer test_data)
+{
+    enable(fixture, TRUE);
+
+    im_disable();
+    g_assert_false(im_is_enabled());
+
+    ITERATE_UNTIL(fixture->n_removed_watches == 1);
+}
+
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add("/idle/pause-and-resume", IdleFixture, NULL, fixture_setup, test_pause_and_resume,
+               fixture_teardown);
+    g_test_add("/idle/keep-idle-time", IdleFixture, NULL, fixture_setup, test_keep_idle_time,
+               fixture_teardown);
+    g_test_add("/idle/breaks-keep-running", IdleFixture, NULL, fixture_setup,
+               test_breaks_keep_running, fixture_teardown);
+    g_test_add("/idle/user-took-over", IdleFixture, NULL, fixture_setup, test_user_took_over,
+               fixture_teardown);
+    g_test_add("/idle/disable", IdleFixture, NULL, fixture_setup, test_disable, fixture_teardown);
+
+    return g_test_run();
+}
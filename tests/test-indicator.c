@@ -0,0 +1,257 @@
+/* test-indicator.c
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include <gio/gio.h>
+#include <glib.h>
+#include "samaya-indicator.h"
+#include "samaya-mock-bus.h"
+#include "samaya-session.h"
+#include "samaya-timer-private.h"
+#include "samaya-timer.h"
+
+/*  The panel indicator, registered with a mock StatusNotifierWatcher on a private bus.
+
+    Sessions are ticked through under a virtual clock, counting how often the indicator tells the
+    panel to fetch a new icon or tooltip.
+*/
+
+#define WORK_MINUTES 25
+
+static const char mockIntrospectionXml[] =
+    "<node>"
+    "  <interface name='" SI_WATCHER_INTERFACE "'>"
+    "    <method name='RegisterStatusNotifierItem'>"
+    "      <arg name='service' direction='in' type='s'/>"
+    "    </method>"
+    "  </interface>"
+    "</node>";
+
+static gint64 virtualClockUs = 0;
+
+typedef struct
+{
+    // The mock watcher is served on the service connection, the indicator uses the client one.
+    MockBus mock_bus;
+    guint signal_id;
+
+    // Seen by the mock watcher.
+    guint n_registrations;
+    gchar *registered_service;
+    guint n_new_icons;
+    guint n_new_tooltips;
+
+    // Seen by the indicator.
+    guint n_registration_changes;
+
+    SessionManagerPtr session_manager;
+} IndicatorFixture;
+
+
+/* ============================================================================
+ * Mock Watcher
+ * ============================================================================ */
+
+static void on_mock_method_call(GDBusConnection *connection, const gchar *sender,
+                                const gchar *object_path, const gchar *interface_name,
+                                const gchar *method_name, GVariant *parameters,
+                                GDBusMethodInvocation *invocation, gpointer user_data)
+{
+    IndicatorFixture *fixture = user_data;
+
+    g_clear_pointer(&fixture->registered_service, g_free);
+    g_variant_get(parameters, "(s)", &fixture->registered_service);
+    fixture->n_registrations++;
+
+    g_dbus_method_invocation_return_value(invocation, NULL);
+}
+
+static const GDBusInterfaceVTable mockVTable = {.method_call = on_mock_method_call};
+
+static void on_item_signal(GDBusConnection *connection, const gchar *sender_name,
+                           const gchar *object_path, const gchar *interface_name,
+                           const gchar *signal_name, GVariant *parameters, gpointer user_data)
+{
+    IndicatorFixture *fixture = user_data;
+
+    if (g_strcmp0(signal_name, "NewIcon") == 0) {
+        fixture->n_new_icons++;
+    } else if (g_strcmp0(signal_name, "NewToolTip") == 0) {
+        fixture->n_new_tooltips++;
+    }
+}
+
+
+/* ============================================================================
+ * Fixture
+ * ============================================================================ */
+
+static gint64 virtual_clock(void)
+{
+    return virtualClockUs;
+}
+
+static void on_registration_changed(gpointer user_data)
+{
+    IndicatorFixture *fixture = user_data;
+
+    fixture->n_registration_changes++;
+}
+
+static void fixture_setup(IndicatorFixture *fixture, gconstpointer test_data)
+{
+    MockBus *mock_bus = &fixture->mock_bus;
+
+    mock_bus_up(mock_bus, mockIntrospectionXml);
+    mock_bus_register_object(mock_bus, SI_WATCHER_OBJECT_PATH, SI_WATCHER_INTERFACE, &mockVTable,
+                             fixture);
+
+    fixture->signal_id = g_dbus_connection_signal_subscribe(
+        mock_bus->service, g_dbus_connection_get_unique_name(mock_bus->client), SI_INTERFACE, NULL,
+        SI_OBJECT_PATH, NULL, G_DBUS_SIGNAL_FLAGS_NONE, on_item_signal, fixture, NULL);
+
+    mock_bus_own_name(mock_bus, SI_WATCHER_BUS_NAME);
+
+    fixture->session_manager = sm_init(4, WORK_MINUTES, 5.0, 20.0, FALSE, FALSE, NULL, NULL);
+    tm_set_clock(fixture->session_manager->timer_instance, virtual_clock);
+
+    si_enable(mock_bus->client, NULL, NULL, on_registration_changed, fixture);
+    ITERATE_UNTIL(si_is_registered());
+}
+
+static void fixture_teardown(IndicatorFixture *fixture, gconstpointer test_data)
+{
+    si_disable();
+    sm_deinit(fixture->session_manager);
+
+    g_dbus_connection_signal_unsubscribe(fixture->mock_bus.service, fixture->signal_id);
+    g_clear_pointer(&fixture->registered_service, g_free);
+
+    mock_bus_down(&fixture->mock_bus);
+}
+
+static GVariant *get_item_property(IndicatorFixture *fixture, const char *property_name)
+{
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GVariant) reply = g_dbus_connection_call_sync(
+        fixture->mock_bus.service, fixture->registered_service, SI_OBJECT_PATH,
+        "org.freedesktop.DBus.Properties", "Get",
+        g_variant_new("(ss)", SI_INTERFACE, property_name), G_VARIANT_TYPE("(v)"),
+        G_DBUS_CALL_FLAGS_NONE, -1, NULL, &error);
+    g_assert_no_error(error);
+
+    GVariant *value = NULL;
+    g_variant_get(reply, "(v)", &value);
+
+    return value;
+}
+
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================ */
+
+static void test_register(IndicatorFixture *fixture, gconstpointer test_data)
+{
+    g_assert_cmpuint(fixture->n_registrations, ==, 1);
+    g_assert_cmpstr(fixture->registered_service, ==,
+                    g_dbus_connection_get_unique_name(fixture->mock_bus.client));
+    g_assert_cmpuint(fixture->n_registration_changes, ==, 1);
+
+    g_autoptr(GVariant) pixmaps = get_item_property(fixture, "IconPixmap");
+    g_assert_cmpuint(g_variant_n_children(pixmaps), ==, 1);
+
+    gint width = 0;
+    gint height = 0;
+    g_autoptr(GVariant) pixels = NULL;
+    g_variant_get_child(pixmaps, 0, "(ii@ay)", &width, &height, &pixels);
+
+    g_assert_cmpint(width, ==, SI_ICON_SIZE);
+    g_assert_cmpint(height, ==, SI_ICON_SIZE);
+    g_assert_cmpuint(g_variant_get_size(pixels), ==, SI_ICON_SIZE * SI_ICON_SIZE * 4);
+
+    // A session that was not started yet shows a full ring, its top is opaque and the middle not.
+    const guint8 *data = g_variant_get_data(pixels);
+    gsize top = (2 * SI_ICON_SIZE + SI_ICON_SIZE / 2) * 4;
+    gsize middle = (SI_ICON_SIZE / 2 * SI_ICON_SIZE + SI_ICON_SIZE / 2) * 4;
+
+    g_assert_cmpuint(data[top], >, 0);
+    g_assert_cmpuint(data[middle], ==, 0);
+
+    g_autoptr(GVariant) tooltip = get_item_property(fixture, "ToolTip");
+    g_assert_true(g_variant_is_of_type(tooltip, G_VARIANT_TYPE("(sa(iiay)ss)")));
+}
+
+static void test_updates_per_session(IndicatorFixture *fixture, gconstpointer test_data)
+{
+    TimerPtr timer = fixture->session_manager->timer_instance;
+
+    tm_trigger_event(timer, EvStart);
+    si_update();
+
+    // Stops a second short of the end, completing the session would move on to the break.
+    for (gint second = 1; second < WORK_MINUTES * 60; second++) {
+        virtualClockUs += G_USEC_PER_SEC;
+        tm_run_tick(timer);
+        si_update();
+    }
+
+    mock_bus_sync(&fixture->mock_bus);
+
+    // The ring went from full to empty, the tooltip changed with the state and every minute.
+    g_assert_cmpuint(fixture->n_new_icons, ==, SI_ATLAS_STEPS);
+    g_assert_cmpuint(fixture->n_new_tooltips, ==, WORK_MINUTES);
+}
+
+static void test_watcher_restart(IndicatorFixture *fixture, gconstpointer test_data)
+{
+    mock_bus_unown_name(&fixture->mock_bus, SI_WATCHER_BUS_NAME);
+    ITERATE_UNTIL(!si_is_registered());
+
+    // Nothing is sent while there is no panel to show it.
+    sm_set_routine(ShortBreak, fixture->session_manager);
+    si_update();
+    mock_bus_sync(&fixture->mock_bus);
+    g_assert_cmpuint(fixture->n_new_icons, ==, 0);
+
+    mock_bus_own_name(&fixture->mock_bus, SI_WATCHER_BUS_NAME);
+    ITERATE_UNTIL(si_is_registered());
+
+    g_assert_cmpuint(fixture->n_registrations, ==, 2);
+    g_assert_cmpuint(fixture->n_registration_changes, ==, 3);
+}
+
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add("/indicator/register", IndicatorFixture, NULL, fixture_setup, test_register,
+               fixture_teardown);
+    g_test_add("/indicator/updates-per-session", IndicatorFixture, NULL, fixture_setup,
+               test_updates_per_session, fixture_teardown);
+    g_test_add("/indicator/watcher-restart", IndicatorFixture, NULL, fixture_setup,
+               test_watcher_restart, fixture_teardown);
+
+    return g_test_run();
+}
@@ -0,0 +1,253 @@
+/* test-low-power.c
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include <gio/gio.h>
+#include <glib.h>
+#include "samaya-low-power.h"
+#include "samaya-mock-bus.h"
+
+/*  Following the power profile and the battery.
+
+    Every case runs against a private bus with mocks of power-profiles-daemon and UPower on it,
+    which answer property reads and let the test change the properties the way the services do
+    when the user picks another profile or unplugs the charger.
+*/
+
+static const char mockIntrospectionXml[] =
+    "<node>"
+    "  <interface name='" LP_PROFILES_INTERFACE "'>"
+    "    <property name='ActiveProfile' type='s' access='read'/>"
+    "  </interface>"
+    "  <interface name='" LP_UPOWER_INTERFACE "'>"
+    "    <property name='OnBattery' type='b' access='read'/>"
+    "  </interface>"
+    "</node>";
+
+typedef struct
+{
+    MockBus mock_bus;
+
+    // State served by the mocks.
+    const gchar *active_profile;
+    gboolean on_battery;
+
+    // What the client was told.
+    guint n_changes;
+    gboolean low_power;
+} LowPowerFixture;
+
+
+/* ============================================================================
+ * Mock Services
+ * ============================================================================ */
+
+static GVariant *on_mock_get_property(GDBusConnection *connection, const gchar *sender,
+                                      const gchar *object_path, const gchar *interface_name,
+                                      const gchar *property_name, GError **error,
+                                      gpointer user_data)
+{
+    LowPowerFixture *fixture = user_data;
+
+    if (g_strcmp0(property_name, "ActiveProfile") == 0) {
+        return g_variant_new_string(fixture->active_profile);
+    }
+    if (g_strcmp0(property_name, "OnBattery") == 0) {
+        return g_variant_new_boolean(fixture->on_battery);
+    }
+
+    g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_PROPERTY, "Unknown property %s",
+                property_name);
+    return NULL;
+}
+
+static const GDBusInterfaceVTable mockVTable = {.get_property = on_mock_get_property};
+
+static void emit_properties_changed(LowPowerFixture *fixture, const gchar *object_path,
+                                    const gchar *interface_name, const gchar *property_name,
+                                    GVariant *value)
+{
+    g_autoptr(GError) error = NULL;
+
+    GVariantBuilder changed;
+    g_variant_builder_init(&changed, G_VARIANT_TYPE("a{sv}"));
+    g_variant_builder_add(&changed, "{sv}", property_name, value);
+
+    g_dbus_connection_emit_signal(fixture->mock_bus.service, NULL, object_path,
+                                  "org.freedesktop.DBus.Properties", "PropertiesChanged",
+                                  g_variant_new("(sa{sv}as)", interface_name, &changed, NULL),
+                                  &error);
+    g_assert_no_error(error);
+}
+
+static void set_active_profile(LowPowerFixture *fixture, const gchar *profile)
+{
+    fixture->active_profile = profile;
+    emit_properties_changed(fixture, LP_PROFILES_OBJECT_PATH, LP_PROFILES_INTERFACE,
+                            "ActiveProfile", g_variant_new_string(profile));
+}
+
+static void set_on_battery(LowPowerFixture *fixture, gboolean on_battery)
+{
+    fixture->on_battery = on_battery;
+    emit_properties_changed(fixture, LP_UPOWER_OBJECT_PATH, LP_UPOWER_INTERFACE, "OnBattery",
+                            g_variant_new_boolean(on_battery));
+}
+
+static void on_low_power_changed(gboolean low_power, gpointer user_data)
+{
+    LowPowerFixture *fixture = user_data;
+
+    fixture->n_changes++;
+    fixture->low_power = low_power;
+}
+
+
+/* ============================================================================
+ * Fixture
+ * ============================================================================ */
+
+static void fixture_setup(LowPowerFixture *fixture, gconstpointer test_data)
+{
+    fixture->active_profile = "balanced";
+    fixture->on_battery = FALSE;
+
+    mock_bus_up(&fixture->mock_bus, mockIntrospectionXml);
+    mock_bus_register_object(&fixture->mock_bus, LP_PROFILES_OBJECT_PATH, LP_PROFILES_INTERFACE,
+                             &mockVTable, fixture);
+    mock_bus_register_object(&fixture->mock_bus, LP_UPOWER_OBJECT_PATH, LP_UPOWER_INTERFACE,
+                             &mockVTable, fixture);
+    mock_bus_own_name(&fixture->mock_bus, LP_PROFILES_BUS_NAME);
+    mock_bus_own_name(&fixture->mock_bus, LP_UPOWER_BUS_NAME);
+}
+
+static void fixture_teardown(LowPowerFixture *fixture, gconstpointer test_data)
+{
+    lp_disable();
+
+    mock_bus_down(&fixture->mock_bus);
+}
+
+// Starts following the mocks and waits until both properties were read.
+static void enable(LowPowerFixture *fixture)
+{
+    lp_enable(fixture->mock_bus.client, on_low_power_changed, fixture);
+
+    // Two pings, the first one can overtake the reads made once the names are seen.
+    mock_bus_sync(&fixture->mock_bus);
+    mock_bus_sync(&fixture->mock_bus);
+}
+
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================ */
+
+static void test_initial_state(LowPowerFixture *fixture, gconstpointer test_data)
+{
+    fixture->active_profile = "power-saver";
+    enable(fixture);
+
+    ITERATE_UNTIL(lp_is_low_power());
+    g_assert_true(fixture->low_power);
+    g_assert_cmpuint(fixture->n_changes, ==, 1);
+}
+
+static void test_profile_changed(LowPowerFixture *fixture, gconstpointer test_data)
+{
+    enable(fixture);
+    g_assert_false(lp_is_low_power());
+
+    set_active_profile(fixture, "power-saver");
+    ITERATE_UNTIL(lp_is_low_power());
+
+    set_active_profile(fixture, "performance");
+    ITERATE_UNTIL(!lp_is_low_power());
+    g_assert_cmpuint(fixture->n_changes, ==, 2);
+}
+
+static void test_on_battery(LowPowerFixture *fixture, gconstpointer test_data)
+{
+    enable(fixture);
+
+    set_on_battery(fixture, TRUE);
+    ITERATE_UNTIL(lp_is_low_power());
+
+    // Still on battery, picking the power-saver profile as well changes nothing.
+    set_active_profile(fixture, "power-saver");
+    mock_bus_sync(&fixture->mock_bus);
+    set_on_battery(fixture, FALSE);
+    mock_bus_sync(&fixture->mock_bus);
+
+    g_assert_true(lp_is_low_power());
+    g_assert_cmpuint(fixture->n_changes, ==, 1);
+}
+
+static void test_service_vanished(LowPowerFixture *fixture, gconstpointer test_data)
+{
+    fixture->active_profile = "power-saver";
+    enable(fixture);
+    ITERATE_UNTIL(lp_is_low_power());
+
+    mock_bus_unown_name(&fixture->mock_bus, LP_PROFILES_BUS_NAME);
+
+    ITERATE_UNTIL(!lp_is_low_power());
+    g_assert_false(fixture->low_power);
+}
+
+static void test_disable(LowPowerFixture *fixture, gconstpointer test_data)
+{
+    fixture->on_battery = TRUE;
+    enable(fixture);
+    ITERATE_UNTIL(lp_is_low_power());
+
+    lp_disable();
+    g_assert_false(lp_is_enabled());
+    g_assert_false(lp_is_low_power());
+    g_assert_false(fixture->low_power);
+
+    // Nothing is followed anymore.
+    set_on_battery(fixture, FALSE);
+    set_on_battery(fixture, TRUE);
+    mock_bus_sync(&fixture->mock_bus);
+    g_assert_cmpuint(fixture->n_changes, ==, 2);
+}
+
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add("/low-power/initial-state", LowPowerFixture, NULL, fixture_setup,
+               test_initial_state, fixture_teardown);
+    g_test_add("/low-power/profile-changed", LowPowerFixture, NULL, fixture_setup,
+               test_profile_changed, fixture_teardown);
+    g_test_add("/low-power/on-battery", LowPowerFixture, NULL, fixture_setup, test_on_battery,
+               fixture_teardown);
+    g_test_add("/low-power/service-vanished", LowPowerFixture, NULL, fixture_setup,
+               test_service_vanished, fixture_teardown);
+    g_test_add("/low-power/disable", LowPowerFixture, NULL, fixture_setup, test_disable,
+               fixture_teardown);
+
+    return g_test_run();
+}
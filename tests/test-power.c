@@ -0,0 +1,241 @@
+/* test-power.c
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include <glib.h>
+#include <sys/resource.h>
+#include "samaya-session.h"
+#include "samaya-timer.h"
+
+/*  Wakeup and CPU time budgets of the timer and session core.
+
+    Every case runs the core under a real main loop for a fixed window and counts how often the
+    loop woke up from poll, how many context switches the process did and how much CPU time it
+    used. A case fails when any of them goes over its budget, so changes to the tick path that
+    quietly cost battery are caught.
+*/
+
+#define WINDOW_SECONDS 3
+
+typedef struct
+{
+    guint64 wakeups;
+    guint64 context_switches;
+    gint64 cpu_time_us;
+} PowerSample;
+
+typedef struct
+{
+    guint64 max_wakeups;
+    guint64 max_context_switches;
+    gint64 max_cpu_time_us;
+} PowerBudget;
+
+typedef struct
+{
+    SessionManagerPtr session_manager;
+    guint consumer_updates;
+} PowerFixture;
+
+// One wakeup is always spent on the timeout ending the measurement window.
+static const PowerBudget idleBudget = {2, 10, 10 * 1000};
+static const PowerBudget runningBudget = {WINDOW_SECONDS + 2, 2 * WINDOW_SECONDS + 10, 30 * 1000};
+
+static guint64 wakeupCount = 0;
+
+
+/* ============================================================================
+ * Measurement Helpers
+ * ============================================================================ */
+
+static gint counting_poll(GPollFD *fds, guint nfds, gint timeout)
+{
+    // A zero timeout only checks for ready sources, the loop did not sleep so it is no wakeup.
+    if (timeout != 0) {
+        wakeupCount++;
+    }
+
+    return g_poll(fds, nfds, timeout);
+}
+
+static PowerSample take_sample(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    return (PowerSample) {
+        .wakeups = wakeupCount,
+        .context_switches = (guint64) usage.ru_nvcsw + (guint64) usage.ru_nivcsw,
+        .cpu_time_us = (gint64) usage.ru_utime.tv_sec * G_USEC_PER_SEC + usage.ru_utime.tv_usec +
+                       (gint64) usage.ru_stime.tv_sec * G_USEC_PER_SEC + usage.ru_stime.tv_usec,
+    };
+}
+
+static gboolean on_window_elapsed(gpointer loop)
+{
+    g_main_loop_quit(loop);
+    return G_SOURCE_REMOVE;
+}
+
+static PowerSample measure_window(void)
+{
+    GMainLoop *loop = g_main_loop_new(NULL, FALSE);
+    g_timeout_add_seconds(WINDOW_SECONDS, on_window_elapsed, loop);
+
+    PowerSample start = take_sample();
+    g_main_loop_run(loop);
+    PowerSample end = take_sample();
+
+    g_main_loop_unref(loop);
+
+    return (PowerSample) {
+        .wakeups = end.wakeups - start.wakeups,
+        .context_switches = end.context_switches - start.context_switches,
+        .cpu_time_us = end.cpu_time_us - start.cpu_time_us,
+    };
+}
+
+static void assert_within_budget(PowerSample sample, const PowerBudget *budget)
+{
+    g_test_message("wakeups: %" G_GUINT64_FORMAT ", context switches: %" G_GUINT64_FORMAT
+                   ", cpu time: %" G_GINT64_FORMAT " us",
+                   sample.wakeups, sample.context_switches, sample.cpu_time_us);
+
+    g_assert_cmpuint(sample.wakeups, <=, budget->max_wakeups);
+    g_assert_cmpuint(sample.context_switches, <=, budget->max_context_switches);
+    g_assert_cmpint(sample.cpu_time_us, <=, budget->max_cpu_time_us);
+}
+
+
+/* ============================================================================
+ * Fixture
+ * ============================================================================ */
+
+// Does roughly what the main window does on every tick, without needing a display.
+static gboolean on_consumer_tick(gpointer user_data)
+{
+    PowerFixture *fixture = user_data;
+    SessionManagerPtr session_manager = fixture->session_manager;
+
+    g_autofree char *session_text =
+        g_strdup_printf("#%" G_GUINT64_FORMAT, session_manager->total_sessions_counted);
+    const char *formatted_time = sm_get_formatted_time(session_manager);
+
+    if (session_text[0] != '\0' && formatted_time[0] != '\0') {
+        fixture->consumer_updates++;
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+static void fixture_setup(PowerFixture *fixture, gconstpointer test_data)
+{
+    fixture->session_manager = sm_init(4, 25.0, 5.0, 20.0, FALSE, FALSE, NULL, fixture);
+    fixture->consumer_updates = 0;
+
+    // Let anything queued during initialisation run before measuring.
+    while (g_main_context_iteration(NULL, FALSE)) {
+    }
+}
+
+static void fixture_teardown(PowerFixture *fixture, gconstpointer test_data)
+{
+    sm_deinit(fixture->session_manager);
+}
+
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================ */
+
+static void test_idle(PowerFixture *fixture, gconstpointer test_data)
+{
+    PowerSample sample = measure_window();
+
+    g_assert_cmpint(tm_get_state(fixture->session_manager->timer_instance), ==, StIdle);
+    assert_within_budget(sample, &idleBudget);
+}
+
+static void test_running_visible(PowerFixture *fixture, gconstpointer test_data)
+{
+    fixture->session_manager->sm_timer_tick_callback = on_consumer_tick;
+    tm_trigger_event(fixture->session_manager->timer_instance, EvStart);
+
+    PowerSample sample = measure_window();
+
+    g_assert_cmpint(tm_get_state(fixture->session_manager->timer_instance), ==, StRunning);
+    g_assert_cmpuint(fixture->consumer_updates, >=, WINDOW_SECONDS - 1);
+    assert_within_budget(sample, &runningBudget);
+}
+
+static void test_running_hidden(PowerFixture *fixture, gconstpointer test_data)
+{
+    tm_trigger_event(fixture->session_manager->timer_instance, EvStart);
+
+    PowerSample sample = measure_window();
+
+    g_assert_cmpint(tm_get_state(fixture->session_manager->timer_instance), ==, StRunning);
+    assert_within_budget(sample, &runningBudget);
+}
+
+// The countdown only shows minutes then, so a fresh session does not tick within the window.
+static void test_running_low_power(PowerFixture *fixture, gconstpointer test_data)
+{
+    sm_set_low_power(fixture->session_manager, TRUE);
+    tm_trigger_event(fixture->session_manager->timer_instance, EvStart);
+
+    PowerSample sample = measure_window();
+
+    g_assert_cmpint(tm_get_state(fixture->session_manager->timer_instance), ==, StRunning);
+    assert_within_budget(sample, &idleBudget);
+}
+
+static void test_paused(PowerFixture *fixture, gconstpointer test_data)
+{
+    tm_trigger_event(fixture->session_manager->timer_instance, EvStart);
+    tm_trigger_event(fixture->session_manager->timer_instance, EvStop);
+
+    PowerSample sample = measure_window();
+
+    g_assert_cmpint(tm_get_state(fixture->session_manager->timer_instance), ==, StPaused);
+    assert_within_budget(sample, &idleBudget);
+}
+
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_main_context_set_poll_func(g_main_context_default(), counting_poll);
+
+    g_test_add("/power/idle", PowerFixture, NULL, fixture_setup, test_idle, fixture_teardown);
+    g_test_add("/power/running-visible", PowerFixture, NULL, fixture_setup, test_running_visible,
+               fixture_teardown);
+    g_test_add("/power/running-hidden", PowerFixture, NULL, fixture_setup, test_running_hidden,
+               fixture_teardown);
+    g_test_add("/power/running-low-power", PowerFixture, NULL, fixture_setup,
+               test_running_low_power, fixture_teardown);
+    g_test_add("/power/paused", PowerFixture, NULL, fixture_setup, test_paused, fixture_teardown);
+
+    return g_test_run();
+}
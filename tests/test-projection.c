@@ -0,0 +1,188 @@
+/* test-projection.c
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include <glib.h>
+#include "samaya-session.h"
+#include "samaya-timer.h"
+
+/*  The day plan projected from the session settings, checked against schedules worked out by hand
+    for four sessions of 25 minutes, with 5 minute short and 20 minute long breaks.
+
+    Projected times count from the end of the current routine, which is taken from the real clock
+    and moves on between two calls, so boundaries are checked a second to either side.
+*/
+
+#define MINUTE_US (60 * G_USEC_PER_SEC)
+
+typedef struct
+{
+    SessionManagerPtr session_manager;
+} ProjectionFixture;
+
+
+/* ============================================================================
+ * Fixture
+ * ============================================================================ */
+
+static void fixture_setup(ProjectionFixture *fixture, gconstpointer test_data)
+{
+    fixture->session_manager = sm_init(4, 25.0, 5.0, 20.0, FALSE, FALSE, NULL, NULL);
+}
+
+static void fixture_teardown(ProjectionFixture *fixture, gconstpointer test_data)
+{
+    sm_deinit(fixture->session_manager);
+}
+
+// Minutes from the end of the current routine to the start of the next long break.
+static gint64 get_long_break_start_minutes(ProjectionFixture *fixture)
+{
+    SmProjectedTimes times;
+    sm_get_projection(fixture->session_manager, &times);
+
+    g_assert_cmpint(times.long_break_end_real_us - times.long_break_start_real_us, ==,
+                    20 * MINUTE_US);
+
+    return (times.long_break_start_real_us - times.session_end_real_us) / MINUTE_US;
+}
+
+static guint32 count_sessions_within(ProjectionFixture *fixture, gint64 offset_us)
+{
+    SmProjectedTimes times;
+    sm_get_projection(fixture->session_manager, &times);
+
+    return sm_count_sessions_before(fixture->session_manager,
+                                    times.session_end_real_us + offset_us);
+}
+
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================ */
+
+static void test_fresh_cycle(ProjectionFixture *fixture, gconstpointer test_data)
+{
+    SmProjectedTimes times;
+    sm_get_projection(fixture->session_manager, &times);
+
+    g_assert_cmpuint(times.work_sessions_left, ==, 4);
+    g_assert_true(times.waits_for_user);
+
+    // Not started, so the session would end a full work duration from now.
+    gint64 session_left_us = times.session_end_real_us - g_get_real_time();
+    g_assert_cmpint(session_left_us, >, 25 * MINUTE_US - G_USEC_PER_SEC);
+    g_assert_cmpint(session_left_us, <=, 25 * MINUTE_US);
+
+    // Three more short breaks and work sessions.
+    g_assert_cmpint(get_long_break_start_minutes(fixture), ==, 90);
+}
+
+static void test_follows_transitions(ProjectionFixture *fixture, gconstpointer test_data)
+{
+    SmProjectedTimes times;
+
+    sm_skip_session();
+    g_assert_cmpint(fixture->session_manager->current_routine, ==, ShortBreak);
+    sm_get_projection(fixture->session_manager, &times);
+    g_assert_cmpuint(times.work_sessions_left, ==, 3);
+    g_assert_cmpint(get_long_break_start_minutes(fixture), ==, 3 * 25 + 2 * 5);
+
+    sm_skip_session();
+    g_assert_cmpint(get_long_break_start_minutes(fixture), ==, 2 * 30);
+
+    // The last work session of the cycle is followed by the long break itself.
+    sm_skip_session();
+    sm_skip_session();
+    sm_skip_session();
+    sm_skip_session();
+    g_assert_cmpint(fixture->session_manager->current_routine, ==, Working);
+    g_assert_cmpint(get_long_break_start_minutes(fixture), ==, 0);
+
+    // During the long break, the one of the next cycle is projected.
+    sm_skip_session();
+    g_assert_cmpint(fixture->session_manager->current_routine, ==, LongBreak);
+    sm_get_projection(fixture->session_manager, &times);
+    g_assert_cmpuint(times.work_sessions_left, ==, 4);
+    g_assert_cmpint(get_long_break_start_minutes(fixture), ==, 4 * 25 + 3 * 5);
+}
+
+static void test_follows_settings(ProjectionFixture *fixture, gconstpointer test_data)
+{
+    SmProjectedTimes times;
+
+    sm_set_work_duration(fixture->session_manager, 50.0);
+    g_assert_cmpint(get_long_break_start_minutes(fixture), ==, 3 * 55);
+
+    sm_set_short_break_duration(fixture->session_manager, 10.0);
+    g_assert_cmpint(get_long_break_start_minutes(fixture), ==, 3 * 60);
+
+    sm_set_sessions_to_complete(fixture->session_manager, 2);
+    g_assert_cmpint(get_long_break_start_minutes(fixture), ==, 60);
+
+    sm_set_auto_start_breaks(fixture->session_manager, TRUE);
+    sm_set_auto_start_work(fixture->session_manager, TRUE);
+    tm_trigger_event(fixture->session_manager->timer_instance, EvStart);
+    sm_get_projection(fixture->session_manager, &times);
+    g_assert_false(times.waits_for_user);
+}
+
+static void test_sessions_before(ProjectionFixture *fixture, gconstpointer test_data)
+{
+    gint64 second_us = G_USEC_PER_SEC;
+    gint64 cycle_us = (4 * 25 + 3 * 5 + 20) * MINUTE_US;
+
+    g_assert_cmpuint(count_sessions_within(fixture, -second_us), ==, 0);
+    g_assert_cmpuint(count_sessions_within(fixture, second_us), ==, 1);
+
+    g_assert_cmpuint(count_sessions_within(fixture, 30 * MINUTE_US - second_us), ==, 1);
+    g_assert_cmpuint(count_sessions_within(fixture, 30 * MINUTE_US + second_us), ==, 2);
+    g_assert_cmpuint(count_sessions_within(fixture, 90 * MINUTE_US + second_us), ==, 4);
+
+    // Nothing more completes during the long break and the first work session after it.
+    g_assert_cmpuint(count_sessions_within(fixture, 135 * MINUTE_US - second_us), ==, 4);
+    g_assert_cmpuint(count_sessions_within(fixture, 135 * MINUTE_US + second_us), ==, 5);
+
+    // Whole cycles later.
+    g_assert_cmpuint(count_sessions_within(fixture, 110 * MINUTE_US + 3 * cycle_us + second_us),
+                     ==, 16);
+    g_assert_cmpuint(count_sessions_within(fixture, 135 * MINUTE_US + 3 * cycle_us + second_us),
+                     ==, 17);
+}
+
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add("/projection/fresh-cycle", ProjectionFixture, NULL, fixture_setup, test_fresh_cycle,
+               fixture_teardown);
+    g_test_add("/projection/follows-transitions", ProjectionFixture, NULL, fixture_setup,
+               test_follows_transitions, fixture_teardown);
+    g_test_add("/projection/follows-settings", ProjectionFixture, NULL, fixture_setup,
+               test_follows_settings, fixture_teardown);
+    g_test_add("/projection/sessions-before", ProjectionFixture, NULL, fixture_setup,
+               test_sessions_before, fixture_teardown);
+
+    return g_test_run();
+}
@@ -0,0 +1,298 @@
+/* test-schedule.c
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include <glib.h>
+#include <time.h>
+#include "samaya-schedule.h"
+#include "samaya-session.h"
+#include "samaya-timer.h"
+
+/*  Scheduled session starts.
+
+    Times are worked out in UTC unless a case sets another zone, starting from Monday, 5 January
+    2026. Firing is only waited for with -m slow, a start can be a minute away.
+*/
+
+#define MONDAY_US (G_GINT64_CONSTANT(1767571200) * G_USEC_PER_SEC)
+#define WAIT_TIMEOUT_US (70 * G_USEC_PER_SEC)
+
+typedef struct
+{
+    SessionManagerPtr session_manager;
+} ScheduleFixture;
+
+typedef struct
+{
+    const char *text;
+    guint8 weekdays;
+    guint16 start_minute;
+    guint16 end_minute;
+    guint16 every_minutes;
+} ParseCase;
+
+static const ParseCase validRules[] = {
+    {"weekdays 09:00", 0x1f, 9 * 60, SC_MINUTES_PER_DAY, 0},
+    {"every 30m", 0x7f, 0, SC_MINUTES_PER_DAY, 30},
+    {"  fri-mon   7:05 ", 0x71, 7 * 60 + 5, SC_MINUTES_PER_DAY, 0},
+    {"Tuesday,thu 23:59", 0x0a, 23 * 60 + 59, SC_MINUTES_PER_DAY, 0},
+    {"weekends 10:00-12:00 every 45min", 0x60, 10 * 60, 12 * 60, 45},
+    {"mon-fri 09:00-24:00 every 25", 0x1f, 9 * 60, SC_MINUTES_PER_DAY, 25},
+};
+
+static const char *const invalidRules[] = {
+    "",
+    "daily",
+    "09:00-17:00",
+    "17:00-09:00 every 30m",
+    "24:00",
+    "25:00",
+    "9:60",
+    "mo 09:00",
+    "someday 09:00",
+    "daily 09:00 every",
+    "daily 09:00 every 0",
+    "daily 09:00 every 30s",
+    "every 30m 09:00",
+};
+
+// Minutes into the week of 5 January 2026.
+static gint64 week_time_us(guint day, guint hour, guint minute, guint second)
+{
+    return MONDAY_US + ((gint64) ((day * 24 + hour) * 60 + minute) * 60 + second) * G_USEC_PER_SEC;
+}
+
+static void set_rules(const char *const *texts, guint n_texts)
+{
+    ScRule rules[8];
+    g_assert_cmpuint(n_texts, <=, G_N_ELEMENTS(rules));
+
+    for (guint i = 0; i < n_texts; i++) {
+        g_autoptr(GError) error = NULL;
+        g_assert_true(sc_parse_rule(texts[i], &rules[i], &error));
+        g_assert_no_error(error);
+    }
+
+    sc_set_rules(rules, n_texts);
+}
+
+static void set_time_zone(const char *zone)
+{
+    g_setenv("TZ", zone, TRUE);
+    sc_time_zone_changed();
+}
+
+
+/* ============================================================================
+ * Fixture
+ * ============================================================================ */
+
+static void fixture_setup(ScheduleFixture *fixture, gconstpointer test_data)
+{
+    fixture->session_manager = sm_init(4, 25.0, 5.0, 20.0, FALSE, FALSE, NULL, NULL);
+}
+
+static void fixture_teardown(ScheduleFixture *fixture, gconstpointer test_data)
+{
+    sm_deinit(fixture->session_manager);
+    sc_set_rules(NULL, 0);
+}
+
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================ */
+
+static void test_parse(void)
+{
+    for (guint i = 0; i < G_N_ELEMENTS(validRules); i++) {
+        const ParseCase *expected = &validRules[i];
+        g_autoptr(GError) error = NULL;
+        ScRule rule;
+
+        g_test_message("valid: “%s”", expected->text);
+        g_assert_true(sc_parse_rule(expected->text, &rule, &error));
+        g_assert_no_error(error);
+        g_assert_cmphex(rule.weekdays, ==, expected->weekdays);
+        g_assert_cmpuint(rule.start_minute, ==, expected->start_minute);
+        g_assert_cmpuint(rule.end_minute, ==, expected->end_minute);
+        g_assert_cmpuint(rule.every_minutes, ==, expected->every_minutes);
+    }
+
+    for (guint i = 0; i < G_N_ELEMENTS(invalidRules); i++) {
+        g_autoptr(GError) error = NULL;
+        ScRule rule;
+
+        g_test_message("invalid: “%s”", invalidRules[i]);
+        g_assert_false(sc_parse_rule(invalidRules[i], &rule, &error));
+        g_assert_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT);
+    }
+}
+
+static void test_next_start(void)
+{
+    static const char *const rules[] = {
+        "weekdays 09:00",
+        "mon,wed,fri 13:30",
+        "weekends 10:00-12:00 every 45m",
+    };
+
+    g_assert_cmpint(sc_next_start_after(MONDAY_US), ==, 0);
+    set_rules(rules, G_N_ELEMENTS(rules));
+
+    g_assert_cmpint(sc_next_start_after(week_time_us(0, 8, 0, 0)), ==, week_time_us(0, 9, 0, 0));
+    g_assert_cmpint(sc_next_start_after(week_time_us(0, 8, 59, 59)), ==, week_time_us(0, 9, 0, 0));
+
+    // A start is after itself only once the minute has gone by.
+    g_assert_cmpint(sc_next_start_after(week_time_us(0, 9, 0, 0)), ==, week_time_us(0, 13, 30, 0));
+    g_assert_cmpint(sc_next_start_after(week_time_us(0, 9, 0, 30)), ==, week_time_us(0, 13, 30, 0));
+
+    g_assert_cmpint(sc_next_start_after(week_time_us(1, 10, 0, 0)), ==, week_time_us(2, 9, 0, 0));
+    g_assert_cmpint(sc_next_start_after(week_time_us(4, 14, 0, 0)), ==, week_time_us(5, 10, 0, 0));
+    g_assert_cmpint(sc_next_start_after(week_time_us(5, 10, 0, 0)), ==, week_time_us(5, 10, 45, 0));
+    g_assert_cmpint(sc_next_start_after(week_time_us(5, 11, 30, 0)), ==, week_time_us(6, 10, 0, 0));
+
+    // Round the end of the week.
+    g_assert_cmpint(sc_next_start_after(week_time_us(6, 12, 0, 0)), ==, week_time_us(7, 9, 0, 0));
+
+    sc_set_rules(NULL, 0);
+    g_assert_cmpint(sc_next_start_after(MONDAY_US), ==, 0);
+}
+
+static void test_single_start(void)
+{
+    static const char *const rules[] = {"thu 06:15"};
+    set_rules(rules, G_N_ELEMENTS(rules));
+
+    // A whole week away, counting from just after it.
+    g_assert_cmpint(sc_next_start_after(week_time_us(3, 6, 15, 0)), ==, week_time_us(10, 6, 15, 0));
+    g_assert_cmpint(sc_next_start_after(week_time_us(3, 6, 14, 0)), ==, week_time_us(3, 6, 15, 0));
+}
+
+static void test_daylight_saving(void)
+{
+    static const char *const rules[] = {"daily 09:00", "daily 02:30"};
+    set_rules(rules, G_N_ELEMENTS(rules));
+
+    // Central European time, the clocks go forward on 29 March and back on 25 October 2026.
+    set_time_zone("CET-1CEST,M3.5.0,M10.5.0/3");
+
+    gint64 march_saturday_noon_us = G_GINT64_CONSTANT(1774699200) * G_USEC_PER_SEC;
+    gint64 march_sunday_us = G_GINT64_CONSTANT(1774738800) * G_USEC_PER_SEC;
+    gint64 march_sunday_nine_us = G_GINT64_CONSTANT(1774767600) * G_USEC_PER_SEC;
+
+    // There is no 02:30 that night, the start moves to some time after it.
+    gint64 start_us = sc_next_start_after(march_saturday_noon_us);
+    g_assert_cmpint(start_us, >=, march_sunday_us);
+    g_assert_cmpint(start_us, <, march_sunday_nine_us);
+
+    // Nine in the morning of summer time is seven in UTC.
+    g_assert_cmpint(sc_next_start_after(start_us), ==, march_sunday_nine_us);
+
+    // 02:30 comes twice in October, a start at the first is not repeated at the second.
+    gint64 october_first_us = G_GINT64_CONSTANT(1792888200) * G_USEC_PER_SEC;
+    gint64 october_second_us = G_GINT64_CONSTANT(1792891800) * G_USEC_PER_SEC;
+    gint64 october_nine_us = G_GINT64_CONSTANT(1792915200) * G_USEC_PER_SEC;
+
+    g_assert_cmpint(sc_next_start_after(october_first_us), ==, october_nine_us);
+    g_assert_cmpint(sc_next_start_after(october_second_us - 20 * 60 * G_USEC_PER_SEC), ==,
+                    october_second_us);
+
+    set_time_zone("UTC");
+}
+
+static void test_offset_span(void)
+{
+    static const char *const rules[] = {"sun 09:00"};
+    set_rules(rules, G_N_ELEMENTS(rules));
+    set_time_zone("CET-1CEST,M3.5.0,M10.5.0/3");
+
+    // Within the two weeks from Monday, 9 March, nine in the morning is still eight in UTC.
+    gint64 march_tuesday_us = G_GINT64_CONSTANT(1773140400) * G_USEC_PER_SEC;
+    gint64 march_sunday_nine_us = G_GINT64_CONSTANT(1773561600) * G_USEC_PER_SEC;
+    gint64 last_sunday_us = G_GINT64_CONSTANT(1774168200) * G_USEC_PER_SEC;
+    g_assert_cmpint(sc_next_start_after(march_tuesday_us), ==, march_sunday_nine_us);
+
+    // The Sunday after the last one of the span is in summer time.
+    gint64 summer_sunday_nine_us = G_GINT64_CONSTANT(1774767600) * G_USEC_PER_SEC;
+    g_assert_cmpint(sc_next_start_after(last_sunday_us), ==, summer_sunday_nine_us);
+
+    // The span cached for one zone is not used in another.
+    set_time_zone("JST-9");
+    g_assert_cmpint(sc_next_start_after(march_tuesday_us), ==,
+                    march_sunday_nine_us - 8 * 60 * 60 * G_USEC_PER_SEC);
+
+    set_time_zone("UTC");
+}
+
+static void test_session_start(ScheduleFixture *fixture, gconstpointer test_data)
+{
+    SessionManagerPtr session_manager = fixture->session_manager;
+    ScRule rule;
+
+    g_assert_true(sc_parse_rule("every 1m", &rule, NULL));
+    sm_set_routine(ShortBreak, session_manager);
+    sm_set_schedule(session_manager, &rule, 1);
+
+    gint64 now_us = g_get_real_time();
+    gint64 armed_us = sc_get_armed_real_us();
+    g_assert_true(sc_is_enabled());
+    g_assert_cmpint(armed_us, >, now_us);
+    g_assert_cmpint(armed_us, <=, now_us + 60 * G_USEC_PER_SEC);
+    g_assert_cmpint(armed_us % (60 * G_USEC_PER_SEC), ==, 0);
+
+    if (g_test_slow()) {
+        gint64 deadline_us = g_get_monotonic_time() + WAIT_TIMEOUT_US;
+        while (tm_get_state(session_manager->timer_instance) == StIdle &&
+               g_get_monotonic_time() < deadline_us) {
+            g_main_context_iteration(NULL, TRUE);
+        }
+
+        // Breaks are cut short, a work session is started.
+        g_assert_cmpint(tm_get_state(session_manager->timer_instance), ==, StRunning);
+        g_assert_cmpint(session_manager->current_routine, ==, Working);
+        g_assert_cmpint(sc_get_armed_real_us(), >, armed_us);
+    }
+
+    sm_set_schedule(session_manager, NULL, 0);
+    g_assert_false(sc_is_enabled());
+    g_assert_cmpint(sc_get_armed_real_us(), ==, 0);
+}
+
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(int argc, char *argv[])
+{
+    set_time_zone("UTC");
+
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/schedule/parse", test_parse);
+    g_test_add_func("/schedule/next-start", test_next_start);
+    g_test_add_func("/schedule/single-start", test_single_start);
+    g_test_add_func("/schedule/daylight-saving", test_daylight_saving);
+    g_test_add_func("/schedule/offset-span", test_offset_span);
+    g_test_add("/schedule/session-start", ScheduleFixture, NULL, fixture_setup, test_session_start,
+               fixture_teardown);
+
+    return g_test_run();
+}
@@ -0,0 +1,368 @@
+/* test-sleep.c
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include <fcntl.h>
+#include <gio/gio.h>
+#include <gio/gunixfdlist.h>
+#include <glib-unix.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include "samaya-mock-bus.h"
+#include "samaya-session.h"
+#include "samaya-sleep.h"
+#include "samaya-timer.h"
+
+/*  Keeping the running routine in step with suspend and resume.
+
+    Every case runs against a private bus with a mock of logind on it, which hands out delay
+    inhibitor locks as the write end of a pipe, so the test sees the lock being let go of as the
+    read end hanging up, and announces sleep and wake up with PrepareForSleep. The timer runs on a
+    virtual clock that the test moves on while the system is "asleep".
+*/
+
+#define MINUTE_US (60 * G_USEC_PER_SEC)
+
+static const char mockIntrospectionXml[] =
+    "<node>"
+    "  <interface name='" SL_INTERFACE "'>"
+    "    <method name='Inhibit'>"
+    "      <arg name='what' direction='in' type='s'/>"
+    "      <arg name='who' direction='in' type='s'/>"
+    "      <arg name='why' direction='in' type='s'/>"
+    "      <arg name='mode' direction='in' type='s'/>"
+    "      <arg name='fd' direction='out' type='h'/>"
+    "    </method>"
+    "    <signal name='PrepareForSleep'>"
+    "      <arg name='start' type='b'/>"
+    "    </signal>"
+    "  </interface>"
+    "</node>";
+
+static gint64 virtualClockUs = 0;
+
+// Routines that made it into the history.
+static GArray *historyRecords = NULL;
+
+// Completions the user was told about, and the last one of them.
+static guint nAnnounced = 0;
+static RoutineType lastAnnounced = Working;
+
+typedef struct
+{
+    MockBus mock_bus;
+
+    // Read end of the pipe behind the last lock handed out, -1 before the first one.
+    gint lock_fd;
+    guint n_inhibits;
+
+    SessionManagerPtr session_manager;
+} SleepFixture;
+
+
+/* ============================================================================
+ * Mock logind
+ * ============================================================================ */
+
+static void on_mock_method_call(GDBusConnection *connection, const gchar *sender,
+                                const gchar *object_path, const gchar *interface_name,
+                                const gchar *method_name, GVariant *parameters,
+                                GDBusMethodInvocation *invocation, gpointer user_data)
+{
+    SleepFixture *fixture = user_data;
+    g_autoptr(GError) error = NULL;
+
+    if (g_strcmp0(method_name, "Inhibit") != 0) {
+        g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR,
+                                              G_DBUS_ERROR_UNKNOWN_METHOD, "Unknown method %s",
+                                              method_name);
+        return;
+    }
+
+    const gchar *what = NULL;
+    const gchar *mode = NULL;
+    g_variant_get(parameters, "(&s&s&s&s)", &what, NULL, NULL, &mode);
+    g_assert_cmpstr(what, ==, "sleep");
+    g_assert_cmpstr(mode, ==, "delay");
+
+    gint fds[2];
+    g_assert_true(g_unix_open_pipe(fds, FD_CLOEXEC, &error));
+    g_assert_no_error(error);
+
+    g_autoptr(GUnixFDList) fd_list = g_unix_fd_list_new_from_array(&fds[1], 1);
+
+    if (fixture->lock_fd >= 0) {
+        g_close(fixture->lock_fd, NULL);
+    }
+    fixture->lock_fd = fds[0];
+    fixture->n_inhibits++;
+
+    g_dbus_method_invocation_return_value_with_unix_fd_list(invocation, g_variant_new("(h)", 0),
+                                                            fd_list);
+}
+
+static const GDBusInterfaceVTable mockVTable = {.method_call = on_mock_method_call};
+
+// The client holds the lock as long as the write end of its pipe is open.
+static gboolean is_lock_held(SleepFixture *fixture)
+{
+    GPollFD poll_fd = {.fd = fixture->lock_fd, .events = G_IO_IN | G_IO_HUP};
+
+    g_assert_cmpint(fixture->lock_fd, >=, 0);
+
+    return g_poll(&poll_fd, 1, 0) == 0;
+}
+
+static void prepare_for_sleep(SleepFixture *fixture, gboolean start)
+{
+    g_autoptr(GError) error = NULL;
+
+    g_dbus_connection_emit_signal(fixture->mock_bus.service, NULL, SL_OBJECT_PATH, SL_INTERFACE,
+                                  "PrepareForSleep", g_variant_new("(b)", start), &error);
+    g_assert_no_error(error);
+
+    mock_bus_sync(&fixture->mock_bus);
+}
+
+// Suspends the system for the given time, as far as the virtual clock is concerned.
+static void sleep_for(SleepFixture *fixture, gint64 asleep_us)
+{
+    prepare_for_sleep(fixture, TRUE);
+    virtualClockUs += asleep_us;
+    prepare_for_sleep(fixture, FALSE);
+}
+
+
+/* ============================================================================
+ * Fixture
+ * ============================================================================ */
+
+static gint64 virtual_clock(void)
+{
+    return virtualClockUs;
+}
+
+static void on_history_recorded(const HsRecord *record, gpointer user_data)
+{
+    g_array_append_vals(historyRecords, record, 1);
+}
+
+static void on_completion_shown(RoutineType ended_routine, gpointer backend_data)
+{
+    nAnnounced++;
+    lastAnnounced = ended_routine;
+}
+
+static const SmBackend countingBackend = {.show_completion = on_completion_shown};
+
+static void fixture_setup(SleepFixture *fixture, gconstpointer test_data)
+{
+    fixture->lock_fd = -1;
+    historyRecords = g_array_new(FALSE, FALSE, sizeof(HsRecord));
+
+    mock_bus_up(&fixture->mock_bus, mockIntrospectionXml);
+    mock_bus_register_object(&fixture->mock_bus, SL_OBJECT_PATH, SL_INTERFACE, &mockVTable,
+                             fixture);
+    mock_bus_own_name(&fixture->mock_bus, SL_BUS_NAME);
+
+    virtualClockUs = 1000 * G_USEC_PER_SEC;
+
+    fixture->session_manager = sm_init(4, 25.0, 5.0, 20.0, FALSE, FALSE, NULL, NULL);
+    tm_set_clock(fixture->session_manager->timer_instance, virtual_clock);
+    sm_set_history_callback(on_history_recorded);
+    sm_set_backend(fixture->session_manager, &countingBackend, NULL);
+    nAnnounced = 0;
+
+    sl_enable(fixture->mock_bus.client);
+    ITERATE_UNTIL(fixture->n_inhibits == 1);
+    mock_bus_sync(&fixture->mock_bus);
+}
+
+static void fixture_teardown(SleepFixture *fixture, gconstpointer test_data)
+{
+    sl_disable();
+    sm_deinit(fixture->session_manager);
+
+    if (fixture->lock_fd >= 0) {
+        g_close(fixture->lock_fd, NULL);
+    }
+    g_clear_pointer(&historyRecords, g_array_unref);
+
+    mock_bus_down(&fixture->mock_bus);
+}
+
+static TimerPtr start_work(SleepFixture *fixture)
+{
+    TimerPtr timer = fixture->session_manager->timer_instance;
+
+    sm_set_routine(Working, fixture->session_manager);
+    tm_trigger_event(timer, EvStart);
+
+    return timer;
+}
+
+static const HsRecord *get_record(guint index)
+{
+    g_assert_cmpuint(index, <, historyRecords->len);
+
+    return &g_array_index(historyRecords, HsRecord, index);
+}
+
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================ */
+
+static void test_drop_ticks(SleepFixture *fixture, gconstpointer test_data)
+{
+    TimerPtr timer = start_work(fixture);
+    g_assert_true(is_lock_held(fixture));
+    g_assert_cmpuint(timer->tick_source_id, !=, 0);
+
+    prepare_for_sleep(fixture, TRUE);
+
+    // Stays running, just without a tick source, and lets the system go to sleep.
+    g_assert_cmpint(tm_get_state(timer), ==, StRunning);
+    g_assert_cmpuint(timer->tick_source_id, ==, 0);
+    g_assert_false(is_lock_held(fixture));
+
+    prepare_for_sleep(fixture, FALSE);
+
+    g_assert_cmpuint(timer->tick_source_id, !=, 0);
+    ITERATE_UNTIL(fixture->n_inhibits == 2);
+    mock_bus_sync(&fixture->mock_bus);
+    g_assert_true(is_lock_held(fixture));
+}
+
+static void test_still_running(SleepFixture *fixture, gconstpointer test_data)
+{
+    TimerPtr timer = start_work(fixture);
+    const TmTickStats *stats = tm_get_tick_stats(timer);
+
+    sleep_for(fixture, 4 * MINUTE_US);
+
+    // A single tick brought it up to date.
+    g_assert_cmpint(tm_get_state(timer), ==, StRunning);
+    g_assert_cmpint(tm_get_remaining_time_ms(timer), ==, 21 * 60 * 1000);
+    g_assert_cmpuint(stats->n_ticks, ==, 1);
+    g_assert_cmpuint(historyRecords->len, ==, 0);
+}
+
+static void test_catch_up(SleepFixture *fixture, gconstpointer test_data)
+{
+    SessionManagerPtr session_manager = fixture->session_manager;
+    sm_set_auto_start_breaks(session_manager, TRUE);
+    sm_set_auto_start_work(session_manager, TRUE);
+
+    TimerPtr timer = start_work(fixture);
+
+    // The work session and the short break after it ran out, the next work session went on.
+    sleep_for(fixture, (25 + 5 + 3) * MINUTE_US);
+
+    g_assert_cmpint(session_manager->current_routine, ==, Working);
+    g_assert_cmpint(tm_get_state(timer), ==, StRunning);
+    g_assert_cmpint(tm_get_remaining_time_ms(timer), ==, 22 * 60 * 1000);
+    g_assert_cmpuint(session_manager->sessions_completed, ==, 1);
+    g_assert_cmpuint(timer->tick_source_id, !=, 0);
+
+    g_assert_cmpuint(historyRecords->len, ==, 2);
+
+    // Only the last one is announced, once the session caught up.
+    g_assert_cmpuint(nAnnounced, ==, 1);
+    g_assert_cmpint(lastAnnounced, ==, ShortBreak);
+
+    const HsRecord *work = get_record(0);
+    const HsRecord *short_break = get_record(1);
+
+    g_assert_cmpint(work->routine, ==, Working);
+    g_assert_cmpint(work->outcome, ==, HsCompleted);
+    g_assert_cmpint(short_break->routine, ==, ShortBreak);
+    g_assert_cmpint(short_break->outcome, ==, HsCompleted);
+
+    // Each ended at its own deadline rather than on waking up.
+    g_assert_cmpint(ABS(short_break->start_real_us - work->end_real_us), <, G_USEC_PER_SEC);
+    g_assert_cmpint(ABS(short_break->end_real_us - work->end_real_us - 5 * MINUTE_US), <,
+                    G_USEC_PER_SEC);
+    g_assert_cmpint(ABS(g_get_real_time() - short_break->end_real_us - 3 * MINUTE_US), <,
+                    G_USEC_PER_SEC);
+}
+
+static void test_waits_for_user(SleepFixture *fixture, gconstpointer test_data)
+{
+    SessionManagerPtr session_manager = fixture->session_manager;
+    TimerPtr timer = start_work(fixture);
+
+    sleep_for(fixture, 40 * MINUTE_US);
+
+    // Breaks are not started on their own, so the chain ends with the work session.
+    g_assert_cmpint(session_manager->current_routine, ==, ShortBreak);
+    g_assert_cmpint(tm_get_state(timer), ==, StIdle);
+    g_assert_cmpuint(timer->tick_source_id, ==, 0);
+    g_assert_cmpuint(historyRecords->len, ==, 1);
+}
+
+static void test_monotonic_clock(SleepFixture *fixture, gconstpointer test_data)
+{
+    TimerPtr timer = start_work(fixture);
+
+    virtualClockUs += 3 * G_USEC_PER_SEC;
+
+    // Switching clocks keeps the time run since the last tick.
+    sm_set_count_suspended_time(fixture->session_manager, FALSE);
+    tm_set_clock(timer, virtual_clock);
+
+    virtualClockUs += 2 * G_USEC_PER_SEC;
+    tm_resume_ticks(timer);
+
+    g_assert_cmpint(tm_get_remaining_time_ms(timer), ==, 25 * 60 * 1000 - 5000);
+}
+
+static void test_disable(SleepFixture *fixture, gconstpointer test_data)
+{
+    g_assert_true(is_lock_held(fixture));
+
+    sl_disable();
+    g_assert_false(sl_is_enabled());
+    g_assert_false(is_lock_held(fixture));
+}
+
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add("/sleep/drop-ticks", SleepFixture, NULL, fixture_setup, test_drop_ticks,
+               fixture_teardown);
+    g_test_add("/sleep/still-running", SleepFixture, NULL, fixture_setup, test_still_running,
+               fixture_teardown);
+    g_test_add("/sleep/catch-up", SleepFixture, NULL, fixture_setup, test_catch_up,
+               fixture_teardown);
+    g_test_add("/sleep/waits-for-user", SleepFixture, NULL, fixture_setup, test_waits_for_user,
+               fixture_teardown);
+    g_test_add("/sleep/monotonic-clock", SleepFixture, NULL, fixture_setup, test_monotonic_clock,
+               fixture_teardown);
+    g_test_add("/sleep/disable", SleepFixture, NULL, fixture_setup, test_disable,
+               fixture_teardown);
+
+    return g_test_run();
+}
@@ -0,0 +1,201 @@
+/* test-snapshot.c
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include <glib.h>
+#include "samaya-session.h"
+#include "samaya-timer.h"
+
+/*  Reading the session state from other threads.
+
+    Durations are picked so every routine has a different length, which lets a reader tell a torn
+    snapshot apart from a consistent one: the routine, its length and the timer state of a
+    snapshot always have to belong together.
+*/
+
+#define N_READERS 4
+#define N_WRITES 20000
+
+typedef struct
+{
+    SessionManagerPtr session_manager;
+} SnapshotFixture;
+
+typedef struct
+{
+    gint *stop;
+    gint *n_started;
+    guint64 n_reads;
+    guint64 n_torn;
+} Reader;
+
+
+/* ============================================================================
+ * Fixture
+ * ============================================================================ */
+
+static void fixture_setup(SnapshotFixture *fixture, gconstpointer test_data)
+{
+    fixture->session_manager = sm_init(4, 25.0, 5.0, 20.0, FALSE, FALSE, NULL, NULL);
+}
+
+static void fixture_teardown(SnapshotFixture *fixture, gconstpointer test_data)
+{
+    sm_deinit(fixture->session_manager);
+}
+
+static guint64 routine_ms(const SmSnapshot *snapshot)
+{
+    switch (snapshot->routine) {
+        case Working:
+            return (guint64) (snapshot->work_duration * 60 * 1000);
+        case ShortBreak:
+            return (guint64) (snapshot->short_break_duration * 60 * 1000);
+        case LongBreak:
+            return (guint64) (snapshot->long_break_duration * 60 * 1000);
+        default:
+            return 0;
+    }
+}
+
+static gboolean is_consistent(const SmSnapshot *snapshot)
+{
+    return snapshot->initial_ms == routine_ms(snapshot) &&
+           snapshot->remaining_ms <= snapshot->initial_ms &&
+           (snapshot->state == StRunning) == (snapshot->deadline_us != 0);
+}
+
+static gpointer run_reader(gpointer user_data)
+{
+    Reader *reader = user_data;
+    guint64 last_sequence = 0;
+
+    g_atomic_int_inc(reader->n_started);
+
+    while (!g_atomic_int_get(reader->stop)) {
+        SmSnapshot snapshot;
+        sm_snapshot(&snapshot);
+
+        if (!is_consistent(&snapshot) || snapshot.sequence < last_sequence) {
+            reader->n_torn++;
+        }
+        last_sequence = snapshot.sequence;
+        reader->n_reads++;
+    }
+
+    return NULL;
+}
+
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================ */
+
+static void test_follows_session(SnapshotFixture *fixture, gconstpointer test_data)
+{
+    SessionManagerPtr session_manager = fixture->session_manager;
+    SmSnapshot snapshot;
+
+    sm_snapshot(&snapshot);
+    g_assert_cmpint(snapshot.state, ==, StIdle);
+    g_assert_cmpint(snapshot.routine, ==, Working);
+    g_assert_cmpuint(snapshot.initial_ms, ==, 25 * 60 * 1000);
+    g_assert_cmpint(snapshot.deadline_us, ==, 0);
+    g_assert_cmpuint(sm_snapshot_get_remaining_ms(&snapshot), ==, 25 * 60 * 1000);
+    guint64 sequence = snapshot.sequence;
+
+    tm_trigger_event(session_manager->timer_instance, EvStart);
+    sm_snapshot(&snapshot);
+    g_assert_cmpint(snapshot.state, ==, StRunning);
+    g_assert_cmpint(snapshot.deadline_us, ==, tm_get_deadline_us(session_manager->timer_instance));
+    g_assert_cmpuint(sm_snapshot_get_remaining_ms(&snapshot), <=, 25 * 60 * 1000);
+    g_assert_cmpuint(sm_snapshot_get_remaining_ms(&snapshot), >, 25 * 60 * 1000 - 5000);
+    g_assert_cmpuint(snapshot.sequence, >, sequence);
+
+    sm_skip_session();
+    sm_set_sessions_to_complete(session_manager, 6);
+    sm_set_auto_start_work(session_manager, TRUE);
+    sm_set_tag(session_manager, 7);
+
+    sm_snapshot(&snapshot);
+    g_assert_cmpint(snapshot.state, ==, StIdle);
+    g_assert_cmpint(snapshot.routine, ==, ShortBreak);
+    g_assert_cmpuint(snapshot.initial_ms, ==, 5 * 60 * 1000);
+    g_assert_cmpuint(snapshot.sessions_completed, ==, 1);
+    g_assert_cmpuint(snapshot.total_sessions_counted, ==, 1);
+    g_assert_cmpuint(snapshot.sessions_to_complete, ==, 6);
+    g_assert_true(snapshot.auto_start_work);
+    g_assert_false(snapshot.auto_start_breaks);
+    g_assert_cmpuint(snapshot.tag_id, ==, 7);
+}
+
+static void test_concurrent_readers(SnapshotFixture *fixture, gconstpointer test_data)
+{
+    SessionManagerPtr session_manager = fixture->session_manager;
+    TimerPtr timer = session_manager->timer_instance;
+    gint stop = 0;
+    gint n_started = 0;
+    Reader readers[N_READERS];
+    GThread *threads[N_READERS];
+
+    for (guint i = 0; i < N_READERS; i++) {
+        readers[i] = (Reader) {.stop = &stop, .n_started = &n_started};
+        threads[i] = g_thread_new("snapshot-reader", run_reader, &readers[i]);
+    }
+
+    // Every reader is in its loop before the session starts changing.
+    while (g_atomic_int_get(&n_started) < N_READERS) {
+        g_thread_yield();
+    }
+
+    for (guint i = 0; i < N_WRITES; i++) {
+        sm_set_routine((RoutineType) (i % 3), session_manager);
+        tm_trigger_event(timer, EvStart);
+        if (i % 2) {
+            tm_trigger_event(timer, EvStop);
+        }
+    }
+
+    g_atomic_int_set(&stop, 1);
+
+    for (guint i = 0; i < N_READERS; i++) {
+        g_thread_join(threads[i]);
+
+        g_test_message("reader %u: %" G_GUINT64_FORMAT " reads", i, readers[i].n_reads);
+        g_assert_cmpuint(readers[i].n_reads, >, 0);
+        g_assert_cmpuint(readers[i].n_torn, ==, 0);
+    }
+}
+
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add("/snapshot/follows-session", SnapshotFixture, NULL, fixture_setup,
+               test_follows_session, fixture_teardown);
+    g_test_add("/snapshot/concurrent-readers", SnapshotFixture, NULL, fixture_setup,
+               test_concurrent_readers, fixture_teardown);
+
+    return g_test_run();
+}
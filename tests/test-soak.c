@@ -0,0 +1,313 @@
+/* test-soak.c
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include <adwaita.h>
+#include <sys/resource.h>
+#include "samaya-alloc-counter.h"
+#include "samaya-application.h"
+#include "samaya-session.h"
+#include "samaya-timer-private.h"
+#include "samaya-timer.h"
+
+/*  Soak test of the tick and session paths over a month of use.
+
+    A month of back to back routines, all of them started on their own, runs in a few seconds
+    under a fake clock that moves on by a tick interval before every tick. Every allocation and
+    free of the process is counted through samaya-alloc-counter, and the test fails when the
+    number of blocks still allocated, the peak resident set or the allocations per tick or per
+    session keep growing once the first day filled the caches of GLib and GTK.
+
+    The core runs on its own first, then inside the real application with its window on a private
+    session bus, which needs a display like the render benchmark. Meson runs the test through
+    samaya-headless.sh to give it one, when no display can be opened that case is skipped.
+*/
+
+#define SOAK_DAYS 30
+#define WARMUP_DAYS 1
+#define WEEK_DAYS 7
+#define DAY_US (G_GINT64_CONSTANT(24) * 60 * 60 * G_USEC_PER_SEC)
+#define TICK_US (TM_TICK_INTERVAL_MS * 1000)
+
+// Blocks still allocated may go up by this much after the first day, the caches of GLib and
+// GTK are filled lazily. A leak in the tick or session path adds thousands over the month.
+#define LIVE_BLOCKS_SLACK 64
+
+// Allocations per tick or per session of the last week may go over the first by this factor.
+#define ALLOCATION_RATE_TOLERANCE 1.1
+
+// The tick path of the core allocates nothing, only the completions in between do.
+#define CORE_ALLOCATIONS_PER_TICK 0.05
+
+#define CORE_RSS_SLACK_KIB 256
+#define UI_RSS_SLACK_KIB 4096
+
+#define REINIT_ROUNDS 8
+#define REINIT_TICKS 120
+
+typedef struct
+{
+    AllocCounterSample allocs;
+    guint64 ticks;
+    guint64 sessions;
+    glong peak_rss_kib;
+} SoakSample;
+
+typedef struct
+{
+    const char *name;
+    SessionManagerPtr session_manager;
+    // Zero leaves the allocations per tick unchecked, only their growth is.
+    gdouble max_allocations_per_tick;
+    glong rss_slack_kib;
+} SoakRun;
+
+static gint64 fakeClockUs = 0;
+
+
+/* ============================================================================
+ * Measurement Helpers
+ * ============================================================================ */
+
+static gint64 fake_clock(void)
+{
+    return fakeClockUs;
+}
+
+static glong get_peak_rss_kib(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    return usage.ru_maxrss;
+}
+
+static SoakSample take_sample(SoakRun *run)
+{
+    SessionManagerPtr session_manager = run->session_manager;
+
+    return (SoakSample) {
+        .allocs = alloc_counter_sample(),
+        .ticks = tm_get_tick_stats(session_manager->timer_instance)->n_ticks,
+        .sessions = session_manager->total_sessions_counted,
+        .peak_rss_kib = get_peak_rss_kib(),
+    };
+}
+
+// Ticks the timer through a day of fake time, letting the main loop run whatever it queued.
+static void run_day(SoakRun *run)
+{
+    TimerPtr timer = run->session_manager->timer_instance;
+
+    for (gint64 elapsed_us = 0; elapsed_us < DAY_US; elapsed_us += TICK_US) {
+        fakeClockUs += TICK_US;
+
+        tm_run_tick(timer);
+        g_main_context_iteration(NULL, FALSE);
+    }
+}
+
+static gdouble get_allocations_per(guint64 allocations, guint64 count)
+{
+    return count > 0 ? (gdouble) allocations / count : 0.0;
+}
+
+static void assert_rate_flat(SoakRun *run, const char *what, gdouble first_week,
+                             gdouble last_week)
+{
+    g_test_message("%s: %.3f allocations per %s in the first week, %.3f in the last", run->name,
+                   first_week, what, last_week);
+
+    // Rounding aside, a path that allocated nothing must keep allocating nothing.
+    g_assert_cmpfloat(last_week, <=, first_week * ALLOCATION_RATE_TOLERANCE + 0.01);
+}
+
+// Compares the allocations per tick and per session of the first and the last week.
+static void assert_rates_flat(SoakRun *run, const SoakSample *samples)
+{
+    const SoakSample *first_start = &samples[WARMUP_DAYS];
+    const SoakSample *first_end = &samples[WARMUP_DAYS + WEEK_DAYS];
+    const SoakSample *last_start = &samples[SOAK_DAYS - WEEK_DAYS];
+    const SoakSample *last_end = &samples[SOAK_DAYS];
+
+    guint64 first_allocations = first_end->allocs.allocations - first_start->allocs.allocations;
+    guint64 last_allocations = last_end->allocs.allocations - last_start->allocs.allocations;
+
+    gdouble first_per_tick =
+        get_allocations_per(first_allocations, first_end->ticks - first_start->ticks);
+    gdouble last_per_tick =
+        get_allocations_per(last_allocations, last_end->ticks - last_start->ticks);
+
+    assert_rate_flat(run, "tick", first_per_tick, last_per_tick);
+    if (run->max_allocations_per_tick > 0) {
+        g_assert_cmpfloat(first_per_tick, <=, run->max_allocations_per_tick);
+    }
+
+    assert_rate_flat(
+        run, "session",
+        get_allocations_per(first_allocations, first_end->sessions - first_start->sessions),
+        get_allocations_per(last_allocations, last_end->sessions - last_start->sessions));
+}
+
+static void run_soak(SoakRun *run)
+{
+    SessionManagerPtr session_manager = run->session_manager;
+    SoakSample samples[SOAK_DAYS + 1];
+
+    fakeClockUs = g_get_monotonic_time();
+    tm_set_clock(session_manager->timer_instance, fake_clock);
+
+    sm_set_auto_start_breaks(session_manager, TRUE);
+    sm_set_auto_start_work(session_manager, TRUE);
+    sm_start(session_manager);
+
+    samples[0] = take_sample(run);
+    for (guint day = 1; day <= SOAK_DAYS; day++) {
+        run_day(run);
+        samples[day] = take_sample(run);
+    }
+
+    const SoakSample *settled = &samples[WARMUP_DAYS];
+    const SoakSample *last = &samples[SOAK_DAYS];
+
+    // Four work sessions every 135 minutes, some 42 a day.
+    g_assert_cmpuint(last->sessions - settled->sessions, >, 40 * (SOAK_DAYS - WARMUP_DAYS));
+
+    assert_rates_flat(run, samples);
+
+    gint64 live_growth =
+        alloc_counter_live_blocks(last->allocs) - alloc_counter_live_blocks(settled->allocs);
+    glong rss_growth_kib = last->peak_rss_kib - settled->peak_rss_kib;
+
+    g_test_message("%s: %" G_GUINT64_FORMAT " ticks and %" G_GUINT64_FORMAT " work sessions, %"
+                   G_GINT64_FORMAT " blocks and %ld KiB peak RSS more than after the first day",
+                   run->name, last->ticks - samples[0].ticks, last->sessions - samples[0].sessions,
+                   live_growth, rss_growth_kib);
+
+    g_assert_cmpint(live_growth, <=, LIVE_BLOCKS_SLACK);
+    g_assert_cmpint(rss_growth_kib, <=, run->rss_slack_kib);
+
+    tm_trigger_event(session_manager->timer_instance, EvReset);
+}
+
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================ */
+
+static void test_core(void)
+{
+    SoakRun run = {
+        .name = "core",
+        .session_manager = sm_init(4, 25.0, 5.0, 20.0, FALSE, FALSE, NULL, NULL),
+        .max_allocations_per_tick = CORE_ALLOCATIONS_PER_TICK,
+        .rss_slack_kib = CORE_RSS_SLACK_KIB,
+    };
+
+    run_soak(&run);
+
+    sm_deinit(run.session_manager);
+}
+
+// Session managers created and torn down again, as the tools and tests do, leave nothing behind.
+static void test_reinit(void)
+{
+    gint64 live_blocks = 0;
+
+    for (guint round = 0; round < REINIT_ROUNDS; round++) {
+        // The first round fills the caches of GLib.
+        if (round == 1) {
+            live_blocks = alloc_counter_live_blocks(alloc_counter_sample());
+        }
+
+        SessionManagerPtr session_manager =
+            sm_init(4, 25.0, 5.0, 20.0, TRUE, TRUE, NULL, NULL);
+        tm_set_clock(session_manager->timer_instance, fake_clock);
+        sm_start(session_manager);
+
+        for (guint tick = 0; tick < REINIT_TICKS; tick++) {
+            fakeClockUs += 30 * TICK_US;
+            tm_run_tick(session_manager->timer_instance);
+        }
+
+        sm_deinit(session_manager);
+        while (g_main_context_iteration(NULL, FALSE)) {
+        }
+    }
+
+    g_assert_cmpint(alloc_counter_live_blocks(alloc_counter_sample()), <=, live_blocks);
+}
+
+static void on_activate(GApplication *app, gpointer user_data)
+{
+    SoakRun run = {
+        .name = "ui",
+        .session_manager = sm_get_default(),
+        .rss_slack_kib = UI_RSS_SLACK_KIB,
+    };
+
+    // Keeps the first frames of the window out of the warm-up day.
+    for (guint i = 0; i < 100; i++) {
+        g_main_context_iteration(NULL, FALSE);
+    }
+
+    run_soak(&run);
+
+    g_application_quit(app);
+}
+
+static void test_ui(void)
+{
+    if (!gtk_init_check()) {
+        g_test_skip("No display available");
+        return;
+    }
+
+    // A private bus, so the notifications of a month of sessions do not end up on the desktop.
+    GTestDBus *bus = g_test_dbus_new(G_TEST_DBUS_NONE);
+    g_test_dbus_up(bus);
+
+    SamayaApplication *app =
+        samaya_application_new("io.github.redddfoxxyy.samaya.Soak", G_APPLICATION_NON_UNIQUE);
+
+    // Runs after the default handler, which creates and presents the main window.
+    g_signal_connect_after(app, "activate", G_CALLBACK(on_activate), NULL);
+
+    g_assert_cmpint(g_application_run(G_APPLICATION(app), 0, NULL), ==, 0);
+
+    g_object_unref(app);
+    g_test_dbus_down(bus);
+    g_object_unref(bus);
+}
+
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/soak/core", test_core);
+    g_test_add_func("/soak/reinit", test_reinit);
+    g_test_add_func("/soak/ui", test_ui);
+
+    return g_test_run();
+}
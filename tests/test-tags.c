@@ -0,0 +1,302 @@
+/* test-tags.c
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include "samaya-history.h"
+#include "samaya-session.h"
+#include "samaya-tags.h"
+
+/*  Interning, completion and totals of session tags.
+
+    Every case starts with an empty tag table and history in a temporary directory. Reloading the
+    table is done the way Samaya does it when it starts again, by enabling it anew from the files.
+*/
+
+typedef struct
+{
+    gchar *directory;
+    gchar *tags_path;
+    gchar *history_path;
+} TagsFixture;
+
+
+/* ============================================================================
+ * Fixture
+ * ============================================================================ */
+
+static void fixture_setup(TagsFixture *fixture, gconstpointer test_data)
+{
+    fixture->directory = g_dir_make_tmp("samaya-tags-XXXXXX", NULL);
+    g_assert_nonnull(fixture->directory);
+
+    fixture->tags_path = g_build_filename(fixture->directory, "tags.txt", NULL);
+    fixture->history_path = g_build_filename(fixture->directory, "history.bin", NULL);
+
+    tg_enable(fixture->tags_path, fixture->history_path);
+    g_assert_true(tg_is_enabled());
+}
+
+static void fixture_teardown(TagsFixture *fixture, gconstpointer test_data)
+{
+    tg_disable();
+    hs_disable();
+
+    g_unlink(fixture->tags_path);
+    g_unlink(fixture->history_path);
+    g_rmdir(fixture->directory);
+
+    g_free(fixture->history_path);
+    g_free(fixture->tags_path);
+    g_free(fixture->directory);
+}
+
+static HsRecord work_record(guint32 tag_id, guint32 duration_ms, HsOutcome outcome)
+{
+    HsRecord record = {
+        .start_real_us = g_get_real_time(),
+        .end_real_us = g_get_real_time() + duration_ms * (gint64) 1000,
+        .duration_ms = duration_ms,
+        .planned_ms = 25 * 60 * 1000,
+        .routine = Working,
+        .outcome = outcome,
+        .tag_id = tag_id,
+    };
+
+    return record;
+}
+
+static void wait_for_totals(void)
+{
+    while (!tg_totals_are_ready()) {
+        g_main_context_iteration(NULL, TRUE);
+    }
+}
+
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================ */
+
+static void test_intern(TagsFixture *fixture, gconstpointer test_data)
+{
+    guint32 thesis = tg_intern("Thesis");
+    guint32 samaya = tg_intern("Samaya");
+
+    g_assert_cmpuint(thesis, !=, TG_NO_TAG);
+    g_assert_cmpuint(samaya, !=, TG_NO_TAG);
+    g_assert_cmpuint(thesis, !=, samaya);
+    g_assert_cmpuint(tg_get_n_tags(), ==, 2);
+
+    // Interning a known name gives its id back without adding to the table.
+    g_assert_cmpuint(tg_intern("Thesis"), ==, thesis);
+    g_assert_cmpuint(tg_lookup("Samaya"), ==, samaya);
+    g_assert_cmpuint(tg_lookup("Unknown"), ==, TG_NO_TAG);
+    g_assert_cmpuint(tg_get_n_tags(), ==, 2);
+
+    g_assert_cmpstr(tg_get_name(thesis), ==, "Thesis");
+    g_assert_null(tg_get_name(TG_NO_TAG));
+    g_assert_null(tg_get_name(1000));
+
+    // Ids are kept across restarts, new tags come after the loaded ones.
+    tg_enable(fixture->tags_path, fixture->history_path);
+
+    g_assert_cmpuint(tg_get_n_tags(), ==, 2);
+    g_assert_cmpuint(tg_lookup("Thesis"), ==, thesis);
+    g_assert_cmpuint(tg_lookup("Samaya"), ==, samaya);
+    g_assert_cmpstr(tg_get_name(samaya), ==, "Samaya");
+
+    guint32 reading = tg_intern("Reading");
+    g_assert_cmpuint(reading, >, MAX(thesis, samaya));
+}
+
+static void test_normalize(TagsFixture *fixture, gconstpointer test_data)
+{
+    g_assert_cmpuint(tg_intern(""), ==, TG_NO_TAG);
+    g_assert_cmpuint(tg_intern("   "), ==, TG_NO_TAG);
+    g_assert_cmpuint(tg_intern(NULL), ==, TG_NO_TAG);
+
+    guint32 tag_id = tg_intern("  Thesis\n");
+    g_assert_cmpstr(tg_get_name(tag_id), ==, "Thesis");
+    g_assert_cmpuint(tg_intern("Thesis"), ==, tag_id);
+
+    // A line break inside a name must not split the table file.
+    guint32 split = tg_intern("Chapter\nTwo");
+    g_assert_cmpstr(tg_get_name(split), ==, "Chapter Two");
+
+    g_autofree gchar *long_name = g_strnfill(TG_MAX_NAME_LENGTH * 2, 'x');
+    guint32 long_id = tg_intern(long_name);
+    g_assert_cmpuint(strlen(tg_get_name(long_id)), ==, TG_MAX_NAME_LENGTH);
+
+    tg_enable(fixture->tags_path, fixture->history_path);
+
+    g_assert_cmpuint(tg_lookup("Thesis"), ==, tag_id);
+    g_assert_cmpuint(tg_lookup("Chapter Two"), ==, split);
+    g_assert_cmpuint(tg_get_n_tags(), ==, 3);
+}
+
+static void test_torn_table(TagsFixture *fixture, gconstpointer test_data)
+{
+    guint32 thesis = tg_intern("Thesis");
+    tg_disable();
+
+    // Samaya was killed while appending a tag.
+    g_assert_true(g_file_set_contents(fixture->tags_path, "Thesis\nSam", -1, NULL));
+
+    tg_enable(fixture->tags_path, fixture->history_path);
+
+    g_assert_cmpuint(tg_lookup("Thesis"), ==, thesis);
+    g_assert_cmpuint(tg_lookup("Sam"), ==, TG_NO_TAG);
+    g_assert_cmpuint(tg_intern("Samaya"), ==, thesis + 1);
+}
+
+static void test_complete(TagsFixture *fixture, gconstpointer test_data)
+{
+    guint32 tag_ids[8];
+
+    guint32 samaya = tg_intern("samaya");
+    guint32 sanskrit = tg_intern("Sanskrit");
+    guint32 release = tg_intern("Samaya release");
+    tg_intern("Thesis");
+
+    // Alphabetical, ignoring case.
+    g_assert_cmpuint(tg_complete("SA", tag_ids, G_N_ELEMENTS(tag_ids)), ==, 3);
+    g_assert_cmpuint(tag_ids[0], ==, samaya);
+    g_assert_cmpuint(tag_ids[1], ==, release);
+    g_assert_cmpuint(tag_ids[2], ==, sanskrit);
+
+    g_assert_cmpuint(tg_complete("samaya ", tag_ids, G_N_ELEMENTS(tag_ids)), ==, 1);
+    g_assert_cmpuint(tag_ids[0], ==, release);
+
+    g_assert_cmpuint(tg_complete("sa", tag_ids, 2), ==, 2);
+    g_assert_cmpuint(tg_complete("x", tag_ids, G_N_ELEMENTS(tag_ids)), ==, 0);
+    g_assert_cmpuint(tg_complete("", tag_ids, G_N_ELEMENTS(tag_ids)), ==, 4);
+
+    // The index loaded from the file is sorted the same way.
+    tg_enable(fixture->tags_path, fixture->history_path);
+
+    g_assert_cmpuint(tg_complete("sa", tag_ids, G_N_ELEMENTS(tag_ids)), ==, 3);
+    g_assert_cmpuint(tag_ids[0], ==, samaya);
+    g_assert_cmpuint(tag_ids[1], ==, release);
+    g_assert_cmpuint(tag_ids[2], ==, sanskrit);
+}
+
+static void test_totals(TagsFixture *fixture, gconstpointer test_data)
+{
+    guint32 thesis = tg_intern("Thesis");
+    guint32 samaya = tg_intern("Samaya");
+
+    hs_enable(fixture->history_path);
+
+    HsRecord records[] = {
+        work_record(thesis, 25 * 60 * 1000, HsCompleted),
+        work_record(thesis, 10 * 60 * 1000, HsSkipped),
+        work_record(samaya, 25 * 60 * 1000, HsCompleted),
+        work_record(TG_NO_TAG, 25 * 60 * 1000, HsCompleted),
+    };
+    for (gsize i = 0; i < G_N_ELEMENTS(records); i++) {
+        hs_append(&records[i]);
+    }
+
+    // Breaks are not counted towards the tag that was set while they ran.
+    HsRecord break_record = work_record(thesis, 5 * 60 * 1000, HsCompleted);
+    break_record.routine = ShortBreak;
+    hs_append(&break_record);
+
+    // The history is summed up when the table is enabled, the way Samaya starts.
+    tg_enable(fixture->tags_path, fixture->history_path);
+    wait_for_totals();
+
+    TgTotals totals = tg_get_totals(thesis);
+    g_assert_cmpuint(totals.work_ms, ==, 35 * 60 * 1000);
+    g_assert_cmpuint(totals.completed_sessions, ==, 1);
+
+    totals = tg_get_totals(samaya);
+    g_assert_cmpuint(totals.work_ms, ==, 25 * 60 * 1000);
+    g_assert_cmpuint(totals.completed_sessions, ==, 1);
+
+    totals = tg_get_totals(TG_NO_TAG);
+    g_assert_cmpuint(totals.work_ms, ==, 0);
+
+    // Sessions ending from now on are added as they end.
+    HsRecord record = work_record(samaya, 25 * 60 * 1000, HsCompleted);
+    hs_append(&record);
+    tg_add_record(&record);
+
+    totals = tg_get_totals(samaya);
+    g_assert_cmpuint(totals.work_ms, ==, 50 * 60 * 1000);
+    g_assert_cmpuint(totals.completed_sessions, ==, 2);
+
+    // And a restart sums up the same from the history.
+    tg_enable(fixture->tags_path, fixture->history_path);
+    wait_for_totals();
+
+    totals = tg_get_totals(samaya);
+    g_assert_cmpuint(totals.work_ms, ==, 50 * 60 * 1000);
+    g_assert_cmpuint(totals.completed_sessions, ==, 2);
+
+    // A session ending while the history is still being summed up is counted once.
+    tg_enable(fixture->tags_path, fixture->history_path);
+    g_assert_false(tg_totals_are_ready());
+
+    record = work_record(samaya, 10 * 60 * 1000, HsSkipped);
+    hs_append(&record);
+    tg_add_record(&record);
+
+    totals = tg_get_totals(samaya);
+    g_assert_cmpuint(totals.work_ms, ==, 10 * 60 * 1000);
+
+    wait_for_totals();
+    totals = tg_get_totals(samaya);
+    g_assert_cmpuint(totals.work_ms, ==, 60 * 60 * 1000);
+    g_assert_cmpuint(totals.completed_sessions, ==, 2);
+
+    // Disabling before the history is summed up leaves the table enabled next alone.
+    tg_enable(fixture->tags_path, fixture->history_path);
+    tg_disable();
+    tg_enable(fixture->tags_path, fixture->history_path);
+    wait_for_totals();
+
+    totals = tg_get_totals(thesis);
+    g_assert_cmpuint(totals.work_ms, ==, 35 * 60 * 1000);
+    totals = tg_get_totals(samaya);
+    g_assert_cmpuint(totals.work_ms, ==, 60 * 60 * 1000);
+}
+
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add("/tags/intern", TagsFixture, NULL, fixture_setup, test_intern, fixture_teardown);
+    g_test_add("/tags/normalize", TagsFixture, NULL, fixture_setup, test_normalize,
+               fixture_teardown);
+    g_test_add("/tags/torn-table", TagsFixture, NULL, fixture_setup, test_torn_table,
+               fixture_teardown);
+    g_test_add("/tags/complete", TagsFixture, NULL, fixture_setup, test_complete,
+               fixture_teardown);
+    g_test_add("/tags/totals", TagsFixture, NULL, fixture_setup, test_totals, fixture_teardown);
+
+    return g_test_run();
+}
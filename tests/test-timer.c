@@ -0,0 +1,181 @@
+/* test-timer.c
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+#include <glib.h>
+#include "samaya-timer-private.h"
+#include "samaya-timer.h"
+
+/*  The timer state machine, driven by hand under a virtual clock.
+
+    Ticks are run directly instead of from the main loop, so every case decides exactly how late
+    each of them comes.
+*/
+
+static gint64 virtualClockUs = 0;
+
+typedef struct
+{
+    TimerPtr timer;
+} TimerFixture;
+
+
+/* ============================================================================
+ * Fixture
+ * ============================================================================ */
+
+static gint64 virtual_clock(void)
+{
+    return virtualClockUs;
+}
+
+static void fixture_setup(TimerFixture *fixture, gconstpointer test_data)
+{
+    virtualClockUs = 1000 * G_USEC_PER_SEC;
+
+    fixture->timer = tm_new(1.0f, NULL, NULL, NULL);
+    tm_set_clock(fixture->timer, virtual_clock);
+}
+
+static void fixture_teardown(TimerFixture *fixture, gconstpointer test_data)
+{
+    tm_free(fixture->timer);
+}
+
+static gboolean tick_after(TimerFixture *fixture, gint64 elapsed_us)
+{
+    virtualClockUs += elapsed_us;
+
+    return tm_run_tick(fixture->timer);
+}
+
+
+/* ============================================================================
+ * Test Cases
+ * ============================================================================ */
+
+static void test_tick_stats(TimerFixture *fixture, gconstpointer test_data)
+{
+    TimerPtr timer = fixture->timer;
+    const TmTickStats *stats = tm_get_tick_stats(timer);
+
+    tm_trigger_event(timer, EvStart);
+    g_assert_cmpuint(stats->n_ticks, ==, 0);
+
+    tick_after(fixture, G_USEC_PER_SEC + 2300);
+    g_assert_cmpuint(stats->n_ticks, ==, 1);
+    g_assert_cmpint(stats->last_jitter_us, ==, 2300);
+    g_assert_cmpint(stats->completion_latency_us, ==, 0);
+
+    // Early ticks count as negative jitter.
+    tick_after(fixture, G_USEC_PER_SEC - 500);
+    g_assert_cmpint(stats->last_jitter_us, ==, -500);
+
+    // Runs the timer down to 300 ms, a tick at the usual period then notices the end 700 ms late.
+    tick_after(fixture, (tm_get_remaining_time_ms(timer) - 300) * 1000);
+    g_assert_cmpint(tm_get_remaining_time_ms(timer), ==, 300);
+
+    g_assert_false(tick_after(fixture, G_USEC_PER_SEC));
+    g_assert_cmpint(tm_get_state(timer), ==, StIdle);
+    g_assert_cmpint(stats->completion_latency_us, ==, 700 * 1000);
+    g_assert_cmpuint(stats->n_ticks, ==, 4);
+}
+
+static void test_pause_keeps_time(TimerFixture *fixture, gconstpointer test_data)
+{
+    TimerPtr timer = fixture->timer;
+
+    tm_trigger_event(timer, EvStart);
+    tick_after(fixture, G_USEC_PER_SEC);
+
+    virtualClockUs += 500 * 1000;
+    tm_trigger_event(timer, EvStop);
+    g_assert_cmpint(tm_get_state(timer), ==, StPaused);
+    g_assert_cmpint(tm_get_remaining_time_ms(timer), ==, 58500);
+    g_assert_cmpint(tm_get_deadline_us(timer), ==, 0);
+
+    // Time spent paused does not count.
+    virtualClockUs += 60 * G_USEC_PER_SEC;
+    tm_trigger_event(timer, EvStart);
+    g_assert_cmpint(tm_get_deadline_us(timer), ==, virtualClockUs + 58500 * 1000);
+
+    tm_trigger_event(timer, EvReset);
+    g_assert_cmpint(tm_get_state(timer), ==, StIdle);
+    g_assert_cmpint(tm_get_remaining_time_ms(timer), ==, 60 * 1000);
+}
+
+static void test_transition_table(TimerFixture *fixture, gconstpointer test_data)
+{
+    TimerPtr timer = fixture->timer;
+
+    // Stopping an idle timer and anything after it exited is rejected.
+    g_assert_false(tm_is_transition_valid(StIdle, EvStop));
+    for (guint event = 0; event < TM_N_EVENTS; event++) {
+        g_assert_false(tm_is_transition_valid(StExited, event));
+    }
+    g_assert_true(tm_is_transition_valid(StPaused, EvStart));
+    g_assert_false(tm_is_transition_valid(TM_N_STATES, EvStart));
+
+    g_test_expect_message(G_LOG_DOMAIN, G_LOG_LEVEL_WARNING, "Invalid transition*");
+    tm_trigger_event(timer, EvStop);
+    g_test_assert_expected_messages();
+    g_assert_cmpint(tm_get_state(timer), ==, StIdle);
+
+    tm_trigger_event(timer, EvStart);
+    tm_trigger_event(timer, EvStart);
+    tm_trigger_event(timer, EvStop);
+    tm_trigger_event(timer, EvReset);
+
+    g_assert_cmpuint(tm_get_transition_stats(timer, StIdle, EvStop)->count, ==, 0);
+    g_assert_cmpuint(tm_get_transition_stats(timer, StIdle, EvStop)->n_rejected, ==, 1);
+    g_assert_cmpuint(tm_get_transition_stats(timer, StIdle, EvStart)->count, ==, 1);
+    g_assert_cmpuint(tm_get_transition_stats(timer, StRunning, EvStart)->count, ==, 1);
+    g_assert_cmpuint(tm_get_transition_stats(timer, StRunning, EvStop)->count, ==, 1);
+    g_assert_cmpuint(tm_get_transition_stats(timer, StPaused, EvReset)->count, ==, 1);
+    g_assert_cmpuint(tm_get_transition_stats(timer, StRunning, EvReset)->count, ==, 0);
+    g_assert_cmpuint(tm_get_transition_stats(timer, StRunning, EvStart)->n_rejected, ==, 0);
+
+    // Only transitions with an action are timed.
+    g_assert_cmpint(tm_get_transition_stats(timer, StIdle, EvStop)->action_time_us, ==, 0);
+    g_assert_cmpint(tm_get_transition_stats(timer, StRunning, EvStart)->action_time_us, ==, 0);
+    g_assert_cmpint(tm_get_transition_stats(timer, StIdle, EvStart)->action_time_us, >=, 0);
+    g_assert_cmpint(tm_get_transition_stats(timer, StIdle, EvStart)->update_time_us, >=, 0);
+    g_assert_cmpint(tm_get_transition_stats(timer, StRunning, EvStart)->update_time_us, ==, 0);
+
+    g_assert_cmpstr(tm_state_to_string(StPaused), ==, "Paused");
+    g_assert_cmpstr(tm_event_to_string(EvReset), ==, "Reset");
+}
+
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(int argc, char *argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add("/timer/tick-stats", TimerFixture, NULL, fixture_setup, test_tick_stats,
+               fixture_teardown);
+    g_test_add("/timer/pause-keeps-time", TimerFixture, NULL, fixture_setup,
+               test_pause_keeps_time, fixture_teardown);
+    g_test_add("/timer/transition-table", TimerFixture, NULL, fixture_setup,
+               test_transition_table, fixture_teardown);
+
+    return g_test_run();
+}
@@ -0,0 +1,356 @@
+/* samaya-replay.c
+ *
+ * Copyright 2025 Suyog Tandel
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include <gio/gio.h>
+#include <stdio.h>
+#include "samaya-session-private.h"
+#include "samaya-session.h"
+#include "samaya-timer-private.h"
+#include "samaya-timer.h"
+#include "samaya-trace.h"
+
+/*  Replays a trace recorded with `samaya --trace`.
+
+    The recorded external inputs (timer events, ticks, time added back, routine and setting changes,
+    skips and planned starts) are fed through the real state machine under a virtual clock that
+    jumps straight to the time of each record, so hours of recorded use replay as fast as the code
+    runs. The trace produced by the replay is compared record by record with the original, and
+    the first divergence is reported.
+*/
+
+static gint64 virtualClockUs = 0;
+
+// The plans of the recording, handed out again in order by replay_planner().
+static const TrRecord *planRecords = NULL;
+static gsize nPlanRecords = 0;
+static gsize planCursor = 0;
+
+static gboolean verbose = FALSE;
+static gint loops = 1;
+
+static const GOptionEntry replayOptions[] = {
+    {"verbose", 'v', 0, G_OPTION_ARG_NONE, &verbose, "Print every record while replaying", NULL},
+    {"loops", 'l', 0, G_OPTION_ARG_INT, &loops, "Replay the trace N times, for profiling", "N"},
+    G_OPTION_ENTRY_NULL,
+};
+
+
+/* ============================================================================
+ * Replay
+ * ============================================================================ */
+
+static gint64 virtual_clock(void)
+{
+    return virtualClockUs;
+}
+
+// The calendars the recording planned around are not around, the session gets their answers.
+static SmPlanDecision replay_planner(gint64 start_real_us, guint64 duration_ms, gboolean automatic,
+                                     guint64 *value_ms, gpointer user_data)
+{
+    while (planCursor < nPlanRecords && planRecords[planCursor].kind != TrPlan) {
+        planCursor++;
+    }
+    if (planCursor == nPlanRecords) {
+        return SmPlanStart;
+    }
+
+    const TrRecord *record = &planRecords[planCursor++];
+    *value_ms = record->value;
+    return (SmPlanDecision) record->arg_a;
+}
+
+static gboolean has_plans(const TrRecord *records, gsize n_records)
+{
+    for (gsize i = 0; i < n_records; i++) {
+        if (records[i].kind == TrPlan) {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static gdouble trace_value_to_duration(guint32 value)
+{
+    return value / (60.0 * 1000.0);
+}
+
+static void print_record(const char *prefix, gsize index, const TrRecord *record)
+{
+    printf("%s%8" G_GSIZE_FORMAT " %16" G_GINT64_FORMAT " %-10s a=%u b=%u flags=%u value=%u\n",
+           prefix, index, record->time_us, tr_record_kind_to_string(record->kind), record->arg_a,
+           record->arg_b, record->flags, record->value);
+}
+
+// Snapshot records only describe the starting state, so they are written straight into it.
+static void apply_snapshot_record(SessionManagerPtr session_manager, const TrRecord *record)
+{
+    if (record->kind == TrRoutine) {
+        session_manager->current_routine = (RoutineType) record->arg_a;
+        return;
+    }
+
+    // The timer is restored once the routine is set up, see replay().
+    if (record->kind == TrTick) {
+        return;
+    }
+
+    switch ((TrSettingKey) record->arg_a) {
+        case TrWorkDuration:
+            session_manager->work_duration = trace_value_to_duration(record->value);
+            break;
+        case TrShortBreakDuration:
+            session_manager->short_break_duration = trace_value_to_duration(record->value);
+            break;
+        case TrLongBreakDuration:
+            session_manager->long_break_duration = trace_value_to_duration(record->value);
+            break;
+        case TrSessionsToComplete:
+            session_manager->sessions_to_complete = (guint8) record->value;
+            break;
+        case TrAutoStartBreaks:
+            session_manager->auto_start_breaks = record->value;
+            break;
+        case TrAutoStartWork:
+            session_manager->auto_start_work = record->value;
+            break;
+        default:
+            g_warning("Unknown setting %u in snapshot", record->arg_a);
+            break;
+    }
+}
+
+static void apply_setting_record(SessionManagerPtr session_manager, const TrRecord *record)
+{
+    switch ((TrSettingKey) record->arg_a) {
+        case TrWorkDuration:
+            sm_set_work_duration(session_manager, trace_value_to_duration(record->value));
+            break;
+        case TrShortBreakDuration:
+            sm_set_short_break_duration(session_manager, trace_value_to_duration(record->value));
+            break;
+        case TrLongBreakDuration:
+            sm_set_long_break_duration(session_manager, trace_value_to_duration(record->value));
+            break;
+        case TrSessionsToComplete:
+            sm_set_sessions_to_complete(session_manager, (guint16) record->value);
+            break;
+        case TrAutoStartBreaks:
+            sm_set_auto_start_breaks(session_manager, record->value);
+            break;
+        case TrAutoStartWork:
+            sm_set_auto_start_work(session_manager, record->value);
+            break;
+        default:
+            g_warning("Unknown setting %u in trace", record->arg_a);
+            break;
+    }
+}
+
+// Everything the user or the main loop fed into the state machine is replayed, the records it
+// produced in response are only compared.
+static void apply_record(SessionManagerPtr session_manager, const TrRecord *record)
+{
+    if (record->flags & (TR_FLAG_INTERNAL | TR_FLAG_SNAPSHOT)) {
+        return;
+    }
+
+    switch ((TrRecordKind) record->kind) {
+        case TrEvent:
+            tm_process_transition(session_manager->timer_instance, (TmEvent) record->arg_a);
+            break;
+        case TrTick:
+            tm_run_tick(session_manager->timer_instance);
+            break;
+        case TrRoutine:
+            sm_set_routine((RoutineType) record->arg_a, session_manager);
+            break;
+        case TrSetting:
+            apply_setting_record(session_manager, record);
+            break;
+        case TrComplete:
+            // Completions that ran out are reproduced by the ticks, only skips are inputs.
+            if (record->arg_b == 0) {
+                on_session_complete(NULL);
+            }
+            break;
+        case TrAddTime:
+            tm_add_time(session_manager->timer_instance, record->value);
+            break;
+        case TrPlan:
+            sm_start_planned(session_manager, record->arg_b);
+            break;
+        case TrTransition:
+        default:
+            break;
+    }
+}
+
+static gboolean records_match(const TrRecord *expected, const TrRecord *actual)
+{
+    // Internal records are timestamped by the trace clock rather than the triggering record.
+    gboolean time_matches =
+        (expected->flags & TR_FLAG_INTERNAL) || expected->time_us == actual->time_us;
+
+    return time_matches && expected->kind == actual->kind && expected->arg_a == actual->arg_a &&
+           expected->arg_b == actual->arg_b && expected->flags == actual->flags &&
+           expected->value == actual->value;
+}
+
+static gboolean replay(const TrRecord *records, gsize n_records, gint64 *elapsed_us)
+{
+    gsize snapshot_end = 0;
+    while (snapshot_end < n_records && (records[snapshot_end].flags & TR_FLAG_SNAPSHOT)) {
+        snapshot_end++;
+    }
+
+    if (snapshot_end == 0) {
+        g_printerr("Trace has no starting snapshot, it probably wrapped around. Replaying from "
+                   "default settings, expect divergences.\n");
+    }
+
+    virtualClockUs = records[0].time_us;
+
+    SessionManagerPtr session_manager = sm_init(4, 25.0, 5.0, 20.0, FALSE, FALSE, NULL, NULL);
+    tm_set_clock(session_manager->timer_instance, virtual_clock);
+
+    planRecords = records;
+    nPlanRecords = n_records;
+    planCursor = snapshot_end;
+    if (has_plans(records, n_records)) {
+        sm_set_planner(session_manager, replay_planner, NULL);
+    }
+
+    const TrRecord *timer_snapshot = NULL;
+    for (gsize i = 0; i < snapshot_end; i++) {
+        apply_snapshot_record(session_manager, &records[i]);
+
+        if (records[i].kind == TrTick) {
+            timer_snapshot = &records[i];
+        }
+    }
+    sm_set_routine(session_manager->current_routine, session_manager);
+
+    // The trace was started on a session resumed from a checkpoint.
+    if (timer_snapshot != NULL) {
+        TimerPtr timer = session_manager->timer_instance;
+
+        virtualClockUs = timer_snapshot->time_us;
+        tm_restore(timer, (TmState) timer_snapshot->arg_a, timer->initial_time_ms,
+                   timer_snapshot->value);
+        virtualClockUs = records[0].time_us;
+    }
+
+    tr_enable(n_records + snapshot_end, virtual_clock, NULL);
+    sm_trace_snapshot(session_manager);
+
+    gint64 start_us = g_get_monotonic_time();
+
+    for (gsize i = snapshot_end; i < n_records; i++) {
+        virtualClockUs = records[i].time_us;
+
+        if (verbose) {
+            print_record("  ", i, &records[i]);
+        }
+        apply_record(session_manager, &records[i]);
+    }
+
+    *elapsed_us = g_get_monotonic_time() - start_us;
+
+    gsize n_replayed = 0;
+    g_autofree TrRecord *replayed = tr_copy_records(&n_replayed);
+
+    tr_disable();
+    sm_deinit(session_manager);
+
+    gsize n_compared = MIN(n_records, n_replayed);
+    for (gsize i = 0; i < n_compared; i++) {
+        if (!records_match(&records[i], &replayed[i])) {
+            printf("Replay diverged at record %" G_GSIZE_FORMAT ":\n", i);
+            print_record("  recorded ", i, &records[i]);
+            print_record("  replayed ", i, &replayed[i]);
+            return FALSE;
+        }
+    }
+
+    if (n_records != n_replayed) {
+        printf("Replay produced %" G_GSIZE_FORMAT " records, the trace has %" G_GSIZE_FORMAT
+               ".\n",
+               n_replayed, n_records);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(int argc, char *argv[])
+{
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GOptionContext) context = g_option_context_new("TRACE - replay a Samaya trace");
+
+    g_option_context_add_main_entries(context, replayOptions, NULL);
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        g_printerr("%s\n", error->message);
+        return 1;
+    }
+
+    if (argc != 2) {
+        g_printerr("Expected exactly one trace file, see --help.\n");
+        return 1;
+    }
+
+    gsize n_records = 0;
+    g_autofree TrRecord *records = tr_load(argv[1], &n_records, &error);
+    if (records == NULL) {
+        g_printerr("%s\n", error->message);
+        return 1;
+    }
+
+    if (n_records == 0) {
+        printf("Trace is empty.\n");
+        return 0;
+    }
+
+    gboolean matched = TRUE;
+    gint64 total_elapsed_us = 0;
+
+    for (gint loop = 0; loop < MAX(loops, 1); loop++) {
+        gint64 elapsed_us = 0;
+
+        matched &= replay(records, n_records, &elapsed_us);
+        total_elapsed_us += elapsed_us;
+    }
+
+    gint64 recorded_span_us = records[n_records - 1].time_us - records[0].time_us;
+    gdouble ns_per_record = (gdouble) total_elapsed_us * 1000.0 / (n_records * MAX(loops, 1));
+
+    printf("%" G_GSIZE_FORMAT " records spanning %.1f s replayed in %.3f ms (%.1f ns/record): %s\n",
+           n_records, recorded_span_us / (gdouble) G_USEC_PER_SEC,
+           total_elapsed_us / 1000.0 / MAX(loops, 1), ns_per_record,
+           matched ? "identical" : "diverged");
+
+    return matched ? 0 : 2;
+}